@@ -0,0 +1,101 @@
+#ifndef BENCH_HARNESS_H
+#define BENCH_HARNESS_H
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include "pheno_perf.h"
+
+// Microbenchmark harness for gosiuml-bench. Each case is timed over
+// warmup repetitions (discarded) and measured repetitions of a fixed
+// number of operations. Repetitions further than a few median absolute
+// deviations from the median are rejected as outliers (preemption, page
+// faults, frequency changes) and the rest are summarised.
+//
+// Latency cases report ns per operation; cases whose body returns a byte
+// count report MB/s instead.
+//
+// With counters (pheno_perf.h) open on the calling thread, each measured
+// repetition is also bracketed by counter reads, and results carry the
+// counts per operation over the kept repetitions. Work a case hands to
+// other threads is not counted.
+
+// Body of a case: run `iterations` operations on state. Returns the
+// number of bytes processed (0 for latency cases), or -1 if the case
+// cannot run (for example because a fixed pool ran out).
+typedef int64_t (*BenchFunc)(void* state, uint64_t iterations);
+
+typedef struct {
+    const char* name;           // "group/variant"
+    BenchFunc run;
+    void* state;
+    uint64_t iterations;        // Per repetition; 0 calibrates to min_time
+} BenchCase;
+
+typedef struct {
+    int warmup;                 // Repetitions run and discarded
+    int repetitions;            // Repetitions measured
+    double min_time;            // Seconds per repetition when calibrating
+    double threshold;           // Relative change flagged against the baseline
+    const PhenoPerf* perf;      // Counters of the calling thread, NULL for none
+} BenchOptions;
+
+#define BENCH_NAME_MAX 64
+
+typedef struct {
+    char name[BENCH_NAME_MAX];
+    const char* unit;           // "ns/op" or "MB/s"
+    bool failed;
+    uint64_t iterations;
+    int repetitions;
+    int kept;                   // Repetitions left after outlier rejection
+    double median;              // Over the kept repetitions, in unit
+    double mean;
+    double min;
+    double max;
+    double stddev;
+    uint32_t counters_valid;    // Mask of PhenoPerfCounter
+    double counters[PHENO_PERF_COUNT];  // Per operation (per iteration for MB/s cases)
+} BenchResult;
+
+void bench_defaults(BenchOptions* options);
+
+// Monotonic time in nanoseconds
+uint64_t bench_now_ns(void);
+
+// Send stdout (where the core logs with printf) to /dev/null and return
+// a stream on the original stdout for the report, NULL on failure
+FILE* bench_redirect_stdout(void);
+
+// Time one case
+void bench_run(const BenchCase* bc, const BenchOptions* options, BenchResult* result);
+
+// Table header and one row per result. With a baseline, each row also
+// shows the change of the median and flags regressions beyond the
+// threshold (slower for ns/op, lower for MB/s); bench_print_result
+// returns true if its row regressed.
+void bench_print_header(FILE* out, bool with_baseline);
+bool bench_print_result(FILE* out, const BenchResult* result, const BenchResult* baseline,
+                        double threshold);
+
+// Counter table: one row per result, "-" for counters not measured
+void bench_print_counters_header(FILE* out);
+void bench_print_counters(FILE* out, const BenchResult* result);
+
+// Results as JSON, one result object per line
+void bench_write_json(FILE* out, const BenchOptions* options, const BenchResult* results,
+                      size_t count);
+
+// Read results written by bench_write_json. Returns the number read
+// (at most max), -1 if the file cannot be opened.
+int bench_read_json(const char* path, BenchResult* results, size_t max);
+
+// Entry of results[0..count) with the given name, NULL if absent
+const BenchResult* bench_find(const BenchResult* results, size_t count, const char* name);
+
+// Multi-threaded contention benchmark (bench_contention.c), run as
+// `gosiuml-bench contention [options]`. argv[0] is "contention"; the
+// report goes to `report`. Returns the process exit status.
+int bench_contention_main(int argc, char* argv[], FILE* report);
+
+#endif // BENCH_HARNESS_H
@@ -10,4 +10,8 @@ int parse_cli_config(const char* config_file);
 void print_token_info(PhenoToken* token);
 void display_state_diagram(GosiUMLContext* ctx);
 
+// Run the subcommand named by argv[1] (e.g. "compile"); returns its exit
+// status, or -1 if argv[1] is not a subcommand
+int cli_run_command(int argc, char* argv[]);
+
 #endif // CLI_PARSER_H
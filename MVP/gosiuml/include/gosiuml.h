@@ -15,7 +15,8 @@
 typedef enum {
     FORMAT_SVG = 0,
     FORMAT_XML = 1,
-    FORMAT_JSON = 2
+    FORMAT_JSON = 2,
+    FORMAT_NDJSON = 3       // One JSON object per line, for streaming
 } GosiUMLFormat;
 
 // Options
@@ -31,6 +32,7 @@ typedef struct GosiUMLContext GosiUMLContext;
 
 // Include platform definitions (contains PhenoToken, PhenoState, etc)
 #include "phenomemory_platform.h"
+#include "token_parser.h"
 
 // Function prototypes
 int gosiuml_init(void);
@@ -43,10 +45,13 @@ PhenoToken* gosiuml_parse_file(const char* filename, int* count);
 PhenoToken* gosiuml_create_token(uint8_t type, const char* name);
 void gosiuml_free_token(PhenoToken* token);
 void gosiuml_free_tokens(PhenoToken* tokens, int count);
+const PhenoEdge* gosiuml_token_relations(const PhenoToken* tokens, size_t* count);
+int gosiuml_parse_stream(int fd, TokenCallback on_token, RelationCallback on_relation, void* user);
 int gosiuml_process_token(GosiUMLContext* ctx, PhenoToken* token);
 int gosiuml_generate_svg(GosiUMLContext* ctx, PhenoToken* tokens, int count, const char* output_file);
 int gosiuml_generate_xml(GosiUMLContext* ctx, PhenoToken* tokens, int count, const char* output_file);
 int gosiuml_generate_json(GosiUMLContext* ctx, PhenoToken* tokens, int count, const char* output_file);
+int gosiuml_export_fd(int fd, GosiUMLFormat format, PhenoToken* tokens, int count);
 int gosiuml_get_state(PhenoToken* token);
 int gosiuml_transition(PhenoToken* token, int new_state);
 int gosiuml_test_state_machine(GosiUMLContext* ctx);
@@ -0,0 +1,40 @@
+#ifndef PHENO_BITMAP_H
+#define PHENO_BITMAP_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+
+// Compressed bitmap of uint32_t row ids (roaring layout): ids are
+// grouped by their high 16 bits into containers that hold the low 16
+// bits either as a sorted array (sparse) or a 65536-bit set (dense)
+typedef struct PhenoBitmapContainer PhenoBitmapContainer;
+
+typedef struct {
+    PhenoBitmapContainer* containers;  // Sorted by key
+    uint32_t count;
+    uint32_t capacity;
+} PhenoBitmap;
+
+// Lifecycle
+void pheno_bitmap_init(PhenoBitmap* bm);
+void pheno_bitmap_free(PhenoBitmap* bm);
+void pheno_bitmap_clear(PhenoBitmap* bm);
+bool pheno_bitmap_copy(PhenoBitmap* dst, const PhenoBitmap* src);
+
+// Membership. add fails only when memory runs out; remove returns
+// whether the id was present.
+bool pheno_bitmap_add(PhenoBitmap* bm, uint32_t id);
+bool pheno_bitmap_remove(PhenoBitmap* bm, uint32_t id);
+bool pheno_bitmap_contains(const PhenoBitmap* bm, uint32_t id);
+uint64_t pheno_bitmap_cardinality(const PhenoBitmap* bm);
+
+// Set algebra; out must be initialized and must not alias an input
+bool pheno_bitmap_and(const PhenoBitmap* a, const PhenoBitmap* b, PhenoBitmap* out);
+bool pheno_bitmap_or(const PhenoBitmap* a, const PhenoBitmap* b, PhenoBitmap* out);
+bool pheno_bitmap_andnot(const PhenoBitmap* a, const PhenoBitmap* b, PhenoBitmap* out);
+
+// Write ids in ascending order; out must hold cardinality entries
+size_t pheno_bitmap_to_array(const PhenoBitmap* bm, uint32_t* out);
+
+#endif // PHENO_BITMAP_H
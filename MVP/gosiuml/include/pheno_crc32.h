@@ -0,0 +1,11 @@
+#ifndef PHENO_CRC32_H
+#define PHENO_CRC32_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+// CRC-32 (IEEE 802.3, as used by gzip and zlib). Pass 0 to start and the
+// previous result to continue over further data.
+uint32_t pheno_crc32(uint32_t crc, const void* data, size_t size);
+
+#endif // PHENO_CRC32_H
@@ -0,0 +1,37 @@
+#ifndef PHENO_DEFLATE_H
+#define PHENO_DEFLATE_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+#include "pheno_writer.h"
+
+// Deflate encoder (RFC 1951) for compressed exports. Input is compressed
+// in independent chunks, pigz style: each chunk may refer back into the
+// PHENO_DEFLATE_WINDOW bytes before it and ends byte-aligned with an
+// empty stored block, so chunks can be compressed on different threads
+// and their outputs simply concatenated. pheno_deflate_finish closes the
+// stream. PhenoWriter uses this for its gzip mode (pheno_writer_gzip).
+#define PHENO_DEFLATE_WINDOW 32768
+#define PHENO_DEFLATE_CHUNK (128 * 1024)
+#define PHENO_DEFLATE_LEVEL_DEFAULT 6
+
+// Per-thread encoder state (about 330 KB)
+typedef struct PhenoDeflate PhenoDeflate;
+
+// level 0 stores, 1-3 match greedily, 4-9 search harder with lazy
+// matching. Returns NULL if out of memory.
+PhenoDeflate* pheno_deflate_create(int level);
+
+void pheno_deflate_free(PhenoDeflate* d);
+
+// Compress data[0..len) to out. The `history` bytes before data are the
+// previous input (only the last PHENO_DEFLATE_WINDOW are used); matches
+// may reach back into them.
+void pheno_deflate_chunk(PhenoDeflate* d, const uint8_t* data, size_t history, size_t len,
+                         PhenoWriter* out);
+
+// Final (empty) block ending the stream
+void pheno_deflate_finish(PhenoWriter* out);
+
+#endif // PHENO_DEFLATE_H
@@ -0,0 +1,61 @@
+#ifndef PHENO_DIAGRAM_H
+#define PHENO_DIAGRAM_H
+
+#include "phenomemory_platform.h"
+#include "pheno_layout.h"
+#include "pheno_writer.h"
+
+// Incrementally maintained token diagram. Node positions are fixed when
+// the diagram is created; after that every node keeps its rendered SVG
+// fragments together with the key they were rendered from (flag word and
+// relation version). When tokens change only those nodes are re-rendered,
+// and a patch with the changed element ids and their new fragments is
+// emitted for templates/gosiuml_template.html to apply, so the cost of an
+// update follows what changed rather than the diagram size.
+//
+// Elements: node i is <g id="tok-i"> in the "nodes" layer, its outgoing
+// relations are <g id="rel-i"> in the "edges" layer. A diagram is not
+// thread-safe; tokens may change concurrently between patches.
+typedef struct PhenoDiagram PhenoDiagram;
+
+// Diagram over a token array the caller keeps alive (relations may be
+// NULL). options may be NULL for the default layout.
+PhenoDiagram* pheno_diagram_create(const PhenoToken* tokens, size_t count,
+                                   const PhenoEdge* relations, size_t relation_count,
+                                   const PhenoLayoutOptions* options);
+void pheno_diagram_destroy(PhenoDiagram* diagram);
+
+// Mark a node for re-checking at the next patch
+void pheno_diagram_touch(PhenoDiagram* diagram, size_t index);
+bool pheno_diagram_touch_id(PhenoDiagram* diagram, uint32_t token_id);
+
+// Node index of a token id (its first occurrence); false if unknown
+bool pheno_diagram_index(const PhenoDiagram* diagram, uint32_t token_id, size_t* index);
+
+// Re-render a node at the next patch even if its flag word is unchanged,
+// after the caller changed the token's type or zone
+void pheno_diagram_redraw(PhenoDiagram* diagram, size_t index);
+
+// Add or remove a relation; the source node's edge group is re-rendered.
+// Returns false if either token is unknown (or, for unlink, no such
+// relation exists).
+bool pheno_diagram_link(PhenoDiagram* diagram, uint32_t src_id, uint32_t dst_id);
+bool pheno_diagram_unlink(PhenoDiagram* diagram, uint32_t src_id, uint32_t dst_id);
+
+// Compare every token's flag word with its rendered one and mark the
+// changed nodes, for callers that do not track changes themselves. O(n)
+// word compares; nothing is formatted.
+size_t pheno_diagram_scan(PhenoDiagram* diagram);
+
+// Whole SVG document from the cached fragments. Pending changes are
+// rendered first and are not repeated in the next patch.
+bool pheno_diagram_write_svg(PhenoDiagram* diagram, PhenoWriter* out);
+
+// Re-render the marked nodes whose key changed and write one patch line:
+//   {"seq":N,"upsert":[{"id":"tok-3","layer":"nodes","svg":"<g ...>"},...]}
+// Nothing is written when no element changed. A node that fails to
+// render (out of memory) stays marked and is retried by the next patch.
+// Returns the number of elements in the patch.
+size_t pheno_diagram_patch(PhenoDiagram* diagram, PhenoWriter* out);
+
+#endif // PHENO_DIAGRAM_H
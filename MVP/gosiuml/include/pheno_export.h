@@ -0,0 +1,54 @@
+#ifndef PHENO_EXPORT_H
+#define PHENO_EXPORT_H
+
+#include "gosiuml.h"
+#include "pheno_writer.h"
+
+// SAX-style exporter: begin, any number of token and relation events,
+// end. Nothing is held back between events, so an export can be driven
+// straight from gosiuml_parse_stream in constant memory.
+//
+// FORMAT_XML and FORMAT_JSON write one document with a tokens section
+// followed by a relations section, so all tokens must be emitted before
+// the first relation. FORMAT_NDJSON writes one self-contained object per
+// line ({"kind":"token",...} or {"kind":"relation",...}) in any order;
+// such output can be split at any newline and processed in parallel.
+typedef enum {
+    EXPORT_SECTION_NONE,
+    EXPORT_SECTION_TOKENS,
+    EXPORT_SECTION_RELATIONS
+} PhenoExportSection;
+
+typedef struct {
+    PhenoWriter* out;
+    GosiUMLFormat format;
+    PhenoExportSection section;
+    size_t tokens;          // Events written so far
+    size_t relations;
+} PhenoExporter;
+
+// format is FORMAT_XML, FORMAT_JSON or FORMAT_NDJSON
+bool pheno_export_begin(PhenoExporter* ex, PhenoWriter* out, GosiUMLFormat format);
+
+// Token id, type, zone, flag word and names, derived state, ref count
+// and degradation metrics. Returns false if a relation was already
+// written to a document format.
+bool pheno_export_token(PhenoExporter* ex, const PhenoToken* token);
+
+bool pheno_export_relation(PhenoExporter* ex, const PhenoEdge* edge);
+
+// Close open sections and the document
+void pheno_export_end(PhenoExporter* ex);
+
+// A whole token array plus its relations (relations may be NULL). Records
+// are formatted on up to `threads` threads (<= 0: one per online CPU)
+// with output identical to emitting them one by one. Returns false if
+// tokens follow relations in a document format.
+bool pheno_export_set(PhenoExporter* ex, const PhenoToken* tokens, size_t count,
+                      const PhenoEdge* relations, size_t relation_count, int threads);
+
+// Whole document for a token array and, for parsed sets, its relations,
+// formatted on one thread per online CPU. w is left open.
+bool pheno_export_tokens(PhenoWriter* w, GosiUMLFormat format, PhenoToken* tokens, size_t count);
+
+#endif // PHENO_EXPORT_H
@@ -0,0 +1,39 @@
+#ifndef PHENO_HAMMING_H
+#define PHENO_HAMMING_H
+
+#include "phenomemory_platform.h"
+
+// Search result: position in the indexed relation array and its
+// Hamming distance (0-128 bits) from the query
+typedef struct {
+    uint32_t index;
+    uint32_t distance;
+} PhenoHammingMatch;
+
+// Multi-index hash over the 16-byte relation encodings. Each code is
+// split into eight 16-bit substrings with one bucket table per
+// substring; any code within distance r of the query matches it on at
+// least one substring within r/8 bits, so only those buckets are probed.
+typedef struct PhenoHammingIndex PhenoHammingIndex;
+
+PhenoHammingIndex* relation_hamming_index_create(const PhenoRelation* rels, size_t count);
+void relation_hamming_index_destroy(PhenoHammingIndex* index);
+
+// k nearest relations, ordered by (distance, index); returns matches written
+size_t relation_knn(const PhenoHammingIndex* index, const PhenoRelation* query,
+                    size_t k, PhenoHammingMatch* out);
+
+// All relations within distance r, ordered by (distance, index). At most
+// max_out are written; returns the total number within the radius.
+size_t relation_radius(const PhenoHammingIndex* index, const PhenoRelation* query,
+                       uint32_t r, PhenoHammingMatch* out, size_t max_out);
+
+// Brute-force scans over an unindexed array (vector XOR + popcount)
+uint32_t relation_hamming_distance(const PhenoRelation* a, const PhenoRelation* b);
+size_t relation_knn_scan(const PhenoRelation* rels, size_t count,
+                         const PhenoRelation* query, size_t k, PhenoHammingMatch* out);
+size_t relation_radius_scan(const PhenoRelation* rels, size_t count,
+                            const PhenoRelation* query, uint32_t r,
+                            PhenoHammingMatch* out, size_t max_out);
+
+#endif // PHENO_HAMMING_H
@@ -0,0 +1,45 @@
+#ifndef PHENO_ID_MAP_H
+#define PHENO_ID_MAP_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+
+// Open-addressing map from 32-bit token ids to 32-bit values (typically
+// dense indices). PHENO_ID_MAP_EMPTY is reserved and cannot be a key.
+#define PHENO_ID_MAP_EMPTY 0xFFFFFFFFu
+
+typedef struct {
+    uint32_t* keys;
+    uint32_t* values;
+    size_t count;
+    size_t mask;        // capacity - 1 (capacity is a power of two)
+} PhenoIdMap;
+
+bool pheno_id_map_init(PhenoIdMap* map, size_t expected);
+void pheno_id_map_free(PhenoIdMap* map);
+void pheno_id_map_clear(PhenoIdMap* map);
+
+// Lookup; returns false if key is absent
+bool pheno_id_map_get(const PhenoIdMap* map, uint32_t key, uint32_t* value);
+
+// Insert or overwrite
+bool pheno_id_map_put(PhenoIdMap* map, uint32_t key, uint32_t value);
+
+// Insert value if key is absent. *existing receives the stored value;
+// returns 1 if inserted, 0 if already present, -1 on error.
+int pheno_id_map_insert(PhenoIdMap* map, uint32_t key, uint32_t value, uint32_t* existing);
+
+bool pheno_id_map_remove(PhenoIdMap* map, uint32_t key);
+
+// Finalizer of MurmurHash3, good spread for sequential ids
+static inline uint32_t pheno_id_hash(uint32_t key) {
+    key ^= key >> 16;
+    key *= 0x85EBCA6Bu;
+    key ^= key >> 13;
+    key *= 0xC2B2AE35u;
+    key ^= key >> 16;
+    return key;
+}
+
+#endif // PHENO_ID_MAP_H
@@ -0,0 +1,34 @@
+#ifndef PHENO_JOIN_H
+#define PHENO_JOIN_H
+
+#include "phenomemory_platform.h"
+
+// One relation joined with both endpoint tokens. Token and relation
+// fields not copied here (sentinel, rel_type) are reached through the
+// indices into the joined arrays.
+typedef struct {
+    uint32_t src_index;     // Index into the token array
+    uint32_t dst_index;
+    uint32_t relation_index;
+    uint8_t src_zone;
+    uint8_t src_state;      // PhenoState inferred from the token flags
+    uint8_t dst_zone;
+    uint8_t dst_state;
+} PhenoAnnotatedEdge;
+
+// Edge table in relation order; relations whose source or destination
+// token is missing are dropped (inner join)
+typedef struct {
+    PhenoAnnotatedEdge* edges;
+    size_t count;
+} PhenoEdgeTable;
+
+// Radix-partitioned parallel hash join of relations against tokens keyed
+// by token_id. threads <= 0 uses one thread per online CPU. If a token
+// id appears more than once the first occurrence is used.
+bool pheno_join_edges(const PhenoToken* tokens, size_t token_count,
+                      const PhenoEdge* relations, size_t relation_count,
+                      int threads, PhenoEdgeTable* out);
+void pheno_edge_table_free(PhenoEdgeTable* table);
+
+#endif // PHENO_JOIN_H
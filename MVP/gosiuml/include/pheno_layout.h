@@ -0,0 +1,40 @@
+#ifndef PHENO_LAYOUT_H
+#define PHENO_LAYOUT_H
+
+#include "phenomemory_platform.h"
+#include "pheno_join.h"
+
+// Force-directed graph layout (Fruchterman-Reingold forces). Every
+// iteration rebuilds a Barnes-Hut quadtree over the current positions, so
+// repulsion costs O(n log n) instead of O(n^2); attraction follows the
+// relation edges. Forces are computed per node on `threads` threads with
+// double-buffered positions, so the result does not depend on the thread
+// count. Coordinates are in units of the ideal edge length.
+typedef struct {
+    float x;
+    float y;
+} PhenoPoint;
+
+typedef struct {
+    int iterations;
+    int threads;            // <= 0: one per online CPU
+    float theta;            // Opening angle; larger is faster and coarser
+    float gravity;          // Pull towards the origin, keeps components together
+    uint32_t seed;          // Initial placement when clusters is NULL
+    const uint8_t* clusters;  // Optional per-node cluster id (PhenoTokenType.cluster_id):
+                              // nodes start grouped around their cluster's centre
+} PhenoLayoutOptions;
+
+void pheno_layout_defaults(PhenoLayoutOptions* options);
+
+// Lay out node_count nodes joined by the edges' src_index/dst_index.
+// options may be NULL for the defaults.
+bool pheno_layout_graph(size_t node_count, const PhenoEdgeTable* edges,
+                        const PhenoLayoutOptions* options, PhenoPoint* out);
+
+// Lay out tokens by their relations (joined on token_id)
+bool pheno_layout_tokens(const PhenoToken* tokens, size_t count,
+                         const PhenoEdge* relations, size_t relation_count,
+                         const PhenoLayoutOptions* options, PhenoPoint* out);
+
+#endif // PHENO_LAYOUT_H
@@ -0,0 +1,82 @@
+#ifndef PHENO_LOD_H
+#define PHENO_LOD_H
+
+#include "phenomemory_platform.h"
+#include "pheno_writer.h"
+
+// Level-of-detail view of a large token set. Tokens are aggregated into
+// summary nodes (count plus state histogram) by one grouping key, and the
+// relations between groups into weighted links. Selected groups can be
+// expanded to show their tokens. The summary is built in one pass over
+// the tokens and one over the relations; what gets rendered is bounded by
+// PHENO_LOD_MAX_CLUSTERS, PHENO_LOD_MAX_LINKS and the expand limit, so
+// the SVG stays small however many tokens there are.
+#define PHENO_LOD_MAX_CLUSTERS 256     // Includes the "other" group
+#define PHENO_LOD_MAX_LINKS 1024       // Heaviest links kept
+#define PHENO_LOD_EXPAND_LIMIT 1024    // Default token boxes across expanded groups
+#define PHENO_LOD_OTHER 0xFFFFFFFEu    // Key of the overflow group
+
+typedef enum {
+    LOD_GROUP_CLUSTER,      // Caller-supplied cluster id (PhenoTokenType.cluster_id)
+    LOD_GROUP_TYPE,         // Interned type name (type_symbol)
+    LOD_GROUP_ZONE,         // memory_zone
+    LOD_GROUP_STATE         // PhenoState derived from the flags
+} PhenoLodGroup;
+
+typedef struct {
+    PhenoLodGroup group;
+    const uint8_t* clusters;    // LOD_GROUP_CLUSTER: cluster id of each token
+    const uint32_t* expand;     // Keys of the groups to draw token by token
+    size_t expand_count;
+    uint32_t expand_limit;      // Token boxes drawn across all expanded groups
+    int threads;                // Layout threads, <= 0: one per online CPU
+} PhenoLodOptions;
+
+typedef struct {
+    uint32_t key;               // Cluster id, type symbol, zone, PhenoState or PHENO_LOD_OTHER
+    uint32_t count;
+    uint32_t internal;          // Relations with both ends in this group
+    uint32_t states[STATE_FREED + 1];
+    bool expanded;
+    uint32_t* members;          // Expanded groups: token indices, at most the expand limit
+    uint32_t member_count;
+} PhenoLodCluster;
+
+typedef struct {
+    uint32_t src;               // Cluster indices
+    uint32_t dst;
+    uint32_t count;             // Relations aggregated into the link
+} PhenoLodLink;
+
+// Groups ordered by descending count, links by descending count
+typedef struct {
+    PhenoLodGroup group;
+    PhenoLodCluster* clusters;
+    size_t count;
+    PhenoLodLink* links;
+    size_t link_count;
+    size_t dropped_links;       // Links beyond PHENO_LOD_MAX_LINKS
+} PhenoLodSummary;
+
+void pheno_lod_defaults(PhenoLodOptions* options);
+
+// Aggregate tokens and their relations (relations may be NULL). options
+// may be NULL for grouping by type.
+bool pheno_lod_summarize(const PhenoToken* tokens, size_t count,
+                         const PhenoEdge* relations, size_t relation_count,
+                         const PhenoLodOptions* options, PhenoLodSummary* out);
+void pheno_lod_free(PhenoLodSummary* summary);
+
+// Display name of a group, e.g. "zone 3" or "ACTIVE"; buf holds at least 32 bytes
+const char* pheno_lod_label(PhenoLodGroup group, uint32_t key, char* buf);
+
+// Summary diagram: group boxes placed by the force layout over the links,
+// then one panel per expanded group with its token boxes
+bool pheno_lod_write_svg(const PhenoLodSummary* summary, const PhenoToken* tokens,
+                         int threads, PhenoWriter* out);
+
+// Summarize and render to a file. Returns 0 on success, -1 on failure.
+int generate_svg_lod(PhenoToken* tokens, int count, const char* output_file,
+                     const PhenoLodOptions* options);
+
+#endif // PHENO_LOD_H
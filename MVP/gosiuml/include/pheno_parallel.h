@@ -0,0 +1,25 @@
+#ifndef PHENO_PARALLEL_H
+#define PHENO_PARALLEL_H
+
+#include <stddef.h>
+#include <stdbool.h>
+
+// Worker body: tid in [0, nthreads)
+typedef void (*PhenoParallelFunc)(void* arg, int tid, int nthreads);
+
+// Resolve a requested thread count (<= 0 means one per online CPU)
+int pheno_parallel_threads(int requested);
+
+// Run fn on nthreads threads (tid 0 on the calling thread) and wait for
+// all of them. Workers must not wait on each other: if thread creation
+// fails, the missing workers run inline on the calling thread.
+void pheno_parallel_run(int nthreads, PhenoParallelFunc fn, void* arg);
+
+// Split [0, count) into nthreads contiguous ranges
+static inline void pheno_parallel_range(size_t count, int tid, int nthreads,
+                                        size_t* begin, size_t* end) {
+    *begin = count * (size_t)tid / (size_t)nthreads;
+    *end = count * (size_t)(tid + 1) / (size_t)nthreads;
+}
+
+#endif // PHENO_PARALLEL_H
@@ -0,0 +1,117 @@
+#ifndef PHENO_PERF_H
+#define PHENO_PERF_H
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdatomic.h>
+
+// Event counters of the calling thread from perf_event_open(2): cycles,
+// instructions, cache misses and branch misses in user space, and context
+// switches. The counters are opened as one group, so a reading is a
+// single read(2) and all values cover the same interval. A counter the
+// kernel refuses (no PMU in a VM, perf_event_paranoid, a seccomp filter
+// in a container) is left out rather than failing the rest: each reading
+// carries a mask of the counters it holds. Context switches fall back to
+// getrusage(2) when perf events are not available at all.
+
+typedef enum {
+    PHENO_PERF_CYCLES,
+    PHENO_PERF_INSTRUCTIONS,
+    PHENO_PERF_CACHE_MISSES,
+    PHENO_PERF_BRANCH_MISSES,
+    PHENO_PERF_CONTEXT_SWITCHES,
+    PHENO_PERF_COUNT
+} PhenoPerfCounter;
+
+#define PHENO_PERF_ALL ((1u << PHENO_PERF_COUNT) - 1)
+
+typedef struct {
+    uint64_t values[PHENO_PERF_COUNT];
+    uint32_t valid;             // Bit i set if values[i] was read
+} PhenoPerfSample;
+
+typedef struct {
+    int leader;                 // Group descriptor, -1 if nothing opened
+    int fds[PHENO_PERF_COUNT];
+    int order[PHENO_PERF_COUNT];    // Counter at each position of a group read
+    int members;
+    uint32_t available;         // Counters a reading can hold
+    bool rusage_switches;       // Context switches come from getrusage
+    int error;                  // errno of the first counter refused
+} PhenoPerf;
+
+// Open the counters for the calling thread. Returns true if any counter
+// is available; perf->error then still tells why others are missing.
+bool pheno_perf_open(PhenoPerf* perf);
+void pheno_perf_close(PhenoPerf* perf);
+
+// Running totals, scaled up if the kernel multiplexed the group. The mask
+// is empty if nothing is open or the read fails.
+void pheno_perf_read(const PhenoPerf* perf, PhenoPerfSample* sample);
+
+// after - before, for the counters valid in both
+void pheno_perf_delta(const PhenoPerfSample* before, const PhenoPerfSample* after,
+                      PhenoPerfSample* delta);
+
+// "cycles", "instructions", "cache-misses", "branch-misses", "context-switches"
+const char* pheno_perf_name(PhenoPerfCounter counter);
+
+// Counter columns shared by the reports. Values are per operation (the
+// caller divides); "-" marks counters missing from valid, and IPC needs
+// both cycles and instructions.
+void pheno_perf_print_header(FILE* out);
+void pheno_perf_print_counts(FILE* out, const double counts[PHENO_PERF_COUNT], uint32_t valid);
+
+// ---- Runtime probes ----
+//
+// A probe accumulates counters and wall time over every pass through a
+// region of the core, from any thread. Probes are off by default and
+// then cost one relaxed load per region; once enabled, each thread opens
+// its own counters on first use and a pass costs two group reads.
+//
+//     static PhenoPerfProbe g_probe = PHENO_PERF_PROBE_INIT("svg_emit");
+//     PhenoPerfMark mark;
+//     pheno_perf_probe_begin(&mark);
+//     ...
+//     pheno_perf_probe_end(&g_probe, &mark);
+
+typedef struct PhenoPerfProbe {
+    const char* name;
+    _Atomic uint64_t calls;
+    _Atomic uint64_t time_ns;
+    _Atomic uint64_t totals[PHENO_PERF_COUNT];
+    atomic_uint valid;
+    atomic_bool registered;
+    struct PhenoPerfProbe* next;    // Registry of probes that recorded a pass
+} PhenoPerfProbe;
+
+#define PHENO_PERF_PROBE_INIT(probe_name) { .name = (probe_name) }
+
+typedef struct {
+    bool active;
+    uint64_t time_ns;
+    PhenoPerfSample start;
+} PhenoPerfMark;
+
+extern atomic_bool pheno_perf_probes_on;
+
+void pheno_perf_probes_enable(bool on);
+
+// Slow paths of pheno_perf_probe_begin and pheno_perf_probe_end
+void pheno_perf_probe_start(PhenoPerfMark* mark);
+void pheno_perf_probe_stop(PhenoPerfProbe* probe, const PhenoPerfMark* mark);
+
+static inline void pheno_perf_probe_begin(PhenoPerfMark* mark) {
+    mark->active = atomic_load_explicit(&pheno_perf_probes_on, memory_order_relaxed);
+    if (mark->active) pheno_perf_probe_start(mark);
+}
+
+static inline void pheno_perf_probe_end(PhenoPerfProbe* probe, const PhenoPerfMark* mark) {
+    if (mark->active) pheno_perf_probe_stop(probe, mark);
+}
+
+// One row per probe that recorded a pass: calls, time and counts per call
+void pheno_perf_probes_report(FILE* out);
+
+#endif // PHENO_PERF_H
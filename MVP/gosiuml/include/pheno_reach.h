@@ -0,0 +1,43 @@
+#ifndef PHENO_REACH_H
+#define PHENO_REACH_H
+
+#include "phenomemory_platform.h"
+
+// Incrementally maintained transitive closure over token relations.
+// Each token keeps a bit row of the tokens it reaches, so queries are a
+// hash lookup plus one bit test. Inserting u->v ORs v's row into every
+// row that reaches u; deleting u->v recomputes only the rows that
+// reached u. Memory is n^2/8 bytes for n distinct tokens, so an index
+// holds at most PHENO_REACH_MAX_NODES tokens (128 MiB of closure) and
+// refuses edges that would add more.
+typedef struct PhenoReachIndex PhenoReachIndex;
+
+#define PHENO_REACH_MAX_NODES 32768u
+
+PhenoReachIndex* reach_index_create(void);
+void reach_index_destroy(PhenoReachIndex* index);
+
+// Lower the node limit (values above PHENO_REACH_MAX_NODES are clamped).
+// Returns the limit now in effect.
+size_t reach_index_set_node_limit(PhenoReachIndex* index, size_t max_nodes);
+
+// Edge maintenance by token id; parallel edges are counted. Adding fails
+// only when memory runs out or a new token would pass the node limit,
+// before any closure row changes; adding back an edge just removed
+// cannot fail. Removing never allocates and
+// fails only for an edge the index does not hold. The reserved id
+// PHENO_ID_MAP_EMPTY (pheno_id_map.h) cannot be a node.
+bool reach_add_edge(PhenoReachIndex* index, uint32_t src_id, uint32_t dst_id);
+bool reach_remove_edge(PhenoReachIndex* index, uint32_t src_id, uint32_t dst_id);
+
+// Bulk load: adds all edges, then computes the closure once. On failure
+// the edges before the failing one stay added.
+bool reach_add_edges(PhenoReachIndex* index, const PhenoEdge* edges, size_t count);
+
+// True if to_id is reachable from from_id (every known token reaches itself)
+bool reach_query(const PhenoReachIndex* index, uint32_t from_id, uint32_t to_id);
+
+size_t reach_node_count(const PhenoReachIndex* index);
+size_t reach_edge_count(const PhenoReachIndex* index);
+
+#endif // PHENO_REACH_H
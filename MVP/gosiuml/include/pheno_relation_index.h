@@ -0,0 +1,51 @@
+#ifndef PHENO_RELATION_INDEX_H
+#define PHENO_RELATION_INDEX_H
+
+#include "pheno_relation_table.h"
+#include "pheno_bitmap.h"
+
+// Bitmap index for one relation field: one bitmap per byte value for
+// equality predicates and one per bit for flag predicates
+typedef struct {
+    PhenoBitmap values[256];
+    PhenoBitmap bits[8];
+} PhenoFieldIndex;
+
+// Secondary indexes over a PhenoRelationTable. Deleted rows stay in the
+// table as tombstones and are dropped from every bitmap, including live.
+typedef struct {
+    PhenoRelationTable* table;                  // Not owned
+    PhenoFieldIndex* fields[REL_FIELD_COUNT];   // NULL when not indexed
+    PhenoBitmap live;
+} PhenoRelationIndex;
+
+// Build indexes for the given fields over the rows already in table.
+// With fields == NULL, subject_id, class_id and person_id are indexed.
+PhenoRelationIndex* relation_index_create(PhenoRelationTable* table,
+                                          const PhenoRelationField* fields,
+                                          size_t field_count);
+void relation_index_destroy(PhenoRelationIndex* index);
+
+// Maintenance; insert appends to the table and returns the new row, or
+// -1 with the table unchanged. A failed update keeps the row's previous
+// values; if even those cannot be indexed again the row is deleted, which
+// relation_index_live shows.
+int64_t relation_index_insert(PhenoRelationIndex* index, const PhenoRelation* rel);
+bool relation_index_delete(PhenoRelationIndex* index, uint32_t row);
+bool relation_index_update(PhenoRelationIndex* index, uint32_t row, const PhenoRelation* rel);
+
+// Bitmap lookups; NULL when the field is not indexed
+const PhenoBitmap* relation_index_eq(const PhenoRelationIndex* index,
+                                     PhenoRelationField field, uint8_t value);
+const PhenoBitmap* relation_index_bit(const PhenoRelationIndex* index,
+                                      PhenoRelationField field, int bit);
+const PhenoBitmap* relation_index_live(const PhenoRelationIndex* index);
+
+// Conjunctive query over indexed fields using bitmap AND/ANDNOT. NE and
+// NO_BITS predicates subtract from the live set. Returns false if a
+// predicate targets an unindexed field or allocation fails.
+bool relation_index_query(const PhenoRelationIndex* index,
+                          const PhenoRelationPredicate* preds, size_t pred_count,
+                          PhenoBitmap* out);
+
+#endif // PHENO_RELATION_INDEX_H
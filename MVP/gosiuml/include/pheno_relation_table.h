@@ -0,0 +1,77 @@
+#ifndef PHENO_RELATION_TABLE_H
+#define PHENO_RELATION_TABLE_H
+
+#include "phenomemory_platform.h"
+
+// Relation fields, numbered in PhenoRelation byte order
+typedef enum {
+    REL_FIELD_SUBJECT_ID,
+    REL_FIELD_SUBJECT_TYPE,
+    REL_FIELD_SUBJECT_STATE,
+    REL_FIELD_SUBJECT_CLASS,
+    REL_FIELD_CLASS_ID,
+    REL_FIELD_CLASS_CATEGORY,
+    REL_FIELD_CLASS_TAXONOMY,
+    REL_FIELD_CLASS_LEVEL,
+    REL_FIELD_INSTANCE_ID,
+    REL_FIELD_INSTANCE_TYPE,
+    REL_FIELD_INSTANCE_STATE,
+    REL_FIELD_INSTANCE_FLAGS,
+    REL_FIELD_PERSON_ID,
+    REL_FIELD_PERSON_ROLE,
+    REL_FIELD_PERSON_AUTH,
+    REL_FIELD_PERSON_STATE,
+    REL_FIELD_COUNT
+} PhenoRelationField;
+
+// Predicate operators for column scans
+typedef enum {
+    REL_PRED_EQ,        // column == value
+    REL_PRED_NE,        // column != value
+    REL_PRED_ANY_BITS,  // (column & value) != 0
+    REL_PRED_NO_BITS    // (column & value) == 0
+} PhenoRelationPredOp;
+
+typedef struct {
+    PhenoRelationField field;
+    PhenoRelationPredOp op;
+    uint8_t value;
+} PhenoRelationPredicate;
+
+// Columnar (structure-of-arrays) relation store: one contiguous
+// byte column per PhenoRelation field, rows addressed by uint32_t
+typedef struct {
+    uint8_t* columns[REL_FIELD_COUNT];
+    size_t count;
+    size_t capacity;
+} PhenoRelationTable;
+
+// Table lifecycle
+PhenoRelationTable* relation_table_create(size_t initial_capacity);
+void relation_table_destroy(PhenoRelationTable* table);
+bool relation_table_reserve(PhenoRelationTable* table, size_t capacity);
+void relation_table_clear(PhenoRelationTable* table);
+
+// Row insertion and AoS conversion
+bool relation_table_append(PhenoRelationTable* table, const PhenoRelation* rel);
+bool relation_table_append_batch(PhenoRelationTable* table,
+                                 const PhenoRelation* rels, size_t count);
+void relation_table_get(const PhenoRelationTable* table, size_t row, PhenoRelation* out);
+void relation_table_set(PhenoRelationTable* table, size_t row, const PhenoRelation* rel);
+void relation_table_export(const PhenoRelationTable* table, size_t start,
+                           size_t count, PhenoRelation* out);
+
+// Predicate scans. Conjunctive predicates are evaluated over the whole
+// table and matching row indices are written to sel (sized for count
+// rows); filter refines an existing selection vector. Both return the
+// number of selected rows.
+size_t relation_table_scan(const PhenoRelationTable* table,
+                           const PhenoRelationPredicate* preds, size_t pred_count,
+                           uint32_t* sel);
+size_t relation_table_scan_eq(const PhenoRelationTable* table,
+                              PhenoRelationField field, uint8_t value, uint32_t* sel);
+size_t relation_table_filter(const PhenoRelationTable* table,
+                             const PhenoRelationPredicate* preds, size_t pred_count,
+                             const uint32_t* sel_in, size_t sel_count, uint32_t* sel_out);
+
+#endif // PHENO_RELATION_TABLE_H
@@ -0,0 +1,51 @@
+#ifndef PHENO_STREAM_H
+#define PHENO_STREAM_H
+
+#include "phenomemory_platform.h"
+#include "pheno_diagram.h"
+
+// Live transition stream over loopback HTTP. A server thread bound to
+// 127.0.0.1 drains the trace ring (pheno_trace.h) once per frame and
+// sends each batch to every subscriber as a server-sent event, so the
+// threads doing the transitions only pay for the trace record.
+//
+//   GET /             the page file (templates/gosiuml_template.html)
+//   GET /diagram.svg  the current diagram
+//   GET /events       text/event-stream:
+//     event: transitions
+//     data: {"frame":N,"dropped":D,"events":[[token_id,from,to,event,time_us],...]}
+//     event: patch
+//     data: <pheno_diagram_patch line for the touched tokens>
+//
+// A frame without transitions sends only the patch, if the diagram
+// changed, or nothing. Subscribers that stop reading are disconnected
+// once a few megabytes are queued for them.
+typedef struct {
+    uint16_t port;              // 0: any free port
+    uint32_t frame_ms;          // Batching interval
+    PhenoDiagram* diagram;      // Optional; other threads change it only under pheno_stream_lock
+    const char* page;           // Optional file served at "/"
+} PhenoStreamOptions;
+
+typedef struct PhenoStream PhenoStream;
+
+void pheno_stream_defaults(PhenoStreamOptions* options);
+
+// Bind, enable tracing and start the server thread. NULL on failure.
+PhenoStream* pheno_stream_start(const PhenoStreamOptions* options);
+
+// Port actually bound
+uint16_t pheno_stream_port(const PhenoStream* stream);
+
+// Hold off the server thread's use of the diagram (and of the tokens it
+// renders) while the caller edits them
+void pheno_stream_lock(PhenoStream* stream);
+void pheno_stream_unlock(PhenoStream* stream);
+
+// Transitions read from the ring and lost to overwriting so far
+void pheno_stream_stats(const PhenoStream* stream, uint64_t* events, uint64_t* dropped);
+
+// Stop the thread, close all connections and disable tracing
+void pheno_stream_stop(PhenoStream* stream);
+
+#endif // PHENO_STREAM_H
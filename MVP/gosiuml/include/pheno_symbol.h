@@ -0,0 +1,28 @@
+#ifndef PHENO_SYMBOL_H
+#define PHENO_SYMBOL_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+// Process-wide string interner. Each distinct string gets a dense 32-bit
+// symbol id (1, 2, 3, ...) and one immutable copy whose address never
+// changes, so type names are compared as integers. Interning and lookup
+// are lock-free and safe from any thread; symbols are never released.
+typedef uint32_t PhenoSymbol;
+
+#define PHENO_SYMBOL_NONE 0u
+
+// Symbol for str[0..len), inserted if new. PHENO_SYMBOL_NONE only if
+// memory runs out.
+PhenoSymbol pheno_symbol_intern(const char* str, size_t len);
+
+// Symbol for str[0..len) if already interned, else PHENO_SYMBOL_NONE
+PhenoSymbol pheno_symbol_find(const char* str, size_t len);
+
+// NUL-terminated name of a symbol (NULL for PHENO_SYMBOL_NONE or unknown ids)
+const char* pheno_symbol_name(PhenoSymbol symbol);
+
+// Number of symbols interned so far
+size_t pheno_symbol_count(void);
+
+#endif // PHENO_SYMBOL_H
@@ -0,0 +1,80 @@
+#ifndef PHENO_TEMPLATE_H
+#define PHENO_TEMPLATE_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+#include "pheno_writer.h"
+
+// Precompiled text templates. A template is parsed once into literal
+// spans and typed placeholders; rendering a record is then a memcpy per
+// span plus the writer's number and escape routines, with no parsing.
+//
+// Syntax: named blocks hold the markup. A block opens with {{#name}} at
+// the start of a line and ends with {{/name}}; everything outside blocks
+// is ignored, so it can hold comments. A newline straight after a block's
+// opening tag is dropped so blocks can start on their own line.
+//
+//   {{#node}}
+//     <rect x="{{x}}" y="{{y+25}}"/><text>{{type|xml}}</text>
+//   {{/node}}
+//
+// Placeholders name a schema field. Number fields take an optional
+// constant offset ({{y+25}}, {{x-4}}) and the hex filter (8 upper-case
+// digits); text fields are copied as they are or through the xml or
+// json filter (json adds the quotes).
+typedef enum {
+    TEMPLATE_FIELD_U32,
+    TEMPLATE_FIELD_TEXT
+} PhenoTemplateFieldType;
+
+typedef struct {
+    const char* name;
+    PhenoTemplateFieldType type;
+} PhenoTemplateField;
+
+// Fields a template may use; must outlive the templates compiled against it
+typedef struct {
+    const PhenoTemplateField* fields;
+    size_t count;
+} PhenoTemplateSchema;
+
+// One record: values[i] belongs to schema field i
+typedef union {
+    uint32_t u32;
+    struct {
+        const char* ptr;
+        size_t len;
+    } text;
+} PhenoTemplateValue;
+
+typedef struct PhenoTemplate PhenoTemplate;
+
+// Compile text[0..len); origin names the source in error messages.
+// Returns NULL (after printing the reason) on a syntax error or an
+// unknown field.
+PhenoTemplate* pheno_template_compile(const char* text, size_t len,
+                                      const PhenoTemplateSchema* schema, const char* origin);
+
+// Compile a template file; it can later be reloaded in place
+PhenoTemplate* pheno_template_load(const char* path, const PhenoTemplateSchema* schema);
+
+// Recompile a loaded template if its file changed on disk. The new
+// version must define every block in required[0..required_count).
+// Returns 1 if reloaded, 0 if unchanged, -1 on error or a missing block;
+// the previous version is then kept, and the failed one is not retried
+// until the file changes again. Must not run while the template is being
+// rendered; block indices may change, so look them up again after 1.
+int pheno_template_reload(PhenoTemplate* tpl, const char* const* required, size_t required_count);
+
+void pheno_template_free(PhenoTemplate* tpl);
+
+// Index of a named block, -1 if absent
+int pheno_template_block(const PhenoTemplate* tpl, const char* name);
+
+// Render one record through a block. Safe to call from several threads
+// on the same template.
+void pheno_template_render(const PhenoTemplate* tpl, int block, PhenoWriter* out,
+                           const PhenoTemplateValue* values);
+
+#endif // PHENO_TEMPLATE_H
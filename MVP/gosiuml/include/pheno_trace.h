@@ -0,0 +1,52 @@
+#ifndef PHENO_TRACE_H
+#define PHENO_TRACE_H
+
+#include "phenomemory_platform.h"
+
+// Process-wide transition trace. Producers claim a slot in a fixed ring
+// with one atomic add and publish it with a release store; nothing is
+// formatted or allocated on the recording thread. While tracing is off a
+// record costs one relaxed load. A consumer reads with its own cursor and
+// learns how many events were overwritten if it fell more than a ring
+// behind.
+#define PHENO_TRACE_CAPACITY (1u << 16)     // Events, power of two
+
+typedef struct {
+    uint64_t time_ns;       // CLOCK_MONOTONIC
+    uint32_t token_id;
+    uint8_t from;           // PhenoState
+    uint8_t to;
+    uint8_t event;          // PhenoEvent
+    uint8_t reserved;
+} PhenoTraceEvent;
+
+typedef struct {
+    uint64_t next;          // Sequence number of the next event to read
+} PhenoTraceCursor;
+
+extern atomic_bool pheno_trace_on;
+
+void pheno_trace_enable(bool on);
+
+// Slow path of pheno_trace_record
+void pheno_trace_push(uint32_t token_id, PhenoState from, PhenoState to, PhenoEvent event);
+
+static inline bool pheno_trace_active(void) {
+    return atomic_load_explicit(&pheno_trace_on, memory_order_relaxed);
+}
+
+static inline void pheno_trace_record(uint32_t token_id, PhenoState from, PhenoState to,
+                                      PhenoEvent event) {
+    if (pheno_trace_active()) pheno_trace_push(token_id, from, to, event);
+}
+
+// Cursor positioned after the newest event, so only later ones are read
+void pheno_trace_cursor(PhenoTraceCursor* cursor);
+
+// Copy up to max published events in order. *dropped receives the number
+// of events lost to overwriting since the last read. Stops early at a
+// slot that is still being written.
+size_t pheno_trace_read(PhenoTraceCursor* cursor, PhenoTraceEvent* out, size_t max,
+                        uint64_t* dropped);
+
+#endif // PHENO_TRACE_H
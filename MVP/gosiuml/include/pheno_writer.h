@@ -0,0 +1,135 @@
+#ifndef PHENO_WRITER_H
+#define PHENO_WRITER_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+#include <string.h>
+
+// Buffered output for the diagram emitters. Text is appended to one large
+// buffer that goes to the descriptor with write(2) only when full, and
+// numbers are formatted by hand, so emitting an element costs a few
+// memcpy calls instead of several fprintf calls. Errors are sticky: once
+// a write fails, further output is dropped and pheno_writer_close reports
+// the failure.
+//
+// A memory writer (fd < 0) has no descriptor: its buffer grows instead
+// and keeps everything written until the writer is closed.
+//
+// A descriptor writer can instead produce a gzip stream: each full
+// buffer is split into PHENO_DEFLATE_CHUNK pieces that are deflated on
+// several threads (pheno_deflate.h) and written in order.
+#define PHENO_WRITER_BUFFER (1 << 20)
+
+typedef struct PhenoWriterGzip PhenoWriterGzip;
+
+typedef struct {
+    int fd;
+    bool owns_fd;
+    bool failed;
+    size_t used;
+    size_t capacity;
+    char* buf;
+    PhenoWriterGzip* gzip;  // Non-NULL in gzip mode
+} PhenoWriter;
+
+// Create (or truncate) path for writing. Paths ending in .gz or .svgz
+// are written in gzip mode at the process-wide gzip level.
+bool pheno_writer_open(PhenoWriter* w, const char* path);
+
+// Write to an existing descriptor; pheno_writer_close leaves it open
+bool pheno_writer_attach(PhenoWriter* w, int fd);
+
+// Growable in-memory buffer with an initial capacity
+bool pheno_writer_memory(PhenoWriter* w, size_t capacity);
+
+// Switch a descriptor writer to gzip mode: everything written from now
+// on is compressed at level 0-9 on up to `threads` threads (<= 0: one
+// per online CPU). Bytes already buffered are written uncompressed first.
+bool pheno_writer_gzip(PhenoWriter* w, int level, int threads);
+
+// Level used by pheno_writer_open for .gz and .svgz paths (default
+// PHENO_DEFLATE_LEVEL_DEFAULT)
+void pheno_writer_set_gzip_level(int level);
+
+// True if pheno_writer_open would compress path
+bool pheno_writer_gzip_path(const char* path);
+
+// Push buffered bytes to the descriptor (no-op for memory writers). In
+// gzip mode the output so far becomes decodable, at a small cost in
+// compression.
+bool pheno_writer_flush(PhenoWriter* w);
+
+// Flush, release the buffer and close an owned descriptor. Returns false
+// if any write failed.
+bool pheno_writer_close(PhenoWriter* w);
+
+// Slow path of pheno_writer_put: data that does not fit in the buffer
+void pheno_writer_put_slow(PhenoWriter* w, const void* data, size_t len);
+
+static inline void pheno_writer_put(PhenoWriter* w, const void* data, size_t len) {
+    if (len <= w->capacity - w->used) {
+        memcpy(w->buf + w->used, data, len);
+        w->used += len;
+    } else {
+        pheno_writer_put_slow(w, data, len);
+    }
+}
+
+// String literal without its terminator
+#define pheno_writer_lit(w, s) pheno_writer_put((w), (s), sizeof(s) - 1)
+
+static inline void pheno_writer_str(PhenoWriter* w, const char* s) {
+    pheno_writer_put(w, s, strlen(s));
+}
+
+static inline void pheno_writer_u32(PhenoWriter* w, uint32_t value) {
+    char digits[10];
+    char* p = digits + sizeof(digits);
+    do {
+        *--p = (char)('0' + value % 10);
+        value /= 10;
+    } while (value);
+    pheno_writer_put(w, p, (size_t)(digits + sizeof(digits) - p));
+}
+
+static inline void pheno_writer_i32(PhenoWriter* w, int32_t value) {
+    if (value < 0) {
+        pheno_writer_lit(w, "-");
+        pheno_writer_u32(w, 0u - (uint32_t)value);
+    } else {
+        pheno_writer_u32(w, (uint32_t)value);
+    }
+}
+
+// Exactly 8 upper-case hex digits, as printf("%08X")
+static inline void pheno_writer_hex32(PhenoWriter* w, uint32_t value) {
+    static const char hex[16] = "0123456789ABCDEF";
+    char digits[8];
+    for (int i = 7; i >= 0; i--) {
+        digits[i] = hex[value & 0xF];
+        value >>= 4;
+    }
+    pheno_writer_put(w, digits, sizeof(digits));
+}
+
+// Format `count` items on up to `threads` threads (<= 0: one per online
+// CPU). fn(out, begin, end, user) must write items [begin, end) to out
+// exactly as a serial fn(w, 0, count, user) would; each thread formats
+// its ranges into a private memory writer and the buffers are appended to
+// w in item order (with writev for descriptor writers), so the output is
+// byte-identical to the serial output. Items are processed in bounded
+// waves, so memory use does not grow with count.
+typedef void (*PhenoFormatFunc)(PhenoWriter* out, size_t begin, size_t end, void* user);
+
+bool pheno_writer_parallel(PhenoWriter* w, size_t count, PhenoFormatFunc fn,
+                           void* user, int threads);
+
+// Text escaped for XML content and attribute values (control bytes other
+// than tab, CR and LF become U+FFFD)
+void pheno_writer_xml_text(PhenoWriter* w, const char* s, size_t len);
+
+// Quoted JSON string
+void pheno_writer_json_string(PhenoWriter* w, const char* s, size_t len);
+
+#endif // PHENO_WRITER_H
@@ -2,6 +2,7 @@
 #define PHENOMEMORY_PLATFORM_H
 
 #include <stdint.h>
+#include <stddef.h>
 #include <stdatomic.h>
 #include <stdbool.h>
 #include <pthread.h>
@@ -141,6 +142,13 @@ typedef struct {
     uint8_t person_state;
 } PhenoRelation;
 
+// Token-to-token edge from a token file ("RELATION: <src> -> <dst> : <type>")
+typedef struct {
+    uint32_t src_id;
+    uint32_t dst_id;
+    char rel_type[16];
+} PhenoEdge;
+
 // Memory flags using atomic for thread safety
 typedef struct {
     atomic_uint32_t flags;  // Combined flags for atomic operations
@@ -154,6 +162,7 @@ struct PhenoToken {
     char sentinel[16];  // "PHENO_NIL", etc.
     uint8_t memory_zone;
     MemFlags mem_flags;
+    uint32_t type_symbol;   // Interned type name (pheno_symbol.h), compared as an integer
     pthread_t thread_owner;
     void* data_ptr;
     size_t data_size;
@@ -212,6 +221,7 @@ bool initialize_state_machine(StateMachine* sm);
 void step_state_machine(StateMachine* sm, PhenoEvent event);
 const char* get_state_name(PhenoState state);
 const char* get_event_name(PhenoEvent event);
+PhenoState pheno_token_state(const PhenoToken* token);
 
 // Token operations
 PhenoToken* pheno_token_alloc(uint32_t size);
@@ -220,6 +230,10 @@ bool pheno_token_lock(PhenoToken* token);
 void pheno_token_unlock(PhenoToken* token);
 bool pheno_token_validate(PhenoToken* token);
 
+// Type name of a token and its length (not NUL-terminated when it falls
+// back to the sentinel, for tokens without a type symbol)
+const char* pheno_token_type(const PhenoToken* token, size_t* len);
+
 // Verification and recovery
 bool verify_geometric_proof(PhenoToken* token);
 bool verify_integrity(StateMachine* sm);
@@ -237,4 +251,11 @@ void process_token_operations(StateMachine* sm);
 void map_obj_to_obj(PhenoRelation* src, PhenoRelation* dst);
 void apply_person_model(PhenoRelation* rel, uint8_t person_a, uint8_t person_b);
 
+// Bulk person-to-person scoring (SSSE3 nibble-LUT popcount on CPUs that have it)
+void apply_person_model_batch(PhenoRelation* rels, const uint8_t* person_a,
+                              const uint8_t* person_b, size_t count);
+void apply_person_model_pairs(PhenoRelation* rels,
+                              const uint8_t* persons_a, size_t count_a,
+                              const uint8_t* persons_b, size_t count_b);
+
 #endif // PHENOMEMORY_PLATFORM_H
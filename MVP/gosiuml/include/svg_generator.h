@@ -0,0 +1,101 @@
+#ifndef SVG_GENERATOR_H
+#define SVG_GENERATOR_H
+
+#include "phenomemory_platform.h"
+#include "pheno_layout.h"
+#include "pheno_writer.h"
+#include "pheno_template.h"
+
+#define SVG_NODE_WIDTH 180
+#define SVG_NODE_HEIGHT 120
+
+// Top-left corner of a node box
+typedef struct {
+    uint32_t x;
+    uint32_t y;
+} SvgSlot;
+
+// Diagram markup comes from a template (pheno_template.h) with the blocks
+// header, edges_open, edge, edges_close, node and footer; see
+// templates/svg_diagram.tpl. Fields: width, height (header, edges_open,
+// edges_close, footer); x, y, cx, cy (node box corner and centre, cx is
+// also the canvas centre); x1, y1, x2, y2 (edge end points); id and type
+// (node token). Fields a block does not set render as 0 or empty text.
+typedef enum {
+    SVG_FIELD_WIDTH,
+    SVG_FIELD_HEIGHT,
+    SVG_FIELD_X,
+    SVG_FIELD_Y,
+    SVG_FIELD_CX,
+    SVG_FIELD_CY,
+    SVG_FIELD_X1,
+    SVG_FIELD_Y1,
+    SVG_FIELD_X2,
+    SVG_FIELD_Y2,
+    SVG_FIELD_ID,
+    SVG_FIELD_TYPE,
+    SVG_FIELD_COUNT
+} SvgField;
+
+typedef enum {
+    SVG_BLOCK_HEADER,
+    SVG_BLOCK_EDGES_OPEN,
+    SVG_BLOCK_EDGE,
+    SVG_BLOCK_EDGES_CLOSE,
+    SVG_BLOCK_NODE,
+    SVG_BLOCK_FOOTER,
+    SVG_BLOCK_COUNT
+} SvgBlock;
+
+// A template with its block indices resolved
+typedef struct {
+    const PhenoTemplate* tpl;
+    int blocks[SVG_BLOCK_COUNT];
+} SvgTemplate;
+
+extern const PhenoTemplateSchema svg_template_schema;
+
+// Resolve the blocks of a template compiled against svg_template_schema;
+// false if one is missing
+bool svg_template_bind(SvgTemplate* st, const PhenoTemplate* tpl);
+
+// Reload tpl (bound to st) if its file changed and resolve the blocks
+// again; as pheno_template_reload, a version missing a block is rejected
+// and st keeps rendering the previous one
+int svg_template_reload(SvgTemplate* st, PhenoTemplate* tpl);
+
+// Built-in template, compiled on first use
+const SvgTemplate* svg_template_default(void);
+
+// Token diagram: one labelled box per token. Parsed sets with relations
+// are placed by the force-directed layout and their relations drawn as
+// lines; otherwise tokens go on a grid of at least four columns, growing
+// towards a square as count increases. The canvas is sized to fit every
+// token; output is streamed through a PhenoWriter. Returns 0 on success,
+// -1 if the file cannot be created or written.
+int generate_svg_from_tokens(PhenoToken* tokens, int count, const char* output_file);
+
+// As above with explicit layout options (NULL for the defaults)
+int generate_svg_with_layout(PhenoToken* tokens, int count, const char* output_file,
+                             const PhenoLayoutOptions* options);
+
+// As above with a custom template (NULL for the built-in one)
+int generate_svg_with_template(PhenoToken* tokens, int count, const char* output_file,
+                               const PhenoLayoutOptions* options, const SvgTemplate* st);
+
+// Node boxes for count tokens: force layout when edges has entries,
+// otherwise the grid. Also returns the canvas size.
+void svg_place_tokens(int count, const PhenoEdgeTable* edges, const PhenoLayoutOptions* options,
+                      SvgSlot* slots, uint32_t* width, uint32_t* height);
+
+// Built-in template's header block: XML prolog, opening <svg> tag,
+// background and title
+void svg_header(PhenoWriter* w, uint32_t width, uint32_t height);
+
+// Labelled box of one token with its top-left corner at (x, y)
+void svg_node(PhenoWriter* w, const PhenoToken* token, uint32_t x, uint32_t y);
+
+// Line between the centres of two node boxes
+void svg_edge(PhenoWriter* w, SvgSlot from, SvgSlot to);
+
+#endif // SVG_GENERATOR_H
@@ -0,0 +1,86 @@
+#ifndef TOKEN_BINARY_H
+#define TOKEN_BINARY_H
+
+#include "phenomemory_platform.h"
+
+// Precompiled token file (.gtok). All sections are 8-byte aligned and
+// addressed by offsets from the start of the file:
+//   header | tokens[token_count] | strings | row_offsets[token_count + 1] | edges
+// Token and relation types are NUL-terminated strings interned in the
+// string table. Relations are stored in CSR form grouped by source token:
+// edges[row_offsets[i] .. row_offsets[i + 1]) leave tokens[i]. The
+// checksum is the CRC-32 of everything after the header.
+#define GTOK_MAGIC "GTOK"
+#define GTOK_VERSION 1
+#define GTOK_BYTE_ORDER 0x01020304u     // Written natively; rejected if swapped
+#define GTOK_NO_TOKEN 0xFFFFFFFFu
+
+typedef struct {
+    char magic[4];
+    uint16_t version;
+    uint16_t header_size;
+    uint32_t byte_order;
+    uint32_t checksum;
+    uint64_t file_size;
+    uint32_t token_count;
+    uint32_t edge_count;
+    uint64_t tokens_offset;
+    uint64_t strings_offset;
+    uint64_t strings_size;
+    uint64_t rows_offset;
+    uint64_t edges_offset;
+} GtokHeader;
+
+typedef struct {
+    uint32_t token_id;
+    uint32_t type;          // String table offset
+    uint8_t zone;
+    uint8_t reserved[3];
+} GtokToken;
+
+typedef struct {
+    uint32_t dst_index;     // Destination token, or GTOK_NO_TOKEN
+    uint32_t dst_id;
+    uint32_t type;          // String table offset
+} GtokEdge;
+
+// Compile a text token file. Duplicate token ids keep their first
+// definition as relation endpoint; relations from unknown sources are
+// skipped and reported. Returns false on I/O or parse failure.
+bool gtok_compile(const char* input, const char* output);
+
+// Mapped, read-only view of a .gtok file used in place
+typedef struct {
+    const GtokHeader* header;
+    const GtokToken* tokens;
+    const char* strings;
+    const uint32_t* rows;
+    const GtokEdge* edges;
+    size_t size;
+} GtokFile;
+
+// Map and validate structure: section bounds, row order, relation
+// targets and string offsets are checked in one pass over the tables.
+// verify_checksum also checks the CRC, reading every page.
+bool gtok_open(const char* path, bool verify_checksum, GtokFile* file);
+void gtok_close(GtokFile* file);
+
+// True if path starts with the .gtok magic
+bool gtok_probe(const char* path);
+
+// Token set (token_set.h) copied out of a .gtok file without parsing
+// text; relations are grouped by source token. NULL if the file is
+// rejected by gtok_open.
+PhenoToken* gtok_load_set(const char* path, int* count);
+
+static inline const char* gtok_string(const GtokFile* file, uint32_t offset) {
+    return file->strings + offset;
+}
+
+// Relations leaving tokens[index]
+static inline const GtokEdge* gtok_edges_of(const GtokFile* file, uint32_t index, size_t* count) {
+    *count = file->rows[index + 1] - file->rows[index];
+    return &file->edges[file->rows[index]];
+}
+
+#endif // TOKEN_BINARY_H
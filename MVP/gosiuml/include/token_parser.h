@@ -0,0 +1,75 @@
+#ifndef TOKEN_PARSER_H
+#define TOKEN_PARSER_H
+
+#include "phenomemory_platform.h"
+
+// Token file syntax, one record per line:
+//   TOKEN: 0x<id> <type> <zone>
+//   RELATION: 0x<src> -> 0x<dst> : <type>
+// Blank lines and lines starting with '#' are skipped; other lines are
+// ignored. Malformed TOKEN/RELATION lines are reported and skipped.
+
+// Non-owning view into the scanned buffer (not NUL-terminated)
+typedef struct {
+    const char* ptr;
+    size_t len;
+} TokenView;
+
+typedef struct {
+    uint32_t id;
+    TokenView type;
+    uint8_t zone;
+    size_t line;            // 1-based line number
+} TokenRecord;
+
+typedef struct {
+    uint32_t src_id;
+    uint32_t dst_id;
+    TokenView rel_type;
+    size_t line;
+} RelationRecord;
+
+typedef void (*TokenCallback)(const TokenRecord* token, void* user);
+typedef void (*RelationCallback)(const RelationRecord* relation, void* user);
+
+// Callbacks may be NULL. Views are only valid during the callback.
+// on_error defaults to a "file:line: message" diagnostic on stderr;
+// its message is a static string.
+typedef struct {
+    TokenCallback on_token;
+    RelationCallback on_relation;
+    void (*on_error)(const char* source, size_t line, const char* message, void* user);
+    void* user;
+    const char* source;     // Name used in diagnostics
+} TokenScanHandler;
+
+typedef struct {
+    size_t lines;
+    size_t tokens;
+    size_t relations;
+    size_t errors;
+} TokenScanStats;
+
+// Scan [data, data + size); first_line is the line number of data[0].
+// A final line without a newline is scanned as well. stats is added to.
+void token_scan_buffer(const char* data, size_t size, size_t first_line,
+                       const TokenScanHandler* handler, TokenScanStats* stats);
+
+// Read records from any descriptor (pipe, socket, file) until EOF using
+// one fixed buffer of TOKEN_STREAM_BUFFER bytes; lines split across reads
+// are carried over. Lines longer than the buffer are reported and skipped.
+// Returns -1 on a read error or allocation failure, otherwise 0.
+#define TOKEN_STREAM_BUFFER (1 << 20)
+
+int token_scan_stream(int fd, const TokenScanHandler* handler, TokenScanStats* stats);
+
+// Read-only private mapping of a whole file (empty files map to size 0)
+typedef struct {
+    const char* data;
+    size_t size;
+} TokenFileMap;
+
+bool token_file_map(const char* filename, TokenFileMap* map);
+void token_file_unmap(TokenFileMap* map);
+
+#endif // TOKEN_PARSER_H
@@ -0,0 +1,70 @@
+#ifndef TOKEN_RELOAD_H
+#define TOKEN_RELOAD_H
+
+#include "phenomemory_platform.h"
+#include "pheno_reach.h"
+
+// Incremental reloader for a token file. Every TOKEN/RELATION line is
+// hashed and remembered with its parsed record; a reload hashes the
+// file again and diffs the line multisets, so only added and removed
+// lines are parsed and applied. Tokens live in a slab with stable
+// addresses: unchanged tokens are never touched, and a token whose line
+// was edited keeps its slot and flags. Relations are applied to a
+// reachability index.
+typedef struct TokenReloader TokenReloader;
+
+typedef struct {
+    size_t lines;               // Lines in the file
+    size_t lines_unchanged;     // Record lines matched against the previous load
+    size_t tokens_added;
+    size_t tokens_changed;      // Same id, different definition line
+    size_t tokens_removed;
+    size_t relations_added;
+    size_t relations_removed;
+} TokenReloadStats;
+
+typedef enum {
+    TOKEN_RELOAD_ADDED,
+    TOKEN_RELOAD_CHANGED,       // Same id, new type or zone; slot and flags kept
+    TOKEN_RELOAD_REMOVED
+} TokenReloadChange;
+
+// Changes of a successful reload, reported before it returns. A removed
+// token is already gone from token_reloader_find; the others can be
+// looked up there.
+typedef struct {
+    void (*on_token)(uint32_t token_id, TokenReloadChange change, void* user);
+    void (*on_relation)(uint32_t src_id, uint32_t dst_id, bool added, void* user);
+    void* user;
+} TokenReloadHandler;
+
+TokenReloader* token_reloader_create(const char* path);
+void token_reloader_destroy(TokenReloader* reloader);
+
+// Diff the file against the previous load and apply the changes (the
+// first call loads everything). A token id defined on several lines is
+// one token with the definition of its first line. False if the file
+// cannot be read, memory runs out or a removed relation is missing from
+// the graph; the live state is then left as it was.
+bool token_reloader_reload(TokenReloader* reloader, TokenReloadStats* stats);
+
+// Report the changes of later reloads (NULL to stop)
+void token_reloader_set_handler(TokenReloader* reloader, const TokenReloadHandler* handler);
+
+// Live token by id (NULL if absent); the pointer stays valid until that
+// token is removed by a reload
+PhenoToken* token_reloader_find(const TokenReloader* reloader, uint32_t token_id);
+size_t token_reloader_token_count(const TokenReloader* reloader);
+PhenoReachIndex* token_reloader_graph(const TokenReloader* reloader);
+
+// inotify watch on the file's directory for completed writes and
+// editors that rename a new file over the old one; creating the file
+// does not trigger a reload until the writer closes it. Returns the
+// non-blocking descriptor to poll, or -1.
+int token_reloader_watch(TokenReloader* reloader);
+
+// Wait up to timeout_ms (-1: forever) for a change to the file and
+// reload it. Returns 1 if reloaded, 0 on timeout, -1 on error.
+int token_reloader_poll(TokenReloader* reloader, int timeout_ms, TokenReloadStats* stats);
+
+#endif // TOKEN_RELOAD_H
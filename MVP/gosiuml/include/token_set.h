@@ -0,0 +1,43 @@
+#ifndef TOKEN_SET_H
+#define TOKEN_SET_H
+
+#include "phenomemory_platform.h"
+#include "token_parser.h"
+
+// A parsed token set is a single allocation:
+//   [TokenSetHeader, padded to 64 bytes][PhenoToken x N][PhenoEdge x M]
+// The caller only sees the token array; the header sits right before it,
+// so releasing the whole set is one free() regardless of N and M. A
+// pointer is taken for a set when the header in front of it carries the
+// magic and points back to itself; debug builds (-DDEBUG) also list live
+// sets and refuse unlisted pointers before reading in front of them.
+#define TOKEN_SET_MAGIC 0x54455354u   // "TSET"
+#define TOKEN_SET_HEADER_SIZE 64
+
+typedef struct TokenSetHeader {
+    uint32_t magic;
+    uint32_t reserved;
+    size_t token_count;
+    size_t relation_count;
+    PhenoEdge* relations;
+    struct TokenSetHeader* self;    // Back-pointer, checked with the magic
+    struct TokenSetHeader* next;    // Live sets (debug builds)
+    struct TokenSetHeader* prev;
+} TokenSetHeader;
+
+// Allocate an uninitialized set with room for the given counts
+PhenoToken* token_set_alloc(size_t token_count, size_t relation_count);
+// Header of a set returned by token_set_alloc, or NULL for other pointers
+TokenSetHeader* token_set_header(const PhenoToken* tokens);
+void token_set_free(PhenoToken* tokens);
+
+// Fill arena records from scanned views (type/rel_type truncated to 15 chars)
+void token_set_init_token(PhenoToken* token, const TokenRecord* rec);
+void token_set_init_relation(PhenoEdge* edge, const RelationRecord* rec);
+
+// Load a token file into a set. Newline-aligned chunks are scanned on
+// up to `threads` threads (<= 0: one per online CPU) and merged in file
+// order; duplicate token ids are reported but kept.
+PhenoToken* token_set_load(const char* filename, int threads, int* count);
+
+#endif // TOKEN_SET_H
@@ -0,0 +1,633 @@
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <time.h>
+#include <sched.h>
+#include <pthread.h>
+#include <unistd.h>
+#include <stdatomic.h>
+#include "phenomemory_platform.h"
+#include "bench_harness.h"
+
+// gosiuml-bench contention: N threads hammer the same tokens and the
+// report shows how throughput and latency change as threads are added.
+// Each operation targets one of `hot` shared tokens with probability
+// shared%, otherwise the thread's private token, so 0% runs the same
+// code path without contention and 100% is full contention.
+//
+// Workloads:
+//   lock   pheno_token_lock (retried until it succeeds) + pheno_token_unlock
+//   ref    increment_ref_count + decrement_ref_count
+//   share  take a reference on a SHARED machine's token and release it
+//          with step_state_machine (SHARED + FREE), under the machine mutex
+//
+// One operation in `sample` is timed, so clock reads barely affect
+// throughput, into a log-linear histogram with 8 buckets per power of two.
+// Each worker also reads its own perf counters (pheno_perf.h) around the
+// run, and the report gives their sum per operation: cache misses that
+// climb with the thread count point at line bouncing, context switches
+// at threads parked on a lock.
+#define CONTENTION_MAX_THREADS 256
+#define CONTENTION_MAX_HOT 64
+#define CONTENTION_MAX_LIST 16
+#define CONTENTION_BATCH 64             // Operations between checks of the stop flag
+#define CONTENTION_SPIN_LIMIT 64        // Failed lock attempts before yielding
+#define CONTENTION_BAR 40
+
+#define HIST_SUB_BITS 3
+#define HIST_SUB (1 << HIST_SUB_BITS)
+#define HIST_LINEAR (2 * HIST_SUB)      // Values below this get a bucket each
+#define HIST_BUCKETS (HIST_LINEAR + (64 - HIST_SUB_BITS - 1) * HIST_SUB)
+
+typedef enum {
+    WORK_LOCK,
+    WORK_REF,
+    WORK_SHARE,
+    WORK_COUNT
+} Workload;
+
+static const char* const WORKLOAD_NAMES[WORK_COUNT] = { "lock", "ref", "share" };
+
+// ---- Latency histogram ----
+
+typedef struct {
+    uint64_t counts[HIST_BUCKETS];
+    uint64_t total;
+    uint64_t max;
+} Histogram;
+
+static size_t hist_bucket(uint64_t ns) {
+    if (ns < HIST_LINEAR) return (size_t)ns;
+    int e = 63 - __builtin_clzll(ns);
+    return HIST_LINEAR + (size_t)(e - HIST_SUB_BITS - 1) * HIST_SUB +
+           (size_t)((ns >> (e - HIST_SUB_BITS)) & (HIST_SUB - 1));
+}
+
+static uint64_t hist_lower(size_t bucket) {
+    if (bucket < HIST_LINEAR) return bucket;
+    size_t k = bucket - HIST_LINEAR;
+    int e = (int)(k / HIST_SUB) + HIST_SUB_BITS + 1;
+    return (uint64_t)(HIST_SUB + k % HIST_SUB) << (e - HIST_SUB_BITS);
+}
+
+static uint64_t hist_upper(size_t bucket) {
+    return bucket + 1 < HIST_BUCKETS ? hist_lower(bucket + 1) - 1 : UINT64_MAX;
+}
+
+static inline void hist_add(Histogram* h, uint64_t ns) {
+    h->counts[hist_bucket(ns)]++;
+    h->total++;
+    if (ns > h->max) h->max = ns;
+}
+
+static void hist_merge(Histogram* into, const Histogram* h) {
+    for (size_t b = 0; b < HIST_BUCKETS; b++) {
+        into->counts[b] += h->counts[b];
+    }
+    into->total += h->total;
+    if (h->max > into->max) into->max = h->max;
+}
+
+// Upper bound of the bucket holding quantile q, capped at the maximum
+static uint64_t hist_quantile(const Histogram* h, double q) {
+    uint64_t rank = (uint64_t)(q * (double)h->total);
+    if (rank >= h->total) rank = h->total - 1;
+    uint64_t seen = 0;
+    for (size_t b = 0; b < HIST_BUCKETS; b++) {
+        seen += h->counts[b];
+        if (seen > rank) {
+            uint64_t upper = hist_upper(b);
+            return upper < h->max ? upper : h->max;
+        }
+    }
+    return h->max;
+}
+
+// One bar per power of two
+static void hist_print(FILE* out, const Histogram* h) {
+    uint64_t octaves[65] = { 0 };
+    int first = 64, last = 0;
+    for (size_t b = 0; b < HIST_BUCKETS; b++) {
+        if (!h->counts[b]) continue;
+        uint64_t lower = hist_lower(b);
+        int o = lower ? 64 - __builtin_clzll(lower) : 0;   // [2^(o-1), 2^o)
+        octaves[o] += h->counts[b];
+        if (o < first) first = o;
+        if (o > last) last = o;
+    }
+    uint64_t peak = 0;
+    for (int o = first; o <= last; o++) {
+        if (octaves[o] > peak) peak = octaves[o];
+    }
+    for (int o = first; o <= last && peak; o++) {
+        unsigned long long lo = o ? 1ull << (o - 1) : 0, hi = 1ull << o;
+        int bar = (int)((octaves[o] * CONTENTION_BAR + peak - 1) / peak);
+        fprintf(out, "    %10llu - %-10llu ns %6.2f%% %.*s\n", lo, hi,
+                100.0 * (double)octaves[o] / (double)h->total, bar,
+                "########################################");
+    }
+}
+
+// ---- Workers ----
+
+typedef struct {
+    Workload workload;
+    int shared_pct;
+    int threads;
+    uint64_t sample_mask;
+    bool counters;
+    int hot;
+    PhenoToken** hot_tokens;
+    StateMachine** hot_machines;
+    atomic_int ready;
+    atomic_bool go;
+    atomic_bool stop;
+} Run;
+
+typedef struct {
+    Run* run;
+    int index;
+    int cpu;                    // -1: not pinned
+    bool pin_failed;
+    PhenoToken* token;          // Private targets
+    StateMachine* machine;
+    uint64_t ops;
+    uint64_t retries;           // Failed lock attempts
+    uint64_t start_ns;
+    uint64_t end_ns;
+    PhenoPerfSample counts;     // Over the measured loop
+    Histogram hist;
+    pthread_t thread;
+} Worker;
+
+static inline uint64_t op_lock(PhenoToken* token) {
+    uint64_t retries = 0;
+    while (!pheno_token_lock(token)) {
+        if (++retries % CONTENTION_SPIN_LIMIT == 0) sched_yield();
+    }
+    pheno_token_unlock(token);
+    return retries;
+}
+
+static void* contention_worker(void* arg) {
+    Worker* w = (Worker*)arg;
+    Run* run = w->run;
+    if (w->cpu >= 0) {
+        cpu_set_t set;
+        CPU_ZERO(&set);
+        CPU_SET(w->cpu, &set);
+        w->pin_failed = pthread_setaffinity_np(pthread_self(), sizeof(set), &set) != 0;
+    }
+    
+    PhenoPerf perf;
+    bool counters = run->counters && pheno_perf_open(&perf);
+    PhenoPerfSample before, after;
+    
+    uint64_t rng = 0x9E3779B97F4A7C15ull * (uint64_t)(w->index + 1);
+    uint64_t ops = 0, retries = 0;
+    atomic_fetch_add(&run->ready, 1);
+    while (!atomic_load(&run->go)) sched_yield();
+    
+    if (counters) pheno_perf_read(&perf, &before);
+    w->start_ns = bench_now_ns();
+    while (!atomic_load_explicit(&run->stop, memory_order_relaxed)) {
+        for (int k = 0; k < CONTENTION_BATCH; k++, ops++) {
+            rng ^= rng << 13;
+            rng ^= rng >> 7;
+            rng ^= rng << 17;
+            bool shared = (uint32_t)rng % 100 < (uint32_t)run->shared_pct;
+            size_t slot = (size_t)(rng >> 32) % (size_t)run->hot;
+            bool timed = (ops & run->sample_mask) == 0;
+            uint64_t start = timed ? bench_now_ns() : 0;
+    
+            switch (run->workload) {
+                case WORK_LOCK:
+                    retries += op_lock(shared ? run->hot_tokens[slot] : w->token);
+                    break;
+                case WORK_REF: {
+                    PhenoToken* token = shared ? run->hot_tokens[slot] : w->token;
+                    increment_ref_count(&token->mem_flags);
+                    decrement_ref_count(&token->mem_flags);
+                    break;
+                }
+                case WORK_SHARE: {
+                    StateMachine* sm = shared ? run->hot_machines[slot] : w->machine;
+                    increment_ref_count(&sm->token->mem_flags);
+                    step_state_machine(sm, EVENT_FREE);
+                    break;
+                }
+                default:
+                    break;
+            }
+            if (timed) hist_add(&w->hist, bench_now_ns() - start);
+        }
+    }
+    w->end_ns = bench_now_ns();
+    w->counts.valid = 0;
+    if (counters) {
+        pheno_perf_read(&perf, &after);
+        pheno_perf_delta(&before, &after, &w->counts);
+        pheno_perf_close(&perf);
+    }
+    w->ops = ops;
+    w->retries = retries;
+    return NULL;
+}
+
+typedef struct {
+    uint64_t ops;
+    uint64_t retries;
+    uint64_t min_thread_ops;
+    uint64_t max_thread_ops;
+    double seconds;
+    double mops;
+    bool pin_failed;
+    uint32_t counters_valid;    // Counters every worker read
+    double counters[PHENO_PERF_COUNT];  // Per operation
+    Histogram hist;
+} ContentionResult;
+
+// Start run->threads workers together, let them run for `seconds` and
+// merge their counts
+static bool run_contention(Run* run, Worker* workers, const int* cpus, int cpu_count,
+                           double seconds, ContentionResult* result) {
+    atomic_store(&run->ready, 0);
+    atomic_store(&run->go, false);
+    atomic_store(&run->stop, false);
+    
+    int started = 0;
+    for (; started < run->threads; started++) {
+        Worker* w = &workers[started];
+        w->run = run;
+        w->cpu = cpus ? cpus[started % cpu_count] : -1;
+        w->pin_failed = false;
+        memset(&w->hist, 0, sizeof(w->hist));
+        if (pthread_create(&w->thread, NULL, contention_worker, w) != 0) break;
+    }
+    while (atomic_load(&run->ready) < started) sched_yield();
+    
+    bool ok = started == run->threads;
+    if (ok) {
+        atomic_store(&run->go, true);
+        struct timespec ts = { (time_t)seconds, (long)((seconds - (double)(time_t)seconds) * 1e9) };
+        nanosleep(&ts, NULL);
+    }
+    atomic_store(&run->stop, true);
+    atomic_store(&run->go, true);
+    for (int i = 0; i < started; i++) {
+        pthread_join(workers[i].thread, NULL);
+    }
+    if (!ok) return false;
+    
+    memset(result, 0, sizeof(*result));
+    result->min_thread_ops = UINT64_MAX;
+    result->counters_valid = PHENO_PERF_ALL;
+    uint64_t first_start = UINT64_MAX, last_end = 0;
+    for (int i = 0; i < started; i++) {
+        const Worker* w = &workers[i];
+        result->ops += w->ops;
+        result->retries += w->retries;
+        if (w->ops < result->min_thread_ops) result->min_thread_ops = w->ops;
+        if (w->ops > result->max_thread_ops) result->max_thread_ops = w->ops;
+        if (w->start_ns < first_start) first_start = w->start_ns;
+        if (w->end_ns > last_end) last_end = w->end_ns;
+        result->pin_failed |= w->pin_failed;
+        result->counters_valid &= w->counts.valid;
+        for (int c = 0; c < PHENO_PERF_COUNT; c++) {
+            result->counters[c] += (double)w->counts.values[c];
+        }
+        hist_merge(&result->hist, &w->hist);
+    }
+    for (int c = 0; c < PHENO_PERF_COUNT; c++) {
+        result->counters[c] = result->ops ? result->counters[c] / (double)result->ops : 0;
+    }
+    result->seconds = (double)(last_end - first_start) / 1e9;
+    result->mops = (double)result->ops / (result->seconds > 0 ? result->seconds : 1e-9) / 1e6;
+    return true;
+}
+
+// ---- Fixtures ----
+
+// Machine driven to SHARED. SHARE leaves a reference on its token and the
+// workload takes one before each release, so the count never reaches zero.
+static StateMachine* shared_machine(void) {
+    static const PhenoEvent path[] = { EVENT_ALLOC, EVENT_LOCK, EVENT_VALIDATE, EVENT_SHARE };
+    StateMachine* sm = create_state_machine();
+    if (!sm) return NULL;
+    if (!initialize_state_machine(sm)) {
+        destroy_state_machine(sm);
+        return NULL;
+    }
+    for (size_t i = 0; i < sizeof(path) / sizeof(path[0]); i++) {
+        step_state_machine(sm, path[i]);
+    }
+    if (sm->current_state != STATE_SHARED) {
+        destroy_state_machine(sm);
+        return NULL;
+    }
+    return sm;
+}
+
+// Timer cost included in every sampled latency
+static uint64_t timer_overhead_ns(void) {
+    uint64_t best = UINT64_MAX;
+    for (int i = 0; i < 1000; i++) {
+        uint64_t start = bench_now_ns();
+        uint64_t elapsed = bench_now_ns() - start;
+        if (elapsed < best) best = elapsed;
+    }
+    return best;
+}
+
+// ---- Reporting ----
+
+static void print_header(FILE* out, bool counters) {
+    fprintf(out, "%-8s %6s %7s %10s %8s %6s %9s %8s %8s %8s %8s %10s", "workload", "shared",
+            "threads", "Mops/s", "speedup", "fair", "retry/op", "p50 ns", "p90 ns", "p99 ns",
+            "p99.9 ns", "max ns");
+    if (counters) pheno_perf_print_header(out);
+    fprintf(out, "\n");
+}
+
+static void print_result(FILE* out, Workload workload, int shared_pct, int threads,
+                         const ContentionResult* r, double base_mops, bool counters) {
+    fprintf(out, "%-8s %5d%% %7d %10.3f %7.2fx %6.2f %9.3f %8llu %8llu %8llu %8llu %10llu",
+            WORKLOAD_NAMES[workload], shared_pct, threads, r->mops,
+            base_mops > 0 ? r->mops / base_mops : 0,
+            r->max_thread_ops ? (double)r->min_thread_ops / (double)r->max_thread_ops : 0,
+            r->ops ? (double)r->retries / (double)r->ops : 0,
+            (unsigned long long)hist_quantile(&r->hist, 0.50),
+            (unsigned long long)hist_quantile(&r->hist, 0.90),
+            (unsigned long long)hist_quantile(&r->hist, 0.99),
+            (unsigned long long)hist_quantile(&r->hist, 0.999),
+            (unsigned long long)r->hist.max);
+    if (counters) pheno_perf_print_counts(out, r->counters, r->counters_valid);
+    fprintf(out, "%s\n", r->pin_failed ? "  (pinning failed)" : "");
+}
+
+static void write_json_result(FILE* out, bool first, Workload workload, int shared_pct,
+                              int threads, const ContentionResult* r) {
+    fprintf(out, "%s{\"workload\":\"%s\",\"shared\":%d,\"threads\":%d,\"ops\":%llu,"
+            "\"seconds\":%.6g,\"mops\":%.6g,\"retries\":%llu,\"min_thread_ops\":%llu,"
+            "\"max_thread_ops\":%llu,\"samples\":%llu,\"p50\":%llu,\"p90\":%llu,\"p99\":%llu,"
+            "\"p999\":%llu,\"max\":%llu,",
+            first ? "" : ",\n", WORKLOAD_NAMES[workload], shared_pct, threads,
+            (unsigned long long)r->ops, r->seconds, r->mops, (unsigned long long)r->retries,
+            (unsigned long long)r->min_thread_ops, (unsigned long long)r->max_thread_ops,
+            (unsigned long long)r->hist.total,
+            (unsigned long long)hist_quantile(&r->hist, 0.50),
+            (unsigned long long)hist_quantile(&r->hist, 0.90),
+            (unsigned long long)hist_quantile(&r->hist, 0.99),
+            (unsigned long long)hist_quantile(&r->hist, 0.999),
+            (unsigned long long)r->hist.max);
+    for (int c = 0; c < PHENO_PERF_COUNT; c++) {
+        if (r->counters_valid & (1u << c)) {
+            fprintf(out, "\"%s\":%.6g,", pheno_perf_name((PhenoPerfCounter)c), r->counters[c]);
+        }
+    }
+    fprintf(out, "\"histogram\":[");
+    bool first_bucket = true;
+    for (size_t b = 0; b < HIST_BUCKETS; b++) {
+        if (!r->hist.counts[b]) continue;
+        fprintf(out, "%s[%llu,%llu]", first_bucket ? "" : ",",
+                (unsigned long long)hist_lower(b), (unsigned long long)r->hist.counts[b]);
+        first_bucket = false;
+    }
+    fprintf(out, "]}");
+}
+
+// ---- Options ----
+
+// Comma-separated integers in [min, max]; returns the count, -1 if invalid
+static int parse_list(const char* text, int* values, int capacity, int min, int max) {
+    int count = 0;
+    const char* p = text;
+    while (*p) {
+        char* end;
+        long v = strtol(p, &end, 10);
+        if (end == p || v < min || v > max || count == capacity) return -1;
+        values[count++] = (int)v;
+        if (*end == ',') end++;
+        else if (*end) return -1;
+        p = end;
+    }
+    return count ? count : -1;
+}
+
+static int parse_workloads(const char* text, Workload* values) {
+    int count = 0;
+    char buf[64];
+    snprintf(buf, sizeof(buf), "%s", text);
+    for (char* save = NULL, *name = strtok_r(buf, ",", &save); name; name = strtok_r(NULL, ",", &save)) {
+        int w = 0;
+        while (w < WORK_COUNT && strcmp(name, WORKLOAD_NAMES[w]) != 0) w++;
+        if (w == WORK_COUNT || count == WORK_COUNT) return -1;
+        values[count++] = (Workload)w;
+    }
+    return count ? count : -1;
+}
+
+static void usage(void) {
+    fprintf(stderr,
+            "Usage: gosiuml-bench contention [options]\n"
+            "  --workload LIST   lock, ref and/or share (default lock,ref,share)\n"
+            "  --threads LIST    Thread counts (default 1,2,4,... up to the CPU count)\n"
+            "  --shared LIST     Percent of operations on shared tokens (default 0,100)\n"
+            "  --hot N           Shared tokens (default 1, at most %d)\n"
+            "  --duration SEC    Length of each run (default 0.5)\n"
+            "  --sample N        Time one operation in N, a power of two (default 16)\n"
+            "  --pin             Pin thread i to the i-th allowed CPU\n"
+            "  --histogram       Print a latency histogram after each run\n"
+            "  --no-counters     Do not read perf event counters\n"
+            "  --json FILE       Write results, with full histograms, as JSON\n",
+            CONTENTION_MAX_HOT);
+}
+
+int bench_contention_main(int argc, char* argv[], FILE* report) {
+    Workload workloads[WORK_COUNT] = { WORK_LOCK, WORK_REF, WORK_SHARE };
+    int workload_count = WORK_COUNT;
+    int threads[CONTENTION_MAX_LIST];
+    int thread_count = 0;
+    int shared[CONTENTION_MAX_LIST] = { 0, 100 };
+    int shared_count = 2;
+    int hot = 1;
+    double duration = 0.5;
+    long sample = 16;
+    bool pin = false, histogram = false, counters = true;
+    const char* json_path = NULL;
+    
+    for (int i = 1; i < argc; i++) {
+        const char* arg = argv[i];
+        if (strcmp(arg, "-h") == 0 || strcmp(arg, "--help") == 0) {
+            usage();
+            return 0;
+        }
+        if (strcmp(arg, "--pin") == 0) {
+            pin = true;
+            continue;
+        }
+        if (strcmp(arg, "--histogram") == 0) {
+            histogram = true;
+            continue;
+        }
+        if (strcmp(arg, "--no-counters") == 0) {
+            counters = false;
+            continue;
+        }
+        const char* value = i + 1 < argc ? argv[++i] : NULL;
+        bool ok = value != NULL;
+        if (!ok) {
+            // Missing value
+        } else if (strcmp(arg, "--workload") == 0) {
+            ok = (workload_count = parse_workloads(value, workloads)) > 0;
+        } else if (strcmp(arg, "--threads") == 0) {
+            ok = (thread_count = parse_list(value, threads, CONTENTION_MAX_LIST, 1,
+                                            CONTENTION_MAX_THREADS)) > 0;
+        } else if (strcmp(arg, "--shared") == 0) {
+            ok = (shared_count = parse_list(value, shared, CONTENTION_MAX_LIST, 0, 100)) > 0;
+        } else if (strcmp(arg, "--hot") == 0) {
+            hot = atoi(value);
+            ok = hot >= 1 && hot <= CONTENTION_MAX_HOT;
+        } else if (strcmp(arg, "--duration") == 0) {
+            duration = atof(value);
+            ok = duration > 0;
+        } else if (strcmp(arg, "--sample") == 0) {
+            sample = atol(value);
+            ok = sample >= 1 && (sample & (sample - 1)) == 0;
+        } else if (strcmp(arg, "--json") == 0) {
+            json_path = value;
+        } else {
+            ok = false;
+        }
+        if (!ok) {
+            usage();
+            return 2;
+        }
+    }
+    
+    cpu_set_t allowed;
+    int cpus[CPU_SETSIZE];
+    int cpu_count = 0;
+    if (sched_getaffinity(0, sizeof(allowed), &allowed) == 0) {
+        for (int c = 0; c < CPU_SETSIZE; c++) {
+            if (CPU_ISSET(c, &allowed)) cpus[cpu_count++] = c;
+        }
+    }
+    if (cpu_count == 0) {
+        long online = sysconf(_SC_NPROCESSORS_ONLN);
+        cpu_count = online > 0 ? (int)online : 1;
+        for (int c = 0; c < cpu_count && c < CPU_SETSIZE; c++) cpus[c] = c;
+    }
+    if (thread_count == 0) {
+        for (int n = 1; n < cpu_count && n <= CONTENTION_MAX_THREADS && thread_count < CONTENTION_MAX_LIST - 1; n *= 2) {
+            threads[thread_count++] = n;
+        }
+        threads[thread_count++] = cpu_count < CONTENTION_MAX_THREADS ? cpu_count : CONTENTION_MAX_THREADS;
+    }
+    int max_threads = 0;
+    for (int t = 0; t < thread_count; t++) {
+        if (threads[t] > max_threads) max_threads = threads[t];
+    }
+    
+    // Fixtures: hot targets and one private pair per worker
+    PhenoToken* hot_tokens[CONTENTION_MAX_HOT] = { 0 };
+    StateMachine* hot_machines[CONTENTION_MAX_HOT] = { 0 };
+    Worker* workers = calloc((size_t)max_threads, sizeof(Worker));
+    bool ready = workers != NULL;
+    for (int h = 0; ready && h < hot; h++) {
+        hot_tokens[h] = pheno_token_alloc(64);
+        hot_machines[h] = shared_machine();
+        ready = hot_tokens[h] && hot_machines[h];
+    }
+    for (int i = 0; ready && i < max_threads; i++) {
+        workers[i].index = i;
+        workers[i].token = pheno_token_alloc(64);
+        workers[i].machine = shared_machine();
+        ready = workers[i].token && workers[i].machine;
+    }
+    
+    FILE* json = NULL;
+    if (ready && json_path && !(json = fopen(json_path, "w"))) {
+        perror(json_path);
+        ready = false;
+    }
+    
+    int status = ready ? 0 : 2;
+    if (ready) {
+        fprintf(report, "gosiuml-bench contention: %d hot token%s, %.2f s per run, "
+                "1 operation in %ld timed, %d CPU%s%s\n", hot, hot == 1 ? "" : "s", duration,
+                sample, cpu_count, cpu_count == 1 ? "" : "s", pin ? ", pinned" : "");
+        fprintf(report, "Latencies include the clock read (%llu ns); speedup is against the "
+                "first thread count.\n", (unsigned long long)timer_overhead_ns());
+        if (counters) {
+            // Probe once to tell the reader what the workers will see
+            PhenoPerf perf;
+            if (!pheno_perf_open(&perf) || perf.error) {
+                fprintf(report, "Some perf counters are unavailable (%s); they are shown as -\n",
+                        strerror(perf.error ? perf.error : ENOSYS));
+            }
+            pheno_perf_close(&perf);
+            fprintf(report, "Counters are per operation, summed over the workers.\n");
+        }
+        print_header(report, counters);
+        fflush(report);
+        if (json) {
+            fprintf(json, "{\n\"benchmark\":\"gosiuml-contention\",\"hot\":%d,\"duration\":%.6g,"
+                    "\"sample\":%ld,\"pinned\":%s,\"cpus\":%d,\n\"results\":[\n", hot, duration,
+                    sample, pin ? "true" : "false", cpu_count);
+        }
+    } else {
+        fprintf(stderr, "gosiuml-bench: could not set up contention fixtures\n");
+    }
+    
+    static ContentionResult result;
+    bool first_json = true;
+    for (int w = 0; ready && w < workload_count; w++) {
+        for (int s = 0; s < shared_count; s++) {
+            double base_mops = 0;
+            for (int t = 0; t < thread_count; t++) {
+                Run run = {
+                    .workload = workloads[w],
+                    .shared_pct = shared[s],
+                    .threads = threads[t],
+                    .sample_mask = (uint64_t)sample - 1,
+                    .counters = counters,
+                    .hot = hot,
+                    .hot_tokens = hot_tokens,
+                    .hot_machines = hot_machines,
+                };
+                if (!run_contention(&run, workers, pin ? cpus : NULL, cpu_count, duration, &result)) {
+                    fprintf(report, "%-8s %5d%% %7d %10s\n", WORKLOAD_NAMES[workloads[w]],
+                            shared[s], threads[t], "failed");
+                    status = 1;
+                    continue;
+                }
+                if (t == 0) base_mops = result.mops;
+                print_result(report, workloads[w], shared[s], threads[t], &result, base_mops, counters);
+                if (histogram) hist_print(report, &result.hist);
+                fflush(report);
+                if (json) {
+                    write_json_result(json, first_json, workloads[w], shared[s], threads[t], &result);
+                    first_json = false;
+                }
+            }
+        }
+    }
+    
+    if (json) {
+        fprintf(json, "\n]\n}\n");
+        if (fclose(json) != 0) status = 2;
+    }
+    for (int h = 0; h < hot; h++) {
+        destroy_state_machine(hot_machines[h]);
+        pheno_token_free(hot_tokens[h]);
+    }
+    for (int i = 0; workers && i < max_threads; i++) {
+        destroy_state_machine(workers[i].machine);
+        pheno_token_free(workers[i].token);
+    }
+    free(workers);
+    return status;
+}
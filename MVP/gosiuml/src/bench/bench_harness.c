@@ -0,0 +1,292 @@
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <time.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include "bench_harness.h"
+
+#define BENCH_MAX_REPETITIONS 1000
+#define BENCH_OUTLIER_MADS 3.0      // Rejection distance in (normal-scaled) MADs
+#define BENCH_MAD_SCALE 1.4826      // MAD to standard deviation for normal data
+#define BENCH_LINE_MAX 1024
+
+static const char* const UNIT_LATENCY = "ns/op";
+static const char* const UNIT_THROUGHPUT = "MB/s";
+
+void bench_defaults(BenchOptions* options) {
+    options->warmup = 2;
+    options->repetitions = 11;
+    options->min_time = 0.05;
+    options->threshold = 0.05;
+    options->perf = NULL;
+}
+
+uint64_t bench_now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000u + (uint64_t)ts.tv_nsec;
+}
+
+FILE* bench_redirect_stdout(void) {
+    fflush(stdout);
+    int report_fd = dup(STDOUT_FILENO);
+    int null_fd = open("/dev/null", O_WRONLY);
+    FILE* report = report_fd >= 0 ? fdopen(report_fd, "w") : NULL;
+    bool ok = report && null_fd >= 0 && dup2(null_fd, STDOUT_FILENO) >= 0;
+    if (null_fd >= 0) close(null_fd);
+    if (!ok) {
+        if (report) fclose(report);
+        else if (report_fd >= 0) close(report_fd);
+        return NULL;
+    }
+    return report;
+}
+
+static int compare_double(const void* a, const void* b) {
+    double x = *(const double*)a, y = *(const double*)b;
+    return (x > y) - (x < y);
+}
+
+static double median_of(double* sorted, int n) {
+    return n % 2 ? sorted[n / 2] : (sorted[n / 2 - 1] + sorted[n / 2]) / 2;
+}
+
+// Double the iteration count until a repetition takes a noticeable part
+// of min_time, then scale it to min_time
+static uint64_t calibrate(const BenchCase* bc, double min_time, bool* ok) {
+    uint64_t n = 1;
+    double target_ns = min_time * 1e9;
+    for (;;) {
+        uint64_t start = bench_now_ns();
+        if (bc->run(bc->state, n) < 0) {
+            *ok = false;
+            return 0;
+        }
+        double elapsed = (double)(bench_now_ns() - start);
+        if (elapsed >= target_ns / 8 || n >= (1ull << 40)) {
+            double scaled = (double)n * target_ns / (elapsed > 1 ? elapsed : 1);
+            *ok = true;
+            return scaled < 1 ? 1 : (uint64_t)scaled;
+        }
+        n *= 2;
+    }
+}
+
+void bench_run(const BenchCase* bc, const BenchOptions* options, BenchResult* result) {
+    memset(result, 0, sizeof(*result));
+    snprintf(result->name, sizeof(result->name), "%s", bc->name);
+    result->unit = UNIT_LATENCY;
+    
+    int reps = options->repetitions;
+    if (reps < 1) reps = 1;
+    if (reps > BENCH_MAX_REPETITIONS) reps = BENCH_MAX_REPETITIONS;
+    
+    bool ok = true;
+    uint64_t iterations = bc->iterations ? bc->iterations : calibrate(bc, options->min_time, &ok);
+    for (int w = 0; ok && w < options->warmup; w++) {
+        ok = bc->run(bc->state, iterations) >= 0;
+    }
+    
+    double values[BENCH_MAX_REPETITIONS];
+    static PhenoPerfSample counts[BENCH_MAX_REPETITIONS];
+    for (int r = 0; ok && r < reps; r++) {
+        PhenoPerfSample before, after;
+        if (options->perf) pheno_perf_read(options->perf, &before);
+        uint64_t start = bench_now_ns();
+        int64_t bytes = bc->run(bc->state, iterations);
+        double elapsed = (double)(bench_now_ns() - start);
+        if (options->perf) {
+            pheno_perf_read(options->perf, &after);
+            pheno_perf_delta(&before, &after, &counts[r]);
+        } else {
+            counts[r].valid = 0;
+        }
+        if (bytes < 0) {
+            ok = false;
+            break;
+        }
+        if (elapsed < 1) elapsed = 1;
+        if (bytes > 0) {
+            result->unit = UNIT_THROUGHPUT;
+            values[r] = (double)bytes / elapsed * 1e3;      // bytes/ns -> MB/s
+        } else {
+            values[r] = elapsed / (double)iterations;
+        }
+    }
+    result->iterations = iterations;
+    result->repetitions = reps;
+    if (!ok) {
+        result->failed = true;
+        return;
+    }
+    
+    // Reject repetitions far from the median
+    double sorted[BENCH_MAX_REPETITIONS], deviation[BENCH_MAX_REPETITIONS];
+    memcpy(sorted, values, (size_t)reps * sizeof(double));
+    qsort(sorted, (size_t)reps, sizeof(double), compare_double);
+    double median = median_of(sorted, reps);
+    for (int r = 0; r < reps; r++) {
+        deviation[r] = fabs(values[r] - median);
+    }
+    qsort(deviation, (size_t)reps, sizeof(double), compare_double);
+    double limit = BENCH_OUTLIER_MADS * BENCH_MAD_SCALE * median_of(deviation, reps);
+    if (limit < median * 0.01) limit = median * 0.01;
+    
+    int kept = 0;
+    double sum = 0;
+    double counter_sums[PHENO_PERF_COUNT] = { 0 };
+    uint32_t counters_valid = PHENO_PERF_ALL;
+    for (int r = 0; r < reps; r++) {
+        if (fabs(values[r] - median) > limit) continue;
+        sorted[kept++] = values[r];
+        sum += values[r];
+        counters_valid &= counts[r].valid;
+        for (int c = 0; c < PHENO_PERF_COUNT; c++) {
+            counter_sums[c] += (double)counts[r].values[c];
+        }
+    }
+    qsort(sorted, (size_t)kept, sizeof(double), compare_double);
+    
+    double mean = sum / kept, var = 0;
+    for (int k = 0; k < kept; k++) {
+        var += (sorted[k] - mean) * (sorted[k] - mean);
+    }
+    result->kept = kept;
+    result->median = median_of(sorted, kept);
+    result->mean = mean;
+    result->min = sorted[0];
+    result->max = sorted[kept - 1];
+    result->stddev = kept > 1 ? sqrt(var / (kept - 1)) : 0;
+    result->counters_valid = counters_valid;
+    for (int c = 0; c < PHENO_PERF_COUNT; c++) {
+        if (counters_valid & (1u << c)) {
+            result->counters[c] = counter_sums[c] / ((double)kept * (double)iterations);
+        }
+    }
+}
+
+// ---- Reporting ----
+
+void bench_print_header(FILE* out, bool with_baseline) {
+    fprintf(out, "%-36s %12s %-6s %12s %10s %7s", "benchmark", "median", "unit", "mean",
+            "stddev", "kept");
+    if (with_baseline) fprintf(out, " %12s %8s", "baseline", "change");
+    fprintf(out, "\n");
+}
+
+bool bench_print_result(FILE* out, const BenchResult* result, const BenchResult* baseline,
+                        double threshold) {
+    if (result->failed) {
+        fprintf(out, "%-36s %12s\n", result->name, "failed");
+        return false;
+    }
+    
+    fprintf(out, "%-36s %12.2f %-6s %12.2f %10.2f %3d/%-3d", result->name, result->median,
+            result->unit, result->mean, result->stddev, result->kept, result->repetitions);
+    bool regressed = false;
+    if (baseline && !baseline->failed && baseline->median > 0 &&
+        strcmp(baseline->unit, result->unit) == 0) {
+        double change = (result->median - baseline->median) / baseline->median;
+        bool higher_is_better = result->unit == UNIT_THROUGHPUT;
+        regressed = higher_is_better ? change < -threshold : change > threshold;
+        fprintf(out, " %12.2f %+7.1f%%%s", baseline->median, change * 100,
+                regressed ? "  REGRESSION" : "");
+    }
+    fprintf(out, "\n");
+    return regressed;
+}
+
+void bench_print_counters_header(FILE* out) {
+    fprintf(out, "%-36s", "benchmark");
+    pheno_perf_print_header(out);
+    fprintf(out, "\n");
+}
+
+void bench_print_counters(FILE* out, const BenchResult* result) {
+    fprintf(out, "%-36s", result->name);
+    pheno_perf_print_counts(out, result->counters, result->failed ? 0 : result->counters_valid);
+    fprintf(out, "\n");
+}
+
+void bench_write_json(FILE* out, const BenchOptions* options, const BenchResult* results,
+                      size_t count) {
+    fprintf(out, "{\n\"benchmark\":\"gosiuml\",\"warmup\":%d,\"repetitions\":%d,\n\"results\":[\n",
+            options->warmup, options->repetitions);
+    for (size_t i = 0; i < count; i++) {
+        const BenchResult* r = &results[i];
+        fprintf(out, "{\"name\":\"%s\",\"unit\":\"%s\",\"failed\":%s,\"iterations\":%llu,"
+                "\"repetitions\":%d,\"kept\":%d,\"median\":%.6g,\"mean\":%.6g,"
+                "\"min\":%.6g,\"max\":%.6g,\"stddev\":%.6g",
+                r->name, r->unit, r->failed ? "true" : "false",
+                (unsigned long long)r->iterations, r->repetitions, r->kept, r->median,
+                r->mean, r->min, r->max, r->stddev);
+        // Counters per operation, only those measured
+        for (int c = 0; c < PHENO_PERF_COUNT; c++) {
+            if (r->counters_valid & (1u << c)) {
+                fprintf(out, ",\"%s\":%.6g", pheno_perf_name((PhenoPerfCounter)c), r->counters[c]);
+            }
+        }
+        fprintf(out, "}%s\n", i + 1 < count ? "," : "");
+    }
+    fprintf(out, "]\n}\n");
+}
+
+// Value of "key":"..." copied into buf
+static bool json_string_field(const char* line, const char* key, char* buf, size_t size) {
+    const char* p = strstr(line, key);
+    if (!p) return false;
+    p += strlen(key);
+    const char* end = strchr(p, '"');
+    if (!end || (size_t)(end - p) >= size) return false;
+    memcpy(buf, p, (size_t)(end - p));
+    buf[end - p] = '\0';
+    return true;
+}
+
+static double json_number_field(const char* line, const char* key) {
+    const char* p = strstr(line, key);
+    return p ? strtod(p + strlen(key), NULL) : 0;
+}
+
+int bench_read_json(const char* path, BenchResult* results, size_t max) {
+    FILE* f = fopen(path, "r");
+    if (!f) return -1;
+    
+    char line[BENCH_LINE_MAX];
+    char unit[16];
+    size_t count = 0;
+    while (count < max && fgets(line, sizeof(line), f)) {
+        BenchResult* r = &results[count];
+        memset(r, 0, sizeof(*r));
+        if (!json_string_field(line, "\"name\":\"", r->name, sizeof(r->name))) continue;
+        if (!json_string_field(line, "\"unit\":\"", unit, sizeof(unit))) continue;
+        r->unit = strcmp(unit, UNIT_THROUGHPUT) == 0 ? UNIT_THROUGHPUT : UNIT_LATENCY;
+        r->failed = strstr(line, "\"failed\":true") != NULL;
+        r->iterations = (uint64_t)json_number_field(line, "\"iterations\":");
+        r->repetitions = (int)json_number_field(line, "\"repetitions\":");
+        r->kept = (int)json_number_field(line, "\"kept\":");
+        r->median = json_number_field(line, "\"median\":");
+        r->mean = json_number_field(line, "\"mean\":");
+        r->min = json_number_field(line, "\"min\":");
+        r->max = json_number_field(line, "\"max\":");
+        r->stddev = json_number_field(line, "\"stddev\":");
+        for (int c = 0; c < PHENO_PERF_COUNT; c++) {
+            char key[32];
+            snprintf(key, sizeof(key), "\"%s\":", pheno_perf_name((PhenoPerfCounter)c));
+            if (!strstr(line, key)) continue;
+            r->counters[c] = json_number_field(line, key);
+            r->counters_valid |= 1u << c;
+        }
+        count++;
+    }
+    fclose(f);
+    return (int)count;
+}
+
+const BenchResult* bench_find(const BenchResult* results, size_t count, const char* name) {
+    for (size_t i = 0; i < count; i++) {
+        if (strcmp(results[i].name, name) == 0) return &results[i];
+    }
+    return NULL;
+}
@@ -0,0 +1,353 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include "phenomemory_platform.h"
+#include "gosiuml.h"
+#include "svg_generator.h"
+#include "bench_harness.h"
+
+// gosiuml-bench: microbenchmarks of the core hot paths.
+//
+// The core logs with printf; stdout is sent to /dev/null while cases
+// run, so timings include the formatting but not terminal I/O, and the
+// report goes to the original stdout. pheno_token_alloc carves data from
+// a fixed 16 MB pool that pheno_token_free never returns, so allocation
+// cases run a fixed number of iterations sized to BENCH_POOL_BUDGET
+// instead of calibrating.
+//
+// Where perf events are available, counters (pheno_perf.h) are read
+// around every measured repetition and reported per operation in a second
+// table, so a slower case can be told apart as more instructions, more
+// cache misses or more context switches.
+#define BENCH_POOL_BUDGET (3u << 20)    // Pool bytes per allocation case
+#define BENCH_RELATIONS 1024            // Working set of the relation cases (power of two)
+#define BENCH_MAX_CASES 32
+#define BENCH_DEFAULT_TOKENS 100000
+
+// ---- Cases ----
+
+static int64_t bench_alloc_free(void* state, uint64_t iterations) {
+    uint32_t size = *(const uint32_t*)state;
+    for (uint64_t i = 0; i < iterations; i++) {
+        PhenoToken* token = pheno_token_alloc(size);
+        if (!token) return -1;
+        pheno_token_free(token);
+    }
+    return 0;
+}
+
+static int64_t bench_lock_unlock(void* state, uint64_t iterations) {
+    PhenoToken* token = (PhenoToken*)state;
+    for (uint64_t i = 0; i < iterations; i++) {
+        pheno_token_lock(token);
+        pheno_token_unlock(token);
+    }
+    return 0;
+}
+
+// Alternate two events on one machine; iterations are steps
+typedef struct {
+    StateMachine* sm;
+    PhenoEvent events[2];
+} StepState;
+
+static int64_t bench_step(void* state, uint64_t iterations) {
+    StepState* s = (StepState*)state;
+    for (uint64_t i = 0; i < iterations; i++) {
+        step_state_machine(s->sm, s->events[i & 1]);
+    }
+    return 0;
+}
+
+typedef struct {
+    PhenoRelation rels[BENCH_RELATIONS];
+    uint8_t person_a[BENCH_RELATIONS];
+    uint8_t person_b[BENCH_RELATIONS];
+} RelationState;
+
+static int64_t bench_map_obj(void* state, uint64_t iterations) {
+    RelationState* s = (RelationState*)state;
+    for (uint64_t i = 0; i < iterations; i++) {
+        map_obj_to_obj(&s->rels[i & (BENCH_RELATIONS - 1)], &s->rels[(i + 1) & (BENCH_RELATIONS - 1)]);
+    }
+    return 0;
+}
+
+static int64_t bench_person_model(void* state, uint64_t iterations) {
+    RelationState* s = (RelationState*)state;
+    for (uint64_t i = 0; i < iterations; i++) {
+        size_t k = i & (BENCH_RELATIONS - 1);
+        apply_person_model(&s->rels[k], s->person_a[k], s->person_b[k]);
+    }
+    return 0;
+}
+
+// Iterations are relations, scored BENCH_RELATIONS at a time
+static int64_t bench_person_model_batch(void* state, uint64_t iterations) {
+    RelationState* s = (RelationState*)state;
+    for (uint64_t done = 0; done < iterations;) {
+        size_t n = iterations - done < BENCH_RELATIONS ? (size_t)(iterations - done) : BENCH_RELATIONS;
+        apply_person_model_batch(s->rels, s->person_a, s->person_b, n);
+        done += n;
+    }
+    return 0;
+}
+
+typedef struct {
+    char path[256];
+    int64_t bytes;              // Size of the input, or of one output
+    PhenoToken* tokens;
+    int count;
+} FileState;
+
+static int64_t bench_parse(void* state, uint64_t iterations) {
+    FileState* s = (FileState*)state;
+    for (uint64_t i = 0; i < iterations; i++) {
+        int count = 0;
+        PhenoToken* tokens = gosiuml_parse_file(s->path, &count);
+        if (!tokens) return -1;
+        gosiuml_free_tokens(tokens, count);
+    }
+    return s->bytes * (int64_t)iterations;
+}
+
+static int64_t bench_svg(void* state, uint64_t iterations) {
+    FileState* s = (FileState*)state;
+    for (uint64_t i = 0; i < iterations; i++) {
+        if (generate_svg_from_tokens(s->tokens, s->count, "/dev/null") != 0) return -1;
+    }
+    return s->bytes * (int64_t)iterations;
+}
+
+// ---- Fixtures ----
+
+static const char* const TOKEN_TYPES[] = {
+    "NODE_IDENTITY", "NODE_STATE", "CLUSTER_TOPOLOGY", "FRAME_REFERENCE",
+    "NODE_DEGRADATION", "CLUSTER_CONSENSUS", "FRAME_TRANSFORM", "FRAME_COLLAPSE"
+};
+
+// Token file with `tokens` tokens and, optionally, one relation per token
+static bool write_token_file(const char* path, int tokens, bool relations) {
+    FILE* f = fopen(path, "w");
+    if (!f) return false;
+    
+    for (int i = 1; i <= tokens; i++) {
+        fprintf(f, "TOKEN: 0x%08X %s %d\n", (unsigned)i, TOKEN_TYPES[i % 8], i % 8);
+    }
+    for (int i = 1; relations && i <= tokens; i++) {
+        fprintf(f, "RELATION: 0x%08X -> 0x%08X : LINK\n", (unsigned)i,
+                (unsigned)((uint64_t)i * 7 % (uint64_t)tokens + 1));
+    }
+    return fclose(f) == 0;
+}
+
+static int64_t file_size(const char* path) {
+    struct stat st;
+    return stat(path, &st) == 0 ? (int64_t)st.st_size : -1;
+}
+
+static void usage(const char* prog) {
+    fprintf(stderr,
+            "Usage: %s [options]\n"
+            "       %s contention [options]   (see contention --help)\n"
+            "  --filter TEXT     Run only cases whose name contains TEXT\n"
+            "  --reps N          Measured repetitions per case (default 11)\n"
+            "  --warmup N        Discarded repetitions per case (default 2)\n"
+            "  --min-time SEC    Target time of one repetition (default 0.05)\n"
+            "  --tokens N        Tokens in the parse and SVG inputs (default %d)\n"
+            "  --json FILE       Write results as JSON\n"
+            "  --baseline FILE   Compare with results saved by --json\n"
+            "  --threshold PCT   Change flagged as a regression (default 5)\n"
+            "  --no-counters     Do not read perf event counters\n"
+            "Exits with status 1 if a case fails or regresses.\n",
+            prog, prog, BENCH_DEFAULT_TOKENS);
+}
+
+int main(int argc, char* argv[]) {
+    if (argc > 1 && strcmp(argv[1], "contention") == 0) {
+        FILE* report = bench_redirect_stdout();
+        if (!report) {
+            perror("gosiuml-bench: redirecting stdout");
+            return 2;
+        }
+        int status = bench_contention_main(argc - 1, argv + 1, report);
+        fclose(report);
+        return status;
+    }
+    
+    BenchOptions options;
+    bench_defaults(&options);
+    const char* filter = NULL;
+    const char* json_path = NULL;
+    const char* baseline_path = NULL;
+    int token_count = BENCH_DEFAULT_TOKENS;
+    bool counters = true;
+    
+    for (int i = 1; i < argc; i++) {
+        const char* arg = argv[i];
+        const char* value = i + 1 < argc ? argv[i + 1] : NULL;
+        if (strcmp(arg, "-h") == 0 || strcmp(arg, "--help") == 0) {
+            usage(argv[0]);
+            return 0;
+        }
+        if (strcmp(arg, "--no-counters") == 0) {
+            counters = false;
+            continue;
+        }
+        if (!value) {
+            usage(argv[0]);
+            return 2;
+        }
+        i++;
+        if (strcmp(arg, "--filter") == 0) filter = value;
+        else if (strcmp(arg, "--reps") == 0) options.repetitions = atoi(value);
+        else if (strcmp(arg, "--warmup") == 0) options.warmup = atoi(value);
+        else if (strcmp(arg, "--min-time") == 0) options.min_time = atof(value);
+        else if (strcmp(arg, "--tokens") == 0) token_count = atoi(value);
+        else if (strcmp(arg, "--json") == 0) json_path = value;
+        else if (strcmp(arg, "--baseline") == 0) baseline_path = value;
+        else if (strcmp(arg, "--threshold") == 0) options.threshold = atof(value) / 100;
+        else {
+            usage(argv[0]);
+            return 2;
+        }
+    }
+    if (options.repetitions < 1 || options.warmup < 0 || options.min_time <= 0 || token_count < 1) {
+        usage(argv[0]);
+        return 2;
+    }
+    
+    BenchResult baseline[BENCH_MAX_CASES];
+    int baseline_count = 0;
+    if (baseline_path) {
+        baseline_count = bench_read_json(baseline_path, baseline, BENCH_MAX_CASES);
+        if (baseline_count < 0) {
+            perror(baseline_path);
+            return 2;
+        }
+    }
+    
+    // Report on the real stdout; core logging goes to /dev/null
+    FILE* report = bench_redirect_stdout();
+    if (!report) {
+        perror("gosiuml-bench: redirecting stdout");
+        return 2;
+    }
+    
+    char dir[] = "/tmp/gosiuml-bench.XXXXXX";
+    if (!mkdtemp(dir)) {
+        perror("gosiuml-bench: mkdtemp");
+        return 2;
+    }
+    
+    // Fixtures
+    static uint32_t alloc_sizes[] = { 64, 1024, 4096 };
+    static RelationState relations;
+    for (size_t k = 0; k < BENCH_RELATIONS; k++) {
+        relations.person_a[k] = (uint8_t)(k * 37 + 11);
+        relations.person_b[k] = (uint8_t)(k * 101 + 3);
+    }
+    
+    PhenoToken* lock_token = pheno_token_alloc(64);
+    StateMachine* sm = create_state_machine();
+    bool ready = lock_token && sm && initialize_state_machine(sm);
+    if (ready) step_state_machine(sm, EVENT_ALLOC);
+    StepState lock_steps = { sm, { EVENT_LOCK, EVENT_UNLOCK } };
+    StepState rejected_steps = { sm, { EVENT_RECOVER, EVENT_RECOVER } };
+    
+    FileState parse_input = { .bytes = -1 };
+    FileState svg_input = { .bytes = -1 };
+    char svg_tokens[sizeof(dir) + 16], svg_output[sizeof(dir) + 16];
+    snprintf(parse_input.path, sizeof(parse_input.path), "%s/tokens.txt", dir);
+    snprintf(svg_tokens, sizeof(svg_tokens), "%s/grid.txt", dir);
+    snprintf(svg_output, sizeof(svg_output), "%s/grid.svg", dir);
+    if (ready && write_token_file(parse_input.path, token_count, true) &&
+        write_token_file(svg_tokens, token_count, false)) {
+        parse_input.bytes = file_size(parse_input.path);
+        svg_input.tokens = gosiuml_parse_file(svg_tokens, &svg_input.count);
+        if (svg_input.tokens && generate_svg_from_tokens(svg_input.tokens, svg_input.count, svg_output) == 0) {
+            svg_input.bytes = file_size(svg_output);
+        }
+    }
+    if (!ready || parse_input.bytes <= 0 || svg_input.bytes <= 0) {
+        fprintf(stderr, "gosiuml-bench: could not set up fixtures in %s\n", dir);
+        return 2;
+    }
+    
+    BenchCase cases[BENCH_MAX_CASES];
+    size_t case_count = 0;
+    for (size_t k = 0; k < sizeof(alloc_sizes) / sizeof(alloc_sizes[0]); k++) {
+        static char names[3][BENCH_NAME_MAX];
+        uint64_t iterations = BENCH_POOL_BUDGET / alloc_sizes[k] / (uint64_t)(options.warmup + options.repetitions);
+        snprintf(names[k], sizeof(names[k]), "token_alloc_free/%u", alloc_sizes[k]);
+        cases[case_count++] = (BenchCase){ names[k], bench_alloc_free, &alloc_sizes[k],
+                                           iterations ? iterations : 1 };
+    }
+    cases[case_count++] = (BenchCase){ "token_lock_unlock", bench_lock_unlock, lock_token, 0 };
+    cases[case_count++] = (BenchCase){ "step_state_machine/lock_unlock", bench_step, &lock_steps, 0 };
+    cases[case_count++] = (BenchCase){ "step_state_machine/rejected", bench_step, &rejected_steps, 0 };
+    cases[case_count++] = (BenchCase){ "map_obj_to_obj", bench_map_obj, &relations, 0 };
+    cases[case_count++] = (BenchCase){ "apply_person_model", bench_person_model, &relations, 0 };
+    cases[case_count++] = (BenchCase){ "apply_person_model_batch", bench_person_model_batch, &relations, 0 };
+    cases[case_count++] = (BenchCase){ "parse_token_file", bench_parse, &parse_input, 0 };
+    cases[case_count++] = (BenchCase){ "svg_emit", bench_svg, &svg_input, 0 };
+    
+    PhenoPerf perf;
+    bool have_perf = counters && pheno_perf_open(&perf);
+    if (have_perf) options.perf = &perf;
+    
+    fprintf(report, "gosiuml-bench: %d repetitions after %d warmup, %.0f ms each, %d tokens\n",
+            options.repetitions, options.warmup, options.min_time * 1e3, token_count);
+    if (counters && (!have_perf || perf.error)) {
+        fprintf(report, "Some perf counters are unavailable (%s); they are shown as -\n",
+                strerror(perf.error ? perf.error : ENOSYS));
+    }
+    bench_print_header(report, baseline_count > 0);
+    fflush(report);
+    
+    BenchResult results[BENCH_MAX_CASES];
+    size_t result_count = 0;
+    int status = 0;
+    for (size_t c = 0; c < case_count; c++) {
+        if (filter && !strstr(cases[c].name, filter)) continue;
+    
+        BenchResult* r = &results[result_count++];
+        bench_run(&cases[c], &options, r);
+        const BenchResult* base = bench_find(baseline, baseline_count > 0 ? (size_t)baseline_count : 0, r->name);
+        if (bench_print_result(report, r, base, options.threshold) || r->failed) status = 1;
+        fflush(report);
+    }
+    
+    if (have_perf && result_count) {
+        fprintf(report, "\nCounters per operation (per iteration for MB/s cases):\n");
+        bench_print_counters_header(report);
+        for (size_t r = 0; r < result_count; r++) {
+            bench_print_counters(report, &results[r]);
+        }
+    }
+    
+    if (json_path) {
+        FILE* json = fopen(json_path, "w");
+        if (!json) {
+            perror(json_path);
+            status = 2;
+        } else {
+            bench_write_json(json, &options, results, result_count);
+            if (fclose(json) != 0) status = 2;
+        }
+    }
+    
+    gosiuml_free_tokens(svg_input.tokens, svg_input.count);
+    destroy_state_machine(sm);
+    pheno_token_free(lock_token);
+    if (have_perf) pheno_perf_close(&perf);
+    unlink(parse_input.path);
+    unlink(svg_tokens);
+    unlink(svg_output);
+    rmdir(dir);
+    fclose(report);
+    return status;
+}
@@ -1,19 +1,526 @@
-#ifndef CLI_PARSER_H
-#define CLI_PARSER_H
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <time.h>
+#include <unistd.h>
+#include "cli_parser.h"
+#include "token_binary.h"
+#include "svg_generator.h"
+#include "gosiuml.h"
+#include "token_set.h"
+#include "pheno_export.h"
+#include "pheno_lod.h"
+#include "pheno_symbol.h"
+#include "pheno_diagram.h"
+#include "pheno_stream.h"
+#include "pheno_trace.h"
+#include "pheno_deflate.h"
+#include "pheno_perf.h"
+#include "token_reload.h"
 
-#include "phenomemory_platform.h"
+// --gzip[=LEVEL] (any position after the command): export compresses its
+// output, and LEVEL applies to .gz and .svgz outputs of every command
+static int g_gzip_level = -1;
 
-// Forward declaration
-typedef struct GosiUMLContext GosiUMLContext;
+// --perf: enable the core's counter probes and report them on stderr
+static bool g_perf;
 
-// CLI functions
-int parse_cli_args(int argc, char* argv[]);
-int parse_cli_config(const char* config_file);
-void print_token_info(PhenoToken* token);
-void display_state_diagram(GosiUMLContext* ctx);
+// compile <input> [output]: output defaults to the input with a .gtok extension
+static int command_compile(int argc, char* argv[]) {
+    if (argc < 3 || argc > 4) {
+        fprintf(stderr, "Usage: %s compile <input> [output.gtok]\n", argv[0]);
+        return 2;
+    }
+    
+    const char* input = argv[2];
+    char* output = NULL;
+    if (argc == 4) {
+        output = strdup(argv[3]);
+    } else {
+        const char* slash = strrchr(input, '/');
+        const char* dot = strrchr(input, '.');
+        size_t stem = (dot && (!slash || dot > slash)) ? (size_t)(dot - input) : strlen(input);
+        output = (char*)malloc(stem + 6);
+        if (output) {
+            memcpy(output, input, stem);
+            memcpy(output + stem, ".gtok", 6);
+        }
+    }
+    if (!output) return 1;
+    
+    int status = gtok_compile(input, output) ? 0 : 1;
+    free(output);
+    return status;
+}
 
-// Context management
-GosiUMLContext* create_cli_context(void);
-void free_cli_context(GosiUMLContext* ctx);
+// Render again whenever the template file changes, until SIGINT or
+// SIGTERM. A broken edit is reported and the last good version stays.
+static int svg_follow_template(PhenoToken* tokens, int count, const char* output,
+                               SvgTemplate* st, PhenoTemplate* tpl) {
+    sigset_t signals;
+    sigemptyset(&signals);
+    sigaddset(&signals, SIGINT);
+    sigaddset(&signals, SIGTERM);
+    pthread_sigmask(SIG_BLOCK, &signals, NULL);
+    printf("Watching the template; Ctrl-C to stop\n");
+    fflush(stdout);
+    
+    int status = 0;
+    const struct timespec interval = { 0, 250000000 };
+    while (sigtimedwait(&signals, NULL, &interval) < 0) {
+        if (svg_template_reload(st, tpl) != 1) continue;
+        status = generate_svg_with_template(tokens, count, output, NULL, st) == 0 ? 0 : 1;
+        if (status == 0) printf("Rendered %s\n", output);
+        fflush(stdout);
+    }
+    
+    pthread_sigmask(SIG_UNBLOCK, &signals, NULL);
+    return status;
+}
 
-#endif // CLI_PARSER_H
+// svg <input> <output.svg> [template [--watch]]: render every token in a
+// token file, optionally through a custom template (templates/svg_diagram.tpl).
+// --watch renders again each time the template is saved.
+static int command_svg(int argc, char* argv[]) {
+    bool watch = argc == 6 && strcmp(argv[5], "--watch") == 0;
+    if (argc != 4 && argc != 5 && !watch) {
+        fprintf(stderr, "Usage: %s svg <input> <output.svg> [template [--watch]]\n", argv[0]);
+        return 2;
+    }
+    
+    PhenoTemplate* tpl = NULL;
+    SvgTemplate custom;
+    if (argc >= 5) {
+        tpl = pheno_template_load(argv[4], &svg_template_schema);
+        if (!tpl || !svg_template_bind(&custom, tpl)) {
+            pheno_template_free(tpl);
+            return 1;
+        }
+    }
+    
+    int count = 0;
+    PhenoToken* tokens = gosiuml_parse_file(argv[2], &count);
+    int status = 1;
+    if (tokens) {
+        status = generate_svg_with_template(tokens, count, argv[3], NULL, tpl ? &custom : NULL) == 0 ? 0 : 1;
+        if (status == 0 && watch) status = svg_follow_template(tokens, count, argv[3], &custom, tpl);
+        gosiuml_free_tokens(tokens, count);
+    }
+    pheno_template_free(tpl);
+    return status;
+}
+
+// NDJSON export straight from the token stream: each record is converted
+// and written as it is scanned, so memory use does not grow with the file
+static void export_stream_token(const TokenRecord* rec, void* user) {
+    PhenoToken token;
+    token_set_init_token(&token, rec);
+    pheno_export_token((PhenoExporter*)user, &token);
+}
+
+static void export_stream_relation(const RelationRecord* rec, void* user) {
+    PhenoEdge edge;
+    token_set_init_relation(&edge, rec);
+    pheno_export_relation((PhenoExporter*)user, &edge);
+}
+
+static int export_stream(const char* input, PhenoWriter* w) {
+    int in_fd = open(input, O_RDONLY | O_CLOEXEC);
+    if (in_fd < 0) {
+        perror(input);
+        return 1;
+    }
+    
+    // Parse and export interleave here, so one probe covers both
+    static PhenoPerfProbe probe = PHENO_PERF_PROBE_INIT("export_stream");
+    PhenoPerfMark mark;
+    pheno_perf_probe_begin(&mark);
+    PhenoExporter ex;
+    pheno_export_begin(&ex, w, FORMAT_NDJSON);
+    int status = gosiuml_parse_stream(in_fd, export_stream_token, export_stream_relation, &ex);
+    pheno_export_end(&ex);
+    pheno_perf_probe_end(&probe, &mark);
+    close(in_fd);
+    return status == 0 ? 0 : 1;
+}
+
+// export <xml|json|ndjson> <input> [output]: output defaults to stdout;
+// gzip-compressed with --gzip or a .gz output
+static int command_export(int argc, char* argv[]) {
+    GosiUMLFormat format;
+    if (argc >= 3 && strcmp(argv[2], "xml") == 0) format = FORMAT_XML;
+    else if (argc >= 3 && strcmp(argv[2], "json") == 0) format = FORMAT_JSON;
+    else if (argc >= 3 && strcmp(argv[2], "ndjson") == 0) format = FORMAT_NDJSON;
+    else argc = 0;
+    
+    if (argc < 4 || argc > 5) {
+        fprintf(stderr, "Usage: %s export <xml|json|ndjson> <input> [output]\n", argv[0]);
+        return 2;
+    }
+    
+    int out_fd = STDOUT_FILENO;
+    if (argc == 5) {
+        out_fd = open(argv[4], O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+        if (out_fd < 0) {
+            perror(argv[4]);
+            return 1;
+        }
+    }
+    
+    PhenoWriter w;
+    if (!pheno_writer_attach(&w, out_fd)) {
+        if (out_fd != STDOUT_FILENO) close(out_fd);
+        return 1;
+    }
+    int status;
+    bool compress = g_gzip_level >= 0 || (argc == 5 && pheno_writer_gzip_path(argv[4]));
+    int level = g_gzip_level >= 0 ? g_gzip_level : PHENO_DEFLATE_LEVEL_DEFAULT;
+    if (compress && !pheno_writer_gzip(&w, level, 0)) {
+        status = 1;
+    } else if (format == FORMAT_NDJSON) {
+        status = export_stream(argv[3], &w);
+    } else {
+        int count = 0;
+        PhenoToken* tokens = gosiuml_parse_file(argv[3], &count);
+        status = tokens && pheno_export_tokens(&w, format, tokens, (size_t)count) ? 0 : 1;
+        gosiuml_free_tokens(tokens, count);
+    }
+    
+    if (!pheno_writer_close(&w)) status = 1;
+    if (out_fd != STDOUT_FILENO && close(out_fd) != 0) status = 1;
+    return status;
+}
+
+// Key of a group named on the command line: type name, state name or zone number
+static bool lod_parse_key(PhenoLodGroup group, const char* name, uint32_t* key) {
+    if (group == LOD_GROUP_TYPE) {
+        *key = pheno_symbol_find(name, strlen(name));
+        return *key != PHENO_SYMBOL_NONE;
+    }
+    if (group == LOD_GROUP_STATE) {
+        for (uint32_t state = STATE_NIL; state <= STATE_FREED; state++) {
+            if (strcmp(name, get_state_name((PhenoState)state)) == 0) {
+                *key = state;
+                return true;
+            }
+        }
+        return false;
+    }
+    char* end;
+    unsigned long zone = strtoul(name, &end, 0);
+    *key = (uint32_t)zone;
+    return *name && !*end && zone <= UINT8_MAX;
+}
+
+// lod <type|zone|state> <input> <output.svg> [group...]: one summary box
+// per group; the named groups are also drawn token by token
+static int command_lod(int argc, char* argv[]) {
+    PhenoLodOptions options;
+    pheno_lod_defaults(&options);
+    if (argc >= 3 && strcmp(argv[2], "type") == 0) options.group = LOD_GROUP_TYPE;
+    else if (argc >= 3 && strcmp(argv[2], "zone") == 0) options.group = LOD_GROUP_ZONE;
+    else if (argc >= 3 && strcmp(argv[2], "state") == 0) options.group = LOD_GROUP_STATE;
+    else argc = 0;
+    
+    if (argc < 5) {
+        fprintf(stderr, "Usage: %s lod <type|zone|state> <input> <output.svg> [group...]\n", argv[0]);
+        return 2;
+    }
+    
+    int count = 0;
+    PhenoToken* tokens = gosiuml_parse_file(argv[3], &count);
+    if (!tokens) return 1;
+    
+    // Type names are interned by the parse, so groups resolve afterwards
+    uint32_t* expand = (uint32_t*)malloc((size_t)(argc - 5 + 1) * sizeof(uint32_t));
+    int status = expand ? 0 : 1;
+    for (int i = 5; status == 0 && i < argc; i++) {
+        if (!lod_parse_key(options.group, argv[i], &expand[options.expand_count])) {
+            fprintf(stderr, "Unknown group: %s\n", argv[i]);
+            status = 2;
+        } else {
+            options.expand_count++;
+        }
+    }
+    options.expand = expand;
+    
+    if (status == 0) status = generate_svg_lod(tokens, count, argv[4], &options) == 0 ? 0 : 1;
+    free(expand);
+    gosiuml_free_tokens(tokens, count);
+    return status;
+}
+
+// Demo load for watch --demo-load: walks random tokens around the
+// ALLOCATED -> LOCKED -> ACTIVE -> ALLOCATED cycle at a fixed rate by
+// writing their flag words directly, bypassing the state machine. Only
+// for showing the view without a running engine.
+typedef struct {
+    PhenoToken* tokens;
+    int count;
+    unsigned rate;              // Transitions per second
+    atomic_bool stop;
+} WatchLoad;
+
+static void watch_step(PhenoToken* token) {
+    MemFlags* flags = &token->mem_flags;
+    PhenoState from = pheno_token_state(token);
+    PhenoEvent event;
+    switch (from) {
+        case STATE_NIL:
+            set_flag(flags, FLAG_ALLOCATED_BIT);
+            event = EVENT_ALLOC;
+            break;
+        case STATE_ALLOCATED:
+            set_flag(flags, FLAG_LOCKED_BIT);
+            event = EVENT_LOCK;
+            break;
+        case STATE_LOCKED:
+            atomic_fetch_or(&flags->flags, (1U << FLAG_COHERENT_BIT) | (1U << FLAG_PROCESSING_BIT));
+            event = EVENT_VALIDATE;
+            break;
+        case STATE_DEGRADED:
+            set_flag(flags, FLAG_COHERENT_BIT);
+            event = EVENT_RECOVER;
+            break;
+        default:
+            atomic_fetch_and(&flags->flags, ~((1U << FLAG_LOCKED_BIT) | (1U << FLAG_COHERENT_BIT) |
+                                              (1U << FLAG_PROCESSING_BIT) | (1U << FLAG_SHARED_BIT)));
+            event = EVENT_UNLOCK;
+            break;
+    }
+    pheno_trace_record(token->token_id, from, pheno_token_state(token), event);
+}
+
+static void* watch_load(void* arg) {
+    WatchLoad* load = (WatchLoad*)arg;
+    uint32_t x = 0x9E3779B9u;
+    struct timespec tick = { 0, 1000000 };
+    unsigned per_tick = load->rate / 1000, remainder = load->rate % 1000, phase = 0;
+    while (!atomic_load(&load->stop)) {
+        unsigned steps = per_tick + ((phase = (phase + remainder) % 1000) < remainder);
+        for (unsigned i = 0; i < steps; i++) {
+            x ^= x << 13;
+            x ^= x >> 17;
+            x ^= x << 5;
+            watch_step(&load->tokens[x % (uint32_t)load->count]);
+        }
+        nanosleep(&tick, NULL);
+    }
+    return NULL;
+}
+
+// Reload handler for watch: edited definitions and relations go to the
+// diagram. Node positions are fixed, so added and removed tokens are
+// only counted until watch is restarted.
+typedef struct {
+    PhenoStream* stream;
+    PhenoDiagram* diagram;
+    PhenoToken* tokens;         // The diagram's tokens
+    TokenReloader* reloader;
+    size_t unplaced;            // Token additions and removals not shown
+} WatchReload;
+
+static void watch_on_token(uint32_t token_id, TokenReloadChange change, void* user) {
+    WatchReload* w = (WatchReload*)user;
+    const PhenoToken* source = token_reloader_find(w->reloader, token_id);
+    size_t index;
+    if (change != TOKEN_RELOAD_CHANGED || !source ||
+        !pheno_diagram_index(w->diagram, token_id, &index)) {
+        if (change != TOKEN_RELOAD_CHANGED) w->unplaced++;
+        return;
+    }
+    
+    pheno_stream_lock(w->stream);
+    PhenoToken* token = &w->tokens[index];
+    token->type_symbol = source->type_symbol;
+    memcpy(token->sentinel, source->sentinel, sizeof(token->sentinel));
+    token->memory_zone = source->memory_zone;
+    pheno_diagram_redraw(w->diagram, index);
+    pheno_stream_unlock(w->stream);
+}
+
+static void watch_on_relation(uint32_t src_id, uint32_t dst_id, bool added, void* user) {
+    WatchReload* w = (WatchReload*)user;
+    pheno_stream_lock(w->stream);
+    if (added) pheno_diagram_link(w->diagram, src_id, dst_id);
+    else pheno_diagram_unlink(w->diagram, src_id, dst_id);
+    pheno_stream_unlock(w->stream);
+}
+
+// Serve until SIGINT/SIGTERM, reloading the input as it is saved
+static void watch_serve(WatchReload* w, const char* input, const sigset_t* signals) {
+    TokenReloadStats stats;
+    bool reloading = w->reloader && token_reloader_reload(w->reloader, NULL) &&
+                     token_reloader_watch(w->reloader) >= 0;
+    if (reloading) {
+        TokenReloadHandler handler = { watch_on_token, watch_on_relation, w };
+        token_reloader_set_handler(w->reloader, &handler);
+    } else {
+        fprintf(stderr, "[WATCH] Not reloading %s on changes\n", input);
+    }
+    
+    struct timespec now = { 0, 0 };
+    while (sigtimedwait(signals, NULL, &now) < 0) {
+        if (!reloading) {
+            int sig;
+            sigwait(signals, &sig);
+            return;
+        }
+        size_t unplaced = w->unplaced;
+        if (token_reloader_poll(w->reloader, 250, &stats) <= 0) continue;
+        printf("Reloaded %s: %zu tokens changed, %zu relations added, %zu removed\n", input,
+               stats.tokens_changed, stats.relations_added, stats.relations_removed);
+        if (w->unplaced != unplaced) {
+            printf("%zu tokens added or removed; restart watch to place them\n", w->unplaced - unplaced);
+        }
+        fflush(stdout);
+    }
+}
+
+// watch <input> [port] [--demo-load[=RATE]]: serve the token diagram
+// and its live transitions on 127.0.0.1 until interrupted. Only what the
+// engine traces is streamed; --demo-load adds RATE (default 1000)
+// synthetic transitions per second. Saving the input updates the served
+// diagram in place.
+static int command_watch(int argc, char* argv[]) {
+    PhenoStreamOptions options;
+    pheno_stream_defaults(&options);
+    options.port = 8080;
+    unsigned rate = 0;
+    bool usage = argc < 3;
+    bool have_port = false;
+    for (int i = 3; !usage && i < argc; i++) {
+        const char* arg = argv[i];
+        char* end;
+        if (strncmp(arg, "--demo-load", 11) == 0 && (!arg[11] || arg[11] == '=')) {
+            rate = arg[11] ? (unsigned)strtoul(arg + 12, &end, 10) : 1000;
+            usage = arg[11] && (end == arg + 12 || *end);
+        } else if (!have_port && arg[0] != '-') {
+            options.port = (uint16_t)strtoul(arg, &end, 10);
+            usage = end == arg || *end;
+            have_port = true;
+        } else {
+            usage = true;
+        }
+    }
+    if (usage) {
+        fprintf(stderr, "Usage: %s watch <input> [port] [--demo-load[=RATE]]\n", argv[0]);
+        return 2;
+    }
+    
+    if (access("templates/gosiuml_template.html", R_OK) == 0) {
+        options.page = "templates/gosiuml_template.html";
+    }
+    
+    int count = 0;
+    PhenoToken* tokens = gosiuml_parse_file(argv[2], &count);
+    if (!tokens) return 1;
+    size_t relation_count = 0;
+    const PhenoEdge* relations = gosiuml_token_relations(tokens, &relation_count);
+    options.diagram = pheno_diagram_create(tokens, (size_t)count, relations, relation_count, NULL);
+    if (!options.diagram) {
+        gosiuml_free_tokens(tokens, count);
+        return 1;
+    }
+    
+    // Worker threads inherit the blocked signals; only sigwait sees them
+    sigset_t signals;
+    sigemptyset(&signals);
+    sigaddset(&signals, SIGINT);
+    sigaddset(&signals, SIGTERM);
+    pthread_sigmask(SIG_BLOCK, &signals, NULL);
+    
+    int status = 1;
+    PhenoStream* stream = pheno_stream_start(&options);
+    if (stream) {
+        WatchLoad load = { tokens, count, rate, false };
+        pthread_t worker;
+        bool running = rate && count && pthread_create(&worker, NULL, watch_load, &load) == 0;
+        printf("Serving http://127.0.0.1:%u/ (%d tokens", pheno_stream_port(stream), count);
+        if (running) printf(", demo load %u transitions/s", rate);
+        printf("); Ctrl-C to stop\n");
+        fflush(stdout);
+        
+        WatchReload reload = { stream, options.diagram, tokens, token_reloader_create(argv[2]), 0 };
+        watch_serve(&reload, argv[2], &signals);
+        token_reloader_destroy(reload.reloader);
+        if (running) {
+            atomic_store(&load.stop, true);
+            pthread_join(worker, NULL);
+        }
+        uint64_t events, dropped;
+        pheno_stream_stats(stream, &events, &dropped);
+        pheno_stream_stop(stream);
+        printf("Streamed %llu transitions, %llu dropped\n",
+               (unsigned long long)events, (unsigned long long)dropped);
+        status = 0;
+    }
+    
+    pthread_sigmask(SIG_UNBLOCK, &signals, NULL);
+    pheno_diagram_destroy(options.diagram);
+    gosiuml_free_tokens(tokens, count);
+    return status;
+}
+
+// Remove --gzip[=LEVEL] and --perf from argv. Returns false on a bad level.
+static bool take_global_options(int* argc, char* argv[]) {
+    int kept = 2;
+    for (int i = 2; i < *argc; i++) {
+        const char* arg = argv[i];
+        if (strcmp(arg, "--perf") == 0) {
+            g_perf = true;
+            continue;
+        }
+        if (strncmp(arg, "--gzip", 6) != 0 || (arg[6] && arg[6] != '=')) {
+            argv[kept++] = argv[i];
+            continue;
+        }
+        g_gzip_level = PHENO_DEFLATE_LEVEL_DEFAULT;
+        if (arg[6] == '=') {
+            if (arg[7] < '0' || arg[7] > '9' || arg[8]) {
+                fprintf(stderr, "Invalid gzip level: %s\n", arg + 7);
+                return false;
+            }
+            g_gzip_level = arg[7] - '0';
+        }
+        pheno_writer_set_gzip_level(g_gzip_level);
+    }
+    *argc = kept;
+    argv[kept] = NULL;
+    return true;
+}
+
+static int run_command(int argc, char* argv[]) {
+    if (strcmp(argv[1], "compile") == 0) {
+        return command_compile(argc, argv);
+    }
+    if (strcmp(argv[1], "svg") == 0) {
+        return command_svg(argc, argv);
+    }
+    if (strcmp(argv[1], "export") == 0) {
+        return command_export(argc, argv);
+    }
+    if (strcmp(argv[1], "lod") == 0) {
+        return command_lod(argc, argv);
+    }
+    if (strcmp(argv[1], "watch") == 0) {
+        return command_watch(argc, argv);
+    }
+    return -1;
+}
+
+int cli_run_command(int argc, char* argv[]) {
+    if (argc < 2) return -1;
+    if (argv[1][0] != '-' && !take_global_options(&argc, argv)) return 2;
+    
+    pheno_perf_probes_enable(g_perf);
+    int status = run_command(argc, argv);
+    if (g_perf && status >= 0) {
+        fflush(stdout);
+        fprintf(stderr, "Counters per call, each counting the thread that made it:\n");
+        pheno_perf_probes_report(stderr);
+    }
+    return status;
+}
@@ -4,11 +4,64 @@
 #include <unistd.h>
 #include <time.h>
 #include "phenomemory_platform.h"
+#include "cli_parser.h"
+#include "pheno_writer.h"
+#include "gosiuml.h"
+#include "token_binary.h"
+#include "pheno_symbol.h"
+#include "pheno_reach.h"
+#include "svg_generator.h"
+#include "token_reload.h"
+#include "pheno_bitmap.h"
+#include "pheno_relation_table.h"
+#include "pheno_hamming.h"
+#include "pheno_join.h"
+#include "token_set.h"
 
 // External functions
 void pheno_memory_stats(void);
 void pheno_memory_cleanup(void);
 
+// Round-trip checks report here; the run exits non-zero if any failed
+static int g_check_failures = 0;
+
+static void check(bool ok, const char* what) {
+    printf("  %-56s %s\n", what, ok ? "PASS" : "FAIL");
+    if (!ok) g_check_failures++;
+}
+
+// Create a temporary file from path (ending in XXXXXX) holding text
+static bool temp_file(char* path, const char* text) {
+    int fd = mkstemp(path);
+    if (fd < 0) return false;
+    size_t len = strlen(text);
+    bool ok = write(fd, text, len) == (ssize_t)len;
+    close(fd);
+    if (!ok) unlink(path);
+    return ok;
+}
+
+// Whole file, NUL-terminated; NULL if it cannot be read
+static char* read_file(const char* path, size_t* len) {
+    FILE* fp = fopen(path, "rb");
+    if (!fp) return NULL;
+    size_t capacity = 4096, used = 0, n;
+    char* buf = (char*)malloc(capacity);
+    while (buf && (n = fread(buf + used, 1, capacity - used - 1, fp)) > 0) {
+        used += n;
+        if (capacity - used == 1) {
+            char* grown = (char*)realloc(buf, capacity * 2);
+            if (!grown) free(buf);
+            buf = grown;
+            capacity *= 2;
+        }
+    }
+    fclose(fp);
+    if (buf) buf[used] = '\0';
+    if (len) *len = used;
+    return buf;
+}
+
 // Test scenarios
 void test_basic_transitions(void) {
     printf("\n=== Testing Basic State Transitions ===\n");
@@ -127,6 +180,1548 @@ void test_memory_zones(void) {
     }
 }
 
+// Compress data through a gzip writer (optionally flushing halfway) and
+// check that gzip(1) restores it byte for byte
+static bool gzip_roundtrip(const uint8_t* data, size_t len, int level, int threads, bool flush) {
+    char path[] = "/tmp/gosiuml-gzip-XXXXXX";
+    int fd = mkstemp(path);
+    if (fd < 0) return false;
+    
+    PhenoWriter w;
+    bool ok = pheno_writer_attach(&w, fd);
+    if (ok) {
+        ok = pheno_writer_gzip(&w, level, threads);
+        size_t half = flush ? len / 2 : len;
+        pheno_writer_put(&w, data, half);
+        if (flush) ok = pheno_writer_flush(&w) && ok;
+        pheno_writer_put(&w, data + half, len - half);
+        ok = pheno_writer_close(&w) && ok;
+    }
+    close(fd);
+    
+    char command[64];
+    snprintf(command, sizeof(command), "gzip -dc < %s", path);
+    FILE* in = ok ? popen(command, "r") : NULL;
+    if (in) {
+        static uint8_t buf[65536];
+        size_t pos = 0, n;
+        while ((n = fread(buf, 1, sizeof(buf), in)) > 0) {
+            if (pos + n > len || memcmp(buf, data + pos, n) != 0) ok = false;
+            pos += n;
+        }
+        ok = (pclose(in) == 0) && ok && pos == len;
+    } else {
+        ok = false;
+    }
+    unlink(path);
+    return ok;
+}
+
+void test_gzip_roundtrip(void) {
+    printf("\n=== Testing gzip Round Trips ===\n");
+    if (system("gzip --version > /dev/null 2>&1") != 0) {
+        printf("  gzip not found; skipped\n");
+        return;
+    }
+    
+    // Token-like text (long matches, several chunks and writer buffers),
+    // pseudo-random bytes (literals and stored blocks) and one long run
+    size_t text_len = 3 * 1024 * 1024 / 2, noise_len = 300 * 1024, run_len = 100 * 1024;
+    uint8_t* text = (uint8_t*)malloc(text_len);
+    uint8_t* noise = (uint8_t*)malloc(noise_len);
+    uint8_t* run = (uint8_t*)malloc(run_len);
+    if (!text || !noise || !run) {
+        check(false, "allocate inputs");
+        free(text);
+        free(noise);
+        free(run);
+        return;
+    }
+    
+    size_t pos = 0;
+    for (uint32_t id = 1; pos < text_len; id++) {
+        char line[64];
+        int n = snprintf(line, sizeof(line), "TOKEN: 0x%08X NODE_%u %u\n", id, id % 7, id % 4);
+        size_t take = (size_t)n < text_len - pos ? (size_t)n : text_len - pos;
+        memcpy(text + pos, line, take);
+        pos += take;
+    }
+    uint32_t seed = 12345;
+    for (size_t i = 0; i < noise_len; i++) {
+        seed = seed * 1103515245u + 12345u;
+        noise[i] = (uint8_t)(seed >> 16);
+    }
+    memset(run, 'x', run_len);
+    
+    const int levels[] = { 0, 1, 6, 9 };
+    char what[80];
+    check(gzip_roundtrip((const uint8_t*)"", 0, 6, 1, false), "empty input");
+    check(gzip_roundtrip((const uint8_t*)"hello, world\n", 13, 6, 1, false), "short input");
+    for (size_t l = 0; l < sizeof(levels) / sizeof(levels[0]); l++) {
+        snprintf(what, sizeof(what), "token text, level %d, 4 threads", levels[l]);
+        check(gzip_roundtrip(text, text_len, levels[l], 4, false), what);
+        snprintf(what, sizeof(what), "random bytes, level %d", levels[l]);
+        check(gzip_roundtrip(noise, noise_len, levels[l], 1, false), what);
+        snprintf(what, sizeof(what), "single-byte run, level %d", levels[l]);
+        check(gzip_roundtrip(run, run_len, levels[l], 1, false), what);
+    }
+    check(gzip_roundtrip(text, text_len, 6, 1, true), "token text, flushed halfway");
+    
+    free(text);
+    free(noise);
+    free(run);
+}
+
+static int edge_compare(const void* pa, const void* pb) {
+    const PhenoEdge* a = (const PhenoEdge*)pa;
+    const PhenoEdge* b = (const PhenoEdge*)pb;
+    if (a->src_id != b->src_id) return a->src_id < b->src_id ? -1 : 1;
+    if (a->dst_id != b->dst_id) return a->dst_id < b->dst_id ? -1 : 1;
+    return memcmp(a->rel_type, b->rel_type, sizeof(a->rel_type));
+}
+
+// Sorted copy of a set's relations, leaving out those from unknown sources
+static PhenoEdge* sorted_relations(const PhenoToken* tokens, int count, size_t* relation_count) {
+    size_t n = 0;
+    const PhenoEdge* relations = gosiuml_token_relations(tokens, &n);
+    PhenoEdge* sorted = (PhenoEdge*)malloc((n ? n : 1) * sizeof(PhenoEdge));
+    if (!sorted) return NULL;
+    
+    size_t kept = 0;
+    for (size_t r = 0; r < n; r++) {
+        for (int i = 0; i < count; i++) {
+            if (tokens[i].token_id == relations[r].src_id) {
+                sorted[kept++] = relations[r];
+                break;
+            }
+        }
+    }
+    qsort(sorted, kept, sizeof(PhenoEdge), edge_compare);
+    *relation_count = kept;
+    return sorted;
+}
+
+// Compile a token file to .gtok, open it, and load it back through
+// gosiuml_parse_file; a damaged copy must be rejected
+void test_gtok_roundtrip(void) {
+    printf("\n=== Testing .gtok Round Trips ===\n");
+    
+    char text_path[] = "/tmp/gosiuml-gtok-XXXXXX";
+    int fd = mkstemp(text_path);
+    FILE* fp = fd >= 0 ? fdopen(fd, "w") : NULL;
+    if (!fp) {
+        check(false, "create token file");
+        if (fd >= 0) close(fd);
+        return;
+    }
+    for (uint32_t id = 1; id <= 300; id++) {
+        fprintf(fp, "TOKEN: 0x%08X %s %u\n", id, id % 3 ? "NODE_IDENTITY" : "CLUSTER_TOPOLOGY", id % 4);
+    }
+    fprintf(fp, "TOKEN: 0x00000007 DUPLICATE 1\n");
+    for (uint32_t id = 1; id <= 300; id++) {
+        fprintf(fp, "RELATION: 0x%08X->0x%08X:%s\n", id, (id * 7) % 300 + 1, id % 2 ? "DEPENDS" : "OWNS");
+    }
+    fprintf(fp, "RELATION: 0x00000005->0x0000BEEF:DANGLING\n");
+    fprintf(fp, "RELATION: 0x0000BEEF->0x00000005:SKIPPED\n");
+    fclose(fp);
+    
+    char gtok_path[sizeof(text_path) + 5];
+    snprintf(gtok_path, sizeof(gtok_path), "%s.gtok", text_path);
+    check(gtok_compile(text_path, gtok_path), "compile");
+    
+    int text_count = 0;
+    PhenoToken* text = gosiuml_parse_file(text_path, &text_count);
+    GtokFile file;
+    bool opened = text && gtok_open(gtok_path, true, &file);
+    check(opened, "open with checksum");
+    if (opened) {
+        bool same = file.header->token_count == (uint32_t)text_count;
+        for (int i = 0; same && i < text_count; i++) {
+            const char* type = gtok_string(&file, file.tokens[i].type);
+            same = file.tokens[i].token_id == text[i].token_id &&
+                   file.tokens[i].zone == text[i].memory_zone &&
+                   pheno_symbol_find(type, strlen(type)) == text[i].type_symbol;
+        }
+        check(same, "tokens match the text file");
+        
+        // Every edge's resolved index names its destination token
+        bool resolved = true;
+        for (uint32_t e = 0; e < file.header->edge_count; e++) {
+            const GtokEdge* edge = &file.edges[e];
+            resolved &= edge->dst_index == GTOK_NO_TOKEN ? edge->dst_id == 0xBEEF
+                                                         : file.tokens[edge->dst_index].token_id == edge->dst_id;
+        }
+        check(resolved && file.header->edge_count == 301, "relation rows and targets");
+        gtok_close(&file);
+    }
+    
+    int gtok_count = 0;
+    PhenoToken* loaded = gosiuml_parse_file(gtok_path, &gtok_count);
+    bool same = text && loaded && gtok_count == text_count;
+    for (int i = 0; same && i < text_count; i++) {
+        same = loaded[i].token_id == text[i].token_id && loaded[i].memory_zone == text[i].memory_zone &&
+               loaded[i].type_symbol == text[i].type_symbol &&
+               memcmp(loaded[i].sentinel, text[i].sentinel, sizeof(text[i].sentinel)) == 0;
+    }
+    size_t text_relations = 0, gtok_relations = 0;
+    PhenoEdge* a = same ? sorted_relations(text, text_count, &text_relations) : NULL;
+    PhenoEdge* b = same ? sorted_relations(loaded, gtok_count, &gtok_relations) : NULL;
+    same = a && b && text_relations == gtok_relations &&
+           memcmp(a, b, text_relations * sizeof(PhenoEdge)) == 0;
+    check(same, "gosiuml_parse_file loads .gtok like the text");
+    free(a);
+    free(b);
+    gosiuml_free_tokens(loaded, gtok_count);
+    gosiuml_free_tokens(text, text_count);
+    
+    // Damage one relation row, then one string byte
+    bool rejected = false, checksum_caught = false, zone_rejected = false;
+    fp = fopen(gtok_path, "r+b");
+    GtokHeader header;
+    if (fp && fread(&header, sizeof(header), 1, fp) == 1) {
+        uint32_t bad_row = header.edge_count + 1;
+        fseek(fp, (long)(header.rows_offset + 2 * sizeof(uint32_t)), SEEK_SET);
+        uint32_t old_row;
+        bool read_row = fread(&old_row, sizeof(old_row), 1, fp) == 1;
+        fseek(fp, (long)(header.rows_offset + 2 * sizeof(uint32_t)), SEEK_SET);
+        fwrite(&bad_row, sizeof(bad_row), 1, fp);
+        fflush(fp);
+        rejected = read_row && !gtok_open(gtok_path, false, &file);
+        
+        fseek(fp, (long)(header.rows_offset + 2 * sizeof(uint32_t)), SEEK_SET);
+        fwrite(&old_row, sizeof(old_row), 1, fp);
+        fseek(fp, (long)header.strings_offset, SEEK_SET);
+        fputc('#', fp);
+        fflush(fp);
+        bool structure_ok = gtok_open(gtok_path, false, &file);
+        if (structure_ok) gtok_close(&file);
+        checksum_caught = structure_ok && !gtok_open(gtok_path, true, &file);
+        
+        // Zones index fixed-size tables, so they are checked without the checksum
+        uint8_t bad_zone = MAX_MEMORY_ZONES;
+        fseek(fp, (long)(header.tokens_offset + offsetof(GtokToken, zone)), SEEK_SET);
+        fwrite(&bad_zone, sizeof(bad_zone), 1, fp);
+        fflush(fp);
+        zone_rejected = !gtok_open(gtok_path, false, &file);
+    }
+    if (fp) fclose(fp);
+    check(rejected, "corrupt relation row rejected");
+    check(checksum_caught, "damaged string caught by the checksum");
+    check(zone_rejected, "out-of-range zone rejected");
+    
+    unlink(text_path);
+    unlink(gtok_path);
+}
+
+#define REACH_TEST_NODES 48
+
+// Reachability by breadth-first search over an edge count matrix
+static void reach_baseline(const uint8_t edges[REACH_TEST_NODES][REACH_TEST_NODES], int from,
+                           bool reached[REACH_TEST_NODES]) {
+    int queue[REACH_TEST_NODES];
+    int head = 0, tail = 0;
+    memset(reached, 0, REACH_TEST_NODES * sizeof(bool));
+    reached[from] = true;
+    queue[tail++] = from;
+    while (head < tail) {
+        int u = queue[head++];
+        for (int v = 0; v < REACH_TEST_NODES; v++) {
+            if (edges[u][v] && !reached[v]) {
+                reached[v] = true;
+                queue[tail++] = v;
+            }
+        }
+    }
+}
+
+static bool reach_matches(const PhenoReachIndex* index,
+                          const uint8_t edges[REACH_TEST_NODES][REACH_TEST_NODES],
+                          const bool known[REACH_TEST_NODES]) {
+    for (int u = 0; u < REACH_TEST_NODES; u++) {
+        bool reached[REACH_TEST_NODES];
+        reach_baseline(edges, u, reached);
+        for (int v = 0; v < REACH_TEST_NODES; v++) {
+            bool expected = known[u] && known[v] && reached[v];
+            if (reach_query(index, 1000 + u, 1000 + v) != expected) return false;
+        }
+    }
+    return true;
+}
+
+// Random inserts and deletes (parallel edges and self loops included)
+// against a BFS baseline after every step, then a bulk load of the
+// surviving edges
+void test_reach_roundtrip(void) {
+    printf("\n=== Testing Reachability Index ===\n");
+    
+    PhenoReachIndex* index = reach_index_create();
+    if (!index) {
+        check(false, "create index");
+        return;
+    }
+    
+    static uint8_t edges[REACH_TEST_NODES][REACH_TEST_NODES];
+    bool known[REACH_TEST_NODES] = { false };
+    memset(edges, 0, sizeof(edges));
+    size_t edge_count = 0;
+    bool ok = true, removes_ok = true;
+    uint32_t seed = 54321;
+    
+    for (int step = 0; step < 1500 && ok; step++) {
+        seed = seed * 1103515245u + 12345u;
+        int u = (int)((seed >> 8) % REACH_TEST_NODES);
+        int v = (int)((seed >> 20) % REACH_TEST_NODES);
+        // Grow to about two edges per node, then churn
+        bool add = edge_count < 2 * REACH_TEST_NODES ? (seed & 3) != 0 : (seed & 1) != 0;
+        if (add) {
+            ok = reach_add_edge(index, 1000 + u, 1000 + v);
+            edges[u][v]++;
+            edge_count++;
+            known[u] = known[v] = true;
+        } else {
+            bool removed = reach_remove_edge(index, 1000 + u, 1000 + v);
+            removes_ok &= removed == (edges[u][v] > 0);
+            if (edges[u][v]) {
+                edges[u][v]--;
+                edge_count--;
+            }
+        }
+        if (ok) ok = reach_matches(index, edges, known) && reach_edge_count(index) == edge_count;
+    }
+    check(ok, "incremental closure matches BFS after every step");
+    check(removes_ok, "remove reports missing edges");
+    
+    // Bulk load of the surviving edges gives the same closure
+    PhenoEdge* list = (PhenoEdge*)malloc((edge_count ? edge_count : 1) * sizeof(PhenoEdge));
+    PhenoReachIndex* bulk = reach_index_create();
+    bool bulk_ok = list && bulk;
+    size_t n = 0;
+    for (int u = 0; bulk_ok && u < REACH_TEST_NODES; u++) {
+        for (int v = 0; v < REACH_TEST_NODES; v++) {
+            for (int k = 0; k < edges[u][v]; k++) {
+                memset(&list[n], 0, sizeof(list[n]));
+                list[n].src_id = 1000 + u;
+                list[n].dst_id = 1000 + v;
+                n++;
+            }
+        }
+    }
+    bool touched[REACH_TEST_NODES] = { false };
+    for (size_t e = 0; e < n; e++) {
+        touched[list[e].src_id - 1000] = touched[list[e].dst_id - 1000] = true;
+    }
+    bulk_ok = bulk_ok && reach_add_edges(bulk, list, n) && reach_matches(bulk, edges, touched);
+    check(bulk_ok, "bulk load matches BFS");
+    
+    free(list);
+    reach_index_destroy(bulk);
+    reach_index_destroy(index);
+    
+    // Past the node limit edges to new tokens are refused, old ones still work
+    PhenoReachIndex* capped = reach_index_create();
+    bool capped_ok = capped && reach_index_set_node_limit(capped, 100) == 100;
+    for (uint32_t id = 1; capped_ok && id < 100; id++) capped_ok = reach_add_edge(capped, id, id + 1);
+    capped_ok = capped_ok && !reach_add_edge(capped, 100, 101) && !reach_add_edge(capped, 101, 1) &&
+                reach_node_count(capped) == 100 && reach_edge_count(capped) == 99 &&
+                reach_add_edge(capped, 100, 1) && reach_query(capped, 50, 49) && !reach_query(capped, 1, 101);
+    capped_ok = capped_ok && reach_index_set_node_limit(capped, SIZE_MAX) == PHENO_REACH_MAX_NODES &&
+                reach_add_edge(capped, 100, 101) && reach_query(capped, 7, 101);
+    check(capped_ok, "node limit refuses new tokens and nothing else");
+    reach_index_destroy(capped);
+}
+
+#define SYMBOL_TEST_STRINGS 2000
+#define SYMBOL_TEST_THREADS 8
+
+typedef struct {
+    int thread;
+    PhenoSymbol ids[SYMBOL_TEST_STRINGS];
+} SymbolWorker;
+
+static void symbol_test_name(char* buf, size_t size, int i) {
+    snprintf(buf, size, "ROUNDTRIP_TYPE_%d", i);
+}
+
+// Each thread interns the same strings, starting at a different place
+static void* symbol_worker(void* arg) {
+    SymbolWorker* worker = (SymbolWorker*)arg;
+    for (int k = 0; k < SYMBOL_TEST_STRINGS; k++) {
+        int i = (k + worker->thread * (SYMBOL_TEST_STRINGS / SYMBOL_TEST_THREADS)) % SYMBOL_TEST_STRINGS;
+        char name[32];
+        symbol_test_name(name, sizeof(name), i);
+        worker->ids[i] = pheno_symbol_intern(name, strlen(name));
+    }
+    return NULL;
+}
+
+void test_symbol_roundtrip(void) {
+    printf("\n=== Testing Symbol Interning ===\n");
+    
+    size_t before = pheno_symbol_count();
+    PhenoSymbol node = pheno_symbol_intern("ROUNDTRIP_NODE", 14);
+    PhenoSymbol again = pheno_symbol_intern("ROUNDTRIP_NODE_X", 14);   // Same 14 bytes
+    PhenoSymbol prefix = pheno_symbol_intern("ROUNDTRIP_NOD", 13);
+    const char* name = pheno_symbol_name(node);
+    check(node != PHENO_SYMBOL_NONE && node == again && prefix != node,
+          "equal strings share a symbol, prefixes do not");
+    check(name && strcmp(name, "ROUNDTRIP_NODE") == 0 && pheno_symbol_find("ROUNDTRIP_NODE", 14) == node,
+          "name and find round trip");
+    check(pheno_symbol_find("ROUNDTRIP_MISSING", 17) == PHENO_SYMBOL_NONE &&
+          pheno_symbol_name(PHENO_SYMBOL_NONE) == NULL, "unknown strings are not interned by find");
+    
+    SymbolWorker* workers = (SymbolWorker*)calloc(SYMBOL_TEST_THREADS, sizeof(SymbolWorker));
+    pthread_t threads[SYMBOL_TEST_THREADS];
+    int started = 0;
+    for (int t = 0; workers && t < SYMBOL_TEST_THREADS; t++) {
+        workers[t].thread = t;
+        if (pthread_create(&threads[t], NULL, symbol_worker, &workers[t]) == 0) started++;
+    }
+    for (int t = 0; t < started; t++) {
+        pthread_join(threads[t], NULL);
+    }
+    
+    bool agree = workers && started == SYMBOL_TEST_THREADS;
+    for (int i = 0; agree && i < SYMBOL_TEST_STRINGS; i++) {
+        char expected[32];
+        symbol_test_name(expected, sizeof(expected), i);
+        const char* interned = pheno_symbol_name(workers[0].ids[i]);
+        agree = workers[0].ids[i] != PHENO_SYMBOL_NONE && interned && strcmp(interned, expected) == 0;
+        for (int t = 1; agree && t < SYMBOL_TEST_THREADS; t++) {
+            agree = workers[t].ids[i] == workers[0].ids[i];
+        }
+    }
+    check(agree, "concurrent interning agrees on every symbol");
+    check(pheno_symbol_count() == before + 2 + SYMBOL_TEST_STRINGS, "each string interned once");
+    check(name == pheno_symbol_name(node), "names stay at the same address");
+    free(workers);
+    
+    PhenoToken* token = pheno_token_alloc(64);
+    check(token && token->type_symbol == pheno_symbol_find("PHENO_NIL", 9) && pheno_token_validate(token),
+          "pool tokens carry the PHENO_NIL symbol");
+    if (token) pheno_token_free(token);
+}
+
+// A custom template may use any field in any block: fields a block does
+// not set come out as 0 or empty text, and the canvas size reaches every
+// document block
+static const char TEMPLATE_TEST_TEXT[] =
+    "{{#header}}\nH {{width}} {{height}}\n{{/header}}\n"
+    "{{#edges_open}}\nEO {{width}} {{height}} [{{type|xml}}] {{id}}\n{{/edges_open}}\n"
+    "{{#edge}}\nE {{type|json}} {{x}}\n{{/edge}}\n"
+    "{{#edges_close}}\nEC {{width}}x{{height}}\n{{/edges_close}}\n"
+    "{{#node}}\nN {{id|hex}} {{type}} {{x1}} {{width}}\n{{/node}}\n"
+    "{{#footer}}\nF {{width}} {{height}} [{{type}}] {{y2}}\n{{/footer}}\n";
+
+void test_template_render(void) {
+    printf("\n=== Testing Custom SVG Templates ===\n");
+    
+    char input[] = "/tmp/gosiuml-tpl-XXXXXX";
+    char output[] = "/tmp/gosiuml-tpl-out-XXXXXX";
+    int out_fd = mkstemp(output);
+    if (out_fd >= 0) close(out_fd);
+    if (out_fd < 0 || !temp_file(input, "TOKEN: 0x00000001 CLUSTER_CONSENSUS_LEADER 1\n"
+                                        "TOKEN: 0x00000002 NODE 2\n"
+                                        "RELATION: 0x00000001->0x00000002:OWNS\n")) {
+        check(false, "create template inputs");
+        if (out_fd >= 0) unlink(output);
+        return;
+    }
+    
+    PhenoTemplate* tpl = pheno_template_compile(TEMPLATE_TEST_TEXT, sizeof(TEMPLATE_TEST_TEXT) - 1,
+                                                &svg_template_schema, "test template");
+    SvgTemplate st;
+    bool bound = tpl && svg_template_bind(&st, tpl);
+    check(bound, "compile and bind");
+    
+    int count = 0;
+    PhenoToken* tokens = bound ? gosiuml_parse_file(input, &count) : NULL;
+    char* svg = tokens && generate_svg_with_template(tokens, count, output, NULL, &st) == 0
+                ? read_file(output, NULL) : NULL;
+    unsigned width = 0, height = 0;
+    char expected[512];
+    if (svg && sscanf(svg, "H %u %u", &width, &height) == 2) {
+        snprintf(expected, sizeof(expected),
+                 "H %u %u\nEO %u %u [] 0\nE \"\" 0\nEC %ux%u\n"
+                 "N 00000001 CLUSTER_CONSENSUS_LEADER 0 0\nN 00000002 NODE 0 0\nF %u %u [] 0\n",
+                 width, height, width, height, width, height, width, height);
+    }
+    check(svg && width && height && strcmp(svg, expected) == 0, "every block renders every field");
+    
+    free(svg);
+    gosiuml_free_tokens(tokens, count);
+    pheno_template_free(tpl);
+    unlink(input);
+    unlink(output);
+}
+
+#define RELOAD_TEST_TOKENS 40
+
+// Variants of the reload test file
+enum {
+    RELOAD_EDIT = 1,            // Token 5 gets another type and zone
+    RELOAD_DUPLICATE = 2,       // Token 7 defined a second time, last
+    RELOAD_DROP_FIRST_7 = 4,    // ... and its first definition removed
+    RELOAD_RELATIONS = 8,       // One relation removed, three added (one a parallel copy)
+    RELOAD_DROP_40 = 16,        // Token 40 removed (its relations stay)
+    RELOAD_NEW_41 = 32          // Token 41 added and related to 40 and 1
+};
+
+static bool reload_file(const char* path, unsigned variant) {
+    FILE* fp = fopen(path, "w");
+    if (!fp) return false;
+    for (uint32_t id = 1; id <= RELOAD_TEST_TOKENS; id++) {
+        if ((id == 7 && (variant & RELOAD_DROP_FIRST_7)) || (id == 40 && (variant & RELOAD_DROP_40))) continue;
+        if (id == 5 && (variant & RELOAD_EDIT)) fprintf(fp, "TOKEN: 0x00000005 CLUSTER_CONSENSUS_LEADER 3\n");
+        else fprintf(fp, "TOKEN: 0x%08X %s %u\n", id, id % 3 ? "NODE_IDENTITY" : "CLUSTER_TOPOLOGY", id % 4);
+    }
+    if (variant & RELOAD_DUPLICATE) fprintf(fp, "TOKEN: 0x00000007 DUPLICATE 2\n");
+    if (variant & RELOAD_NEW_41) {
+        fprintf(fp, "TOKEN: 0x00000029 NODE_IDENTITY 1\n");
+        fprintf(fp, "RELATION: 0x00000028->0x00000029:NEXT\n");
+        fprintf(fp, "RELATION: 0x00000029->0x00000001:NEXT\n");
+    }
+    for (uint32_t id = 1; id < RELOAD_TEST_TOKENS; id++) {
+        if (id != 24 || !(variant & RELOAD_RELATIONS)) {
+            fprintf(fp, "RELATION: 0x%08X->0x%08X:NEXT\n", id, id + 1);
+        }
+        if (id % 5 == 0) fprintf(fp, "RELATION: 0x%08X->0x%08X:JUMP\n", id, (id * 7) % RELOAD_TEST_TOKENS + 1);
+    }
+    if (variant & RELOAD_RELATIONS) {
+        fprintf(fp, "RELATION: 0x00000019->0x00000003:BACK\n");
+        fprintf(fp, "RELATION: 0x00000001->0x00000002:NEXT\n");
+        fprintf(fp, "RELATION: 0x0000001E->0x0000000A:JUMP\n");
+    }
+    return fclose(fp) == 0;
+}
+
+// Same tokens and closure as a reloader that loads the file from scratch
+static bool reload_matches_fresh(const TokenReloader* r, const char* path) {
+    TokenReloader* fresh = token_reloader_create(path);
+    const PhenoReachIndex* a = token_reloader_graph(r);
+    const PhenoReachIndex* b = fresh ? token_reloader_graph(fresh) : NULL;
+    bool same = fresh && token_reloader_reload(fresh, NULL) &&
+                token_reloader_token_count(fresh) == token_reloader_token_count(r) &&
+                reach_edge_count(a) == reach_edge_count(b);
+    for (uint32_t x = 1; same && x <= RELOAD_TEST_TOKENS + 1; x++) {
+        const PhenoToken* t = token_reloader_find(r, x);
+        const PhenoToken* u = token_reloader_find(fresh, x);
+        same = (!t && !u) || (t && u && t->type_symbol == u->type_symbol && t->memory_zone == u->memory_zone &&
+                              memcmp(t->sentinel, u->sentinel, sizeof(t->sentinel)) == 0);
+        for (uint32_t y = 1; same && y <= RELOAD_TEST_TOKENS + 1; y++) {
+            same = x == y || reach_query(a, x, y) == reach_query(b, x, y);
+        }
+    }
+    token_reloader_destroy(fresh);
+    return same;
+}
+
+typedef struct {
+    size_t tokens[3];           // By TokenReloadChange
+    size_t linked;
+    size_t unlinked;
+} ReloadEvents;
+
+static void reload_on_token(uint32_t token_id, TokenReloadChange change, void* user) {
+    (void)token_id;
+    ((ReloadEvents*)user)->tokens[change]++;
+}
+
+static void reload_on_relation(uint32_t src_id, uint32_t dst_id, bool added, void* user) {
+    (void)src_id;
+    (void)dst_id;
+    if (added) ((ReloadEvents*)user)->linked++;
+    else ((ReloadEvents*)user)->unlinked++;
+}
+
+// Reload and check that the handler saw what the stats count
+static bool reload_step(TokenReloader* r, const char* path, unsigned variant, TokenReloadStats* stats) {
+    ReloadEvents events = {{0}};
+    TokenReloadHandler handler = { reload_on_token, reload_on_relation, &events };
+    token_reloader_set_handler(r, &handler);
+    bool ok = reload_file(path, variant) && token_reloader_reload(r, stats);
+    token_reloader_set_handler(r, NULL);
+    return ok && events.tokens[TOKEN_RELOAD_ADDED] == stats->tokens_added &&
+           events.tokens[TOKEN_RELOAD_CHANGED] == stats->tokens_changed &&
+           events.tokens[TOKEN_RELOAD_REMOVED] == stats->tokens_removed &&
+           events.linked == stats->relations_added && events.unlinked == stats->relations_removed;
+}
+
+void test_reload_roundtrip(void) {
+    printf("\n=== Testing Incremental Reload ===\n");
+    
+    char path[] = "/tmp/gosiuml-reload-XXXXXX";
+    TokenReloader* r = temp_file(path, "") ? token_reloader_create(path) : NULL;
+    TokenReloadStats stats;
+    bool loaded = r && reload_step(r, path, 0, &stats) && stats.tokens_added == RELOAD_TEST_TOKENS &&
+                  token_reloader_token_count(r) == RELOAD_TEST_TOKENS;
+    check(loaded, "first reload loads every token");
+    if (!loaded) {
+        token_reloader_destroy(r);
+        unlink(path);
+        return;
+    }
+    PhenoReachIndex* graph = token_reloader_graph(r);
+    
+    // Edited in place: same slot, flags kept, new definition
+    PhenoToken* t5 = token_reloader_find(r, 5);
+    set_flag(&t5->mem_flags, FLAG_LOCKED_BIT);
+    unsigned variant = RELOAD_EDIT;
+    bool ok = reload_step(r, path, variant, &stats) && stats.tokens_changed == 1 &&
+              stats.tokens_added == 0 && stats.tokens_removed == 0 &&
+              token_reloader_find(r, 5) == t5 && test_flag(&t5->mem_flags, FLAG_LOCKED_BIT) &&
+              t5->memory_zone == 3 && t5->type_symbol == pheno_symbol_find("CLUSTER_CONSENSUS_LEADER", 24);
+    check(ok && reload_matches_fresh(r, path), "edited token keeps its slot and flags");
+    
+    // Duplicate ids: the first definition wins until it is removed
+    PhenoToken* t7 = token_reloader_find(r, 7);
+    uint32_t type7 = t7->type_symbol;
+    variant |= RELOAD_DUPLICATE;
+    ok = reload_step(r, path, variant, &stats) && stats.tokens_added == 0 && stats.tokens_changed == 0 &&
+         token_reloader_token_count(r) == RELOAD_TEST_TOKENS && t7->type_symbol == type7;
+    check(ok && reload_matches_fresh(r, path), "second definition of an id is ignored");
+    variant |= RELOAD_DROP_FIRST_7;
+    ok = reload_step(r, path, variant, &stats) && stats.tokens_changed == 1 && stats.tokens_removed == 0 &&
+         token_reloader_find(r, 7) == t7 && t7->type_symbol == pheno_symbol_find("DUPLICATE", 9);
+    check(ok && reload_matches_fresh(r, path), "removing the first definition promotes the next");
+    
+    // Relations in and out, including a parallel copy and a new cycle
+    size_t edges = reach_edge_count(graph);
+    ok = reload_step(r, path, variant | RELOAD_RELATIONS, &stats) && stats.relations_added == 3 &&
+         stats.relations_removed == 1 && reach_edge_count(graph) == edges + 2 && !reach_query(graph, 24, 25);
+    check(ok && reload_matches_fresh(r, path), "added and removed relations match a fresh load");
+    ok = reload_step(r, path, variant, &stats) && stats.relations_added == 1 && stats.relations_removed == 3 &&
+         reach_edge_count(graph) == edges && reach_query(graph, 24, 25);
+    check(ok && reload_matches_fresh(r, path), "reverting them restores the closure");
+    
+    variant |= RELOAD_DROP_40;
+    ok = reload_step(r, path, variant, &stats) && stats.tokens_removed == 1 &&
+         token_reloader_token_count(r) == RELOAD_TEST_TOKENS - 1 && !token_reloader_find(r, 40);
+    check(ok && reload_matches_fresh(r, path), "removed token leaves the set");
+    
+    // A reload that fails leaves everything as it was
+    unlink(path);
+    ok = !token_reloader_reload(r, &stats) && token_reloader_token_count(r) == RELOAD_TEST_TOKENS - 1 &&
+         token_reloader_find(r, 5) == t5 && reach_edge_count(graph) == edges;
+    ok = ok && reload_file(path, variant) && token_reloader_reload(r, &stats) &&
+         stats.tokens_added == 0 && stats.tokens_removed == 0 && stats.relations_added == 0;
+    check(ok, "failed reload keeps the previous state");
+    
+    // Failing halfway through the diff: the node limit refuses token 41's
+    // relations after the slot and the other relations were added
+    ReloadEvents events = {{0}};
+    TokenReloadHandler handler = { reload_on_token, reload_on_relation, &events };
+    size_t nodes = reach_node_count(graph);
+    reach_index_set_node_limit(graph, nodes);
+    token_reloader_set_handler(r, &handler);
+    ok = reload_file(path, variant | RELOAD_RELATIONS | RELOAD_NEW_41) && !token_reloader_reload(r, &stats);
+    token_reloader_set_handler(r, NULL);
+    ok = ok && !token_reloader_find(r, 0x29) && token_reloader_find(r, 5) == t5 &&
+         token_reloader_token_count(r) == RELOAD_TEST_TOKENS - 1 && reach_edge_count(graph) == edges &&
+         reach_node_count(graph) == nodes && memcmp(&events, &(ReloadEvents){{0}}, sizeof(events)) == 0;
+    ok = ok && reload_file(path, variant) && reload_matches_fresh(r, path);
+    reach_index_set_node_limit(graph, PHENO_REACH_MAX_NODES);
+    ok = ok && reload_step(r, path, variant | RELOAD_RELATIONS | RELOAD_NEW_41, &stats) &&
+         stats.tokens_added == 1 && stats.relations_added == 5 && reload_matches_fresh(r, path);
+    check(ok, "reload failing midway rolls back what it applied");
+    
+    token_reloader_destroy(r);
+    unlink(path);
+}
+
+// Bitmap ids live under three container keys; slot k of the baseline
+// holds key g_bitmap_keys[k]
+static const uint32_t g_bitmap_keys[] = { 0, 1, 5 };
+#define BITMAP_TEST_IDS (3 * 65536)
+
+static uint32_t bitmap_test_id(size_t slot) {
+    return (g_bitmap_keys[slot >> 16] << 16) | (uint32_t)(slot & 0xFFFF);
+}
+
+// Same members as the byte-per-id baseline, in ascending order
+static bool bitmap_matches(const PhenoBitmap* bm, const uint8_t* expected) {
+    size_t count = 0;
+    for (size_t s = 0; s < BITMAP_TEST_IDS; s++) count += expected[s];
+    if (pheno_bitmap_cardinality(bm) != count) return false;
+    
+    uint32_t* ids = (uint32_t*)malloc((count ? count : 1) * sizeof(uint32_t));
+    bool same = ids && pheno_bitmap_to_array(bm, ids) == count;
+    size_t next = 0;
+    for (size_t s = 0; same && s < BITMAP_TEST_IDS; s++) {
+        if (!expected[s]) continue;
+        same = ids[next++] == bitmap_test_id(s) && pheno_bitmap_contains(bm, bitmap_test_id(s));
+    }
+    free(ids);
+    return same;
+}
+
+// Random adds and removes against a byte-per-id baseline. Key 1 is
+// filled densely so its container turns into a bitset and back; key 5
+// is emptied, which must drop its container. Then the set algebra.
+void test_bitmap_roundtrip(void) {
+    printf("\n=== Testing Compressed Bitmap ===\n");
+    
+    uint8_t* expected = (uint8_t*)calloc(2 * BITMAP_TEST_IDS, 1);
+    uint8_t* other = expected ? expected + BITMAP_TEST_IDS : NULL;
+    PhenoBitmap a, b, out;
+    pheno_bitmap_init(&a);
+    pheno_bitmap_init(&b);
+    pheno_bitmap_init(&out);
+    if (!expected) {
+        check(false, "allocate baseline");
+        return;
+    }
+    
+    bool ok = true, returns_ok = true;
+    uint32_t seed = 0xB17B17u;
+    for (int step = 0; step < 60000 && ok; step++) {
+        seed = seed * 1103515245u + 12345u;
+        uint32_t r = seed >> 4;
+        // Slot 1 takes most of the traffic, over a narrow range
+        size_t slot = (r & 3) ? (1u << 16) | ((r >> 2) % 8192) : ((r >> 2) % 3) << 16 | ((r >> 4) & 0xFFFF);
+        bool add = step < 30000 ? (r >> 24) != 0 : (r >> 24) < 3;
+        if (add) {
+            ok = pheno_bitmap_add(&a, bitmap_test_id(slot));
+            expected[slot] = 1;
+        } else {
+            returns_ok &= pheno_bitmap_remove(&a, bitmap_test_id(slot)) == (expected[slot] != 0);
+            expected[slot] = 0;
+        }
+        if (ok && step % 5000 == 4999) ok = bitmap_matches(&a, expected);
+    }
+    check(ok && bitmap_matches(&a, expected), "adds and removes match the baseline");
+    
+    for (size_t s = 0; s < BITMAP_TEST_IDS; s++) {
+        if (g_bitmap_keys[s >> 16] == 5 && expected[s]) {
+            returns_ok &= pheno_bitmap_remove(&a, bitmap_test_id(s));
+            expected[s] = 0;
+        }
+    }
+    returns_ok &= !pheno_bitmap_remove(&a, 5u << 16) && !pheno_bitmap_remove(&a, 9u << 16);
+    check(returns_ok && bitmap_matches(&a, expected), "remove reports whether the id was present");
+    
+    // Set algebra against the baseline
+    for (size_t s = 0; ok && s < BITMAP_TEST_IDS; s++) {
+        seed = seed * 1103515245u + 12345u;
+        other[s] = (s >> 16) == 1 ? (seed >> 16) % 3 == 0 : (seed >> 16) % 97 == 0;
+        if (other[s]) ok = pheno_bitmap_add(&b, bitmap_test_id(s));
+    }
+    uint8_t* want = ok ? (uint8_t*)malloc(BITMAP_TEST_IDS) : NULL;
+    static const char* const ops[] = { "and", "or", "andnot" };
+    for (int op = 0; op < 3; op++) {
+        bool op_ok = want != NULL;
+        if (op_ok && op == 0) op_ok = pheno_bitmap_and(&a, &b, &out);
+        if (op_ok && op == 1) op_ok = pheno_bitmap_or(&a, &b, &out);
+        if (op_ok && op == 2) op_ok = pheno_bitmap_andnot(&a, &b, &out);
+        for (size_t s = 0; op_ok && s < BITMAP_TEST_IDS; s++) {
+            want[s] = op == 0 ? expected[s] & other[s] : op == 1 ? expected[s] | other[s]
+                                                                 : expected[s] & !other[s];
+        }
+        char what[64];
+        snprintf(what, sizeof(what), "%s matches the baseline", ops[op]);
+        check(op_ok && bitmap_matches(&out, want), what);
+    }
+    
+    free(want);
+    free(expected);
+    pheno_bitmap_free(&a);
+    pheno_bitmap_free(&b);
+    pheno_bitmap_free(&out);
+}
+
+// Person model as first written: bit loop and branches
+static void person_baseline(PhenoRelation* rel, uint8_t person_a, uint8_t person_b) {
+    rel->person_id = person_a;
+    rel->person_role = person_b;
+    rel->person_auth = 0;
+    for (uint8_t x = person_a ^ person_b; x; x >>= 1) rel->person_auth += x & 1;
+    rel->person_state = 0;
+    if (person_a & 0x01) rel->person_state |= 1 << 0;
+    if (person_b & 0x02) rel->person_state |= 1 << 1;
+    if ((person_a ^ person_b) & 0x04) rel->person_state |= 1 << 2;
+}
+
+// Single, batch (vector where the CPU has it) and all-pairs scoring over
+// every byte pair, against the baseline. Batch lengths are odd so the
+// scalar tails run too, and fields outside the person quad must survive.
+void test_person_model(void) {
+    printf("\n=== Testing Person Model ===\n");
+    
+    PhenoRelation* got = (PhenoRelation*)malloc(65536 * sizeof(PhenoRelation));
+    PhenoRelation* want = (PhenoRelation*)malloc(65536 * sizeof(PhenoRelation));
+    uint8_t* a = (uint8_t*)malloc(2 * 65536);
+    uint8_t* b = a ? a + 65536 : NULL;
+    if (!got || !want || !a) {
+        check(false, "allocate pairs");
+        free(got);
+        free(want);
+        free(a);
+        return;
+    }
+    for (size_t i = 0; i < 65536; i++) {
+        a[i] = (uint8_t)(i >> 8);
+        b[i] = (uint8_t)i;
+        memset(&want[i], (int)(i % 251), sizeof(PhenoRelation));
+        person_baseline(&want[i], a[i], b[i]);
+    }
+    
+    bool ok = true;
+    for (size_t i = 0; i < 65536; i++) {
+        memset(&got[i], (int)(i % 251), sizeof(PhenoRelation));
+        apply_person_model(&got[i], a[i], b[i]);
+    }
+    ok = memcmp(got, want, 65536 * sizeof(PhenoRelation)) == 0;
+    check(ok, "apply_person_model matches the bit loop");
+    
+    for (size_t i = 0; i < 65536; i++) memset(&got[i], (int)(i % 251), sizeof(PhenoRelation));
+    for (size_t start = 0, len = 1; start < 65536; start += len, len = len * 3 + 1) {
+        if (len > 65536 - start) len = 65536 - start;
+        apply_person_model_batch(&got[start], &a[start], &b[start], len);
+    }
+    ok = memcmp(got, want, 65536 * sizeof(PhenoRelation)) == 0;
+    check(ok, "batch matches the bit loop");
+    
+    // 256 x 37 block: row i pairs every a with b[j] = 3j + 1
+    uint8_t column[37];
+    for (size_t j = 0; j < 37; j++) column[j] = (uint8_t)(3 * j + 1);
+    for (size_t k = 0; k < 256 * 37; k++) memset(&got[k], 0x5A, sizeof(PhenoRelation));
+    uint8_t rows[256];
+    for (size_t i = 0; i < 256; i++) rows[i] = (uint8_t)i;
+    apply_person_model_pairs(got, rows, 256, column, 37);
+    ok = true;
+    for (size_t i = 0; ok && i < 256; i++) {
+        for (size_t j = 0; ok && j < 37; j++) {
+            PhenoRelation expected;
+            memset(&expected, 0x5A, sizeof(expected));
+            person_baseline(&expected, rows[i], column[j]);
+            ok = memcmp(&got[i * 37 + j], &expected, sizeof(expected)) == 0;
+        }
+    }
+    check(ok, "all-pairs block matches the bit loop");
+    
+    free(got);
+    free(want);
+    free(a);
+}
+
+#define TABLE_TEST_ROWS 5013
+
+static bool relation_pred_baseline(const PhenoRelation* rel, const PhenoRelationPredicate* preds,
+                                   size_t pred_count) {
+    for (size_t p = 0; p < pred_count; p++) {
+        uint8_t v = ((const uint8_t*)rel)[preds[p].field];
+        bool hit = preds[p].op == REL_PRED_EQ ? v == preds[p].value
+                 : preds[p].op == REL_PRED_NE ? v != preds[p].value
+                 : preds[p].op == REL_PRED_ANY_BITS ? (v & preds[p].value) != 0
+                 : (v & preds[p].value) == 0;
+        if (!hit) return false;
+    }
+    return true;
+}
+
+// Column store against the row array it was built from: append and batch
+// transpose, export, get/set, then random conjunctive scans and filters
+// against a row-at-a-time loop
+void test_relation_table(void) {
+    printf("\n=== Testing Columnar Relation Table ===\n");
+    
+    PhenoRelation* rows = (PhenoRelation*)malloc(TABLE_TEST_ROWS * sizeof(PhenoRelation));
+    PhenoRelation* back = (PhenoRelation*)malloc(TABLE_TEST_ROWS * sizeof(PhenoRelation));
+    uint32_t* sel = (uint32_t*)malloc(3 * TABLE_TEST_ROWS * sizeof(uint32_t));
+    PhenoRelationTable* table = relation_table_create(16);
+    if (!rows || !back || !sel || !table) {
+        check(false, "allocate table");
+        free(rows);
+        free(back);
+        free(sel);
+        relation_table_destroy(table);
+        return;
+    }
+    uint32_t* want = sel + TABLE_TEST_ROWS;
+    uint32_t* refined = want + TABLE_TEST_ROWS;
+    
+    // Few distinct values per field so predicates select something
+    uint32_t seed = 0x5EED52u;
+    for (size_t i = 0; i < TABLE_TEST_ROWS; i++) {
+        uint8_t* bytes = (uint8_t*)&rows[i];
+        for (int f = 0; f < REL_FIELD_COUNT; f++) {
+            seed = seed * 1103515245u + 12345u;
+            bytes[f] = (uint8_t)((seed >> 16) % (f + 3));
+        }
+    }
+    
+    // Single appends, then the rest through the batch transpose
+    bool ok = true;
+    for (size_t i = 0; ok && i < 37; i++) ok = relation_table_append(table, &rows[i]);
+    ok = ok && relation_table_append_batch(table, &rows[37], TABLE_TEST_ROWS - 37) &&
+         table->count == TABLE_TEST_ROWS;
+    if (ok) relation_table_export(table, 0, TABLE_TEST_ROWS, back);
+    ok = ok && memcmp(back, rows, TABLE_TEST_ROWS * sizeof(PhenoRelation)) == 0;
+    for (size_t i = 0; ok && i < TABLE_TEST_ROWS; i += 97) {
+        PhenoRelation one;
+        relation_table_get(table, i, &one);
+        ok = memcmp(&one, &rows[i], sizeof(one)) == 0;
+        rows[i].class_level ^= 0x80;
+        relation_table_set(table, i, &rows[i]);
+    }
+    if (ok) relation_table_export(table, 0, TABLE_TEST_ROWS, back);
+    ok = ok && memcmp(back, rows, TABLE_TEST_ROWS * sizeof(PhenoRelation)) == 0;
+    check(ok, "columns round-trip the rows");
+    
+    bool scans_ok = ok, filters_ok = ok;
+    for (int round = 0; ok && round < 200; round++) {
+        PhenoRelationPredicate preds[3];
+        size_t pred_count = 1 + round % 3;
+        for (size_t p = 0; p < pred_count; p++) {
+            seed = seed * 1103515245u + 12345u;
+            preds[p].field = (PhenoRelationField)((seed >> 8) % REL_FIELD_COUNT);
+            preds[p].op = (PhenoRelationPredOp)((seed >> 16) % 4);
+            preds[p].value = (uint8_t)((seed >> 20) % (preds[p].field + 3));
+        }
+        size_t expected = 0;
+        for (size_t i = 0; i < TABLE_TEST_ROWS; i++) {
+            if (relation_pred_baseline(&rows[i], preds, pred_count)) want[expected++] = (uint32_t)i;
+        }
+        size_t n = relation_table_scan(table, preds, pred_count, sel);
+        scans_ok &= n == expected && memcmp(sel, want, n * sizeof(uint32_t)) == 0;
+        if (preds[0].op == REL_PRED_EQ) {
+            n = relation_table_scan_eq(table, preds[0].field, preds[0].value, sel);
+            size_t eq = 0;
+            for (size_t i = 0; i < TABLE_TEST_ROWS; i++) {
+                if (relation_pred_baseline(&rows[i], preds, 1)) want[eq++] = (uint32_t)i;
+            }
+            scans_ok &= n == eq && memcmp(sel, want, n * sizeof(uint32_t)) == 0;
+        }
+        
+        // Refine the first predicate's selection by the others
+        n = relation_table_scan(table, preds, 1, sel);
+        size_t kept = relation_table_filter(table, preds + 1, pred_count - 1, sel, n, refined);
+        expected = 0;
+        for (size_t k = 0; k < n; k++) {
+            if (relation_pred_baseline(&rows[sel[k]], preds + 1, pred_count - 1)) want[expected++] = sel[k];
+        }
+        filters_ok &= kept == expected && memcmp(refined, want, kept * sizeof(uint32_t)) == 0;
+    }
+    check(scans_ok, "scans match a row-at-a-time loop");
+    check(filters_ok, "filters match a row-at-a-time loop");
+    
+    free(rows);
+    free(back);
+    free(sel);
+    relation_table_destroy(table);
+}
+
+#define HAMMING_TEST_ROWS 6000
+
+static uint32_t hamming_baseline(const PhenoRelation* a, const PhenoRelation* b) {
+    const uint8_t* x = (const uint8_t*)a;
+    const uint8_t* y = (const uint8_t*)b;
+    uint32_t distance = 0;
+    for (size_t i = 0; i < sizeof(PhenoRelation); i++) {
+        for (uint8_t d = x[i] ^ y[i]; d; d >>= 1) distance += d & 1;
+    }
+    return distance;
+}
+
+static int hamming_match_order(const void* a, const void* b) {
+    const PhenoHammingMatch* x = (const PhenoHammingMatch*)a;
+    const PhenoHammingMatch* y = (const PhenoHammingMatch*)b;
+    if (x->distance != y->distance) return x->distance < y->distance ? -1 : 1;
+    return x->index < y->index ? -1 : x->index > y->index;
+}
+
+// Index and scan searches against distances from a bit loop, sorted by
+// (distance, index). Enough rows that the index probes instead of
+// scanning; they are clustered copies with a few bits flipped, including
+// exact duplicates, so small radii and ties both occur.
+void test_hamming_search(void) {
+    printf("\n=== Testing Hamming Search ===\n");
+    
+    PhenoRelation* rows = (PhenoRelation*)malloc(HAMMING_TEST_ROWS * sizeof(PhenoRelation));
+    PhenoHammingMatch* all = (PhenoHammingMatch*)malloc(3 * HAMMING_TEST_ROWS * sizeof(PhenoHammingMatch));
+    PhenoHammingIndex* index = NULL;
+    uint32_t seed = 0x4A3E55u;
+    if (rows) {
+        for (size_t i = 0; i < HAMMING_TEST_ROWS; i++) {
+            uint8_t* bytes = (uint8_t*)&rows[i];
+            if (i % 50 == 0) {
+                for (size_t b = 0; b < sizeof(PhenoRelation); b++) {
+                    seed = seed * 1103515245u + 12345u;
+                    bytes[b] = (uint8_t)(seed >> 16);
+                }
+                continue;
+            }
+            rows[i] = rows[i - i % 50];
+            seed = seed * 1103515245u + 12345u;
+            for (uint32_t flips = (seed >> 16) % 12; flips; flips--) {
+                seed = seed * 1103515245u + 12345u;
+                bytes[(seed >> 16) % sizeof(PhenoRelation)] ^= (uint8_t)(1u << ((seed >> 8) & 7));
+            }
+        }
+        index = relation_hamming_index_create(rows, HAMMING_TEST_ROWS);
+    }
+    if (!index || !all) {
+        check(false, "build index");
+        free(rows);
+        free(all);
+        relation_hamming_index_destroy(index);
+        return;
+    }
+    PhenoHammingMatch* got = all + HAMMING_TEST_ROWS;
+    PhenoHammingMatch* scanned = got + HAMMING_TEST_ROWS;
+    
+    bool distance_ok = true, knn_ok = true, radius_ok = true;
+    static const size_t ks[] = { 1, 7, 100, HAMMING_TEST_ROWS + 5 };
+    static const uint32_t radii[] = { 0, 3, 8, 17, 40, 128 };
+    for (int q = 0; q < 40; q++) {
+        // Perturbed rows, and every fourth query a fresh random code
+        PhenoRelation query = rows[(q * 211) % HAMMING_TEST_ROWS];
+        uint8_t* bytes = (uint8_t*)&query;
+        for (size_t b = 0; b < sizeof(query); b++) {
+            seed = seed * 1103515245u + 12345u;
+            if (q % 4 == 3) bytes[b] = (uint8_t)(seed >> 16);
+            else if ((seed >> 16) % 8 == 0) bytes[b] ^= (uint8_t)(1u << ((seed >> 8) & 7));
+        }
+        for (size_t i = 0; i < HAMMING_TEST_ROWS; i++) {
+            all[i].index = (uint32_t)i;
+            all[i].distance = hamming_baseline(&rows[i], &query);
+            distance_ok &= relation_hamming_distance(&rows[i], &query) == all[i].distance;
+        }
+        qsort(all, HAMMING_TEST_ROWS, sizeof(all[0]), hamming_match_order);
+        
+        for (size_t t = 0; t < sizeof(ks) / sizeof(ks[0]); t++) {
+            size_t want = ks[t] < HAMMING_TEST_ROWS ? ks[t] : HAMMING_TEST_ROWS;
+            size_t n = relation_knn(index, &query, ks[t], got);
+            size_t m = relation_knn_scan(rows, HAMMING_TEST_ROWS, &query, ks[t], scanned);
+            knn_ok &= n == want && m == want && memcmp(got, all, n * sizeof(all[0])) == 0 &&
+                      memcmp(scanned, all, m * sizeof(all[0])) == 0;
+        }
+        for (size_t t = 0; t < sizeof(radii) / sizeof(radii[0]); t++) {
+            size_t want = 0;
+            while (want < HAMMING_TEST_ROWS && all[want].distance <= radii[t]) want++;
+            size_t n = relation_radius(index, &query, radii[t], got, HAMMING_TEST_ROWS);
+            size_t m = relation_radius_scan(rows, HAMMING_TEST_ROWS, &query, radii[t], scanned, HAMMING_TEST_ROWS);
+            radius_ok &= n == want && m == want && memcmp(got, all, n * sizeof(all[0])) == 0 &&
+                         memcmp(scanned, all, m * sizeof(all[0])) == 0;
+            // A short output keeps the nearest and still counts them all
+            if (want > 5) {
+                radius_ok &= relation_radius(index, &query, radii[t], got, 5) == want &&
+                             memcmp(got, all, 5 * sizeof(all[0])) == 0;
+            }
+        }
+    }
+    check(distance_ok, "distance matches the bit loop");
+    check(knn_ok, "knn (index and scan) matches brute force");
+    check(radius_ok, "radius (index and scan) matches brute force");
+    
+    free(rows);
+    free(all);
+    relation_hamming_index_destroy(index);
+}
+
+#define JOIN_TEST_TOKENS 20000
+#define JOIN_TEST_RELATIONS 50000
+
+// Index of the first token with id, by linear search; UINT32_MAX if none
+static uint32_t join_baseline_find(const PhenoToken* tokens, size_t count, uint32_t id) {
+    for (size_t i = 0; i < count; i++) {
+        if (tokens[i].token_id == id) return (uint32_t)i;
+    }
+    return UINT32_MAX;
+}
+
+// Nested loop: endpoint token indices of every relation
+static void join_baseline(const PhenoToken* tokens, size_t token_count,
+                          const PhenoEdge* relations, size_t relation_count, uint32_t* ends) {
+    for (size_t r = 0; r < relation_count; r++) {
+        ends[2 * r] = join_baseline_find(tokens, token_count, relations[r].src_id);
+        ends[2 * r + 1] = join_baseline_find(tokens, token_count, relations[r].dst_id);
+    }
+}
+
+// Join against the endpoints found by join_baseline
+static bool join_matches(const PhenoToken* tokens, size_t token_count,
+                         const PhenoEdge* relations, size_t relation_count, int threads,
+                         const uint32_t* ends) {
+    PhenoEdgeTable table = {0};
+    if (!pheno_join_edges(tokens, token_count, relations, relation_count, threads, &table)) return false;
+    
+    size_t n = 0;
+    bool same = true;
+    for (size_t r = 0; same && r < relation_count; r++) {
+        uint32_t src = ends[2 * r], dst = ends[2 * r + 1];
+        if (src == UINT32_MAX || dst == UINT32_MAX) continue;
+        const PhenoAnnotatedEdge* e = &table.edges[n++];
+        same = n <= table.count && e->relation_index == r && e->src_index == src && e->dst_index == dst &&
+               e->src_zone == tokens[src].memory_zone && e->dst_zone == tokens[dst].memory_zone &&
+               e->src_state == (uint8_t)pheno_token_state(&tokens[src]) &&
+               e->dst_state == (uint8_t)pheno_token_state(&tokens[dst]);
+    }
+    same = same && n == table.count;
+    pheno_edge_table_free(&table);
+    return same;
+}
+
+// Partitioned join against a nested loop: enough rows for the parallel,
+// multi-partition path, then one thread, then a join small enough to run
+// serially. Ids repeat (first occurrence wins) and a tenth of the
+// relations name a missing token.
+void test_join_edges(void) {
+    printf("\n=== Testing Relation Join ===\n");
+    
+    PhenoToken* tokens = (PhenoToken*)calloc(JOIN_TEST_TOKENS, sizeof(PhenoToken));
+    PhenoEdge* relations = (PhenoEdge*)calloc(JOIN_TEST_RELATIONS, sizeof(PhenoEdge));
+    uint32_t* ends = (uint32_t*)malloc(2 * JOIN_TEST_RELATIONS * sizeof(uint32_t));
+    if (!tokens || !relations || !ends) {
+        check(false, "allocate join inputs");
+        free(tokens);
+        free(relations);
+        free(ends);
+        return;
+    }
+    uint32_t seed = 0x701Eu;
+    for (size_t i = 0; i < JOIN_TEST_TOKENS; i++) {
+        seed = seed * 1103515245u + 12345u;
+        tokens[i].token_id = (i % 17 == 16) ? tokens[(seed >> 8) % i].token_id : (uint32_t)(i * 3 + 1);
+        tokens[i].memory_zone = (uint8_t)((seed >> 12) % MAX_MEMORY_ZONES);
+        atomic_store(&tokens[i].mem_flags.flags, (seed >> 16) & 0xFF);
+    }
+    for (size_t r = 0; r < JOIN_TEST_RELATIONS; r++) {
+        seed = seed * 1103515245u + 12345u;
+        uint32_t a = tokens[(seed >> 8) % JOIN_TEST_TOKENS].token_id;
+        seed = seed * 1103515245u + 12345u;
+        uint32_t b = tokens[(seed >> 8) % JOIN_TEST_TOKENS].token_id;
+        relations[r].src_id = (seed & 0x1F) == 0 ? a + 1 : a;     // ids 3k+2 are never tokens
+        relations[r].dst_id = (seed & 0x3E0) == 0x20 ? b + 1 : b;
+    }
+    
+    join_baseline(tokens, JOIN_TEST_TOKENS, relations, JOIN_TEST_RELATIONS, ends);
+    check(join_matches(tokens, JOIN_TEST_TOKENS, relations, JOIN_TEST_RELATIONS, 4, ends),
+          "parallel join matches a nested loop");
+    check(join_matches(tokens, JOIN_TEST_TOKENS, relations, JOIN_TEST_RELATIONS, 1, ends),
+          "one-thread join matches a nested loop");
+    join_baseline(tokens, 300, relations, 2000, ends);
+    check(join_matches(tokens, 300, relations, 2000, 0, ends), "small join matches a nested loop");
+    
+    free(tokens);
+    free(relations);
+    free(ends);
+}
+
+// One scanned TOKEN or RELATION line, for comparing parsers
+typedef struct {
+    bool relation;
+    uint32_t a, b;          // id, or src and dst
+    uint8_t zone;
+    size_t line;
+    char type[48];
+} ScanRecord;
+
+typedef struct {
+    ScanRecord* items;
+    size_t count;
+    size_t capacity;
+    size_t errors;
+} ScanLog;
+
+static ScanRecord* scan_log_push(ScanLog* log) {
+    if (log->count == log->capacity) {
+        size_t capacity = log->capacity ? log->capacity * 2 : 256;
+        ScanRecord* items = (ScanRecord*)realloc(log->items, capacity * sizeof(ScanRecord));
+        if (!items) return NULL;
+        log->items = items;
+        log->capacity = capacity;
+    }
+    ScanRecord* rec = &log->items[log->count++];
+    memset(rec, 0, sizeof(*rec));
+    return rec;
+}
+
+static void scan_log_view(ScanRecord* rec, TokenView view) {
+    size_t len = view.len < sizeof(rec->type) - 1 ? view.len : sizeof(rec->type) - 1;
+    memcpy(rec->type, view.ptr, len);
+}
+
+static void scan_log_token(const TokenRecord* token, void* user) {
+    ScanRecord* rec = scan_log_push((ScanLog*)user);
+    if (!rec) return;
+    rec->a = token->id;
+    rec->zone = token->zone;
+    rec->line = token->line;
+    scan_log_view(rec, token->type);
+}
+
+static void scan_log_relation(const RelationRecord* relation, void* user) {
+    ScanRecord* rec = scan_log_push((ScanLog*)user);
+    if (!rec) return;
+    rec->relation = true;
+    rec->a = relation->src_id;
+    rec->b = relation->dst_id;
+    rec->line = relation->line;
+    scan_log_view(rec, relation->rel_type);
+}
+
+static void scan_log_error(const char* source, size_t line, const char* message, void* user) {
+    (void)source;
+    (void)line;
+    (void)message;
+    ((ScanLog*)user)->errors++;
+}
+
+// The parser the scanner replaced: fgets and sscanf per line
+static bool scan_baseline(const char* path, ScanLog* log) {
+    FILE* fp = fopen(path, "r");
+    if (!fp) return false;
+    char line[512];
+    size_t number = 0;
+    while (fgets(line, sizeof(line), fp)) {
+        number++;
+        if (line[0] == '#' || line[0] == '\n') continue;
+        unsigned id, dst;
+        char type[48], zone[16];
+        ScanRecord* rec;
+        if (strstr(line, "TOKEN:") && sscanf(line, "TOKEN: 0x%x %47s %15s", &id, type, zone) == 3 &&
+            (rec = scan_log_push(log))) {
+            rec->a = id;
+            rec->zone = (uint8_t)atoi(zone);
+            rec->line = number;
+            strcpy(rec->type, type);
+        }
+        if (strstr(line, "RELATION:") && sscanf(line, "RELATION: 0x%x -> 0x%x : %47s", &id, &dst, type) == 3 &&
+            (rec = scan_log_push(log))) {
+            rec->relation = true;
+            rec->a = id;
+            rec->b = dst;
+            rec->line = number;
+            strcpy(rec->type, type);
+        }
+    }
+    fclose(fp);
+    return true;
+}
+
+static bool scan_logs_equal(const ScanLog* x, const ScanLog* y) {
+    return x->count == y->count && memcmp(x->items, y->items, x->count * sizeof(ScanRecord)) == 0;
+}
+
+#define SCAN_TEST_LINES 3000
+
+// Random token file mixing the spellings sscanf accepts (spacing, tabs,
+// case, leading zeros, CRLF, long types) with comments, blank lines,
+// unrelated text and malformed records; returns the malformed count
+static size_t scan_test_file(FILE* fp, uint32_t seed) {
+    static const char* const junk[] = {
+        "# comment TOKEN: 0x1 NOT_A_TOKEN 1", "", "plain text line", "\t# indented comment?",
+        "TOKEN: 0xZZ BAD_ID 1", "TOKEN: 0x10 TYPE_ONLY", "RELATION: 0x1 -> 0x2",
+        "RELATION: 0x1 => 0x2 : ARROW", "RELATION: 0x5 -> : NO_TARGET"
+    };
+    static const size_t junk_malformed[] = { 0, 0, 0, 0, 1, 1, 1, 1, 1 };
+    size_t malformed = 0;
+    for (int line = 0; line < SCAN_TEST_LINES; line++) {
+        seed = seed * 1103515245u + 12345u;
+        uint32_t r = seed >> 8;
+        uint32_t id = (r % 7 == 0) ? 0xFFFFFFFFu - r % 5 : r % 100000;
+        const char* eol = (r & 0x30) == 0x30 ? "\r\n" : "\n";
+        switch (r % 6) {
+            case 0:
+                fprintf(fp, "TOKEN: 0x%08X NODE_IDENTITY %u%s", id, (r >> 4) % MAX_MEMORY_ZONES, eol);
+                break;
+            case 1:
+                fprintf(fp, "TOKEN:\t0x%x  %s\t%u  %s", id, (r & 0x100) ? "A_TYPE_NAME_LONGER_THAN_FIFTEEN" : "t",
+                        (r >> 4) % MAX_MEMORY_ZONES, eol);
+                break;
+            case 2:
+                fprintf(fp, "RELATION: 0x%08X -> 0x%08X : DEPENDS%s", id, r % 977, eol);
+                break;
+            case 3:
+                fprintf(fp, "RELATION: 0x%x->0x%X:owns_%u%s", id, r % 977, r % 10, eol);
+                break;
+            case 4:
+                fprintf(fp, "RELATION:  0x%06x  ->\t0x%x  :  SPACED%s", id, r % 13, eol);
+                break;
+            default:
+                fprintf(fp, "%s%s", junk[(r >> 4) % 9], eol);
+                malformed += junk_malformed[(r >> 4) % 9];
+                break;
+        }
+    }
+    return malformed;
+}
+
+// mmap scanner against the fgets/sscanf parser it replaced, record by
+// record with line numbers
+void test_token_scanner(void) {
+    printf("\n=== Testing Token Scanner ===\n");
+    
+    char path[] = "/tmp/gosiuml-scan-XXXXXX";
+    int fd = mkstemp(path);
+    FILE* fp = fd >= 0 ? fdopen(fd, "w") : NULL;
+    if (!fp) {
+        check(false, "create token file");
+        if (fd >= 0) close(fd);
+        return;
+    }
+    size_t malformed = scan_test_file(fp, 0x5CA11u);
+    fclose(fp);
+    
+    ScanLog want = {0}, got = {0};
+    TokenScanHandler handler = { scan_log_token, scan_log_relation, scan_log_error, &got, path };
+    TokenScanStats stats = {0};
+    TokenFileMap map;
+    bool ok = scan_baseline(path, &want) && token_file_map(path, &map);
+    if (ok) {
+        token_scan_buffer(map.data, map.size, 1, &handler, &stats);
+        token_file_unmap(&map);
+    }
+    check(ok && scan_logs_equal(&got, &want), "records match fgets/sscanf");
+    check(ok && got.errors == malformed && stats.errors == malformed && stats.lines == SCAN_TEST_LINES,
+          "malformed records reported, lines counted");
+    
+    free(want.items);
+    free(got.items);
+    unlink(path);
+}
+
+// Scan log that also notes where over-long lines were reported
+typedef struct {
+    ScanLog log;            // First, so the scan_log_* callbacks accept it
+    size_t long_lines[4];
+    size_t long_count;
+} StreamLog;
+
+static void stream_log_error(const char* source, size_t line, const char* message, void* user) {
+    StreamLog* log = (StreamLog*)user;
+    scan_log_error(source, line, message, &log->log);
+    if (strcmp(message, "line too long") == 0 && log->long_count < 4) {
+        log->long_lines[log->long_count++] = line;
+    }
+}
+
+typedef struct {
+    int fd;
+    const char* data;
+    size_t size;
+    uint32_t seed;
+} StreamWriter;
+
+// Feed a pipe in uneven pieces so lines arrive split across reads
+static void* stream_writer(void* arg) {
+    StreamWriter* w = (StreamWriter*)arg;
+    size_t sent = 0;
+    while (sent < w->size) {
+        w->seed = w->seed * 1103515245u + 12345u;
+        size_t piece = 1 + (w->seed >> 8) % 5000;
+        if (piece > w->size - sent) piece = w->size - sent;
+        ssize_t n = write(w->fd, w->data + sent, piece);
+        if (n <= 0) break;
+        sent += (size_t)n;
+    }
+    close(w->fd);
+    return NULL;
+}
+
+// Append a line of len bytes that starts like a token record
+static void stream_long_line(FILE* fp, size_t len, const char* eol) {
+    fputs("TOKEN: 0x1 ", fp);
+    for (size_t i = 11; i < len; i++) fputc('A' + (int)(i % 26), fp);
+    fputs(eol, fp);
+}
+
+// fd stream parser fed through a pipe against the buffer scanner on the
+// same text: lines split across reads give the same records and line
+// numbers, and lines longer than the read buffer (one in the middle, one
+// unterminated at the end) are reported once each and skipped
+void test_token_stream(void) {
+    printf("\n=== Testing Token Stream ===\n");
+    
+    char* text = NULL;
+    char* expected = NULL;
+    size_t text_size = 0, expected_size = 0;
+    FILE* fp = open_memstream(&text, &text_size);
+    FILE* ep = open_memstream(&expected, &expected_size);
+    if (!fp || !ep) {
+        check(false, "build stream text");
+        if (fp) fclose(fp);
+        if (ep) fclose(ep);
+        free(text);
+        free(expected);
+        return;
+    }
+    size_t malformed = 0;
+    for (int part = 0; part < 2; part++) {
+        malformed += scan_test_file(fp, 0x57EA0u + (uint32_t)part);
+        scan_test_file(ep, 0x57EA0u + (uint32_t)part);
+        // The skipped line stands in as a malformed one, keeping counts and lines aligned
+        const char* eol = part == 0 ? "\n" : "";
+        stream_long_line(fp, TOKEN_STREAM_BUFFER + (part == 0 ? TOKEN_STREAM_BUFFER / 2 : 3 * TOKEN_STREAM_BUFFER / 2), eol);
+        fprintf(ep, "TOKEN: 0x10 TYPE_ONLY%s", eol);
+    }
+    fclose(fp);
+    fclose(ep);
+    
+    StreamLog got = {0};
+    ScanLog want = {0};
+    TokenScanHandler handler = { scan_log_token, scan_log_relation, stream_log_error, &got, "<pipe>" };
+    TokenScanHandler baseline = { scan_log_token, scan_log_relation, scan_log_error, &want, "<buffer>" };
+    TokenScanStats stats = {0}, want_stats = {0};
+    token_scan_buffer(expected, expected_size, 1, &baseline, &want_stats);
+    
+    int fds[2];
+    pthread_t writer;
+    StreamWriter w = { -1, text, text_size, 0x5EEDu };
+    bool ok = pipe(fds) == 0;
+    if (ok) {
+        w.fd = fds[1];
+        ok = pthread_create(&writer, NULL, stream_writer, &w) == 0;
+        if (!ok) close(fds[1]);
+        int status = ok ? token_scan_stream(fds[0], &handler, &stats) : -1;
+        if (ok) pthread_join(writer, NULL);
+        close(fds[0]);
+        ok = ok && status == 0;
+    }
+    check(ok && text_size > 3 * TOKEN_STREAM_BUFFER, "pipe read to end");
+    check(ok && got.log.count > 0 && scan_logs_equal(&got.log, &want),
+          "records match buffer scan");
+    check(ok && got.long_count == 2 && got.long_lines[0] == SCAN_TEST_LINES + 1 &&
+          got.long_lines[1] == 2 * SCAN_TEST_LINES + 2,
+          "over-long lines reported at their lines");
+    check(ok && got.log.errors == malformed + 2 && got.log.errors == want.errors &&
+          stats.errors == want_stats.errors && stats.lines == want_stats.lines &&
+          stats.tokens == want_stats.tokens && stats.relations == want_stats.relations,
+          "stream stats match buffer scan");
+    
+    free(got.log.items);
+    free(want.items);
+    free(text);
+    free(expected);
+}
+
+#define LOAD_TEST_LINES 160000
+
+// Loader run with stderr captured, so diagnostics can be compared too
+static PhenoToken* load_captured(const char* path, int threads, int* count, char** diagnostics) {
+    char log[] = "/tmp/gosiuml-load-log-XXXXXX";
+    int log_fd = mkstemp(log);
+    int saved = log_fd >= 0 ? dup(STDERR_FILENO) : -1;
+    *diagnostics = NULL;
+    if (saved < 0) {
+        if (log_fd >= 0) {
+            close(log_fd);
+            unlink(log);
+        }
+        return NULL;
+    }
+    fflush(stderr);
+    dup2(log_fd, STDERR_FILENO);
+    PhenoToken* tokens = token_set_load(path, threads, count);
+    fflush(stderr);
+    dup2(saved, STDERR_FILENO);
+    close(saved);
+    close(log_fd);
+    *diagnostics = read_file(log, NULL);
+    unlink(log);
+    return tokens;
+}
+
+// Chunked parallel load against a single-chunk load of a file big enough
+// to split: same tokens and relations in file order, same diagnostics with
+// the same absolute line numbers
+void test_load_parallel(void) {
+    printf("\n=== Testing Parallel Load ===\n");
+    
+    char path[] = "/tmp/gosiuml-load-XXXXXX";
+    int fd = mkstemp(path);
+    FILE* fp = fd >= 0 ? fdopen(fd, "w") : NULL;
+    if (!fp) {
+        check(false, "create token file");
+        if (fd >= 0) close(fd);
+        return;
+    }
+    uint32_t seed = 0x10AD5u;
+    size_t malformed = 0;
+    for (int line = 0; line < LOAD_TEST_LINES; line++) {
+        seed = seed * 1103515245u + 12345u;
+        uint32_t r = seed >> 8;
+        // A small id range now and then gives duplicates across chunks
+        uint32_t id = (r % 53 == 0) ? r % 64 : (uint32_t)line + 0x1000u;
+        switch (r % 5) {
+            case 0: case 1: case 2:
+                fprintf(fp, "TOKEN: 0x%08X NODE_%u %u\n", id, r % 40, (r >> 4) % MAX_MEMORY_ZONES);
+                break;
+            case 3:
+                fprintf(fp, "RELATION: 0x%08X -> 0x%08X : REL_%u\n", id, r % 100000, r % 7);
+                break;
+            default:
+                if (r % 97 == 0) {
+                    fprintf(fp, "TOKEN: 0x%X MISSING_ZONE\n", id);
+                    malformed++;
+                } else {
+                    fprintf(fp, "# filler comment %u\n", r);
+                }
+                break;
+        }
+    }
+    long size = ftell(fp);
+    fclose(fp);
+    
+    int serial_count = 0, parallel_count = 0;
+    char* serial_log = NULL;
+    char* parallel_log = NULL;
+    PhenoToken* serial = load_captured(path, 1, &serial_count, &serial_log);
+    PhenoToken* parallel = load_captured(path, 4, &parallel_count, &parallel_log);
+    check(size > 4L * 1024 * 1024 && serial && parallel && serial_count > 0,
+          "file splits into chunks, both loads succeed");
+    
+    bool tokens_same = serial && parallel && serial_count == parallel_count;
+    for (int i = 0; tokens_same && i < serial_count; i++) {
+        tokens_same = serial[i].token_id == parallel[i].token_id &&
+                      serial[i].type_symbol == parallel[i].type_symbol &&
+                      serial[i].memory_zone == parallel[i].memory_zone &&
+                      strncmp(serial[i].sentinel, parallel[i].sentinel, sizeof(serial[i].sentinel)) == 0;
+    }
+    check(tokens_same, "tokens match serial load in order");
+    
+    size_t serial_edges = 0, parallel_edges = 0;
+    const PhenoEdge* a = serial ? gosiuml_token_relations(serial, &serial_edges) : NULL;
+    const PhenoEdge* b = parallel ? gosiuml_token_relations(parallel, &parallel_edges) : NULL;
+    bool edges_same = a && b && serial_edges > 0 && serial_edges == parallel_edges;
+    for (size_t i = 0; edges_same && i < serial_edges; i++) {
+        edges_same = a[i].src_id == b[i].src_id && a[i].dst_id == b[i].dst_id &&
+                     strncmp(a[i].rel_type, b[i].rel_type, sizeof(a[i].rel_type)) == 0;
+    }
+    check(edges_same, "relations match serial load in order");
+    size_t reported = 0;
+    for (const char* p = serial_log; p && (p = strchr(p, '\n')) != NULL; p++) reported++;
+    size_t duplicates = 0;
+    for (const char* p = serial_log; p && (p = strstr(p, "duplicate token id")) != NULL; p++) duplicates++;
+    check(serial_log && parallel_log && malformed > 0 && duplicates > 0 &&
+          reported == malformed + duplicates && strcmp(serial_log, parallel_log) == 0,
+          "duplicate and malformed lines reported alike");
+    
+    if (serial) token_set_free(serial);
+    if (parallel) token_set_free(parallel);
+    free(serial_log);
+    free(parallel_log);
+    unlink(path);
+}
+
+// Fast paths and file formats against their baselines (-r, and part of -t)
+void run_roundtrip_checks(void) {
+    test_gzip_roundtrip();
+    test_gtok_roundtrip();
+    test_reach_roundtrip();
+    test_symbol_roundtrip();
+    test_template_render();
+    test_reload_roundtrip();
+    test_bitmap_roundtrip();
+    test_person_model();
+    test_relation_table();
+    test_hamming_search();
+    test_join_edges();
+    test_token_scanner();
+    test_token_stream();
+    test_load_parallel();
+}
+
 void run_stress_test(int iterations) {
     printf("\n=== Running Stress Test (%d iterations) ===\n", iterations);
     
@@ -178,11 +1773,33 @@ void print_usage(const char* prog_name) {
     printf("  -c      Test concurrent access\n");
     printf("  -z      Test memory zones\n");
     printf("  -s <n>  Run stress test with n iterations\n");
+    printf("  -r      Run round-trip checks\n");
     printf("  -m      Show memory statistics\n");
     printf("  -h      Show this help\n");
+    printf("Commands:\n");
+    printf("  compile <input> [output]  Compile a token file to .gtok\n");
+    printf("  svg <input> <output.svg> [template [--watch]]\n");
+    printf("                            Render a token file as SVG; --watch renders\n");
+    printf("                            again whenever the template changes\n");
+    printf("  export <xml|json|ndjson> <input> [output]\n");
+    printf("                            Export tokens and relations\n");
+    printf("  lod <type|zone|state> <input> <output.svg> [group...]\n");
+    printf("                            Render grouped summary, expanding the named groups\n");
+    printf("  watch <input> [port] [--demo-load[=RATE]]\n");
+    printf("                            Stream live transitions to the HTML template;\n");
+    printf("                            --demo-load adds RATE (default 1000) synthetic\n");
+    printf("                            transitions per second\n");
+    printf("  Outputs ending in .gz or .svgz are gzip-compressed; --gzip[=LEVEL]\n");
+    printf("  sets the level (0-9) and makes export compress its output\n");
+    printf("  --perf prints cycles, instructions, cache and branch misses and\n");
+    printf("  context switches per call of the parse, render and export stages\n");
 }
 
 int main(int argc, char* argv[]) {
+    // Subcommands bypass the test driver
+    int command_status = cli_run_command(argc, argv);
+    if (command_status >= 0) return command_status;
+    
     printf("===========================================\n");
     printf("   GosiUML Phenomenological Memory Test   \n");
     printf("   OBINexus Platform v1.0.0              \n");
@@ -197,7 +1814,7 @@ int main(int argc, char* argv[]) {
     }
     
     int opt;
-    while ((opt = getopt(argc, argv, "tbdczs:mh")) != -1) {
+    while ((opt = getopt(argc, argv, "tbdczrs:mh")) != -1) {
         switch (opt) {
             case 't':
                 // Run all tests
@@ -205,6 +1822,7 @@ int main(int argc, char* argv[]) {
                 test_degradation_recovery();
                 test_concurrent_access();
                 test_memory_zones();
+                run_roundtrip_checks();
                 run_stress_test(100);
                 break;
                 
@@ -224,6 +1842,10 @@ int main(int argc, char* argv[]) {
                 test_memory_zones();
                 break;
                 
+            case 'r':
+                run_roundtrip_checks();
+                break;
+                
             case 's':
                 run_stress_test(atoi(optarg));
                 break;
@@ -243,5 +1865,9 @@ int main(int argc, char* argv[]) {
     pheno_memory_cleanup();
     
     printf("\n=== Test Suite Complete ===\n");
+    if (g_check_failures) {
+        printf("%d round-trip checks failed\n", g_check_failures);
+        return 1;
+    }
     return 0;
 }
@@ -0,0 +1,545 @@
+#include <stdlib.h>
+#include <string.h>
+#include "pheno_bitmap.h"
+
+// Container representations
+#define CONTAINER_ARRAY  0
+#define CONTAINER_BITSET 1
+
+// Arrays above this size are larger than a bitset (4096 * 2 = 8KB)
+#define ARRAY_MAX_CARDINALITY 4096
+#define BITSET_WORDS 1024
+
+struct PhenoBitmapContainer {
+    uint16_t key;          // High 16 bits of every id in the container
+    uint16_t type;
+    uint32_t cardinality;
+    uint32_t capacity;     // Array slots (array containers only)
+    union {
+        uint16_t* array;
+        uint64_t* words;
+    } data;
+};
+
+typedef PhenoBitmapContainer Container;
+
+// ---------------------------------------------------------------------
+// Container primitives
+// ---------------------------------------------------------------------
+
+static void container_release(Container* c) {
+    free(c->type == CONTAINER_ARRAY ? (void*)c->data.array : (void*)c->data.words);
+    c->data.array = NULL;
+    c->cardinality = 0;
+    c->capacity = 0;
+}
+
+static bool container_init_array(Container* c, uint16_t key, uint32_t capacity) {
+    if (capacity < 4) capacity = 4;
+    c->key = key;
+    c->type = CONTAINER_ARRAY;
+    c->cardinality = 0;
+    c->capacity = capacity;
+    c->data.array = (uint16_t*)malloc(capacity * sizeof(uint16_t));
+    return c->data.array != NULL;
+}
+
+static bool container_init_bitset(Container* c, uint16_t key) {
+    c->key = key;
+    c->type = CONTAINER_BITSET;
+    c->cardinality = 0;
+    c->capacity = 0;
+    c->data.words = (uint64_t*)calloc(BITSET_WORDS, sizeof(uint64_t));
+    return c->data.words != NULL;
+}
+
+// Lower bound of value in a sorted array
+static uint32_t array_lower_bound(const uint16_t* array, uint32_t n, uint16_t value) {
+    uint32_t lo = 0, hi = n;
+    while (lo < hi) {
+        uint32_t mid = (lo + hi) >> 1;
+        if (array[mid] < value) lo = mid + 1;
+        else hi = mid;
+    }
+    return lo;
+}
+
+static inline bool bitset_test(const uint64_t* words, uint16_t low) {
+    return (words[low >> 6] >> (low & 63)) & 1;
+}
+
+static uint32_t bitset_popcount(const uint64_t* words) {
+    uint32_t card = 0;
+    for (int w = 0; w < BITSET_WORDS; w++) {
+        card += (uint32_t)__builtin_popcountll(words[w]);
+    }
+    return card;
+}
+
+static bool container_array_to_bitset(Container* c) {
+    uint64_t* words = (uint64_t*)calloc(BITSET_WORDS, sizeof(uint64_t));
+    if (!words) return false;
+    
+    for (uint32_t i = 0; i < c->cardinality; i++) {
+        uint16_t v = c->data.array[i];
+        words[v >> 6] |= 1ULL << (v & 63);
+    }
+    free(c->data.array);
+    c->data.words = words;
+    c->type = CONTAINER_BITSET;
+    c->capacity = 0;
+    return true;
+}
+
+static bool container_bitset_to_array(Container* c) {
+    uint16_t* array = (uint16_t*)malloc((c->cardinality ? c->cardinality : 1) * sizeof(uint16_t));
+    if (!array) return false;
+    
+    uint32_t n = 0;
+    for (int w = 0; w < BITSET_WORDS; w++) {
+        uint64_t bits = c->data.words[w];
+        while (bits) {
+            array[n++] = (uint16_t)((w << 6) + __builtin_ctzll(bits));
+            bits &= bits - 1;
+        }
+    }
+    free(c->data.words);
+    c->data.array = array;
+    c->type = CONTAINER_ARRAY;
+    c->capacity = c->cardinality ? c->cardinality : 1;
+    return true;
+}
+
+// Build a container from a scratch bitset, picking the smaller layout
+static bool container_from_words(Container* c, uint16_t key, const uint64_t* words,
+                                 uint32_t card) {
+    if (card > ARRAY_MAX_CARDINALITY) {
+        if (!container_init_bitset(c, key)) return false;
+        memcpy(c->data.words, words, BITSET_WORDS * sizeof(uint64_t));
+        c->cardinality = card;
+        return true;
+    }
+    
+    if (!container_init_array(c, key, card)) return false;
+    uint32_t n = 0;
+    for (int w = 0; w < BITSET_WORDS && n < card; w++) {
+        uint64_t bits = words[w];
+        while (bits) {
+            c->data.array[n++] = (uint16_t)((w << 6) + __builtin_ctzll(bits));
+            bits &= bits - 1;
+        }
+    }
+    c->cardinality = n;
+    return true;
+}
+
+// Expand any container into a scratch bitset
+static void container_to_words(const Container* c, uint64_t* words) {
+    if (c->type == CONTAINER_BITSET) {
+        memcpy(words, c->data.words, BITSET_WORDS * sizeof(uint64_t));
+        return;
+    }
+    memset(words, 0, BITSET_WORDS * sizeof(uint64_t));
+    for (uint32_t i = 0; i < c->cardinality; i++) {
+        uint16_t v = c->data.array[i];
+        words[v >> 6] |= 1ULL << (v & 63);
+    }
+}
+
+static bool container_contains(const Container* c, uint16_t low) {
+    if (c->type == CONTAINER_BITSET) return bitset_test(c->data.words, low);
+    
+    uint32_t pos = array_lower_bound(c->data.array, c->cardinality, low);
+    return pos < c->cardinality && c->data.array[pos] == low;
+}
+
+static bool container_add(Container* c, uint16_t low) {
+    if (c->type == CONTAINER_BITSET) {
+        uint64_t bit = 1ULL << (low & 63);
+        if (c->data.words[low >> 6] & bit) return true;
+        c->data.words[low >> 6] |= bit;
+        c->cardinality++;
+        return true;
+    }
+    
+    // Appends of increasing ids are the common case
+    uint32_t pos = c->cardinality;
+    if (pos > 0 && c->data.array[pos - 1] >= low) {
+        pos = array_lower_bound(c->data.array, c->cardinality, low);
+        if (c->data.array[pos] == low) return true;
+    }
+    
+    if (c->cardinality == ARRAY_MAX_CARDINALITY) {
+        if (!container_array_to_bitset(c)) return false;
+        return container_add(c, low);
+    }
+    
+    if (c->cardinality == c->capacity) {
+        uint32_t capacity = c->capacity * 2;
+        if (capacity > ARRAY_MAX_CARDINALITY) capacity = ARRAY_MAX_CARDINALITY;
+        uint16_t* array = (uint16_t*)realloc(c->data.array, capacity * sizeof(uint16_t));
+        if (!array) return false;
+        c->data.array = array;
+        c->capacity = capacity;
+    }
+    
+    memmove(&c->data.array[pos + 1], &c->data.array[pos],
+            (c->cardinality - pos) * sizeof(uint16_t));
+    c->data.array[pos] = low;
+    c->cardinality++;
+    return true;
+}
+
+// Returns true if low was present
+static bool container_remove(Container* c, uint16_t low) {
+    if (c->type == CONTAINER_BITSET) {
+        uint64_t bit = 1ULL << (low & 63);
+        if (!(c->data.words[low >> 6] & bit)) return false;
+        c->data.words[low >> 6] &= ~bit;
+        c->cardinality--;
+        if (c->cardinality <= ARRAY_MAX_CARDINALITY / 2) {
+            container_bitset_to_array(c);  // Best effort; stays a bitset on OOM
+        }
+        return true;
+    }
+    
+    uint32_t pos = array_lower_bound(c->data.array, c->cardinality, low);
+    if (pos == c->cardinality || c->data.array[pos] != low) return false;
+    memmove(&c->data.array[pos], &c->data.array[pos + 1],
+            (c->cardinality - pos - 1) * sizeof(uint16_t));
+    c->cardinality--;
+    return true;
+}
+
+// ---------------------------------------------------------------------
+// Container set algebra (result written into an uninitialized out)
+// ---------------------------------------------------------------------
+
+static bool container_and(const Container* a, const Container* b, Container* out) {
+    if (a->type == CONTAINER_BITSET && b->type == CONTAINER_BITSET) {
+        uint64_t words[BITSET_WORDS];
+        uint32_t card = 0;
+        for (int w = 0; w < BITSET_WORDS; w++) {
+            words[w] = a->data.words[w] & b->data.words[w];
+            card += (uint32_t)__builtin_popcountll(words[w]);
+        }
+        return container_from_words(out, a->key, words, card);
+    }
+    
+    // At least one side is an array: the result is no larger than it
+    if (a->type == CONTAINER_BITSET) {
+        const Container* t = a; a = b; b = t;
+    }
+    if (!container_init_array(out, a->key, a->cardinality)) return false;
+    
+    uint32_t n = 0;
+    if (b->type == CONTAINER_BITSET) {
+        for (uint32_t i = 0; i < a->cardinality; i++) {
+            uint16_t v = a->data.array[i];
+            out->data.array[n] = v;
+            n += bitset_test(b->data.words, v);
+        }
+    } else {
+        uint32_t i = 0, j = 0;
+        while (i < a->cardinality && j < b->cardinality) {
+            uint16_t va = a->data.array[i], vb = b->data.array[j];
+            if (va == vb) { out->data.array[n++] = va; i++; j++; }
+            else if (va < vb) i++;
+            else j++;
+        }
+    }
+    out->cardinality = n;
+    return true;
+}
+
+static bool container_or(const Container* a, const Container* b, Container* out) {
+    if (a->type == CONTAINER_ARRAY && b->type == CONTAINER_ARRAY &&
+        a->cardinality + b->cardinality <= ARRAY_MAX_CARDINALITY) {
+        if (!container_init_array(out, a->key, a->cardinality + b->cardinality)) return false;
+        
+        uint32_t i = 0, j = 0, n = 0;
+        while (i < a->cardinality && j < b->cardinality) {
+            uint16_t va = a->data.array[i], vb = b->data.array[j];
+            if (va == vb) { out->data.array[n++] = va; i++; j++; }
+            else if (va < vb) { out->data.array[n++] = va; i++; }
+            else { out->data.array[n++] = vb; j++; }
+        }
+        while (i < a->cardinality) out->data.array[n++] = a->data.array[i++];
+        while (j < b->cardinality) out->data.array[n++] = b->data.array[j++];
+        out->cardinality = n;
+        return true;
+    }
+    
+    uint64_t words[BITSET_WORDS];
+    container_to_words(a, words);
+    if (b->type == CONTAINER_BITSET) {
+        for (int w = 0; w < BITSET_WORDS; w++) words[w] |= b->data.words[w];
+    } else {
+        for (uint32_t i = 0; i < b->cardinality; i++) {
+            uint16_t v = b->data.array[i];
+            words[v >> 6] |= 1ULL << (v & 63);
+        }
+    }
+    return container_from_words(out, a->key, words, bitset_popcount(words));
+}
+
+static bool container_andnot(const Container* a, const Container* b, Container* out) {
+    if (a->type == CONTAINER_ARRAY) {
+        if (!container_init_array(out, a->key, a->cardinality)) return false;
+        
+        uint32_t n = 0;
+        if (b->type == CONTAINER_BITSET) {
+            for (uint32_t i = 0; i < a->cardinality; i++) {
+                uint16_t v = a->data.array[i];
+                out->data.array[n] = v;
+                n += !bitset_test(b->data.words, v);
+            }
+        } else {
+            uint32_t j = 0;
+            for (uint32_t i = 0; i < a->cardinality; i++) {
+                uint16_t v = a->data.array[i];
+                while (j < b->cardinality && b->data.array[j] < v) j++;
+                out->data.array[n] = v;
+                n += !(j < b->cardinality && b->data.array[j] == v);
+            }
+        }
+        out->cardinality = n;
+        return true;
+    }
+    
+    uint64_t words[BITSET_WORDS];
+    memcpy(words, a->data.words, sizeof(words));
+    if (b->type == CONTAINER_BITSET) {
+        for (int w = 0; w < BITSET_WORDS; w++) words[w] &= ~b->data.words[w];
+    } else {
+        for (uint32_t i = 0; i < b->cardinality; i++) {
+            uint16_t v = b->data.array[i];
+            words[v >> 6] &= ~(1ULL << (v & 63));
+        }
+    }
+    return container_from_words(out, a->key, words, bitset_popcount(words));
+}
+
+static bool container_copy(Container* dst, const Container* src) {
+    *dst = *src;
+    if (src->type == CONTAINER_BITSET) {
+        dst->data.words = (uint64_t*)malloc(BITSET_WORDS * sizeof(uint64_t));
+        if (!dst->data.words) return false;
+        memcpy(dst->data.words, src->data.words, BITSET_WORDS * sizeof(uint64_t));
+    } else {
+        dst->data.array = (uint16_t*)malloc(src->capacity * sizeof(uint16_t));
+        if (!dst->data.array) return false;
+        memcpy(dst->data.array, src->data.array, src->cardinality * sizeof(uint16_t));
+    }
+    return true;
+}
+
+// ---------------------------------------------------------------------
+// Bitmap level
+// ---------------------------------------------------------------------
+
+void pheno_bitmap_init(PhenoBitmap* bm) {
+    bm->containers = NULL;
+    bm->count = 0;
+    bm->capacity = 0;
+}
+
+void pheno_bitmap_clear(PhenoBitmap* bm) {
+    for (uint32_t i = 0; i < bm->count; i++) {
+        container_release(&bm->containers[i]);
+    }
+    bm->count = 0;
+}
+
+void pheno_bitmap_free(PhenoBitmap* bm) {
+    if (!bm) return;
+    
+    pheno_bitmap_clear(bm);
+    free(bm->containers);
+    pheno_bitmap_init(bm);
+}
+
+// Index of the container for key, or the insertion point if absent
+static uint32_t bitmap_find(const PhenoBitmap* bm, uint16_t key) {
+    if (bm->count && bm->containers[bm->count - 1].key < key) return bm->count;
+    
+    uint32_t lo = 0, hi = bm->count;
+    while (lo < hi) {
+        uint32_t mid = (lo + hi) >> 1;
+        if (bm->containers[mid].key < key) lo = mid + 1;
+        else hi = mid;
+    }
+    return lo;
+}
+
+static bool bitmap_reserve(PhenoBitmap* bm, uint32_t needed) {
+    if (needed <= bm->capacity) return true;
+    
+    uint32_t capacity = bm->capacity ? bm->capacity * 2 : 4;
+    if (capacity < needed) capacity = needed;
+    Container* containers = (Container*)realloc(bm->containers, capacity * sizeof(Container));
+    if (!containers) return false;
+    bm->containers = containers;
+    bm->capacity = capacity;
+    return true;
+}
+
+// Append a finished container, dropping it if empty
+static bool bitmap_push(PhenoBitmap* bm, Container* c) {
+    if (c->cardinality == 0) {
+        container_release(c);
+        return true;
+    }
+    if (!bitmap_reserve(bm, bm->count + 1)) {
+        container_release(c);
+        return false;
+    }
+    bm->containers[bm->count++] = *c;
+    return true;
+}
+
+// Drop the container at pos
+static void bitmap_erase(PhenoBitmap* bm, uint32_t pos) {
+    container_release(&bm->containers[pos]);
+    memmove(&bm->containers[pos], &bm->containers[pos + 1],
+            (bm->count - pos - 1) * sizeof(Container));
+    bm->count--;
+}
+
+bool pheno_bitmap_add(PhenoBitmap* bm, uint32_t id) {
+    uint16_t key = (uint16_t)(id >> 16);
+    uint32_t pos = bitmap_find(bm, key);
+    
+    if (pos == bm->count || bm->containers[pos].key != key) {
+        if (!bitmap_reserve(bm, bm->count + 1)) return false;
+        Container c;
+        if (!container_init_array(&c, key, 4)) return false;
+        memmove(&bm->containers[pos + 1], &bm->containers[pos],
+                (bm->count - pos) * sizeof(Container));
+        bm->containers[pos] = c;
+        bm->count++;
+    }
+    if (container_add(&bm->containers[pos], (uint16_t)id)) return true;
+    
+    // Never leave an empty container behind
+    if (bm->containers[pos].cardinality == 0) bitmap_erase(bm, pos);
+    return false;
+}
+
+bool pheno_bitmap_remove(PhenoBitmap* bm, uint32_t id) {
+    uint16_t key = (uint16_t)(id >> 16);
+    uint32_t pos = bitmap_find(bm, key);
+    if (pos == bm->count || bm->containers[pos].key != key) return false;
+    
+    if (!container_remove(&bm->containers[pos], (uint16_t)id)) return false;
+    if (bm->containers[pos].cardinality == 0) bitmap_erase(bm, pos);
+    return true;
+}
+
+bool pheno_bitmap_contains(const PhenoBitmap* bm, uint32_t id) {
+    uint16_t key = (uint16_t)(id >> 16);
+    uint32_t pos = bitmap_find(bm, key);
+    if (pos == bm->count || bm->containers[pos].key != key) return false;
+    return container_contains(&bm->containers[pos], (uint16_t)id);
+}
+
+uint64_t pheno_bitmap_cardinality(const PhenoBitmap* bm) {
+    uint64_t card = 0;
+    for (uint32_t i = 0; i < bm->count; i++) {
+        card += bm->containers[i].cardinality;
+    }
+    return card;
+}
+
+bool pheno_bitmap_copy(PhenoBitmap* dst, const PhenoBitmap* src) {
+    pheno_bitmap_clear(dst);
+    if (!bitmap_reserve(dst, src->count)) return false;
+    
+    for (uint32_t i = 0; i < src->count; i++) {
+        if (!container_copy(&dst->containers[i], &src->containers[i])) {
+            dst->count = i;
+            return false;
+        }
+    }
+    dst->count = src->count;
+    return true;
+}
+
+bool pheno_bitmap_and(const PhenoBitmap* a, const PhenoBitmap* b, PhenoBitmap* out) {
+    pheno_bitmap_clear(out);
+    
+    uint32_t i = 0, j = 0;
+    while (i < a->count && j < b->count) {
+        uint16_t ka = a->containers[i].key, kb = b->containers[j].key;
+        if (ka < kb) { i++; continue; }
+        if (kb < ka) { j++; continue; }
+        
+        Container c;
+        if (!container_and(&a->containers[i], &b->containers[j], &c)) return false;
+        if (!bitmap_push(out, &c)) return false;
+        i++; j++;
+    }
+    return true;
+}
+
+bool pheno_bitmap_or(const PhenoBitmap* a, const PhenoBitmap* b, PhenoBitmap* out) {
+    pheno_bitmap_clear(out);
+    
+    uint32_t i = 0, j = 0;
+    while (i < a->count || j < b->count) {
+        Container c;
+        bool ok;
+        if (j == b->count || (i < a->count && a->containers[i].key < b->containers[j].key)) {
+            ok = container_copy(&c, &a->containers[i++]);
+        } else if (i == a->count || b->containers[j].key < a->containers[i].key) {
+            ok = container_copy(&c, &b->containers[j++]);
+        } else {
+            ok = container_or(&a->containers[i++], &b->containers[j++], &c);
+        }
+        if (!ok || !bitmap_push(out, &c)) return false;
+    }
+    return true;
+}
+
+bool pheno_bitmap_andnot(const PhenoBitmap* a, const PhenoBitmap* b, PhenoBitmap* out) {
+    pheno_bitmap_clear(out);
+    
+    uint32_t j = 0;
+    for (uint32_t i = 0; i < a->count; i++) {
+        uint16_t key = a->containers[i].key;
+        while (j < b->count && b->containers[j].key < key) j++;
+        
+        Container c;
+        bool ok;
+        if (j < b->count && b->containers[j].key == key) {
+            ok = container_andnot(&a->containers[i], &b->containers[j], &c);
+        } else {
+            ok = container_copy(&c, &a->containers[i]);
+        }
+        if (!ok || !bitmap_push(out, &c)) return false;
+    }
+    return true;
+}
+
+size_t pheno_bitmap_to_array(const PhenoBitmap* bm, uint32_t* out) {
+    size_t n = 0;
+    for (uint32_t i = 0; i < bm->count; i++) {
+        const Container* c = &bm->containers[i];
+        uint32_t high = (uint32_t)c->key << 16;
+        
+        if (c->type == CONTAINER_ARRAY) {
+            for (uint32_t k = 0; k < c->cardinality; k++) {
+                out[n++] = high | c->data.array[k];
+            }
+            continue;
+        }
+        for (int w = 0; w < BITSET_WORDS; w++) {
+            uint64_t bits = c->data.words[w];
+            while (bits) {
+                out[n++] = high | (uint32_t)((w << 6) + __builtin_ctzll(bits));
+                bits &= bits - 1;
+            }
+        }
+    }
+    return n;
+}
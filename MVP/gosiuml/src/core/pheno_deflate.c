@@ -0,0 +1,604 @@
+#include <stdlib.h>
+#include <pthread.h>
+#include "pheno_deflate.h"
+#include "pheno_perf.h"
+
+#define WINDOW_MASK (PHENO_DEFLATE_WINDOW - 1)
+#define HASH_BITS 15
+#define HASH_SIZE (1 << HASH_BITS)
+#define MIN_MATCH 3
+#define MAX_MATCH 258
+#define BLOCK_SYMBOLS 16384     // Symbols per deflate block
+#define STORED_MAX 65535        // Bytes per stored block
+#define LITLEN_CODES 286
+#define DIST_CODES 30
+#define CODELEN_CODES 19
+#define MAX_BITS 15
+#define MAX_CODELEN_BITS 7
+#define END_OF_BLOCK 256
+
+// Match search effort per level, as in zlib: stop lazy evaluation at a
+// match of `lazy` bytes (0: greedy), accept `nice` bytes at once, follow
+// at most `chain` candidates (a quarter once a `good` match is held)
+typedef struct {
+    uint16_t good;
+    uint16_t lazy;
+    uint16_t nice;
+    uint16_t chain;
+} LevelConfig;
+
+static const LevelConfig g_levels[10] = {
+    { 0, 0, 0, 0 },             // Stored
+    { 4, 0, 8, 4 },
+    { 4, 0, 16, 8 },
+    { 4, 0, 32, 32 },
+    { 4, 4, 16, 16 },
+    { 8, 16, 32, 32 },
+    { 8, 16, 128, 128 },
+    { 8, 32, 128, 256 },
+    { 32, 128, 258, 1024 },
+    { 32, 258, 258, 4096 },
+};
+
+static const uint16_t g_length_base[29] = {
+    3, 4, 5, 6, 7, 8, 9, 10, 11, 13, 15, 17, 19, 23, 27, 31,
+    35, 43, 51, 59, 67, 83, 99, 115, 131, 163, 195, 227, 258
+};
+static const uint8_t g_length_extra[29] = {
+    0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 2, 2, 2, 2,
+    3, 3, 3, 3, 4, 4, 4, 4, 5, 5, 5, 5, 0
+};
+static const uint16_t g_dist_base[DIST_CODES] = {
+    1, 2, 3, 4, 5, 7, 9, 13, 17, 25, 33, 49, 65, 97, 129, 193,
+    257, 385, 513, 769, 1025, 1537, 2049, 3073, 4097, 6145, 8193, 12289, 16385, 24577
+};
+static const uint8_t g_dist_extra[DIST_CODES] = {
+    0, 0, 0, 0, 1, 1, 2, 2, 3, 3, 4, 4, 5, 5, 6, 6,
+    7, 7, 8, 8, 9, 9, 10, 10, 11, 11, 12, 12, 13, 13
+};
+static const uint8_t g_codelen_order[CODELEN_CODES] = {
+    16, 17, 18, 0, 8, 7, 9, 6, 10, 5, 11, 4, 12, 3, 13, 2, 14, 1, 15
+};
+
+// Code of match length 3 + i, and of distance 1 + d (d < 256) or
+// 1 + (d >> 7 << 7) (index 256 + (d >> 7))
+static uint8_t g_length_code[256];
+static uint8_t g_dist_code[512];
+static uint8_t g_fixed_litlen_lens[288];
+static uint16_t g_fixed_litlen_codes[288];
+static uint16_t g_fixed_dist_codes[DIST_CODES];
+static uint8_t g_fixed_dist_lens[DIST_CODES];
+static pthread_once_t g_tables_once = PTHREAD_ONCE_INIT;
+
+struct PhenoDeflate {
+    LevelConfig config;
+    int level;
+    int32_t head[HASH_SIZE];                // Newest position per hash, -1 if none
+    int32_t prev[PHENO_DEFLATE_WINDOW];     // Older position with the same hash
+    uint16_t sym_litlen[BLOCK_SYMBOLS];     // Literal byte or match length
+    uint16_t sym_dist[BLOCK_SYMBOLS];       // 0 for literals
+    size_t symbols;
+    uint32_t litlen_freq[LITLEN_CODES];
+    uint32_t dist_freq[DIST_CODES];
+    const uint8_t* base;                    // Start of the history
+    size_t block_start;                     // Input offsets of the open block
+    size_t block_end;
+    PhenoWriter* out;
+    uint64_t bits;
+    unsigned bit_count;
+};
+
+static uint16_t reverse_bits(uint16_t code, unsigned len) {
+    uint16_t r = 0;
+    for (unsigned i = 0; i < len; i++) {
+        r = (uint16_t)(r << 1 | (code & 1));
+        code >>= 1;
+    }
+    return r;
+}
+
+// Canonical codes for a set of code lengths, bit-reversed because deflate
+// sends Huffman codes starting with the most significant bit
+static void huffman_codes(const uint8_t* lens, int n, uint16_t* codes) {
+    uint16_t count[MAX_BITS + 1] = { 0 };
+    uint16_t next[MAX_BITS + 1];
+    for (int s = 0; s < n; s++) count[lens[s]]++;
+    count[0] = 0;
+    
+    uint16_t code = 0;
+    for (int bits = 1; bits <= MAX_BITS; bits++) {
+        code = (uint16_t)((code + count[bits - 1]) << 1);
+        next[bits] = code;
+    }
+    for (int s = 0; s < n; s++) {
+        codes[s] = lens[s] ? reverse_bits(next[lens[s]]++, lens[s]) : 0;
+    }
+}
+
+static void deflate_init_tables(void) {
+    for (int code = 0; code < 28; code++) {
+        for (int j = 0; j < 1 << g_length_extra[code]; j++) {
+            g_length_code[g_length_base[code] - MIN_MATCH + j] = (uint8_t)code;
+        }
+    }
+    g_length_code[MAX_MATCH - MIN_MATCH] = 28;
+    
+    for (int code = 0; code < DIST_CODES; code++) {
+        for (int j = 0; j < 1 << g_dist_extra[code]; j++) {
+            int d = g_dist_base[code] - 1 + j;
+            g_dist_code[d < 256 ? d : 256 + (d >> 7)] = (uint8_t)code;
+        }
+    }
+    
+    for (int s = 0; s < 288; s++) {
+        g_fixed_litlen_lens[s] = s < 144 ? 8 : s < 256 ? 9 : s < 280 ? 7 : 8;
+    }
+    huffman_codes(g_fixed_litlen_lens, 288, g_fixed_litlen_codes);
+    for (int s = 0; s < DIST_CODES; s++) {
+        g_fixed_dist_codes[s] = reverse_bits((uint16_t)s, 5);
+        g_fixed_dist_lens[s] = 5;
+    }
+}
+
+static inline unsigned dist_code(unsigned dist) {
+    dist--;
+    return g_dist_code[dist < 256 ? dist : 256 + (dist >> 7)];
+}
+
+// Code lengths of at most `limit` bits for freq[0..n). Always assigns at
+// least two codes, since a complete code needs two (inflate rejects
+// incomplete ones), and always returns a complete code.
+static void huffman_lengths(const uint32_t* freq, int n, int limit, uint8_t* lens) {
+    uint16_t leaf[LITLEN_CODES];
+    uint32_t weight[2 * LITLEN_CODES];
+    uint16_t parent[2 * LITLEN_CODES];
+    uint8_t depth[2 * LITLEN_CODES];
+    int m = 0;
+    
+    for (int s = 0; s < n; s++) {
+        lens[s] = 0;
+        if (freq[s]) leaf[m++] = (uint16_t)s;
+    }
+    for (int s = 0; m < 2; s++) {
+        if (!freq[s]) leaf[m++] = (uint16_t)s;
+    }
+    
+    // Leaves by ascending frequency
+    for (int i = 1; i < m; i++) {
+        uint16_t s = leaf[i];
+        int j = i;
+        while (j > 0 && freq[leaf[j - 1]] > freq[s]) {
+            leaf[j] = leaf[j - 1];
+            j--;
+        }
+        leaf[j] = s;
+    }
+    for (int i = 0; i < m; i++) {
+        weight[i] = freq[leaf[i]] ? freq[leaf[i]] : 1;
+    }
+    
+    // Two-queue construction: leaves [0, m) and internal nodes [m, 2m-1)
+    // are both created in ascending weight order
+    int next_leaf = 0, next_node = m;
+    for (int k = m; k < 2 * m - 1; k++) {
+        int pick[2];
+        for (int p = 0; p < 2; p++) {
+            if (next_leaf < m && (next_node >= k || weight[next_leaf] <= weight[next_node])) {
+                pick[p] = next_leaf++;
+            } else {
+                pick[p] = next_node++;
+            }
+        }
+        weight[k] = weight[pick[0]] + weight[pick[1]];
+        parent[pick[0]] = parent[pick[1]] = (uint16_t)k;
+    }
+    
+    int root = 2 * m - 2;
+    int max_depth = 0;
+    depth[root] = 0;
+    for (int k = root - 1; k >= 0; k--) {
+        int d = depth[parent[k]] + 1;
+        depth[k] = (uint8_t)(d > 255 ? 255 : d);
+        if (k < m && d > max_depth) max_depth = d;
+    }
+    
+    uint8_t len[LITLEN_CODES];
+    for (int i = 0; i < m; i++) len[i] = depth[i];
+    
+    if (max_depth > limit) {
+        // Clamp, then repair the Kraft sum in units of 2^-limit: lengthen
+        // the rarest codes while over-subscribed, shorten the most common
+        // while there is room left
+        uint32_t total = 1u << limit, kraft = 0;
+        for (int i = 0; i < m; i++) {
+            if (len[i] > limit) len[i] = (uint8_t)limit;
+            kraft += 1u << (limit - len[i]);
+        }
+        for (int i = 0; kraft > total; i = (i + 1) % m) {
+            if (len[i] < limit) {
+                len[i]++;
+                kraft -= 1u << (limit - len[i]);
+            }
+        }
+        for (int i = m - 1; kraft < total; i = i ? i - 1 : m - 1) {
+            if (len[i] > 1 && kraft + (1u << (limit - len[i])) <= total) {
+                kraft += 1u << (limit - len[i]);
+                len[i]--;
+            }
+        }
+    }
+    for (int i = 0; i < m; i++) lens[leaf[i]] = len[i];
+}
+
+// ---- Bit output ----
+
+static inline void put_bits(PhenoDeflate* d, uint32_t value, unsigned count) {
+    d->bits |= (uint64_t)value << d->bit_count;
+    d->bit_count += count;
+    if (d->bit_count >= 32) {
+        uint8_t bytes[4] = { (uint8_t)d->bits, (uint8_t)(d->bits >> 8),
+                             (uint8_t)(d->bits >> 16), (uint8_t)(d->bits >> 24) };
+        pheno_writer_put(d->out, bytes, sizeof(bytes));
+        d->bits >>= 32;
+        d->bit_count -= 32;
+    }
+}
+
+// Pad to a byte boundary and write out the pending bits
+static void align_bits(PhenoDeflate* d) {
+    while (d->bit_count > 0) {
+        uint8_t byte = (uint8_t)d->bits;
+        pheno_writer_put(d->out, &byte, 1);
+        d->bits >>= 8;
+        d->bit_count = d->bit_count > 8 ? d->bit_count - 8 : 0;
+    }
+    d->bits = 0;
+}
+
+// Stored blocks for raw[0..len); a zero length writes one empty block
+static void write_stored(PhenoDeflate* d, const uint8_t* raw, size_t len) {
+    do {
+        size_t n = len < STORED_MAX ? len : STORED_MAX;
+        put_bits(d, 0, 3);
+        align_bits(d);
+        uint8_t header[4] = { (uint8_t)n, (uint8_t)(n >> 8), (uint8_t)~n, (uint8_t)(~n >> 8) };
+        pheno_writer_put(d->out, header, sizeof(header));
+        if (n) pheno_writer_put(d->out, raw, n);
+        raw += n;
+        len -= n;
+    } while (len);
+}
+
+static void write_symbols(PhenoDeflate* d, const uint16_t* ll_codes, const uint8_t* ll_lens,
+                          const uint16_t* d_codes, const uint8_t* d_lens) {
+    for (size_t i = 0; i < d->symbols; i++) {
+        unsigned value = d->sym_litlen[i];
+        unsigned dist = d->sym_dist[i];
+        if (!dist) {
+            put_bits(d, ll_codes[value], ll_lens[value]);
+            continue;
+        }
+        unsigned lc = g_length_code[value - MIN_MATCH];
+        put_bits(d, ll_codes[257 + lc], ll_lens[257 + lc]);
+        if (g_length_extra[lc]) put_bits(d, value - g_length_base[lc], g_length_extra[lc]);
+        unsigned dc = dist_code(dist);
+        put_bits(d, d_codes[dc], d_lens[dc]);
+        if (g_dist_extra[dc]) put_bits(d, dist - g_dist_base[dc], g_dist_extra[dc]);
+    }
+    put_bits(d, ll_codes[END_OF_BLOCK], ll_lens[END_OF_BLOCK]);
+}
+
+// Run-length code the concatenated code lengths with symbols 16-18
+static int encode_lengths(const uint8_t* lens, int n, uint8_t* syms, uint8_t* extra) {
+    int count = 0;
+    for (int i = 0; i < n;) {
+        uint8_t len = lens[i];
+        int run = 1;
+        while (i + run < n && lens[i + run] == len) run++;
+        i += run;
+    
+        if (len == 0) {
+            while (run >= 11) {
+                int r = run < 138 ? run : 138;
+                syms[count] = 18;
+                extra[count++] = (uint8_t)(r - 11);
+                run -= r;
+            }
+            if (run >= 3) {
+                syms[count] = 17;
+                extra[count++] = (uint8_t)(run - 3);
+                run = 0;
+            }
+        } else {
+            syms[count] = len;
+            extra[count++] = 0;
+            run--;
+            while (run >= 3) {
+                int r = run < 6 ? run : 6;
+                syms[count] = 16;
+                extra[count++] = (uint8_t)(r - 3);
+                run -= r;
+            }
+        }
+        while (run-- > 0) {
+            syms[count] = len;
+            extra[count++] = 0;
+        }
+    }
+    return count;
+}
+
+// Emit the recorded symbols as one block, dynamic, fixed or stored,
+// whichever is smallest
+static void flush_block(PhenoDeflate* d) {
+    const uint8_t* raw = d->base + d->block_start;
+    size_t raw_len = d->block_end - d->block_start;
+    if (!raw_len) return;
+    
+    d->litlen_freq[END_OF_BLOCK]++;
+    uint8_t ll_lens[LITLEN_CODES], d_lens[DIST_CODES];
+    huffman_lengths(d->litlen_freq, LITLEN_CODES, MAX_BITS, ll_lens);
+    huffman_lengths(d->dist_freq, DIST_CODES, MAX_BITS, d_lens);
+    
+    int nlit = LITLEN_CODES, ndist = DIST_CODES;
+    while (nlit > 257 && !ll_lens[nlit - 1]) nlit--;
+    while (ndist > 1 && !d_lens[ndist - 1]) ndist--;
+    
+    uint8_t all[LITLEN_CODES + DIST_CODES];
+    uint8_t cl_syms[LITLEN_CODES + DIST_CODES], cl_extra[LITLEN_CODES + DIST_CODES];
+    memcpy(all, ll_lens, (size_t)nlit);
+    memcpy(all + nlit, d_lens, (size_t)ndist);
+    int ncl = encode_lengths(all, nlit + ndist, cl_syms, cl_extra);
+    
+    uint32_t cl_freq[CODELEN_CODES] = { 0 };
+    for (int i = 0; i < ncl; i++) cl_freq[cl_syms[i]]++;
+    uint8_t cl_lens[CODELEN_CODES];
+    huffman_lengths(cl_freq, CODELEN_CODES, MAX_CODELEN_BITS, cl_lens);
+    int nclen = CODELEN_CODES;
+    while (nclen > 4 && !cl_lens[g_codelen_order[nclen - 1]]) nclen--;
+    
+    // Sizes in bits
+    uint64_t extra_bits = 0, dynamic_bits = 0, fixed_bits = 0;
+    for (int s = 0; s < LITLEN_CODES; s++) {
+        dynamic_bits += (uint64_t)d->litlen_freq[s] * ll_lens[s];
+        fixed_bits += (uint64_t)d->litlen_freq[s] * g_fixed_litlen_lens[s];
+        if (s > END_OF_BLOCK) extra_bits += (uint64_t)d->litlen_freq[s] * g_length_extra[s - 257];
+    }
+    for (int s = 0; s < DIST_CODES; s++) {
+        dynamic_bits += (uint64_t)d->dist_freq[s] * d_lens[s];
+        fixed_bits += (uint64_t)d->dist_freq[s] * 5;
+        extra_bits += (uint64_t)d->dist_freq[s] * g_dist_extra[s];
+    }
+    dynamic_bits += 3 + 14 + 3 * (uint64_t)nclen + extra_bits;
+    for (int s = 0; s < CODELEN_CODES; s++) {
+        static const uint8_t cl_extra_bits[CODELEN_CODES] = { [16] = 2, [17] = 3, [18] = 7 };
+        dynamic_bits += (uint64_t)cl_freq[s] * (cl_lens[s] + cl_extra_bits[s]);
+    }
+    fixed_bits += 3 + extra_bits;
+    uint64_t stored_bits = ((raw_len + STORED_MAX - 1) / STORED_MAX) * 40 + 8 + raw_len * 8;
+    
+    if (stored_bits <= dynamic_bits && stored_bits <= fixed_bits) {
+        write_stored(d, raw, raw_len);
+    } else if (fixed_bits <= dynamic_bits) {
+        put_bits(d, 1 << 1, 3);
+        write_symbols(d, g_fixed_litlen_codes, g_fixed_litlen_lens, g_fixed_dist_codes, g_fixed_dist_lens);
+    } else {
+        uint16_t ll_codes[LITLEN_CODES], d_codes[DIST_CODES], cl_codes[CODELEN_CODES];
+        huffman_codes(ll_lens, LITLEN_CODES, ll_codes);
+        huffman_codes(d_lens, DIST_CODES, d_codes);
+        huffman_codes(cl_lens, CODELEN_CODES, cl_codes);
+    
+        put_bits(d, 2 << 1, 3);
+        put_bits(d, (uint32_t)(nlit - 257), 5);
+        put_bits(d, (uint32_t)(ndist - 1), 5);
+        put_bits(d, (uint32_t)(nclen - 4), 4);
+        for (int i = 0; i < nclen; i++) {
+            put_bits(d, cl_lens[g_codelen_order[i]], 3);
+        }
+        for (int i = 0; i < ncl; i++) {
+            uint8_t s = cl_syms[i];
+            put_bits(d, cl_codes[s], cl_lens[s]);
+            if (s == 16) put_bits(d, cl_extra[i], 2);
+            else if (s == 17) put_bits(d, cl_extra[i], 3);
+            else if (s == 18) put_bits(d, cl_extra[i], 7);
+        }
+        write_symbols(d, ll_codes, ll_lens, d_codes, d_lens);
+    }
+    
+    d->symbols = 0;
+    memset(d->litlen_freq, 0, sizeof(d->litlen_freq));
+    memset(d->dist_freq, 0, sizeof(d->dist_freq));
+    d->block_start = d->block_end;
+}
+
+// ---- Matching ----
+
+static inline void record_literal(PhenoDeflate* d, uint8_t byte) {
+    d->sym_litlen[d->symbols] = byte;
+    d->sym_dist[d->symbols++] = 0;
+    d->litlen_freq[byte]++;
+    d->block_end++;
+    if (d->symbols == BLOCK_SYMBOLS) flush_block(d);
+}
+
+static inline void record_match(PhenoDeflate* d, unsigned len, unsigned dist) {
+    d->sym_litlen[d->symbols] = (uint16_t)len;
+    d->sym_dist[d->symbols++] = (uint16_t)dist;
+    d->litlen_freq[257 + g_length_code[len - MIN_MATCH]]++;
+    d->dist_freq[dist_code(dist)]++;
+    d->block_end += len;
+    if (d->symbols == BLOCK_SYMBOLS) flush_block(d);
+}
+
+static inline uint32_t hash3(const uint8_t* p) {
+    uint32_t v = (uint32_t)p[0] | (uint32_t)p[1] << 8 | (uint32_t)p[2] << 16;
+    return (v * 2654435761u) >> (32 - HASH_BITS);
+}
+
+// Link pos into its hash chain; returns the previous chain head
+static inline int32_t insert_string(PhenoDeflate* d, int32_t pos) {
+    uint32_t h = hash3(d->base + pos);
+    int32_t cand = d->head[h];
+    d->prev[pos & WINDOW_MASK] = cand;
+    d->head[h] = pos;
+    return cand;
+}
+
+static inline unsigned common_length(const uint8_t* a, const uint8_t* b, unsigned max) {
+    unsigned n = 0;
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+    while (n + 8 <= max) {
+        uint64_t x, y;
+        memcpy(&x, a + n, 8);
+        memcpy(&y, b + n, 8);
+        if (x != y) return n + (unsigned)__builtin_ctzll(x ^ y) / 8;
+        n += 8;
+    }
+#endif
+    while (n < max && a[n] == b[n]) n++;
+    return n;
+}
+
+// Longest match for pos longer than `best` along the chain from cand;
+// 0 if none
+static unsigned longest_match(PhenoDeflate* d, int32_t pos, int32_t cand, unsigned max_len,
+                              unsigned best, unsigned* dist) {
+    const uint8_t* cur = d->base + pos;
+    int32_t limit = pos > PHENO_DEFLATE_WINDOW ? pos - PHENO_DEFLATE_WINDOW : 0;
+    unsigned chain = d->config.chain;
+    unsigned found = 0;
+    if (best >= d->config.good) chain >>= 2;
+    if (best < MIN_MATCH - 1) best = MIN_MATCH - 1;
+    if (best >= max_len) return 0;
+    
+    while (cand >= limit && chain--) {
+        const uint8_t* m = d->base + cand;
+        if (m[best] == cur[best] && m[0] == cur[0] && m[1] == cur[1]) {
+            unsigned len = common_length(m, cur, max_len);
+            if (len > best) {
+                best = found = len;
+                *dist = (unsigned)(pos - cand);
+                if (len >= d->config.nice || len >= max_len) break;
+            }
+        }
+        int32_t next = d->prev[cand & WINDOW_MASK];
+        if (next >= cand) break;        // Slot reused by a newer position
+        cand = next;
+    }
+    return found;
+}
+
+static void compress_greedy(PhenoDeflate* d, size_t pos, size_t end) {
+    while (pos < end) {
+        size_t avail = end - pos;
+        unsigned len = 0, dist = 0;
+        if (avail >= MIN_MATCH) {
+            int32_t cand = insert_string(d, (int32_t)pos);
+            unsigned max_len = avail < MAX_MATCH ? (unsigned)avail : MAX_MATCH;
+            if (cand >= 0) len = longest_match(d, (int32_t)pos, cand, max_len, 0, &dist);
+        }
+        if (len < MIN_MATCH) {
+            record_literal(d, d->base[pos++]);
+            continue;
+        }
+        record_match(d, len, dist);
+        for (size_t k = pos + 1; k < pos + len && k + MIN_MATCH <= end; k++) {
+            insert_string(d, (int32_t)k);
+        }
+        pos += len;
+    }
+}
+
+// Defer each match by one byte in case the next position matches longer
+static void compress_lazy(PhenoDeflate* d, size_t pos, size_t end) {
+    unsigned prev_len = 0, prev_dist = 0;
+    bool pending = false;               // Literal at pos - 1 not yet recorded
+    
+    while (pos < end) {
+        size_t avail = end - pos;
+        unsigned len = 0, dist = 0;
+        if (avail >= MIN_MATCH) {
+            int32_t cand = insert_string(d, (int32_t)pos);
+            unsigned max_len = avail < MAX_MATCH ? (unsigned)avail : MAX_MATCH;
+            if (cand >= 0 && prev_len < d->config.lazy) {
+                len = longest_match(d, (int32_t)pos, cand, max_len, prev_len, &dist);
+            }
+        }
+    
+        if (prev_len >= MIN_MATCH && len <= prev_len) {
+            record_match(d, prev_len, prev_dist);
+            size_t match_end = pos - 1 + prev_len;
+            for (size_t k = pos + 1; k < match_end && k + MIN_MATCH <= end; k++) {
+                insert_string(d, (int32_t)k);
+            }
+            pos = match_end;
+            prev_len = 0;
+            pending = false;
+        } else {
+            if (pending) record_literal(d, d->base[pos - 1]);
+            pending = true;
+            prev_len = len;
+            prev_dist = dist;
+            pos++;
+        }
+    }
+    if (pending) record_literal(d, d->base[pos - 1]);
+}
+
+// ---- Public API ----
+
+PhenoDeflate* pheno_deflate_create(int level) {
+    pthread_once(&g_tables_once, deflate_init_tables);
+    
+    PhenoDeflate* d = (PhenoDeflate*)calloc(1, sizeof(PhenoDeflate));
+    if (!d) return NULL;
+    if (level < 0) level = 0;
+    if (level > 9) level = 9;
+    d->level = level;
+    d->config = g_levels[level];
+    return d;
+}
+
+void pheno_deflate_free(PhenoDeflate* d) {
+    free(d);
+}
+
+void pheno_deflate_chunk(PhenoDeflate* d, const uint8_t* data, size_t history, size_t len,
+                         PhenoWriter* out) {
+    static PhenoPerfProbe probe = PHENO_PERF_PROBE_INIT("deflate_chunk");
+    PhenoPerfMark mark;
+    pheno_perf_probe_begin(&mark);
+    if (history > PHENO_DEFLATE_WINDOW) history = PHENO_DEFLATE_WINDOW;
+    d->out = out;
+    d->bits = 0;
+    d->bit_count = 0;
+    
+    if (d->level == 0) {
+        if (len) write_stored(d, data, len);
+    } else {
+        d->base = data - history;
+        d->block_start = d->block_end = history;
+        d->symbols = 0;
+        memset(d->litlen_freq, 0, sizeof(d->litlen_freq));
+        memset(d->dist_freq, 0, sizeof(d->dist_freq));
+        memset(d->head, 0xFF, sizeof(d->head));
+    
+        size_t end = history + len;
+        for (size_t k = 0; k < history && k + MIN_MATCH <= end; k++) {
+            insert_string(d, (int32_t)k);
+        }
+        if (d->config.lazy) compress_lazy(d, history, end);
+        else compress_greedy(d, history, end);
+        flush_block(d);
+    }
+    
+    // Empty stored block: ends the chunk on a byte boundary
+    write_stored(d, NULL, 0);
+    pheno_perf_probe_end(&probe, &mark);
+}
+
+void pheno_deflate_finish(PhenoWriter* out) {
+    // Final fixed-code block holding only the end-of-block code
+    static const uint8_t last_block[2] = { 0x03, 0x00 };
+    pheno_writer_put(out, last_block, sizeof(last_block));
+}
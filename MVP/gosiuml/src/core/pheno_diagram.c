@@ -0,0 +1,373 @@
+#include <stdlib.h>
+#include <string.h>
+#include "pheno_diagram.h"
+#include "pheno_id_map.h"
+#include "pheno_join.h"
+#include "svg_generator.h"
+
+typedef struct {
+    char* svg;
+    uint32_t len;
+} DiagramFragment;
+
+typedef struct {
+    uint32_t flags;             // Flag word the node fragment shows
+    uint32_t relations;         // Bumped on every link/unlink from this node
+    uint32_t drawn_relations;   // Relation version the edge fragment shows
+    bool redraw;                // Definition changed since the node was rendered
+    bool queued;
+    uint32_t* out;              // Destination indices
+    uint32_t out_count;
+    uint32_t out_capacity;
+    DiagramFragment node;
+    DiagramFragment edges;      // Empty until the node has had a relation
+} DiagramNode;
+
+struct PhenoDiagram {
+    const PhenoToken* tokens;
+    size_t count;
+    DiagramNode* nodes;
+    SvgSlot* slots;
+    uint32_t width;
+    uint32_t height;
+    PhenoIdMap ids;             // token_id -> index (first occurrence)
+    uint32_t* dirty;            // Queued node indices, each at most once
+    size_t dirty_count;
+    uint32_t seq;
+    PhenoWriter scratch;        // Fragment being rendered
+};
+
+// Fill and stroke per PhenoState, matching the template's state classes
+static const char* const g_state_class[] = {
+    "nil", "allocated", "locked", "active", "degraded", "shared", "freed"
+};
+static const char* const g_state_style[] = {
+    "fill=\"#eeeeee\" stroke=\"#9E9E9E\"",
+    "fill=\"#e8f4f8\" stroke=\"#2196F3\"",
+    "fill=\"#bbdefb\" stroke=\"#1565C0\"",
+    "fill=\"#c8e6c9\" stroke=\"#4CAF50\"",
+    "fill=\"#ffccbc\" stroke=\"#FF5722\"",
+    "fill=\"#e1bee7\" stroke=\"#9C27B0\"",
+    "fill=\"#f5f5f5\" stroke=\"#BDBDBD\" stroke-dasharray=\"4 2\""
+};
+
+static bool diagram_keep(PhenoDiagram* d, DiagramFragment* frag) {
+    PhenoWriter* w = &d->scratch;
+    if (w->failed) return false;
+    char* svg = (char*)realloc(frag->svg, w->used ? w->used : 1);
+    if (!svg) return false;
+    memcpy(svg, w->buf, w->used);
+    frag->svg = svg;
+    frag->len = (uint32_t)w->used;
+    return true;
+}
+
+static bool diagram_render_node(PhenoDiagram* d, uint32_t index, uint32_t flags) {
+    const PhenoToken* token = &d->tokens[index];
+    SvgSlot slot = d->slots[index];
+    PhenoState state = pheno_token_state(token);
+    if ((unsigned)state > STATE_FREED) state = STATE_NIL;
+    uint32_t center = slot.x + SVG_NODE_WIDTH / 2;
+    
+    PhenoWriter* w = &d->scratch;
+    w->used = 0;
+    pheno_writer_lit(w, "    <g id=\"tok-");
+    pheno_writer_u32(w, index);
+    pheno_writer_lit(w, "\" class=\"token state-");
+    pheno_writer_str(w, g_state_class[state]);
+    pheno_writer_lit(w, "\">\n      <rect x=\"");
+    pheno_writer_u32(w, slot.x);
+    pheno_writer_lit(w, "\" y=\"");
+    pheno_writer_u32(w, slot.y);
+    pheno_writer_lit(w, "\" width=\"");
+    pheno_writer_u32(w, SVG_NODE_WIDTH);
+    pheno_writer_lit(w, "\" height=\"");
+    pheno_writer_u32(w, SVG_NODE_HEIGHT);
+    pheno_writer_lit(w, "\" ");
+    pheno_writer_str(w, g_state_style[state]);
+    pheno_writer_lit(w, " stroke-width=\"2\" rx=\"5\"/>\n");
+    
+    pheno_writer_lit(w, "      <text x=\"");
+    pheno_writer_u32(w, center);
+    pheno_writer_lit(w, "\" y=\"");
+    pheno_writer_u32(w, slot.y + 25);
+    pheno_writer_lit(w, "\" text-anchor=\"middle\" font-family=\"monospace\" "
+                        "font-size=\"14\" font-weight=\"bold\">");
+    size_t type_len;
+    const char* type = pheno_token_type(token, &type_len);
+    pheno_writer_xml_text(w, type, type_len);
+    pheno_writer_lit(w, "</text>\n");
+    
+    pheno_writer_lit(w, "      <text x=\"");
+    pheno_writer_u32(w, center);
+    pheno_writer_lit(w, "\" y=\"");
+    pheno_writer_u32(w, slot.y + 45);
+    pheno_writer_lit(w, "\" text-anchor=\"middle\" font-family=\"monospace\" "
+                        "font-size=\"12\">ID: 0x");
+    pheno_writer_hex32(w, token->token_id);
+    pheno_writer_lit(w, "</text>\n");
+    
+    // State and flag word
+    pheno_writer_lit(w, "      <text x=\"");
+    pheno_writer_u32(w, center);
+    pheno_writer_lit(w, "\" y=\"");
+    pheno_writer_u32(w, slot.y + 70);
+    pheno_writer_lit(w, "\" text-anchor=\"middle\" font-family=\"monospace\" "
+                        "font-size=\"11\">");
+    pheno_writer_str(w, get_state_name(state));
+    pheno_writer_lit(w, " 0x");
+    pheno_writer_hex32(w, flags);
+    pheno_writer_lit(w, "</text>\n    </g>\n");
+    
+    if (!diagram_keep(d, &d->nodes[index].node)) return false;
+    d->nodes[index].flags = flags;
+    d->nodes[index].redraw = false;
+    return true;
+}
+
+static bool diagram_render_edges(PhenoDiagram* d, uint32_t index) {
+    DiagramNode* node = &d->nodes[index];
+    PhenoWriter* w = &d->scratch;
+    w->used = 0;
+    pheno_writer_lit(w, "    <g id=\"rel-");
+    pheno_writer_u32(w, index);
+    pheno_writer_lit(w, "\">\n");
+    for (uint32_t e = 0; e < node->out_count; e++) {
+        svg_edge(w, d->slots[index], d->slots[node->out[e]]);
+    }
+    pheno_writer_lit(w, "    </g>\n");
+    
+    if (!diagram_keep(d, &node->edges)) return false;
+    node->drawn_relations = node->relations;
+    return true;
+}
+
+static bool diagram_add_out(DiagramNode* node, uint32_t dst) {
+    if (node->out_count == node->out_capacity) {
+        uint32_t capacity = node->out_capacity ? node->out_capacity * 2 : 4;
+        uint32_t* out = (uint32_t*)realloc(node->out, capacity * sizeof(uint32_t));
+        if (!out) return false;
+        node->out = out;
+        node->out_capacity = capacity;
+    }
+    node->out[node->out_count++] = dst;
+    return true;
+}
+
+PhenoDiagram* pheno_diagram_create(const PhenoToken* tokens, size_t count,
+                                   const PhenoEdge* relations, size_t relation_count,
+                                   const PhenoLayoutOptions* options) {
+    if ((count && !tokens) || count > (size_t)INT32_MAX) return NULL;
+    PhenoDiagram* d = (PhenoDiagram*)calloc(1, sizeof(PhenoDiagram));
+    if (!d) return NULL;
+    d->tokens = tokens;
+    d->count = count;
+    
+    size_t slots = count ? count : 1;
+    d->nodes = (DiagramNode*)calloc(slots, sizeof(DiagramNode));
+    d->slots = (SvgSlot*)malloc(slots * sizeof(SvgSlot));
+    d->dirty = (uint32_t*)malloc(slots * sizeof(uint32_t));
+    if (!d->nodes || !d->slots || !d->dirty ||
+        !pheno_id_map_init(&d->ids, count) ||
+        !pheno_writer_memory(&d->scratch, 4096)) {
+        pheno_diagram_destroy(d);
+        return NULL;
+    }
+    for (size_t i = 0; i < count; i++) {
+        uint32_t existing;
+        if (tokens[i].token_id == PHENO_ID_MAP_EMPTY) continue;
+        if (pheno_id_map_insert(&d->ids, tokens[i].token_id, (uint32_t)i, &existing) < 0) {
+            pheno_diagram_destroy(d);
+            return NULL;
+        }
+    }
+    
+    PhenoEdgeTable edges = {0};
+    if (relation_count && !pheno_join_edges(tokens, count, relations, relation_count,
+                                            options ? options->threads : 0, &edges)) {
+        pheno_diagram_destroy(d);
+        return NULL;
+    }
+    svg_place_tokens((int)count, &edges, options, d->slots, &d->width, &d->height);
+    
+    bool ok = true;
+    for (size_t e = 0; ok && e < edges.count; e++) {
+        ok = diagram_add_out(&d->nodes[edges.edges[e].src_index], edges.edges[e].dst_index);
+    }
+    pheno_edge_table_free(&edges);
+    
+    for (size_t i = 0; ok && i < count; i++) {
+        ok = diagram_render_node(d, (uint32_t)i, atomic_load(&tokens[i].mem_flags.flags));
+        if (ok && d->nodes[i].out_count) ok = diagram_render_edges(d, (uint32_t)i);
+    }
+    if (!ok) {
+        pheno_diagram_destroy(d);
+        return NULL;
+    }
+    return d;
+}
+
+void pheno_diagram_destroy(PhenoDiagram* diagram) {
+    if (!diagram) return;
+    if (diagram->nodes) {
+        for (size_t i = 0; i < diagram->count; i++) {
+            free(diagram->nodes[i].out);
+            free(diagram->nodes[i].node.svg);
+            free(diagram->nodes[i].edges.svg);
+        }
+    }
+    free(diagram->nodes);
+    free(diagram->slots);
+    free(diagram->dirty);
+    pheno_id_map_free(&diagram->ids);
+    if (diagram->scratch.buf) pheno_writer_close(&diagram->scratch);
+    free(diagram);
+}
+
+void pheno_diagram_touch(PhenoDiagram* diagram, size_t index) {
+    if (index >= diagram->count || diagram->nodes[index].queued) return;
+    diagram->nodes[index].queued = true;
+    diagram->dirty[diagram->dirty_count++] = (uint32_t)index;
+}
+
+bool pheno_diagram_touch_id(PhenoDiagram* diagram, uint32_t token_id) {
+    uint32_t index;
+    if (!pheno_id_map_get(&diagram->ids, token_id, &index)) return false;
+    pheno_diagram_touch(diagram, index);
+    return true;
+}
+
+bool pheno_diagram_index(const PhenoDiagram* diagram, uint32_t token_id, size_t* index) {
+    uint32_t found;
+    if (!pheno_id_map_get(&diagram->ids, token_id, &found)) return false;
+    *index = found;
+    return true;
+}
+
+void pheno_diagram_redraw(PhenoDiagram* diagram, size_t index) {
+    if (index >= diagram->count) return;
+    diagram->nodes[index].redraw = true;
+    pheno_diagram_touch(diagram, index);
+}
+
+bool pheno_diagram_link(PhenoDiagram* diagram, uint32_t src_id, uint32_t dst_id) {
+    uint32_t src, dst;
+    if (!pheno_id_map_get(&diagram->ids, src_id, &src) ||
+        !pheno_id_map_get(&diagram->ids, dst_id, &dst) ||
+        !diagram_add_out(&diagram->nodes[src], dst)) {
+        return false;
+    }
+    diagram->nodes[src].relations++;
+    pheno_diagram_touch(diagram, src);
+    return true;
+}
+
+bool pheno_diagram_unlink(PhenoDiagram* diagram, uint32_t src_id, uint32_t dst_id) {
+    uint32_t src, dst;
+    if (!pheno_id_map_get(&diagram->ids, src_id, &src) ||
+        !pheno_id_map_get(&diagram->ids, dst_id, &dst)) {
+        return false;
+    }
+    DiagramNode* node = &diagram->nodes[src];
+    for (uint32_t e = 0; e < node->out_count; e++) {
+        if (node->out[e] != dst) continue;
+        // Keep relation order so the redrawn group matches a fresh render
+        memmove(&node->out[e], &node->out[e + 1], (node->out_count - e - 1) * sizeof(uint32_t));
+        node->out_count--;
+        node->relations++;
+        pheno_diagram_touch(diagram, src);
+        return true;
+    }
+    return false;
+}
+
+size_t pheno_diagram_scan(PhenoDiagram* diagram) {
+    size_t marked = 0;
+    for (size_t i = 0; i < diagram->count; i++) {
+        if (atomic_load(&diagram->tokens[i].mem_flags.flags) != diagram->nodes[i].flags) {
+            pheno_diagram_touch(diagram, i);
+            marked++;
+        }
+    }
+    return marked;
+}
+
+// Re-render one queued node; *node_changed / *edges_changed report which
+// of its fragments were replaced. False if a stale fragment could not be
+// rendered: the node then stays queued for the next pass.
+static bool diagram_refresh(PhenoDiagram* d, uint32_t index, bool* node_changed, bool* edges_changed) {
+    DiagramNode* node = &d->nodes[index];
+    uint32_t flags = atomic_load(&d->tokens[index].mem_flags.flags);
+    bool node_stale = flags != node->flags || node->redraw;
+    bool edges_stale = node->relations != node->drawn_relations;
+    *node_changed = node_stale && diagram_render_node(d, index, flags);
+    *edges_changed = edges_stale && diagram_render_edges(d, index);
+    node->queued = (node_stale && !*node_changed) || (edges_stale && !*edges_changed);
+    return !node->queued;
+}
+
+bool pheno_diagram_write_svg(PhenoDiagram* diagram, PhenoWriter* out) {
+    bool ok = true;
+    size_t kept = 0;
+    for (size_t q = 0; q < diagram->dirty_count; q++) {
+        bool node_changed, edges_changed;
+        if (!diagram_refresh(diagram, diagram->dirty[q], &node_changed, &edges_changed)) {
+            diagram->dirty[kept++] = diagram->dirty[q];
+            ok = false;
+        }
+    }
+    diagram->dirty_count = kept;
+    
+    svg_header(out, diagram->width, diagram->height);
+    pheno_writer_lit(out, "  <g id=\"gosiuml-edges\">\n");
+    for (size_t i = 0; i < diagram->count; i++) {
+        pheno_writer_put(out, diagram->nodes[i].edges.svg, diagram->nodes[i].edges.len);
+    }
+    pheno_writer_lit(out, "  </g>\n  <g id=\"gosiuml-nodes\">\n");
+    for (size_t i = 0; i < diagram->count; i++) {
+        pheno_writer_put(out, diagram->nodes[i].node.svg, diagram->nodes[i].node.len);
+    }
+    pheno_writer_lit(out, "  </g>\n</svg>\n");
+    return ok && !out->failed;
+}
+
+static void diagram_upsert(PhenoWriter* out, size_t written, const char* prefix, uint32_t index,
+                           const char* layer, const DiagramFragment* frag) {
+    if (written) pheno_writer_lit(out, ",");
+    pheno_writer_lit(out, "{\"id\":\"");
+    pheno_writer_str(out, prefix);
+    pheno_writer_u32(out, index);
+    pheno_writer_lit(out, "\",\"layer\":\"");
+    pheno_writer_str(out, layer);
+    pheno_writer_lit(out, "\",\"svg\":");
+    pheno_writer_json_string(out, frag->svg, frag->len);
+    pheno_writer_lit(out, "}");
+}
+
+size_t pheno_diagram_patch(PhenoDiagram* diagram, PhenoWriter* out) {
+    size_t written = 0;
+    size_t kept = 0;
+    for (size_t q = 0; q < diagram->dirty_count; q++) {
+        uint32_t index = diagram->dirty[q];
+        bool node_changed, edges_changed;
+        if (!diagram_refresh(diagram, index, &node_changed, &edges_changed)) {
+            diagram->dirty[kept++] = index;     // Retried by the next patch
+        }
+        if (!node_changed && !edges_changed) continue;
+    
+        if (!written) {
+            pheno_writer_lit(out, "{\"seq\":");
+            pheno_writer_u32(out, ++diagram->seq);
+            pheno_writer_lit(out, ",\"upsert\":[");
+        }
+        if (node_changed) {
+            diagram_upsert(out, written++, "tok-", index, "nodes", &diagram->nodes[index].node);
+        }
+        if (edges_changed) {
+            diagram_upsert(out, written++, "rel-", index, "edges", &diagram->nodes[index].edges);
+        }
+    }
+    diagram->dirty_count = kept;
+    if (written) pheno_writer_lit(out, "]}\n");
+    return written;
+}
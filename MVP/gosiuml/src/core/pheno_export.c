@@ -0,0 +1,307 @@
+#include <stdio.h>
+#include <string.h>
+#include "pheno_export.h"
+#include "pheno_perf.h"
+
+#define EXPORT_VERSION "1.0.0"
+
+// Flag names by bit position (FLAG_*_BIT)
+static const char* const g_flag_names[] = {
+    "NIL", "ALLOCATED", "LOCKED", "DIRTY", "COHERENT", "PROCESSING", "SHARED"
+};
+#define EXPORT_FLAG_COUNT (sizeof(g_flag_names) / sizeof(g_flag_names[0]))
+
+static size_t rel_type_length(const PhenoEdge* edge) {
+    return strnlen(edge->rel_type, sizeof(edge->rel_type));
+}
+
+// ---- Sections ----
+
+static void section_open(PhenoExporter* ex, PhenoExportSection section) {
+    PhenoWriter* w = ex->out;
+    bool tokens = section == EXPORT_SECTION_TOKENS;
+    
+    if (ex->format == FORMAT_XML) {
+        if (tokens) pheno_writer_lit(w, "  <tokens>\n");
+        else pheno_writer_lit(w, "  <relations>\n");
+    } else if (ex->format == FORMAT_JSON) {
+        if (tokens) pheno_writer_lit(w, "\"tokens\":[");
+        else pheno_writer_lit(w, ",\"relations\":[");
+    }
+}
+
+static void section_close(PhenoExporter* ex, PhenoExportSection section) {
+    PhenoWriter* w = ex->out;
+    
+    if (ex->format == FORMAT_XML) {
+        if (section == EXPORT_SECTION_TOKENS) pheno_writer_lit(w, "  </tokens>\n");
+        else pheno_writer_lit(w, "  </relations>\n");
+    } else if (ex->format == FORMAT_JSON) {
+        pheno_writer_lit(w, "\n]");
+    }
+}
+
+// Move forward to the given section, opening and closing the ones in
+// between so both sections are always present in document formats
+static bool section_enter(PhenoExporter* ex, PhenoExportSection section) {
+    if (ex->format == FORMAT_NDJSON) return true;
+    if (ex->section > section) return false;
+    
+    while (ex->section < section) {
+        if (ex->section != EXPORT_SECTION_NONE) section_close(ex, ex->section);
+        ex->section++;
+        section_open(ex, ex->section);
+    }
+    return true;
+}
+
+// Separator before the next record of a JSON array or NDJSON stream
+static void json_record_start(PhenoExporter* ex, size_t index) {
+    if (ex->format == FORMAT_NDJSON) return;
+    if (index) pheno_writer_lit(ex->out, ",\n");
+    else pheno_writer_lit(ex->out, "\n");
+}
+
+// ---- Records ----
+
+static void xml_token(PhenoWriter* w, const PhenoToken* token, uint32_t flags) {
+    pheno_writer_lit(w, "    <token id=\"0x");
+    pheno_writer_hex32(w, token->token_id);
+    pheno_writer_lit(w, "\" type=\"");
+    size_t type_len;
+    const char* type = pheno_token_type(token, &type_len);
+    pheno_writer_xml_text(w, type, type_len);
+    pheno_writer_lit(w, "\" zone=\"");
+    pheno_writer_u32(w, token->memory_zone);
+    pheno_writer_lit(w, "\" state=\"");
+    pheno_writer_str(w, get_state_name(pheno_token_state(token)));
+    pheno_writer_lit(w, "\" flags=\"0x");
+    pheno_writer_hex32(w, flags);
+    pheno_writer_lit(w, "\" flag_names=\"");
+    bool first = true;
+    for (size_t bit = 0; bit < EXPORT_FLAG_COUNT; bit++) {
+        if (!(flags & (1U << bit))) continue;
+        if (!first) pheno_writer_lit(w, " ");
+        pheno_writer_str(w, g_flag_names[bit]);
+        first = false;
+    }
+    pheno_writer_lit(w, "\" ref_count=\"");
+    pheno_writer_u32(w, atomic_load(&token->mem_flags.ref_count));
+    pheno_writer_lit(w, "\" degradation=\"");
+    pheno_writer_u32(w, atomic_load(&token->mem_flags.degradation_metrics));
+    pheno_writer_lit(w, "\"/>\n");
+}
+
+static void json_token(PhenoWriter* w, const PhenoToken* token, uint32_t flags) {
+    pheno_writer_lit(w, "\"id\":\"0x");
+    pheno_writer_hex32(w, token->token_id);
+    pheno_writer_lit(w, "\",\"type\":");
+    size_t type_len;
+    const char* type = pheno_token_type(token, &type_len);
+    pheno_writer_json_string(w, type, type_len);
+    pheno_writer_lit(w, ",\"zone\":");
+    pheno_writer_u32(w, token->memory_zone);
+    pheno_writer_lit(w, ",\"state\":\"");
+    pheno_writer_str(w, get_state_name(pheno_token_state(token)));
+    pheno_writer_lit(w, "\",\"flags\":");
+    pheno_writer_u32(w, flags);
+    pheno_writer_lit(w, ",\"flag_names\":[");
+    bool first = true;
+    for (size_t bit = 0; bit < EXPORT_FLAG_COUNT; bit++) {
+        if (!(flags & (1U << bit))) continue;
+        if (!first) pheno_writer_lit(w, ",");
+        pheno_writer_lit(w, "\"");
+        pheno_writer_str(w, g_flag_names[bit]);
+        pheno_writer_lit(w, "\"");
+        first = false;
+    }
+    pheno_writer_lit(w, "],\"ref_count\":");
+    pheno_writer_u32(w, atomic_load(&token->mem_flags.ref_count));
+    pheno_writer_lit(w, ",\"degradation\":");
+    pheno_writer_u32(w, atomic_load(&token->mem_flags.degradation_metrics));
+    pheno_writer_lit(w, "}");
+}
+
+static void xml_relation(PhenoWriter* w, const PhenoEdge* edge) {
+    pheno_writer_lit(w, "    <relation src=\"0x");
+    pheno_writer_hex32(w, edge->src_id);
+    pheno_writer_lit(w, "\" dst=\"0x");
+    pheno_writer_hex32(w, edge->dst_id);
+    pheno_writer_lit(w, "\" type=\"");
+    pheno_writer_xml_text(w, edge->rel_type, rel_type_length(edge));
+    pheno_writer_lit(w, "\"/>\n");
+}
+
+static void json_relation(PhenoWriter* w, const PhenoEdge* edge) {
+    pheno_writer_lit(w, "\"src\":\"0x");
+    pheno_writer_hex32(w, edge->src_id);
+    pheno_writer_lit(w, "\",\"dst\":\"0x");
+    pheno_writer_hex32(w, edge->dst_id);
+    pheno_writer_lit(w, "\",\"type\":");
+    pheno_writer_json_string(w, edge->rel_type, rel_type_length(edge));
+    pheno_writer_lit(w, "}");
+}
+
+// ---- Events ----
+
+bool pheno_export_begin(PhenoExporter* ex, PhenoWriter* out, GosiUMLFormat format) {
+    if (format != FORMAT_XML && format != FORMAT_JSON && format != FORMAT_NDJSON) return false;
+    
+    ex->out = out;
+    ex->format = format;
+    ex->section = EXPORT_SECTION_NONE;
+    ex->tokens = 0;
+    ex->relations = 0;
+    
+    if (format == FORMAT_XML) {
+        pheno_writer_lit(out, "<?xml version=\"1.0\" encoding=\"UTF-8\"?>\n"
+                              "<gosiuml version=\"" EXPORT_VERSION "\">\n");
+    } else if (format == FORMAT_JSON) {
+        pheno_writer_lit(out, "{\"version\":\"" EXPORT_VERSION "\",");
+    }
+    return true;
+}
+
+bool pheno_export_token(PhenoExporter* ex, const PhenoToken* token) {
+    if (!section_enter(ex, EXPORT_SECTION_TOKENS)) return false;
+    
+    uint32_t flags = atomic_load(&token->mem_flags.flags);
+    if (ex->format == FORMAT_XML) {
+        xml_token(ex->out, token, flags);
+    } else {
+        json_record_start(ex, ex->tokens);
+        if (ex->format == FORMAT_NDJSON) pheno_writer_lit(ex->out, "{\"kind\":\"token\",");
+        else pheno_writer_lit(ex->out, "{");
+        json_token(ex->out, token, flags);
+        if (ex->format == FORMAT_NDJSON) pheno_writer_lit(ex->out, "\n");
+    }
+    ex->tokens++;
+    return true;
+}
+
+bool pheno_export_relation(PhenoExporter* ex, const PhenoEdge* edge) {
+    if (!section_enter(ex, EXPORT_SECTION_RELATIONS)) return false;
+    
+    if (ex->format == FORMAT_XML) {
+        xml_relation(ex->out, edge);
+    } else {
+        json_record_start(ex, ex->relations);
+        if (ex->format == FORMAT_NDJSON) pheno_writer_lit(ex->out, "{\"kind\":\"relation\",");
+        else pheno_writer_lit(ex->out, "{");
+        json_relation(ex->out, edge);
+        if (ex->format == FORMAT_NDJSON) pheno_writer_lit(ex->out, "\n");
+    }
+    ex->relations++;
+    return true;
+}
+
+void pheno_export_end(PhenoExporter* ex) {
+    if (ex->format == FORMAT_NDJSON) return;
+    
+    section_enter(ex, EXPORT_SECTION_RELATIONS);
+    section_close(ex, EXPORT_SECTION_RELATIONS);
+    if (ex->format == FORMAT_XML) pheno_writer_lit(ex->out, "</gosiuml>\n");
+    else pheno_writer_lit(ex->out, "}\n");
+}
+
+// Ranges for pheno_writer_parallel: each range runs on a private copy of
+// the exporter whose record counter starts at the range, so separators
+// come out exactly as in a serial export
+typedef struct {
+    const PhenoExporter* ex;
+    const PhenoToken* tokens;
+    const PhenoEdge* relations;
+} ExportRange;
+
+static void export_token_range(PhenoWriter* out, size_t begin, size_t end, void* user) {
+    const ExportRange* range = (const ExportRange*)user;
+    PhenoExporter local = *range->ex;
+    local.out = out;
+    local.tokens += begin;
+    for (size_t i = begin; i < end; i++) {
+        pheno_export_token(&local, &range->tokens[i]);
+    }
+}
+
+static void export_relation_range(PhenoWriter* out, size_t begin, size_t end, void* user) {
+    const ExportRange* range = (const ExportRange*)user;
+    PhenoExporter local = *range->ex;
+    local.out = out;
+    local.relations += begin;
+    for (size_t r = begin; r < end; r++) {
+        pheno_export_relation(&local, &range->relations[r]);
+    }
+}
+
+bool pheno_export_set(PhenoExporter* ex, const PhenoToken* tokens, size_t count,
+                      const PhenoEdge* relations, size_t relation_count, int threads) {
+    ExportRange range = { ex, tokens, relations };
+    
+    if (count) {
+        if (!section_enter(ex, EXPORT_SECTION_TOKENS)) return false;
+        pheno_writer_parallel(ex->out, count, export_token_range, &range, threads);
+        ex->tokens += count;
+    }
+    if (relations && relation_count) {
+        section_enter(ex, EXPORT_SECTION_RELATIONS);
+        pheno_writer_parallel(ex->out, relation_count, export_relation_range, &range, threads);
+        ex->relations += relation_count;
+    }
+    return true;
+}
+
+bool pheno_export_tokens(PhenoWriter* w, GosiUMLFormat format, PhenoToken* tokens, size_t count) {
+    static PhenoPerfProbe probe = PHENO_PERF_PROBE_INIT("export");
+    PhenoExporter ex;
+    if (!pheno_export_begin(&ex, w, format)) return false;
+    
+    PhenoPerfMark mark;
+    pheno_perf_probe_begin(&mark);
+    size_t relation_count = 0;
+    const PhenoEdge* relations = count ? gosiuml_token_relations(tokens, &relation_count) : NULL;
+    pheno_export_set(&ex, tokens, count, relations, relation_count, 0);
+    pheno_export_end(&ex);
+    pheno_perf_probe_end(&probe, &mark);
+    return !w->failed;
+}
+
+// ---- Public API ----
+
+// Export a token array (and its relations, for parsed sets), then close w
+static int export_tokens(PhenoWriter* w, GosiUMLFormat format, PhenoToken* tokens, int count) {
+    bool ok = pheno_export_tokens(w, format, tokens, (size_t)count);
+    return pheno_writer_close(w) && ok ? 0 : -1;
+}
+
+static int export_file(GosiUMLFormat format, PhenoToken* tokens, int count, const char* output_file) {
+    if (count < 0 || (count > 0 && !tokens)) return -1;
+    
+    PhenoWriter w;
+    if (!pheno_writer_open(&w, output_file)) {
+        perror("Failed to create export file");
+        return -1;
+    }
+    if (export_tokens(&w, format, tokens, count) != 0) {
+        fprintf(stderr, "Failed to write export file: %s\n", output_file);
+        return -1;
+    }
+    return 0;
+}
+
+int gosiuml_export_fd(int fd, GosiUMLFormat format, PhenoToken* tokens, int count) {
+    if (count < 0 || (count > 0 && !tokens)) return -1;
+    
+    PhenoWriter w;
+    if (!pheno_writer_attach(&w, fd)) return -1;
+    return export_tokens(&w, format, tokens, count);
+}
+
+int gosiuml_generate_xml(GosiUMLContext* ctx, PhenoToken* tokens, int count, const char* output_file) {
+    (void)ctx;
+    return export_file(FORMAT_XML, tokens, count, output_file);
+}
+
+int gosiuml_generate_json(GosiUMLContext* ctx, PhenoToken* tokens, int count, const char* output_file) {
+    (void)ctx;
+    return export_file(FORMAT_JSON, tokens, count, output_file);
+}
@@ -0,0 +1,379 @@
+#include <stdlib.h>
+#include <string.h>
+#include "pheno_hamming.h"
+
+// Baseline x86-64 has neither SSSE3 nor popcnt: the vector scans are
+// compiled for them explicitly and chosen at run time
+#if defined(__x86_64__) || defined(__i386__)
+#include <tmmintrin.h>
+#define HAMMING_SIMD 1
+#define HAMMING_SIMD_TARGET __attribute__((target("ssse3,popcnt")))
+#endif
+
+#define MIH_CHUNKS 8
+#define MIH_BUCKETS 65536
+#define MIH_MAX_ROUND 3           // Probes C(16, s) buckets per chunk in round s
+#define MIH_SCAN_THRESHOLD 4096   // Smaller sets are scanned directly
+
+struct PhenoHammingIndex {
+    PhenoRelation* codes;                // Private copy of the indexed codes
+    size_t count;
+    uint32_t* offsets[MIH_CHUNKS];       // MIH_BUCKETS + 1 bucket starts
+    uint32_t* ids[MIH_CHUNKS];           // count ids per chunk, grouped by bucket
+};
+
+// ---------------------------------------------------------------------
+// Distance kernels
+// ---------------------------------------------------------------------
+
+static inline void code_words(const PhenoRelation* rel, uint64_t words[2]) {
+    memcpy(words, rel, sizeof(uint64_t) * 2);
+}
+
+static inline uint16_t code_chunk(const uint64_t words[2], int chunk) {
+    return (uint16_t)(words[chunk >> 2] >> ((chunk & 3) * 16));
+}
+
+static inline uint32_t code_distance(const PhenoRelation* a, const PhenoRelation* b) {
+    uint64_t wa[2], wb[2];
+    code_words(a, wa);
+    code_words(b, wb);
+    return (uint32_t)(__builtin_popcountll(wa[0] ^ wb[0]) +
+                      __builtin_popcountll(wa[1] ^ wb[1]));
+}
+
+#ifdef HAMMING_SIMD
+static bool hamming_simd(void) {
+    return __builtin_cpu_supports("ssse3") && __builtin_cpu_supports("popcnt");
+}
+
+// XOR, nibble-LUT popcount per byte, then horizontal byte sum via SAD
+static inline HAMMING_SIMD_TARGET uint32_t code_distance_simd(const PhenoRelation* a,
+                                                              const PhenoRelation* b) {
+    const __m128i nibble_lut = _mm_setr_epi8(0, 1, 1, 2, 1, 2, 2, 3,
+                                             1, 2, 2, 3, 2, 3, 3, 4);
+    const __m128i low_mask = _mm_set1_epi8(0x0F);
+    
+    __m128i x = _mm_xor_si128(_mm_loadu_si128((const __m128i*)a),
+                              _mm_loadu_si128((const __m128i*)b));
+    __m128i cnt = _mm_add_epi8(
+        _mm_shuffle_epi8(nibble_lut, _mm_and_si128(x, low_mask)),
+        _mm_shuffle_epi8(nibble_lut, _mm_and_si128(_mm_srli_epi16(x, 4), low_mask)));
+    __m128i sum = _mm_sad_epu8(cnt, _mm_setzero_si128());
+    return (uint32_t)(_mm_cvtsi128_si32(sum) + _mm_extract_epi16(sum, 4));
+}
+#endif
+
+uint32_t relation_hamming_distance(const PhenoRelation* a, const PhenoRelation* b) {
+#ifdef HAMMING_SIMD
+    if (hamming_simd()) return code_distance_simd(a, b);
+#endif
+    return code_distance(a, b);
+}
+
+// ---------------------------------------------------------------------
+// Result ordering: bounded max-heap on (distance, index)
+// ---------------------------------------------------------------------
+
+static inline bool match_less(const PhenoHammingMatch* a, const PhenoHammingMatch* b) {
+    return a->distance < b->distance ||
+           (a->distance == b->distance && a->index < b->index);
+}
+
+static int match_compare(const void* pa, const void* pb) {
+    const PhenoHammingMatch* a = (const PhenoHammingMatch*)pa;
+    const PhenoHammingMatch* b = (const PhenoHammingMatch*)pb;
+    if (match_less(a, b)) return -1;
+    return match_less(b, a);
+}
+
+typedef struct {
+    PhenoHammingMatch* items;
+    size_t count;
+    size_t k;
+} MatchHeap;
+
+// Offer a match; keeps the k best with the worst at the root
+static void heap_offer(MatchHeap* heap, uint32_t index, uint32_t distance) {
+    PhenoHammingMatch m = { index, distance };
+    PhenoHammingMatch* h = heap->items;
+    
+    if (heap->count < heap->k) {
+        size_t i = heap->count++;
+        while (i > 0) {
+            size_t parent = (i - 1) / 2;
+            if (!match_less(&h[parent], &m)) break;
+            h[i] = h[parent];
+            i = parent;
+        }
+        h[i] = m;
+        return;
+    }
+    if (!match_less(&m, &h[0])) return;
+    
+    size_t i = 0;
+    for (;;) {
+        size_t child = 2 * i + 1;
+        if (child >= heap->count) break;
+        if (child + 1 < heap->count && match_less(&h[child], &h[child + 1])) child++;
+        if (!match_less(&m, &h[child])) break;
+        h[i] = h[child];
+        i = child;
+    }
+    h[i] = m;
+}
+
+// ---------------------------------------------------------------------
+// Brute-force scans
+// ---------------------------------------------------------------------
+
+static void knn_scan_codes(MatchHeap* heap, const PhenoRelation* rels, size_t count,
+                           const PhenoRelation* query) {
+    for (size_t i = 0; i < count; i++) {
+        heap_offer(heap, (uint32_t)i, code_distance(&rels[i], query));
+    }
+}
+
+#ifdef HAMMING_SIMD
+static HAMMING_SIMD_TARGET void knn_scan_codes_simd(MatchHeap* heap, const PhenoRelation* rels,
+                                                    size_t count, const PhenoRelation* query) {
+    for (size_t i = 0; i < count; i++) {
+        heap_offer(heap, (uint32_t)i, code_distance_simd(&rels[i], query));
+    }
+}
+#endif
+
+size_t relation_knn_scan(const PhenoRelation* rels, size_t count,
+                         const PhenoRelation* query, size_t k, PhenoHammingMatch* out) {
+    if (!rels || !query || !out || k == 0) return 0;
+    
+    MatchHeap heap = { out, 0, k };
+#ifdef HAMMING_SIMD
+    if (hamming_simd()) knn_scan_codes_simd(&heap, rels, count, query);
+    else
+#endif
+    knn_scan_codes(&heap, rels, count, query);
+    qsort(out, heap.count, sizeof(PhenoHammingMatch), match_compare);
+    return heap.count;
+}
+
+// ---------------------------------------------------------------------
+// Multi-index hashing
+// ---------------------------------------------------------------------
+
+PhenoHammingIndex* relation_hamming_index_create(const PhenoRelation* rels, size_t count) {
+    if ((!rels && count) || count > UINT32_MAX) return NULL;
+    
+    PhenoHammingIndex* index = (PhenoHammingIndex*)calloc(1, sizeof(PhenoHammingIndex));
+    if (!index) return NULL;
+    
+    index->count = count;
+    index->codes = (PhenoRelation*)malloc((count ? count : 1) * sizeof(PhenoRelation));
+    if (!index->codes) goto fail;
+    memcpy(index->codes, rels, count * sizeof(PhenoRelation));
+    
+    for (int c = 0; c < MIH_CHUNKS; c++) {
+        uint32_t* offsets = (uint32_t*)calloc(MIH_BUCKETS + 1, sizeof(uint32_t));
+        uint32_t* ids = (uint32_t*)malloc((count ? count : 1) * sizeof(uint32_t));
+        index->offsets[c] = offsets;
+        index->ids[c] = ids;
+        if (!offsets || !ids) goto fail;
+        
+        // Counting sort of ids by substring value
+        for (size_t i = 0; i < count; i++) {
+            uint64_t w[2];
+            code_words(&rels[i], w);
+            offsets[code_chunk(w, c) + 1]++;
+        }
+        for (int b = 0; b < MIH_BUCKETS; b++) {
+            offsets[b + 1] += offsets[b];
+        }
+        for (size_t i = 0; i < count; i++) {
+            uint64_t w[2];
+            code_words(&rels[i], w);
+            ids[offsets[code_chunk(w, c)]++] = (uint32_t)i;
+        }
+        // Fill pass advanced each start to the next bucket; shift back
+        memmove(&offsets[1], &offsets[0], MIH_BUCKETS * sizeof(uint32_t));
+        offsets[0] = 0;
+    }
+    return index;
+
+fail:
+    relation_hamming_index_destroy(index);
+    return NULL;
+}
+
+void relation_hamming_index_destroy(PhenoHammingIndex* index) {
+    if (!index) return;
+    
+    for (int c = 0; c < MIH_CHUNKS; c++) {
+        free(index->offsets[c]);
+        free(index->ids[c]);
+    }
+    free(index->codes);
+    free(index);
+}
+
+typedef void (*MihVisit)(void* state, uint32_t index, uint32_t distance);
+
+// Report every code whose closest substring to the query is exactly s
+// bits away. A code is reported once: from the first substring at that
+// distance, and only in round s. The chunk popcounts get a popcnt clone
+// picked by the loader on CPUs that have it.
+#ifdef HAMMING_SIMD
+__attribute__((target_clones("popcnt", "default")))
+#endif
+static void mih_round(const PhenoHammingIndex* index, const PhenoRelation* query,
+                      int s, MihVisit visit, void* state) {
+    uint64_t q[2];
+    code_words(query, q);
+    
+    for (int c = 0; c < MIH_CHUNKS; c++) {
+        uint16_t qc = code_chunk(q, c);
+        const uint32_t* offsets = index->offsets[c];
+        const uint32_t* ids = index->ids[c];
+        
+        // Gosper's hack: every 16-bit flip mask with exactly s bits set
+        uint32_t flip = (1u << s) - 1;
+        while (flip < MIH_BUCKETS) {
+            uint16_t bucket = qc ^ (uint16_t)flip;
+            for (uint32_t p = offsets[bucket]; p < offsets[bucket + 1]; p++) {
+                uint32_t id = ids[p];
+                uint64_t w[2];
+                code_words(&index->codes[id], w);
+                uint64_t x0 = w[0] ^ q[0], x1 = w[1] ^ q[1];
+                
+                bool owner = true;
+                for (int o = 0; o < MIH_CHUNKS && owner; o++) {
+                    uint64_t xo = o < 4 ? x0 : x1;
+                    int d = __builtin_popcount((uint32_t)((xo >> ((o & 3) * 16)) & 0xFFFF));
+                    owner = o < c ? d > s : d >= s;
+                }
+                if (owner) {
+                    visit(state, id, (uint32_t)(__builtin_popcountll(x0) + __builtin_popcountll(x1)));
+                }
+            }
+            if (s == 0) break;
+            uint32_t low = flip & -flip;
+            uint32_t ripple = flip + low;
+            flip = (((ripple ^ flip) >> 2) / low) | ripple;
+        }
+    }
+}
+
+static void knn_visit(void* state, uint32_t index, uint32_t distance) {
+    heap_offer((MatchHeap*)state, index, distance);
+}
+
+typedef struct {
+    PhenoHammingMatch* items;
+    size_t count;
+    size_t capacity;
+    uint32_t radius;
+    bool failed;
+} RadiusCollector;
+
+static void radius_visit(void* state, uint32_t index, uint32_t distance) {
+    RadiusCollector* rc = (RadiusCollector*)state;
+    if (distance > rc->radius || rc->failed) return;
+    
+    if (rc->count == rc->capacity) {
+        size_t capacity = rc->capacity ? rc->capacity * 2 : 64;
+        PhenoHammingMatch* grown = (PhenoHammingMatch*)realloc(rc->items, capacity * sizeof(PhenoHammingMatch));
+        if (!grown) {
+            rc->failed = true;
+            return;
+        }
+        rc->items = grown;
+        rc->capacity = capacity;
+    }
+    rc->items[rc->count].index = index;
+    rc->items[rc->count].distance = distance;
+    rc->count++;
+}
+
+// Sort collected matches and copy out the best max_out
+static size_t radius_finish(RadiusCollector* rc, PhenoHammingMatch* out, size_t max_out) {
+    qsort(rc->items, rc->count, sizeof(PhenoHammingMatch), match_compare);
+    if (out) {
+        memcpy(out, rc->items, (rc->count < max_out ? rc->count : max_out) * sizeof(PhenoHammingMatch));
+    }
+    free(rc->items);
+    return rc->count;
+}
+
+static void radius_scan_codes(RadiusCollector* rc, const PhenoRelation* rels, size_t count,
+                              const PhenoRelation* query) {
+    for (size_t i = 0; i < count; i++) {
+        radius_visit(rc, (uint32_t)i, code_distance(&rels[i], query));
+    }
+}
+
+#ifdef HAMMING_SIMD
+static HAMMING_SIMD_TARGET void radius_scan_codes_simd(RadiusCollector* rc, const PhenoRelation* rels,
+                                                       size_t count, const PhenoRelation* query) {
+    for (size_t i = 0; i < count; i++) {
+        radius_visit(rc, (uint32_t)i, code_distance_simd(&rels[i], query));
+    }
+}
+#endif
+
+size_t relation_radius_scan(const PhenoRelation* rels, size_t count,
+                            const PhenoRelation* query, uint32_t r,
+                            PhenoHammingMatch* out, size_t max_out) {
+    if (!rels || !query) return 0;
+    
+    RadiusCollector rc = { NULL, 0, 0, r, false };
+#ifdef HAMMING_SIMD
+    if (hamming_simd()) radius_scan_codes_simd(&rc, rels, count, query);
+    else
+#endif
+    radius_scan_codes(&rc, rels, count, query);
+    if (rc.failed) {
+        free(rc.items);
+        return 0;
+    }
+    return radius_finish(&rc, out, max_out);
+}
+
+size_t relation_knn(const PhenoHammingIndex* index, const PhenoRelation* query,
+                    size_t k, PhenoHammingMatch* out) {
+    if (!index || !query || !out || k == 0) return 0;
+    
+    if (index->count <= MIH_SCAN_THRESHOLD || k >= index->count) {
+        return relation_knn_scan(index->codes, index->count, query, k, out);
+    }
+    
+    // After round s every code within 8s+7 bits has been seen
+    MatchHeap heap = { out, 0, k };
+    for (int s = 0; s <= MIH_MAX_ROUND; s++) {
+        mih_round(index, query, s, knn_visit, &heap);
+        if (heap.count == k && heap.items[0].distance <= (uint32_t)(8 * s + 7)) {
+            qsort(out, heap.count, sizeof(PhenoHammingMatch), match_compare);
+            return heap.count;
+        }
+    }
+    return relation_knn_scan(index->codes, index->count, query, k, out);
+}
+
+size_t relation_radius(const PhenoHammingIndex* index, const PhenoRelation* query,
+                       uint32_t r, PhenoHammingMatch* out, size_t max_out) {
+    if (!index || !query) return 0;
+    
+    int rounds = (int)(r / MIH_CHUNKS);
+    if (index->count <= MIH_SCAN_THRESHOLD || rounds > MIH_MAX_ROUND) {
+        return relation_radius_scan(index->codes, index->count, query, r, out, max_out);
+    }
+    
+    RadiusCollector rc = { NULL, 0, 0, r, false };
+    for (int s = 0; s <= rounds; s++) {
+        mih_round(index, query, s, radius_visit, &rc);
+    }
+    if (rc.failed) {
+        free(rc.items);
+        return relation_radius_scan(index->codes, index->count, query, r, out, max_out);
+    }
+    
+    return radius_finish(&rc, out, max_out);
+}
@@ -0,0 +1,130 @@
+#include <stdlib.h>
+#include <string.h>
+#include "pheno_id_map.h"
+
+// Keep the load factor at or below 1/2
+static size_t capacity_for(size_t expected) {
+    size_t capacity = 16;
+    while (capacity < expected * 2) capacity <<= 1;
+    return capacity;
+}
+
+static bool map_alloc(PhenoIdMap* map, size_t capacity) {
+    map->keys = (uint32_t*)malloc(capacity * sizeof(uint32_t));
+    map->values = (uint32_t*)malloc(capacity * sizeof(uint32_t));
+    if (!map->keys || !map->values) {
+        free(map->keys);
+        free(map->values);
+        map->keys = map->values = NULL;
+        return false;
+    }
+    memset(map->keys, 0xFF, capacity * sizeof(uint32_t));
+    map->mask = capacity - 1;
+    map->count = 0;
+    return true;
+}
+
+bool pheno_id_map_init(PhenoIdMap* map, size_t expected) {
+    return map_alloc(map, capacity_for(expected));
+}
+
+void pheno_id_map_free(PhenoIdMap* map) {
+    if (!map) return;
+    
+    free(map->keys);
+    free(map->values);
+    map->keys = map->values = NULL;
+    map->count = 0;
+    map->mask = 0;
+}
+
+void pheno_id_map_clear(PhenoIdMap* map) {
+    memset(map->keys, 0xFF, (map->mask + 1) * sizeof(uint32_t));
+    map->count = 0;
+}
+
+// Slot holding key, or the empty slot where it would go
+static inline size_t map_probe(const PhenoIdMap* map, uint32_t key) {
+    size_t slot = pheno_id_hash(key) & map->mask;
+    while (map->keys[slot] != key && map->keys[slot] != PHENO_ID_MAP_EMPTY) {
+        slot = (slot + 1) & map->mask;
+    }
+    return slot;
+}
+
+static bool map_grow(PhenoIdMap* map) {
+    PhenoIdMap grown;
+    if (!map_alloc(&grown, (map->mask + 1) * 2)) return false;
+    
+    for (size_t i = 0; i <= map->mask; i++) {
+        if (map->keys[i] == PHENO_ID_MAP_EMPTY) continue;
+        size_t slot = map_probe(&grown, map->keys[i]);
+        grown.keys[slot] = map->keys[i];
+        grown.values[slot] = map->values[i];
+    }
+    grown.count = map->count;
+    
+    pheno_id_map_free(map);
+    *map = grown;
+    return true;
+}
+
+bool pheno_id_map_get(const PhenoIdMap* map, uint32_t key, uint32_t* value) {
+    if (key == PHENO_ID_MAP_EMPTY) return false;
+    
+    size_t slot = map_probe(map, key);
+    if (map->keys[slot] == PHENO_ID_MAP_EMPTY) return false;
+    if (value) *value = map->values[slot];
+    return true;
+}
+
+int pheno_id_map_insert(PhenoIdMap* map, uint32_t key, uint32_t value, uint32_t* existing) {
+    if (key == PHENO_ID_MAP_EMPTY) return -1;
+    
+    if ((map->count + 1) * 2 > map->mask + 1 && !map_grow(map)) return -1;
+    
+    size_t slot = map_probe(map, key);
+    if (map->keys[slot] == key) {
+        if (existing) *existing = map->values[slot];
+        return 0;
+    }
+    map->keys[slot] = key;
+    map->values[slot] = value;
+    map->count++;
+    if (existing) *existing = value;
+    return 1;
+}
+
+bool pheno_id_map_put(PhenoIdMap* map, uint32_t key, uint32_t value) {
+    uint32_t existing;
+    int rc = pheno_id_map_insert(map, key, value, &existing);
+    if (rc < 0) return false;
+    if (rc == 0) map->values[map_probe(map, key)] = value;
+    return true;
+}
+
+// Backward-shift deletion keeps probe chains intact without tombstones
+bool pheno_id_map_remove(PhenoIdMap* map, uint32_t key) {
+    if (key == PHENO_ID_MAP_EMPTY) return false;
+    
+    size_t hole = map_probe(map, key);
+    if (map->keys[hole] == PHENO_ID_MAP_EMPTY) return false;
+    
+    size_t slot = hole;
+    for (;;) {
+        slot = (slot + 1) & map->mask;
+        uint32_t k = map->keys[slot];
+        if (k == PHENO_ID_MAP_EMPTY) break;
+        
+        // Move k back if its home slot is not cyclically in (hole, slot]
+        size_t home = pheno_id_hash(k) & map->mask;
+        if (((slot - home) & map->mask) >= ((slot - hole) & map->mask)) {
+            map->keys[hole] = k;
+            map->values[hole] = map->values[slot];
+            hole = slot;
+        }
+    }
+    map->keys[hole] = PHENO_ID_MAP_EMPTY;
+    map->count--;
+    return true;
+}
@@ -0,0 +1,280 @@
+#include <stdlib.h>
+#include <string.h>
+#include "pheno_join.h"
+#include "pheno_id_map.h"
+#include "pheno_parallel.h"
+
+#define JOIN_MISSING 0xFFFFFFFFu
+#define JOIN_PARTITION_TARGET 4096     // Build tuples per partition (cache-resident table)
+#define JOIN_MAX_PARTITION_BITS 12
+#define JOIN_SERIAL_THRESHOLD 65536    // Smaller joins run on one thread
+
+// Partitioned (key, payload) pair. Build payload is the token index;
+// probe payload is relation_index * 2 + side (0 = src, 1 = dst).
+typedef struct {
+    uint32_t key;
+    uint32_t payload;
+} JoinTuple;
+
+typedef struct {
+    const PhenoToken* tokens;
+    size_t token_count;
+    const PhenoEdge* relations;
+    size_t relation_count;
+    
+    int nthreads;
+    int bits;
+    uint32_t partitions;
+    
+    size_t* build_offsets;      // [nthreads][partitions] histogram, then write cursor
+    size_t* probe_offsets;
+    size_t* build_start;        // [partitions + 1]
+    size_t* probe_start;
+    JoinTuple* build;
+    JoinTuple* probe;
+    
+    uint32_t* match;            // [relation_count * 2] token index or JOIN_MISSING
+    atomic_uint next_partition;
+    atomic_bool failed;
+    
+    size_t* emit_offsets;       // [nthreads + 1]
+    PhenoAnnotatedEdge* out;
+} JoinState;
+
+static inline uint32_t join_partition(const JoinState* js, uint32_t key) {
+    return js->bits ? pheno_id_hash(key) >> (32 - js->bits) : 0;
+}
+
+// Phase 1: per-thread partition histograms of both sides
+static void join_histogram(void* arg, int tid, int nthreads) {
+    JoinState* js = (JoinState*)arg;
+    size_t* build_hist = &js->build_offsets[(size_t)tid * js->partitions];
+    size_t* probe_hist = &js->probe_offsets[(size_t)tid * js->partitions];
+    size_t begin, end;
+    
+    pheno_parallel_range(js->token_count, tid, nthreads, &begin, &end);
+    for (size_t i = begin; i < end; i++) {
+        build_hist[join_partition(js, js->tokens[i].token_id)]++;
+    }
+    
+    pheno_parallel_range(js->relation_count, tid, nthreads, &begin, &end);
+    for (size_t i = begin; i < end; i++) {
+        probe_hist[join_partition(js, js->relations[i].src_id)]++;
+        probe_hist[join_partition(js, js->relations[i].dst_id)]++;
+    }
+}
+
+// Phase 2: scatter tuples; each thread writes its own slice of every
+// partition, so partitions keep input order
+static void join_scatter(void* arg, int tid, int nthreads) {
+    JoinState* js = (JoinState*)arg;
+    size_t* build_cursor = &js->build_offsets[(size_t)tid * js->partitions];
+    size_t* probe_cursor = &js->probe_offsets[(size_t)tid * js->partitions];
+    size_t begin, end;
+    
+    pheno_parallel_range(js->token_count, tid, nthreads, &begin, &end);
+    for (size_t i = begin; i < end; i++) {
+        uint32_t key = js->tokens[i].token_id;
+        js->build[build_cursor[join_partition(js, key)]++] = (JoinTuple){ key, (uint32_t)i };
+    }
+    
+    pheno_parallel_range(js->relation_count, tid, nthreads, &begin, &end);
+    for (size_t i = begin; i < end; i++) {
+        uint32_t src = js->relations[i].src_id;
+        uint32_t dst = js->relations[i].dst_id;
+        js->probe[probe_cursor[join_partition(js, src)]++] = (JoinTuple){ src, (uint32_t)(i * 2) };
+        js->probe[probe_cursor[join_partition(js, dst)]++] = (JoinTuple){ dst, (uint32_t)(i * 2 + 1) };
+    }
+}
+
+// Phase 3: per-partition build and probe; partitions are handed out
+// dynamically so skewed partitions do not stall a thread
+static void join_partitions(void* arg, int tid, int nthreads) {
+    JoinState* js = (JoinState*)arg;
+    (void)tid; (void)nthreads;
+    
+    size_t largest = 0;
+    for (uint32_t p = 0; p < js->partitions; p++) {
+        size_t size = js->build_start[p + 1] - js->build_start[p];
+        if (size > largest) largest = size;
+    }
+    size_t capacity = 16;
+    while (capacity < largest * 2) capacity <<= 1;
+    
+    uint32_t* keys = (uint32_t*)malloc(capacity * sizeof(uint32_t));
+    uint32_t* slots = (uint32_t*)malloc(capacity * sizeof(uint32_t));   // token index + 1, 0 = empty
+    if (!keys || !slots) {
+        atomic_store(&js->failed, true);
+        free(keys);
+        free(slots);
+        return;
+    }
+    
+    uint32_t p;
+    while ((p = atomic_fetch_add(&js->next_partition, 1)) < js->partitions) {
+        size_t size = js->build_start[p + 1] - js->build_start[p];
+        size_t mask = 16;
+        while (mask < size * 2) mask <<= 1;
+        mask -= 1;
+        memset(slots, 0, (mask + 1) * sizeof(uint32_t));
+        
+        for (size_t b = js->build_start[p]; b < js->build_start[p + 1]; b++) {
+            const JoinTuple* t = &js->build[b];
+            size_t slot = pheno_id_hash(t->key) & mask;
+            while (slots[slot] && keys[slot] != t->key) slot = (slot + 1) & mask;
+            if (!slots[slot]) {   // First occurrence of a duplicated id wins
+                keys[slot] = t->key;
+                slots[slot] = t->payload + 1;
+            }
+        }
+        
+        for (size_t q = js->probe_start[p]; q < js->probe_start[p + 1]; q++) {
+            const JoinTuple* t = &js->probe[q];
+            size_t slot = pheno_id_hash(t->key) & mask;
+            while (slots[slot] && keys[slot] != t->key) slot = (slot + 1) & mask;
+            js->match[t->payload] = slots[slot] ? slots[slot] - 1 : JOIN_MISSING;
+        }
+    }
+    
+    free(keys);
+    free(slots);
+}
+
+static inline bool join_matched(const JoinState* js, size_t i) {
+    return js->match[i * 2] != JOIN_MISSING && js->match[i * 2 + 1] != JOIN_MISSING;
+}
+
+// Phase 4: count surviving relations per thread range
+static void join_count(void* arg, int tid, int nthreads) {
+    JoinState* js = (JoinState*)arg;
+    size_t begin, end, n = 0;
+    
+    pheno_parallel_range(js->relation_count, tid, nthreads, &begin, &end);
+    for (size_t i = begin; i < end; i++) {
+        n += join_matched(js, i);
+    }
+    js->emit_offsets[tid + 1] = n;
+}
+
+// Phase 5: emit annotated edges in relation order
+static void join_emit(void* arg, int tid, int nthreads) {
+    JoinState* js = (JoinState*)arg;
+    size_t begin, end;
+    PhenoAnnotatedEdge* out = &js->out[js->emit_offsets[tid]];
+    
+    pheno_parallel_range(js->relation_count, tid, nthreads, &begin, &end);
+    for (size_t i = begin; i < end; i++) {
+        if (!join_matched(js, i)) continue;
+        
+        const PhenoToken* src = &js->tokens[js->match[i * 2]];
+        const PhenoToken* dst = &js->tokens[js->match[i * 2 + 1]];
+        out->src_index = js->match[i * 2];
+        out->dst_index = js->match[i * 2 + 1];
+        out->relation_index = (uint32_t)i;
+        out->src_zone = src->memory_zone;
+        out->src_state = (uint8_t)pheno_token_state(src);
+        out->dst_zone = dst->memory_zone;
+        out->dst_state = (uint8_t)pheno_token_state(dst);
+        out++;
+    }
+}
+
+bool pheno_join_edges(const PhenoToken* tokens, size_t token_count,
+                      const PhenoEdge* relations, size_t relation_count,
+                      int threads, PhenoEdgeTable* out) {
+    if (!out) return false;
+    out->edges = NULL;
+    out->count = 0;
+    if ((!tokens && token_count) || (!relations && relation_count)) return false;
+    if (token_count >= JOIN_MISSING || relation_count >= JOIN_MISSING / 2) return false;
+    if (relation_count == 0) return true;
+    
+    JoinState js;
+    memset(&js, 0, sizeof(js));
+    js.tokens = tokens;
+    js.token_count = token_count;
+    js.relations = relations;
+    js.relation_count = relation_count;
+    js.nthreads = token_count + relation_count < JOIN_SERIAL_THRESHOLD
+                  ? 1 : pheno_parallel_threads(threads);
+    while (js.bits < JOIN_MAX_PARTITION_BITS &&
+           (token_count >> js.bits) > JOIN_PARTITION_TARGET) {
+        js.bits++;
+    }
+    js.partitions = 1u << js.bits;
+    atomic_init(&js.next_partition, 0);
+    atomic_init(&js.failed, false);
+    
+    size_t grid = (size_t)js.nthreads * js.partitions;
+    js.build_offsets = (size_t*)calloc(grid, sizeof(size_t));
+    js.probe_offsets = (size_t*)calloc(grid, sizeof(size_t));
+    js.build_start = (size_t*)malloc((js.partitions + 1) * sizeof(size_t));
+    js.probe_start = (size_t*)malloc((js.partitions + 1) * sizeof(size_t));
+    js.build = (JoinTuple*)malloc((token_count ? token_count : 1) * sizeof(JoinTuple));
+    js.probe = (JoinTuple*)malloc(relation_count * 2 * sizeof(JoinTuple));
+    js.match = (uint32_t*)malloc(relation_count * 2 * sizeof(uint32_t));
+    js.emit_offsets = (size_t*)calloc(js.nthreads + 1, sizeof(size_t));
+    
+    bool ok = js.build_offsets && js.probe_offsets && js.build_start && js.probe_start &&
+              js.build && js.probe && js.match && js.emit_offsets;
+    
+    if (ok) {
+        pheno_parallel_run(js.nthreads, join_histogram, &js);
+        
+        // Partition-major prefix sums turn histograms into write cursors
+        size_t build_pos = 0, probe_pos = 0;
+        for (uint32_t p = 0; p < js.partitions; p++) {
+            js.build_start[p] = build_pos;
+            js.probe_start[p] = probe_pos;
+            for (int t = 0; t < js.nthreads; t++) {
+                size_t* b = &js.build_offsets[(size_t)t * js.partitions + p];
+                size_t* q = &js.probe_offsets[(size_t)t * js.partitions + p];
+                size_t bn = *b, qn = *q;
+                *b = build_pos;
+                *q = probe_pos;
+                build_pos += bn;
+                probe_pos += qn;
+            }
+        }
+        js.build_start[js.partitions] = build_pos;
+        js.probe_start[js.partitions] = probe_pos;
+        
+        pheno_parallel_run(js.nthreads, join_scatter, &js);
+        pheno_parallel_run(js.nthreads, join_partitions, &js);
+        ok = !atomic_load(&js.failed);
+    }
+    
+    if (ok) {
+        pheno_parallel_run(js.nthreads, join_count, &js);
+        for (int t = 0; t < js.nthreads; t++) {
+            js.emit_offsets[t + 1] += js.emit_offsets[t];
+        }
+        
+        size_t total = js.emit_offsets[js.nthreads];
+        js.out = (PhenoAnnotatedEdge*)malloc((total ? total : 1) * sizeof(PhenoAnnotatedEdge));
+        ok = js.out != NULL;
+        if (ok) {
+            pheno_parallel_run(js.nthreads, join_emit, &js);
+            out->edges = js.out;
+            out->count = total;
+        }
+    }
+    
+    free(js.build_offsets);
+    free(js.probe_offsets);
+    free(js.build_start);
+    free(js.probe_start);
+    free(js.build);
+    free(js.probe);
+    free(js.match);
+    free(js.emit_offsets);
+    return ok;
+}
+
+void pheno_edge_table_free(PhenoEdgeTable* table) {
+    if (!table) return;
+    
+    free(table->edges);
+    table->edges = NULL;
+    table->count = 0;
+}
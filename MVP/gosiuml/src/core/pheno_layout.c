@@ -0,0 +1,594 @@
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include "pheno_layout.h"
+#include "pheno_parallel.h"
+
+#define LAYOUT_MAX_DEPTH 24         // Deeper cells hold coincident points together
+#define LAYOUT_STACK (3 * LAYOUT_MAX_DEPTH + 4)
+#define LAYOUT_NO_NODE -1
+#define LAYOUT_NONE 0xFFFFFFFFu
+#define LAYOUT_MIN_DIST2 1e-6f
+#define LAYOUT_GOLDEN_ANGLE 2.39996323f
+#define LAYOUT_MAX_LEVELS 48
+#define LAYOUT_COARSEST 64          // Stop coarsening at this many nodes
+#define LAYOUT_MIN_SHRINK 0.9       // ... or when a level keeps more than this fraction
+#define LAYOUT_THREAD_GRAIN 256     // Nodes per thread below which threads don't pay
+
+// Quadtree cell. Leaves hold one body (or several coincident ones at
+// LAYOUT_MAX_DEPTH); internal cells hold the aggregate of their children.
+typedef struct {
+    float cx, cy;           // Centre of mass (weighted sums while building)
+    float mass;
+    float mid_x, mid_y;     // Square bounds: centre and half side
+    float half;
+    int32_t child;          // First of four consecutive children, or LAYOUT_NO_NODE
+    int32_t body;           // Leaf body, or LAYOUT_NO_NODE
+} QuadCell;
+
+typedef struct {
+    QuadCell* cells;
+    size_t count;
+    size_t capacity;
+} QuadTree;
+
+// One level of the multilevel hierarchy: an undirected graph in CSR form
+// (so each node sums its own attraction) and the node each vertex was
+// merged into on the next coarser level
+typedef struct {
+    size_t count;
+    uint32_t* offsets;
+    uint32_t* neighbors;
+    uint32_t* parent;
+    uint8_t* clusters;      // Cluster of each node, or NULL
+} LayoutLevel;
+
+typedef struct {
+    size_t count;
+    const PhenoPoint* pos;
+    PhenoPoint* next;
+    const QuadTree* tree;
+    const LayoutLevel* level;
+    float k;                // Ideal edge length on this level
+    float theta2;
+    float gravity;
+    float temperature;
+} LayoutStep;
+
+void pheno_layout_defaults(PhenoLayoutOptions* options) {
+    options->iterations = 40;
+    options->threads = 0;
+    options->theta = 1.0f;
+    options->gravity = 2.0f;
+    options->seed = 0x9E3779B9u;
+    options->clusters = NULL;
+}
+
+// ---- Quadtree ----
+
+static int32_t tree_push(QuadTree* tree, float mid_x, float mid_y, float half) {
+    if (tree->count == tree->capacity) {
+        size_t capacity = tree->capacity ? tree->capacity * 2 : 1024;
+        QuadCell* cells = (QuadCell*)realloc(tree->cells, capacity * sizeof(QuadCell));
+        if (!cells) return LAYOUT_NO_NODE;
+        tree->cells = cells;
+        tree->capacity = capacity;
+    }
+    
+    QuadCell* cell = &tree->cells[tree->count];
+    cell->cx = cell->cy = cell->mass = 0.0f;
+    cell->mid_x = mid_x;
+    cell->mid_y = mid_y;
+    cell->half = half;
+    cell->child = LAYOUT_NO_NODE;
+    cell->body = LAYOUT_NO_NODE;
+    return (int32_t)tree->count++;
+}
+
+static int quadrant(const QuadCell* cell, PhenoPoint p) {
+    return (p.x >= cell->mid_x) | ((p.y >= cell->mid_y) << 1);
+}
+
+static bool tree_split(QuadTree* tree, int32_t index) {
+    float half = tree->cells[index].half * 0.5f;
+    float mid_x = tree->cells[index].mid_x;
+    float mid_y = tree->cells[index].mid_y;
+    int32_t first = LAYOUT_NO_NODE;
+    
+    for (int q = 0; q < 4; q++) {
+        int32_t child = tree_push(tree, mid_x + ((q & 1) ? half : -half),
+                                  mid_y + ((q & 2) ? half : -half), half);
+        if (child == LAYOUT_NO_NODE) return false;
+        if (q == 0) first = child;
+    }
+    tree->cells[index].child = first;
+    return true;
+}
+
+static bool tree_insert(QuadTree* tree, const PhenoPoint* pos, int32_t body) {
+    PhenoPoint p = pos[body];
+    int32_t index = 0;
+    
+    for (int depth = 0; ; depth++) {
+        QuadCell* cell = &tree->cells[index];
+        cell->cx += p.x;
+        cell->cy += p.y;
+        cell->mass += 1.0f;
+    
+        if (cell->child == LAYOUT_NO_NODE) {
+            if (cell->body == LAYOUT_NO_NODE) {
+                cell->body = body;
+                return true;
+            }
+            if (depth >= LAYOUT_MAX_DEPTH) return true;     // Coincident: aggregate
+    
+            // Occupied leaf: push its body down one level, then keep going
+            int32_t resident = cell->body;
+            if (!tree_split(tree, index)) return false;
+            cell = &tree->cells[index];
+            cell->body = LAYOUT_NO_NODE;
+            QuadCell* down = &tree->cells[cell->child + quadrant(cell, pos[resident])];
+            down->cx = pos[resident].x;
+            down->cy = pos[resident].y;
+            down->mass = 1.0f;
+            down->body = resident;
+        }
+        index = cell->child + quadrant(cell, p);
+    }
+}
+
+static bool tree_build(QuadTree* tree, const PhenoPoint* pos, size_t count) {
+    float min_x = INFINITY, min_y = INFINITY, max_x = -INFINITY, max_y = -INFINITY;
+    for (size_t i = 0; i < count; i++) {
+        if (pos[i].x < min_x) min_x = pos[i].x;
+        if (pos[i].x > max_x) max_x = pos[i].x;
+        if (pos[i].y < min_y) min_y = pos[i].y;
+        if (pos[i].y > max_y) max_y = pos[i].y;
+    }
+    
+    float half = fmaxf(max_x - min_x, max_y - min_y) * 0.5f + 1e-3f;
+    tree->count = 0;
+    if (tree_push(tree, (min_x + max_x) * 0.5f, (min_y + max_y) * 0.5f, half) == LAYOUT_NO_NODE) {
+        return false;
+    }
+    for (size_t i = 0; i < count; i++) {
+        if (!tree_insert(tree, pos, (int32_t)i)) return false;
+    }
+    
+    for (size_t c = 0; c < tree->count; c++) {
+        QuadCell* cell = &tree->cells[c];
+        if (cell->mass > 0.0f) {
+            cell->cx /= cell->mass;
+            cell->cy /= cell->mass;
+        }
+    }
+    return true;
+}
+
+// ---- Forces ----
+
+// Repulsion on body i, divided by k^2 (magnitude 1 / d per unit of mass)
+static void repulsion(const LayoutStep* step, uint32_t i, float* fx, float* fy) {
+    const QuadCell* cells = step->tree->cells;
+    PhenoPoint p = step->pos[i];
+    float min_d2 = LAYOUT_MIN_DIST2 * step->k * step->k;
+    int32_t stack[LAYOUT_STACK];
+    int top = 0;
+    stack[top++] = 0;
+    
+    while (top) {
+        const QuadCell* cell = &cells[stack[--top]];
+        if (cell->mass == 0.0f) continue;
+    
+        float dx = p.x - cell->cx;
+        float dy = p.y - cell->cy;
+        float d2 = dx * dx + dy * dy;
+        float size = cell->half * 2.0f;
+    
+        if (cell->child == LAYOUT_NO_NODE) {
+            float mass = cell->mass;
+            if (cell->body == (int32_t)i) mass -= 1.0f;
+            if (mass <= 0.0f) continue;
+            if (d2 < min_d2) {
+                // Coincident bodies: separate them in an arbitrary but fixed direction
+                *fx += mass * (float)((i & 1) ? 1 : -1) / step->k;
+                *fy += mass * (float)((i & 2) ? 1 : -1) / step->k;
+                continue;
+            }
+            *fx += dx * mass / d2;
+            *fy += dy * mass / d2;
+        } else if (size * size < step->theta2 * d2) {
+            *fx += dx * cell->mass / d2;
+            *fy += dy * cell->mass / d2;
+        } else {
+            for (int q = 0; q < 4; q++) {
+                stack[top++] = cell->child + q;
+            }
+        }
+    }
+}
+
+// Attraction along edges (magnitude d^2 / k)
+static void attraction(const LayoutStep* step, uint32_t i, float* fx, float* fy) {
+    const LayoutLevel* level = step->level;
+    PhenoPoint p = step->pos[i];
+    
+    for (uint32_t e = level->offsets[i]; e < level->offsets[i + 1]; e++) {
+        PhenoPoint q = step->pos[level->neighbors[e]];
+        float dx = q.x - p.x;
+        float dy = q.y - p.y;
+        float d = sqrtf(dx * dx + dy * dy);
+        *fx += dx * d / step->k;
+        *fy += dy * d / step->k;
+    }
+}
+
+static void layout_step(void* arg, int tid, int nthreads) {
+    const LayoutStep* step = (const LayoutStep*)arg;
+    float k2 = step->k * step->k;
+    size_t begin, end;
+    pheno_parallel_range(step->count, tid, nthreads, &begin, &end);
+    
+    for (size_t i = begin; i < end; i++) {
+        PhenoPoint p = step->pos[i];
+        float rx = 0.0f, ry = 0.0f;
+        repulsion(step, (uint32_t)i, &rx, &ry);
+        float fx = rx * k2 - step->gravity * p.x;
+        float fy = ry * k2 - step->gravity * p.y;
+        attraction(step, (uint32_t)i, &fx, &fy);
+    
+        // Move along the net force, at most `temperature`
+        float len = sqrtf(fx * fx + fy * fy);
+        if (len > step->temperature) {
+            float scale = step->temperature / len;
+            fx *= scale;
+            fy *= scale;
+        }
+        step->next[i].x = p.x + fx;
+        step->next[i].y = p.y + fy;
+    }
+}
+
+// ---- Random placement ----
+
+static uint32_t xorshift32(uint32_t* state) {
+    uint32_t x = *state;
+    x ^= x << 13;
+    x ^= x >> 17;
+    x ^= x << 5;
+    return *state = x;
+}
+
+static float unit_random(uint32_t* state) {
+    return (float)(xorshift32(state) >> 8) * (1.0f / 16777216.0f);
+}
+
+// Uniform in a disc of the given radius around (cx, cy)
+static PhenoPoint disc_point(uint32_t* state, float cx, float cy, float radius) {
+    float r = radius * sqrtf(unit_random(state));
+    float a = 6.28318531f * unit_random(state);
+    return (PhenoPoint){ cx + r * cosf(a), cy + r * sinf(a) };
+}
+
+// Coarsest level: uniformly in a disc, or with cluster ids grouped around
+// cluster centres on a sunflower spiral, each disc sized to its membership
+static void layout_seed(PhenoPoint* pos, const LayoutLevel* level, float k, uint32_t* state) {
+    float radius = (sqrtf((float)level->count) * 0.5f + 1.0f) * k;
+    
+    if (!level->clusters) {
+        for (size_t i = 0; i < level->count; i++) {
+            pos[i] = disc_point(state, 0.0f, 0.0f, radius);
+        }
+        return;
+    }
+    
+    size_t members[256] = {0};
+    for (size_t i = 0; i < level->count; i++) {
+        members[level->clusters[i]]++;
+    }
+    float centre_x[256], centre_y[256];
+    for (int c = 0; c < 256; c++) {
+        float r = radius * sqrtf((c + 0.5f) / 256.0f);
+        centre_x[c] = r * cosf(c * LAYOUT_GOLDEN_ANGLE);
+        centre_y[c] = r * sinf(c * LAYOUT_GOLDEN_ANGLE);
+    }
+    for (size_t i = 0; i < level->count; i++) {
+        uint8_t c = level->clusters[i];
+        pos[i] = disc_point(state, centre_x[c], centre_y[c], (sqrtf((float)members[c]) * 0.5f + 0.5f) * k);
+    }
+}
+
+// ---- Multilevel hierarchy ----
+
+static void level_free(LayoutLevel* level) {
+    free(level->offsets);
+    free(level->neighbors);
+    free(level->parent);
+    free(level->clusters);
+    memset(level, 0, sizeof(*level));
+}
+
+static bool level_from_edges(LayoutLevel* level, size_t count, const PhenoEdgeTable* edges,
+                             const uint8_t* clusters) {
+    level->count = count;
+    level->offsets = (uint32_t*)calloc(count + 1, sizeof(uint32_t));
+    if (!level->offsets) return false;
+    if (clusters) {
+        level->clusters = (uint8_t*)malloc(count);
+        if (!level->clusters) return false;
+        memcpy(level->clusters, clusters, count);
+    }
+    
+    size_t edge_count = edges ? edges->count : 0;
+    if (edge_count > UINT32_MAX / 2) return false;
+    for (size_t e = 0; e < edge_count; e++) {
+        const PhenoAnnotatedEdge* edge = &edges->edges[e];
+        if (edge->src_index >= count || edge->dst_index >= count) continue;
+        if (edge->src_index == edge->dst_index) continue;
+        level->offsets[edge->src_index + 1]++;
+        level->offsets[edge->dst_index + 1]++;
+    }
+    for (size_t i = 0; i < count; i++) {
+        level->offsets[i + 1] += level->offsets[i];
+    }
+    
+    uint32_t total = level->offsets[count];
+    level->neighbors = (uint32_t*)malloc((total ? total : 1) * sizeof(uint32_t));
+    uint32_t* cursor = (uint32_t*)malloc(count * sizeof(uint32_t));
+    if (!level->neighbors || !cursor) {
+        free(cursor);
+        return false;
+    }
+    memcpy(cursor, level->offsets, count * sizeof(uint32_t));
+    for (size_t e = 0; e < edge_count; e++) {
+        const PhenoAnnotatedEdge* edge = &edges->edges[e];
+        if (edge->src_index >= count || edge->dst_index >= count) continue;
+        if (edge->src_index == edge->dst_index) continue;
+        level->neighbors[cursor[edge->src_index]++] = edge->dst_index;
+        level->neighbors[cursor[edge->dst_index]++] = edge->src_index;
+    }
+    free(cursor);
+    return true;
+}
+
+static int compare_u32(const void* a, const void* b) {
+    uint32_t x = *(const uint32_t*)a, y = *(const uint32_t*)b;
+    return (x > y) - (x < y);
+}
+
+static bool same_cluster(const LayoutLevel* level, uint32_t a, uint32_t b) {
+    return !level->clusters || level->clusters[a] == level->clusters[b];
+}
+
+static uint32_t degree(const LayoutLevel* level, uint32_t u) {
+    return level->offsets[u + 1] - level->offsets[u];
+}
+
+// Merge fine into coarse: a random maximal matching that prefers
+// low-degree partners, after which unmatched leaves join their neighbour's
+// group so stars collapse too. Nodes only merge within a cluster. Sets
+// fine->parent; returns false on allocation failure.
+static bool level_coarsen(LayoutLevel* fine, LayoutLevel* coarse, uint32_t* state) {
+    size_t n = fine->count;
+    uint32_t* order = (uint32_t*)malloc(n * sizeof(uint32_t));
+    uint32_t* mate = (uint32_t*)malloc(n * sizeof(uint32_t));
+    fine->parent = (uint32_t*)malloc(n * sizeof(uint32_t));
+    bool ok = order && mate && fine->parent;
+    
+    if (ok) {
+        for (size_t i = 0; i < n; i++) {
+            order[i] = (uint32_t)i;
+            mate[i] = LAYOUT_NONE;
+        }
+        for (size_t i = n; i > 1; i--) {
+            size_t j = xorshift32(state) % i;
+            uint32_t t = order[i - 1];
+            order[i - 1] = order[j];
+            order[j] = t;
+        }
+    
+        for (size_t o = 0; o < n; o++) {
+            uint32_t u = order[o];
+            if (mate[u] != LAYOUT_NONE) continue;
+            uint32_t best = LAYOUT_NONE, best_degree = UINT32_MAX;
+            for (uint32_t e = fine->offsets[u]; e < fine->offsets[u + 1]; e++) {
+                uint32_t v = fine->neighbors[e];
+                if (v == u || mate[v] != LAYOUT_NONE || !same_cluster(fine, u, v)) continue;
+                if (degree(fine, v) < best_degree) {
+                    best = v;
+                    best_degree = degree(fine, v);
+                }
+            }
+            if (best != LAYOUT_NONE) {
+                mate[u] = best;
+                mate[best] = u;
+            }
+        }
+    
+        // Number the groups; unmatched leaves are resolved afterwards
+        // (their neighbour is never an unmatched leaf, or they would have
+        // been matched with each other)
+        uint32_t groups = 0;
+        for (size_t u = 0; u < n; u++) {
+            fine->parent[u] = LAYOUT_NONE;
+        }
+        for (size_t u = 0; u < n; u++) {
+            if (mate[u] == LAYOUT_NONE) {
+                if (degree(fine, (uint32_t)u) != 1 ||
+                    !same_cluster(fine, (uint32_t)u, fine->neighbors[fine->offsets[u]])) {
+                    fine->parent[u] = groups++;
+                }
+            } else if (mate[u] > u) {
+                fine->parent[u] = fine->parent[mate[u]] = groups++;
+            }
+        }
+        for (size_t u = 0; u < n; u++) {
+            if (fine->parent[u] == LAYOUT_NONE) {
+                fine->parent[u] = fine->parent[fine->neighbors[fine->offsets[u]]];
+            }
+        }
+        coarse->count = groups;
+    }
+    
+    // Coarse edges: images of fine edges, without self loops or duplicates
+    if (ok) {
+        coarse->offsets = (uint32_t*)calloc(coarse->count + 1, sizeof(uint32_t));
+        coarse->neighbors = (uint32_t*)malloc((fine->offsets[n] ? fine->offsets[n] : 1) * sizeof(uint32_t));
+        ok = coarse->offsets && coarse->neighbors;
+    }
+    if (ok && fine->clusters) {
+        coarse->clusters = (uint8_t*)malloc(coarse->count);
+        ok = coarse->clusters != NULL;
+        for (size_t u = 0; ok && u < n; u++) {
+            coarse->clusters[fine->parent[u]] = fine->clusters[u];
+        }
+    }
+    if (ok) {
+        for (size_t u = 0; u < n; u++) {
+            coarse->offsets[fine->parent[u] + 1] += degree(fine, (uint32_t)u);
+        }
+        for (size_t c = 0; c < coarse->count; c++) {
+            coarse->offsets[c + 1] += coarse->offsets[c];
+        }
+        memcpy(mate, coarse->offsets, coarse->count * sizeof(uint32_t));   // Reused as cursors
+        for (size_t u = 0; u < n; u++) {
+            uint32_t pu = fine->parent[u];
+            for (uint32_t e = fine->offsets[u]; e < fine->offsets[u + 1]; e++) {
+                coarse->neighbors[mate[pu]++] = fine->parent[fine->neighbors[e]];
+            }
+        }
+    
+        // Sort and compact each row in place
+        uint32_t out = 0;
+        for (size_t c = 0; c < coarse->count; c++) {
+            uint32_t begin = coarse->offsets[c], end = coarse->offsets[c + 1];
+            qsort(coarse->neighbors + begin, end - begin, sizeof(uint32_t), compare_u32);
+            coarse->offsets[c] = out;
+            for (uint32_t e = begin; e < end; e++) {
+                uint32_t v = coarse->neighbors[e];
+                if (v == c || (out > coarse->offsets[c] && coarse->neighbors[out - 1] == v)) continue;
+                coarse->neighbors[out++] = v;
+            }
+        }
+        coarse->offsets[coarse->count] = out;
+    }
+    
+    free(order);
+    free(mate);
+    return ok;
+}
+
+// ---- Driver ----
+
+static bool layout_level(const LayoutLevel* level, PhenoPoint** pos, PhenoPoint** next,
+                         QuadTree* tree, float k, float start, int iterations,
+                         int threads, const PhenoLayoutOptions* options) {
+    LayoutStep step = {
+        .count = level->count,
+        .tree = tree,
+        .level = level,
+        .k = k,
+        .theta2 = options->theta * options->theta,
+        .gravity = options->gravity
+    };
+    
+    for (int it = 0; it < iterations; it++) {
+        if (!tree_build(tree, *pos, level->count)) return false;
+        step.pos = *pos;
+        step.next = *next;
+        step.temperature = start * (float)(iterations - it) / (float)iterations;
+        pheno_parallel_run(threads, layout_step, &step);
+    
+        PhenoPoint* swap = *pos;
+        *pos = *next;
+        *next = swap;
+    }
+    return true;
+}
+
+bool pheno_layout_graph(size_t node_count, const PhenoEdgeTable* edges,
+                        const PhenoLayoutOptions* options, PhenoPoint* out) {
+    PhenoLayoutOptions defaults;
+    if (!options) {
+        pheno_layout_defaults(&defaults);
+        options = &defaults;
+    }
+    if (node_count == 0) return true;
+    if (node_count > INT32_MAX / 8) return false;
+    
+    uint32_t state = options->seed ? options->seed : 1;
+    LayoutLevel levels[LAYOUT_MAX_LEVELS];
+    memset(levels, 0, sizeof(levels));
+    QuadTree tree = {0};
+    PhenoPoint* pos = (PhenoPoint*)malloc(node_count * sizeof(PhenoPoint));
+    PhenoPoint* next = (PhenoPoint*)malloc(node_count * sizeof(PhenoPoint));
+    bool ok = pos && next && level_from_edges(&levels[0], node_count, edges, options->clusters);
+    
+    // Coarsen until small, or until merging stops paying off
+    int depth = 1;
+    while (ok && depth < LAYOUT_MAX_LEVELS && levels[depth - 1].count > LAYOUT_COARSEST) {
+        LayoutLevel* fine = &levels[depth - 1];
+        ok = level_coarsen(fine, &levels[depth], &state);
+        if (ok && levels[depth].count > fine->count * LAYOUT_MIN_SHRINK) {
+            level_free(&levels[depth]);
+            free(fine->parent);
+            fine->parent = NULL;
+            break;
+        }
+        depth++;
+    }
+    
+    // Lay out the coarsest level from scratch, then refine level by level.
+    // A level with n nodes stands for node_count fine nodes, so its ideal
+    // edge length is sqrt(node_count / n) fine lengths.
+    int max_threads = pheno_parallel_threads(options->threads);
+    for (int l = depth - 1; ok && l >= 0; l--) {
+        const LayoutLevel* level = &levels[l];
+        float k = sqrtf((float)node_count / (float)level->count);
+        int threads = max_threads;
+        if ((size_t)threads > level->count / LAYOUT_THREAD_GRAIN + 1) {
+            threads = (int)(level->count / LAYOUT_THREAD_GRAIN + 1);
+        }
+    
+        if (l == depth - 1) {
+            layout_seed(pos, level, k, &state);
+            float start = (sqrtf((float)level->count) * 0.1f + 1.0f) * k;
+            ok = layout_level(level, &pos, &next, &tree, k, start, options->iterations * 4,
+                              threads, options);
+        } else {
+            // Each node starts near the coarse node it was merged into
+            for (size_t i = 0; i < level->count; i++) {
+                PhenoPoint p = pos[level->parent[i]];
+                next[i] = disc_point(&state, p.x, p.y, k * 0.5f);
+            }
+            PhenoPoint* swap = pos;
+            pos = next;
+            next = swap;
+            ok = layout_level(level, &pos, &next, &tree, k, k, options->iterations,
+                              threads, options);
+        }
+    }
+    
+    if (ok) memcpy(out, pos, node_count * sizeof(PhenoPoint));
+    for (int l = 0; l < LAYOUT_MAX_LEVELS; l++) {
+        level_free(&levels[l]);
+    }
+    free(pos);
+    free(next);
+    free(tree.cells);
+    return ok;
+}
+
+bool pheno_layout_tokens(const PhenoToken* tokens, size_t count,
+                         const PhenoEdge* relations, size_t relation_count,
+                         const PhenoLayoutOptions* options, PhenoPoint* out) {
+    PhenoEdgeTable edges = {0};
+    int threads = options ? options->threads : 0;
+    
+    if (relation_count && !pheno_join_edges(tokens, count, relations, relation_count, threads, &edges)) {
+        return false;
+    }
+    bool ok = pheno_layout_graph(count, &edges, options, out);
+    pheno_edge_table_free(&edges);
+    return ok;
+}
@@ -0,0 +1,425 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "gosiuml.h"
+#include "pheno_lod.h"
+#include "pheno_id_map.h"
+#include "pheno_join.h"
+#include "pheno_layout.h"
+#include "pheno_symbol.h"
+#include "svg_generator.h"
+
+// Panel geometry for expanded groups, matching the token grid
+#define LOD_MARGIN 100
+#define LOD_H_SPACING 220
+#define LOD_V_SPACING (SVG_NODE_HEIGHT + 60)
+#define LOD_PANEL_HEADER 50
+#define LOD_BAR_WIDTH (SVG_NODE_WIDTH - 20)
+#define LOD_BAR_HEIGHT 16
+
+static const char* const g_state_fill[] = {
+    "#9E9E9E", "#2196F3", "#1565C0", "#4CAF50", "#FF5722", "#9C27B0", "#BDBDBD"
+};
+
+void pheno_lod_defaults(PhenoLodOptions* options) {
+    memset(options, 0, sizeof(*options));
+    options->group = LOD_GROUP_TYPE;
+    options->expand_limit = PHENO_LOD_EXPAND_LIMIT;
+}
+
+static uint32_t lod_key(const PhenoLodOptions* options, const PhenoToken* token, size_t index) {
+    switch (options->group) {
+        case LOD_GROUP_CLUSTER: return options->clusters ? options->clusters[index] : 0;
+        case LOD_GROUP_ZONE: return token->memory_zone;
+        case LOD_GROUP_STATE: return (uint32_t)pheno_token_state(token);
+        default: return token->type_symbol;
+    }
+}
+
+static bool lod_expanded(const PhenoLodOptions* options, uint32_t key) {
+    for (size_t i = 0; i < options->expand_count; i++) {
+        if (options->expand[i] == key) return true;
+    }
+    return false;
+}
+
+static int lod_cluster_order(const void* a, const void* b) {
+    const PhenoLodCluster* x = (const PhenoLodCluster*)a;
+    const PhenoLodCluster* y = (const PhenoLodCluster*)b;
+    if (x->count != y->count) return x->count > y->count ? -1 : 1;
+    return x->key < y->key ? -1 : x->key > y->key;
+}
+
+static int lod_link_order(const void* a, const void* b) {
+    const PhenoLodLink* x = (const PhenoLodLink*)a;
+    const PhenoLodLink* y = (const PhenoLodLink*)b;
+    if (x->count != y->count) return x->count > y->count ? -1 : 1;
+    if (x->src != y->src) return x->src < y->src ? -1 : 1;
+    return x->dst < y->dst ? -1 : x->dst > y->dst;
+}
+
+// Cluster index of a key, creating the group on first sight. The last
+// slot is kept for "other", which takes every key once the rest are used.
+static int lod_cluster(PhenoLodSummary* s, PhenoIdMap* keys, const PhenoLodOptions* options,
+                       uint32_t key, uint32_t* other) {
+    uint32_t index;
+    if (pheno_id_map_get(keys, key, &index)) return (int)index;
+    if (s->count == PHENO_LOD_MAX_CLUSTERS - 1 || *other != UINT32_MAX) {
+        if (*other == UINT32_MAX) {
+            *other = (uint32_t)s->count++;
+            s->clusters[*other].key = PHENO_LOD_OTHER;
+            s->clusters[*other].expanded = lod_expanded(options, PHENO_LOD_OTHER);
+        }
+        return (int)*other;
+    }
+    
+    index = (uint32_t)s->count++;
+    s->clusters[index].key = key;
+    s->clusters[index].expanded = lod_expanded(options, key);
+    return pheno_id_map_put(keys, key, index) ? (int)index : -1;
+}
+
+bool pheno_lod_summarize(const PhenoToken* tokens, size_t count,
+                         const PhenoEdge* relations, size_t relation_count,
+                         const PhenoLodOptions* options, PhenoLodSummary* out) {
+    PhenoLodOptions defaults;
+    if (!options) {
+        pheno_lod_defaults(&defaults);
+        options = &defaults;
+    }
+    memset(out, 0, sizeof(*out));
+    out->group = options->group;
+    if (count && !tokens) return false;
+    
+    out->clusters = (PhenoLodCluster*)calloc(PHENO_LOD_MAX_CLUSTERS, sizeof(PhenoLodCluster));
+    PhenoIdMap keys, ids;
+    bool keys_ok = pheno_id_map_init(&keys, PHENO_LOD_MAX_CLUSTERS);
+    bool ids_ok = relation_count && pheno_id_map_init(&ids, count);
+    bool ok = out->clusters && keys_ok && (ids_ok || !relation_count);
+    
+    // Single pass over the tokens: group, histogram, expanded members
+    uint32_t other = UINT32_MAX, shown = 0;
+    for (size_t i = 0; ok && i < count; i++) {
+        const PhenoToken* token = &tokens[i];
+        int c = lod_cluster(out, &keys, options, lod_key(options, token, i), &other);
+        if (c < 0) {
+            ok = false;
+            break;
+        }
+        PhenoLodCluster* cluster = &out->clusters[c];
+        PhenoState state = pheno_token_state(token);
+        cluster->count++;
+        cluster->states[(unsigned)state <= STATE_FREED ? state : STATE_NIL]++;
+        if (ids_ok && token->token_id != PHENO_ID_MAP_EMPTY) {
+            uint32_t existing;
+            if (pheno_id_map_insert(&ids, token->token_id, (uint32_t)c, &existing) < 0) ok = false;
+        }
+        if (cluster->expanded && shown < options->expand_limit) {
+            if (!cluster->members) {
+                size_t room = options->expand_limit - shown;
+                if (room > count - i) room = count - i;
+                cluster->members = (uint32_t*)malloc(room * sizeof(uint32_t));
+                if (!cluster->members) {
+                    ok = false;
+                    break;
+                }
+            }
+            cluster->members[cluster->member_count++] = (uint32_t)i;
+            shown++;
+        }
+    }
+    
+    // Largest groups first; internal carries each group's old index
+    // through the sort so the token-to-group indices can be remapped
+    uint32_t remap[PHENO_LOD_MAX_CLUSTERS];
+    if (ok) {
+        for (size_t c = 0; c < out->count; c++) out->clusters[c].internal = (uint32_t)c;
+        qsort(out->clusters, out->count, sizeof(PhenoLodCluster), lod_cluster_order);
+        for (size_t c = 0; c < out->count; c++) {
+            remap[out->clusters[c].internal] = (uint32_t)c;
+            out->clusters[c].internal = 0;
+        }
+    }
+    
+    // Single pass over the relations into a dense group-pair matrix
+    uint32_t* pairs = NULL;
+    if (ok && relation_count) {
+        pairs = (uint32_t*)calloc(out->count * out->count, sizeof(uint32_t));
+        ok = pairs != NULL;
+    }
+    for (size_t r = 0; ok && r < relation_count; r++) {
+        uint32_t a, b;
+        if (!pheno_id_map_get(&ids, relations[r].src_id, &a) ||
+            !pheno_id_map_get(&ids, relations[r].dst_id, &b)) {
+            continue;
+        }
+        a = remap[a];
+        b = remap[b];
+        if (a == b) {
+            out->clusters[a].internal++;
+        } else {
+            pairs[a * out->count + b]++;
+        }
+    }
+    
+    size_t links = 0;
+    for (size_t p = 0; ok && pairs && p < out->count * out->count; p++) {
+        if (pairs[p]) links++;
+    }
+    if (ok && links) {
+        out->links = (PhenoLodLink*)malloc(links * sizeof(PhenoLodLink));
+        ok = out->links != NULL;
+        for (size_t p = 0; ok && p < out->count * out->count; p++) {
+            if (!pairs[p]) continue;
+            out->links[out->link_count++] = (PhenoLodLink){
+                (uint32_t)(p / out->count), (uint32_t)(p % out->count), pairs[p]
+            };
+        }
+        if (ok) {
+            qsort(out->links, out->link_count, sizeof(PhenoLodLink), lod_link_order);
+            if (out->link_count > PHENO_LOD_MAX_LINKS) {
+                out->dropped_links = out->link_count - PHENO_LOD_MAX_LINKS;
+                out->link_count = PHENO_LOD_MAX_LINKS;
+            }
+        }
+    }
+    
+    free(pairs);
+    if (keys_ok) pheno_id_map_free(&keys);
+    if (ids_ok) pheno_id_map_free(&ids);
+    if (!ok) pheno_lod_free(out);
+    return ok;
+}
+
+void pheno_lod_free(PhenoLodSummary* summary) {
+    if (summary->clusters) {
+        for (size_t c = 0; c < summary->count; c++) free(summary->clusters[c].members);
+    }
+    free(summary->clusters);
+    free(summary->links);
+    memset(summary, 0, sizeof(*summary));
+}
+
+const char* pheno_lod_label(PhenoLodGroup group, uint32_t key, char* buf) {
+    if (key == PHENO_LOD_OTHER) return "other";
+    switch (group) {
+        case LOD_GROUP_CLUSTER:
+            snprintf(buf, 32, "cluster %u", key);
+            return buf;
+        case LOD_GROUP_ZONE:
+            snprintf(buf, 32, "zone %u", key);
+            return buf;
+        case LOD_GROUP_STATE:
+            return get_state_name((PhenoState)key);
+        default: {
+            const char* name = pheno_symbol_name(key);
+            return name ? name : "(untyped)";
+        }
+    }
+}
+
+static void lod_text(PhenoWriter* w, uint32_t x, uint32_t y, const char* attrs) {
+    pheno_writer_lit(w, "    <text x=\"");
+    pheno_writer_u32(w, x);
+    pheno_writer_lit(w, "\" y=\"");
+    pheno_writer_u32(w, y);
+    pheno_writer_lit(w, "\" text-anchor=\"middle\" font-family=\"monospace\" ");
+    pheno_writer_str(w, attrs);
+    pheno_writer_lit(w, ">");
+}
+
+static void lod_group_box(PhenoWriter* w, const PhenoLodSummary* s, size_t index, SvgSlot slot) {
+    const PhenoLodCluster* c = &s->clusters[index];
+    uint32_t center = slot.x + SVG_NODE_WIDTH / 2;
+    char buf[32];
+    const char* label = pheno_lod_label(s->group, c->key, buf);
+    
+    pheno_writer_lit(w, "  <g id=\"cluster-");
+    pheno_writer_u32(w, (uint32_t)index);
+    pheno_writer_lit(w, "\" class=\"cluster\">\n    <rect x=\"");
+    pheno_writer_u32(w, slot.x);
+    pheno_writer_lit(w, "\" y=\"");
+    pheno_writer_u32(w, slot.y);
+    pheno_writer_lit(w, "\" width=\"");
+    pheno_writer_u32(w, SVG_NODE_WIDTH);
+    pheno_writer_lit(w, "\" height=\"");
+    pheno_writer_u32(w, SVG_NODE_HEIGHT);
+    pheno_writer_lit(w, "\" fill=\"#fff3e0\" stroke=\"#FB8C00\" stroke-width=\"2\" rx=\"5\"");
+    if (c->expanded) pheno_writer_lit(w, " stroke-dasharray=\"6 3\"");
+    pheno_writer_lit(w, "/>\n");
+    
+    lod_text(w, center, slot.y + 25, "font-size=\"14\" font-weight=\"bold\"");
+    pheno_writer_xml_text(w, label, strlen(label));
+    pheno_writer_lit(w, "</text>\n");
+    lod_text(w, center, slot.y + 45, "font-size=\"12\"");
+    pheno_writer_u32(w, c->count);
+    pheno_writer_lit(w, " tokens</text>\n");
+    
+    // State histogram as one stacked bar; segment edges are rounded from
+    // the running total so the segments always fill the bar exactly
+    uint32_t bar_x = slot.x + (SVG_NODE_WIDTH - LOD_BAR_WIDTH) / 2;
+    uint64_t running = 0;
+    uint32_t left = bar_x;
+    for (int state = 0; state <= STATE_FREED; state++) {
+        if (!c->states[state]) continue;
+        running += c->states[state];
+        uint32_t right = bar_x + (uint32_t)(running * LOD_BAR_WIDTH / c->count);
+        pheno_writer_lit(w, "    <rect x=\"");
+        pheno_writer_u32(w, left);
+        pheno_writer_lit(w, "\" y=\"");
+        pheno_writer_u32(w, slot.y + 60);
+        pheno_writer_lit(w, "\" width=\"");
+        pheno_writer_u32(w, right - left);
+        pheno_writer_lit(w, "\" height=\"");
+        pheno_writer_u32(w, LOD_BAR_HEIGHT);
+        pheno_writer_lit(w, "\" fill=\"");
+        pheno_writer_str(w, g_state_fill[state]);
+        pheno_writer_lit(w, "\"><title>");
+        pheno_writer_str(w, get_state_name((PhenoState)state));
+        pheno_writer_lit(w, ": ");
+        pheno_writer_u32(w, c->states[state]);
+        pheno_writer_lit(w, "</title></rect>\n");
+        left = right;
+    }
+    
+    lod_text(w, center, slot.y + 100, "font-size=\"11\"");
+    pheno_writer_u32(w, c->internal);
+    pheno_writer_lit(w, " internal relations</text>\n  </g>\n");
+}
+
+static void lod_link(PhenoWriter* w, const PhenoLodLink* link, SvgSlot from, SvgSlot to) {
+    uint32_t width = 1;
+    for (uint32_t n = link->count; n > 1 && width < 12; n >>= 1) width++;
+    pheno_writer_lit(w, "    <line x1=\"");
+    pheno_writer_u32(w, from.x + SVG_NODE_WIDTH / 2);
+    pheno_writer_lit(w, "\" y1=\"");
+    pheno_writer_u32(w, from.y + SVG_NODE_HEIGHT / 2);
+    pheno_writer_lit(w, "\" x2=\"");
+    pheno_writer_u32(w, to.x + SVG_NODE_WIDTH / 2);
+    pheno_writer_lit(w, "\" y2=\"");
+    pheno_writer_u32(w, to.y + SVG_NODE_HEIGHT / 2);
+    pheno_writer_lit(w, "\" stroke=\"#90A4AE\" stroke-width=\"");
+    pheno_writer_u32(w, width);
+    pheno_writer_lit(w, "\"><title>");
+    pheno_writer_u32(w, link->count);
+    pheno_writer_lit(w, " relations</title></line>\n");
+}
+
+static uint32_t lod_panel_columns(uint32_t members) {
+    uint32_t cols = 4;
+    while ((uint64_t)cols * cols < members) cols++;
+    return cols;
+}
+
+bool pheno_lod_write_svg(const PhenoLodSummary* summary, const PhenoToken* tokens,
+                         int threads, PhenoWriter* out) {
+    size_t n = summary->count;
+    SvgSlot* slots = (SvgSlot*)malloc((n ? n : 1) * sizeof(SvgSlot));
+    PhenoEdgeTable table = { NULL, 0 };
+    if (summary->link_count) {
+        table.edges = (PhenoAnnotatedEdge*)calloc(summary->link_count, sizeof(PhenoAnnotatedEdge));
+    }
+    if (!slots || (summary->link_count && !table.edges)) {
+        free(slots);
+        free(table.edges);
+        return false;
+    }
+    for (size_t l = 0; l < summary->link_count; l++) {
+        table.edges[l].src_index = summary->links[l].src;
+        table.edges[l].dst_index = summary->links[l].dst;
+        table.edges[l].relation_index = (uint32_t)l;
+    }
+    table.count = summary->link_count;
+    
+    PhenoLayoutOptions layout;
+    pheno_layout_defaults(&layout);
+    layout.threads = threads;
+    uint32_t width, height;
+    svg_place_tokens((int)n, &table, &layout, slots, &width, &height);
+    free(table.edges);
+    
+    // Expanded panels stack below the summary
+    uint64_t total_height = height;
+    for (size_t c = 0; c < n; c++) {
+        const PhenoLodCluster* cluster = &summary->clusters[c];
+        if (!cluster->expanded) continue;
+        uint32_t cols = lod_panel_columns(cluster->member_count);
+        uint32_t rows = (cluster->member_count + cols - 1) / cols;
+        uint32_t panel_width = LOD_MARGIN * 2 + (cols - 1) * LOD_H_SPACING + SVG_NODE_WIDTH;
+        if (panel_width > width) width = panel_width;
+        total_height += LOD_PANEL_HEADER + (uint64_t)(rows ? rows : 1) * LOD_V_SPACING + LOD_MARGIN;
+    }
+    if (total_height > UINT32_MAX) total_height = UINT32_MAX;
+    
+    svg_header(out, width, (uint32_t)total_height);
+    if (summary->link_count) {
+        pheno_writer_lit(out, "  <g class=\"edges\">\n");
+        for (size_t l = 0; l < summary->link_count; l++) {
+            const PhenoLodLink* link = &summary->links[l];
+            lod_link(out, link, slots[link->src], slots[link->dst]);
+        }
+        pheno_writer_lit(out, "  </g>\n");
+    }
+    for (size_t c = 0; c < n; c++) lod_group_box(out, summary, c, slots[c]);
+    
+    uint32_t y = height;
+    for (size_t c = 0; c < n; c++) {
+        const PhenoLodCluster* cluster = &summary->clusters[c];
+        if (!cluster->expanded) continue;
+        char buf[32];
+        const char* label = pheno_lod_label(summary->group, cluster->key, buf);
+        pheno_writer_lit(out, "  <g id=\"expanded-");
+        pheno_writer_u32(out, (uint32_t)c);
+        pheno_writer_lit(out, "\" class=\"expanded\">\n  <text x=\"");
+        pheno_writer_u32(out, LOD_MARGIN);
+        pheno_writer_lit(out, "\" y=\"");
+        pheno_writer_u32(out, y + 30);
+        pheno_writer_lit(out, "\" font-family=\"monospace\" font-size=\"16\" font-weight=\"bold\">");
+        pheno_writer_xml_text(out, label, strlen(label));
+        pheno_writer_lit(out, ": ");
+        pheno_writer_u32(out, cluster->member_count);
+        pheno_writer_lit(out, " of ");
+        pheno_writer_u32(out, cluster->count);
+        pheno_writer_lit(out, " tokens shown</text>\n");
+    
+        uint32_t cols = lod_panel_columns(cluster->member_count);
+        for (uint32_t m = 0; m < cluster->member_count; m++) {
+            svg_node(out, &tokens[cluster->members[m]],
+                     LOD_MARGIN + (m % cols) * LOD_H_SPACING,
+                     y + LOD_PANEL_HEADER + (m / cols) * LOD_V_SPACING);
+        }
+        uint32_t rows = (cluster->member_count + cols - 1) / cols;
+        y += LOD_PANEL_HEADER + (rows ? rows : 1) * LOD_V_SPACING + LOD_MARGIN;
+        pheno_writer_lit(out, "  </g>\n");
+    }
+    
+    pheno_writer_lit(out, "</svg>\n");
+    free(slots);
+    return !out->failed;
+}
+
+int generate_svg_lod(PhenoToken* tokens, int count, const char* output_file,
+                     const PhenoLodOptions* options) {
+    if (count < 0 || (count > 0 && !tokens)) return -1;
+    
+    size_t relation_count = 0;
+    const PhenoEdge* relations = count ? gosiuml_token_relations(tokens, &relation_count) : NULL;
+    PhenoLodSummary summary;
+    if (!pheno_lod_summarize(tokens, (size_t)count, relations, relation_count, options, &summary)) {
+        return -1;
+    }
+    
+    PhenoWriter w;
+    if (!pheno_writer_open(&w, output_file)) {
+        perror("Failed to create SVG file");
+        pheno_lod_free(&summary);
+        return -1;
+    }
+    pheno_lod_write_svg(&summary, tokens, options ? options->threads : 0, &w);
+    pheno_lod_free(&summary);
+    if (!pheno_writer_close(&w)) {
+        fprintf(stderr, "Failed to write SVG file: %s\n", output_file);
+        return -1;
+    }
+    return 0;
+}
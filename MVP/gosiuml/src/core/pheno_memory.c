@@ -4,6 +4,7 @@
 #include <unistd.h>
 #include <sys/mman.h>
 #include "phenomemory_platform.h"
+#include "pheno_symbol.h"
 
 // Global memory pool for phenomenological tokens
 typedef struct {
@@ -16,6 +17,20 @@ typedef struct {
 
 static MemoryPool g_pool = {0};
 
+// PHENO_NIL, the type of every pool token, interned once. assign_token_id
+// relabels the sentinel but not the type.
+static PhenoSymbol g_nil_symbol = PHENO_SYMBOL_NONE;
+static pthread_once_t g_nil_once = PTHREAD_ONCE_INIT;
+
+static void intern_nil_symbol(void) {
+    g_nil_symbol = pheno_symbol_intern("PHENO_NIL", 9);
+}
+
+static PhenoSymbol nil_symbol(void) {
+    pthread_once(&g_nil_once, intern_nil_symbol);
+    return g_nil_symbol;
+}
+
 // Initialize memory pool
 static void init_memory_pool(void) {
     static atomic_bool initialized = ATOMIC_VAR_INIT(false);
@@ -41,6 +56,7 @@ static void init_memory_pool(void) {
 // Allocate a phenomenological token
 PhenoToken* pheno_token_alloc(uint32_t size) {
     init_memory_pool();
+    PhenoSymbol type = nil_symbol();
     
     pthread_mutex_lock(&g_pool.pool_mutex);
     
@@ -64,6 +80,7 @@ PhenoToken* pheno_token_alloc(uint32_t size) {
     
     // Initialize token
     strncpy(token->sentinel, "PHENO_NIL", 16);
+    token->type_symbol = type;
     token->memory_zone = g_pool.used_size / (g_pool.total_size / MAX_MEMORY_ZONES);
     
     // Initialize atomic flags
@@ -113,8 +130,8 @@ void pheno_token_free(PhenoToken* token) {
 bool pheno_token_lock(PhenoToken* token) {
     if (!token) return false;
     
-    // Try to atomically set the lock bit
-    if (test_and_set_flag(&token->mem_flags, FLAG_LOCKED_BIT)) {
+    // Try to atomically set the lock bit (true if it was clear)
+    if (!test_and_set_flag(&token->mem_flags, FLAG_LOCKED_BIT)) {
         return false; // Already locked
     }
     
@@ -137,8 +154,10 @@ void pheno_token_unlock(PhenoToken* token) {
         return;
     }
     
-    clear_flag(&token->mem_flags, FLAG_LOCKED_BIT);
+    // Release ownership before the bit: once it is clear another thread
+    // may take the lock and set its own owner
     token->thread_owner = 0;
+    clear_flag(&token->mem_flags, FLAG_LOCKED_BIT);
     
     printf("[UNLOCK] Token unlocked\n");
 }
@@ -147,9 +166,9 @@ void pheno_token_unlock(PhenoToken* token) {
 bool pheno_token_validate(PhenoToken* token) {
     if (!token) return false;
     
-    // Check sentinel
-    if (strncmp(token->sentinel, "PHENO_", 6) != 0) {
-        printf("[VALIDATE] Invalid sentinel: %s\n", token->sentinel);
+    // Check type: pool tokens are PHENO_NIL
+    if (token->type_symbol == PHENO_SYMBOL_NONE || token->type_symbol != nil_symbol()) {
+        printf("[VALIDATE] Invalid sentinel: %.16s\n", token->sentinel);
         return false;
     }
     
@@ -176,6 +195,17 @@ bool pheno_token_validate(PhenoToken* token) {
     return true;
 }
 
+// Full type name from the symbol table; the sentinel keeps 15 characters
+const char* pheno_token_type(const PhenoToken* token, size_t* len) {
+    const char* name = pheno_symbol_name(token->type_symbol);
+    if (name) {
+        *len = strlen(name);
+        return name;
+    }
+    *len = strnlen(token->sentinel, sizeof(token->sentinel));
+    return token->sentinel;
+}
+
 // Get memory pool statistics
 void pheno_memory_stats(void) {
     init_memory_pool();
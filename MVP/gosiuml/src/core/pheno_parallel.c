@@ -0,0 +1,59 @@
+#include <stdlib.h>
+#include <unistd.h>
+#include <pthread.h>
+#include "pheno_parallel.h"
+
+#define PARALLEL_MAX_THREADS 256
+
+typedef struct {
+    PhenoParallelFunc fn;
+    void* arg;
+    int tid;
+    int nthreads;
+} ParallelTask;
+
+static void* parallel_trampoline(void* p) {
+    ParallelTask* task = (ParallelTask*)p;
+    task->fn(task->arg, task->tid, task->nthreads);
+    return NULL;
+}
+
+int pheno_parallel_threads(int requested) {
+    if (requested > 0) {
+        return requested > PARALLEL_MAX_THREADS ? PARALLEL_MAX_THREADS : requested;
+    }
+    
+    long online = sysconf(_SC_NPROCESSORS_ONLN);
+    if (online < 1) online = 1;
+    if (online > PARALLEL_MAX_THREADS) online = PARALLEL_MAX_THREADS;
+    return (int)online;
+}
+
+void pheno_parallel_run(int nthreads, PhenoParallelFunc fn, void* arg) {
+    if (nthreads < 1) nthreads = 1;
+    if (nthreads > PARALLEL_MAX_THREADS) nthreads = PARALLEL_MAX_THREADS;
+    
+    if (nthreads == 1) {
+        fn(arg, 0, 1);
+        return;
+    }
+    
+    pthread_t threads[PARALLEL_MAX_THREADS];
+    ParallelTask tasks[PARALLEL_MAX_THREADS];
+    int started = 1;
+    
+    for (int t = 1; t < nthreads; t++) {
+        tasks[t] = (ParallelTask){ fn, arg, t, nthreads };
+        if (pthread_create(&threads[t], NULL, parallel_trampoline, &tasks[t]) != 0) break;
+        started++;
+    }
+    
+    // Thread creation failed part way: run the missing workers inline
+    fn(arg, 0, nthreads);
+    for (int t = started; t < nthreads; t++) {
+        fn(arg, t, nthreads);
+    }
+    for (int t = 1; t < started; t++) {
+        pthread_join(threads[t], NULL);
+    }
+}
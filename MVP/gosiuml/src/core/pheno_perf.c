@@ -0,0 +1,242 @@
+#define _GNU_SOURCE
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <time.h>
+#include <pthread.h>
+#include <unistd.h>
+#include <sys/ioctl.h>
+#include <sys/resource.h>
+#include <sys/syscall.h>
+#include <linux/perf_event.h>
+#include "pheno_perf.h"
+
+typedef struct {
+    uint32_t type;
+    uint64_t config;
+    bool kernel;                // Count in the kernel too (switches happen there)
+    const char* name;
+} CounterSpec;
+
+static const CounterSpec COUNTERS[PHENO_PERF_COUNT] = {
+    { PERF_TYPE_HARDWARE, PERF_COUNT_HW_CPU_CYCLES, false, "cycles" },
+    { PERF_TYPE_HARDWARE, PERF_COUNT_HW_INSTRUCTIONS, false, "instructions" },
+    { PERF_TYPE_HARDWARE, PERF_COUNT_HW_CACHE_MISSES, false, "cache-misses" },
+    { PERF_TYPE_HARDWARE, PERF_COUNT_HW_BRANCH_MISSES, false, "branch-misses" },
+    { PERF_TYPE_SOFTWARE, PERF_COUNT_SW_CONTEXT_SWITCHES, true, "context-switches" },
+};
+
+// Group read: nr, time_enabled, time_running, then one value per member
+typedef struct {
+    uint64_t nr;
+    uint64_t time_enabled;
+    uint64_t time_running;
+    uint64_t values[PHENO_PERF_COUNT];
+} GroupReading;
+
+const char* pheno_perf_name(PhenoPerfCounter counter) {
+    return counter < PHENO_PERF_COUNT ? COUNTERS[counter].name : "unknown";
+}
+
+bool pheno_perf_open(PhenoPerf* perf) {
+    memset(perf, 0, sizeof(*perf));
+    perf->leader = -1;
+    for (int c = 0; c < PHENO_PERF_COUNT; c++) {
+        perf->fds[c] = -1;
+    
+        struct perf_event_attr attr;
+        memset(&attr, 0, sizeof(attr));
+        attr.size = sizeof(attr);
+        attr.type = COUNTERS[c].type;
+        attr.config = COUNTERS[c].config;
+        attr.exclude_kernel = !COUNTERS[c].kernel;
+        attr.exclude_hv = 1;
+        attr.disabled = perf->leader < 0;   // The group starts with its leader
+        attr.read_format = PERF_FORMAT_GROUP | PERF_FORMAT_TOTAL_TIME_ENABLED |
+                           PERF_FORMAT_TOTAL_TIME_RUNNING;
+    
+        int fd = (int)syscall(SYS_perf_event_open, &attr, 0, -1, perf->leader, PERF_FLAG_FD_CLOEXEC);
+        if (fd < 0) {
+            if (!perf->error) perf->error = errno;
+            continue;
+        }
+        if (perf->leader < 0) perf->leader = fd;
+        perf->fds[c] = fd;
+        perf->order[perf->members++] = c;
+        perf->available |= 1u << c;
+    }
+    
+    if (perf->leader >= 0) {
+        ioctl(perf->leader, PERF_EVENT_IOC_ENABLE, PERF_IOC_FLAG_GROUP);
+    }
+    if (!(perf->available & (1u << PHENO_PERF_CONTEXT_SWITCHES))) {
+        perf->rusage_switches = true;
+        perf->available |= 1u << PHENO_PERF_CONTEXT_SWITCHES;
+    }
+    return perf->available != 0;
+}
+
+void pheno_perf_close(PhenoPerf* perf) {
+    // Members first, then the leader
+    for (int i = perf->members - 1; i >= 0; i--) {
+        close(perf->fds[perf->order[i]]);
+    }
+    memset(perf, 0, sizeof(*perf));
+    perf->leader = -1;
+}
+
+void pheno_perf_read(const PhenoPerf* perf, PhenoPerfSample* sample) {
+    memset(sample, 0, sizeof(*sample));
+    if (perf->leader >= 0) {
+        GroupReading reading;
+        ssize_t n = read(perf->leader, &reading, sizeof(reading));
+        if (n >= (ssize_t)(3 * sizeof(uint64_t)) && reading.nr == (uint64_t)perf->members) {
+            // Multiplexed groups ran for part of the time: extrapolate
+            double scale = reading.time_running && reading.time_running < reading.time_enabled
+                           ? (double)reading.time_enabled / (double)reading.time_running : 1.0;
+            for (int i = 0; i < perf->members; i++) {
+                int c = perf->order[i];
+                sample->values[c] = scale == 1.0 ? reading.values[i]
+                                                 : (uint64_t)((double)reading.values[i] * scale);
+                sample->valid |= 1u << c;
+            }
+        }
+    }
+    if (perf->rusage_switches) {
+        struct rusage usage;
+        if (getrusage(RUSAGE_THREAD, &usage) == 0) {
+            sample->values[PHENO_PERF_CONTEXT_SWITCHES] = (uint64_t)(usage.ru_nvcsw + usage.ru_nivcsw);
+            sample->valid |= 1u << PHENO_PERF_CONTEXT_SWITCHES;
+        }
+    }
+}
+
+void pheno_perf_delta(const PhenoPerfSample* before, const PhenoPerfSample* after,
+                      PhenoPerfSample* delta) {
+    delta->valid = before->valid & after->valid;
+    for (int c = 0; c < PHENO_PERF_COUNT; c++) {
+        delta->values[c] = (delta->valid & (1u << c)) ? after->values[c] - before->values[c] : 0;
+    }
+}
+
+// ---- Report columns ----
+
+static void print_value(FILE* out, double v, bool valid) {
+    if (!valid) fprintf(out, " %12s", "-");
+    else if (v == 0) fprintf(out, " %12s", "0");
+    else if (v >= 100) fprintf(out, " %12.0f", v);
+    else if (v >= 0.01) fprintf(out, " %12.2f", v);
+    else fprintf(out, " %12.1e", v);
+}
+
+void pheno_perf_print_header(FILE* out) {
+    fprintf(out, " %12s %12s %12s %12s %12s %12s", "cycles", "instructions", "IPC",
+            "cache-miss", "branch-miss", "ctx-switch");
+}
+
+void pheno_perf_print_counts(FILE* out, const double counts[PHENO_PERF_COUNT], uint32_t valid) {
+    uint32_t ipc_mask = (1u << PHENO_PERF_CYCLES) | (1u << PHENO_PERF_INSTRUCTIONS);
+    print_value(out, counts[PHENO_PERF_CYCLES], valid & (1u << PHENO_PERF_CYCLES));
+    print_value(out, counts[PHENO_PERF_INSTRUCTIONS], valid & (1u << PHENO_PERF_INSTRUCTIONS));
+    print_value(out, counts[PHENO_PERF_CYCLES] > 0 ? counts[PHENO_PERF_INSTRUCTIONS] / counts[PHENO_PERF_CYCLES] : 0,
+                (valid & ipc_mask) == ipc_mask && counts[PHENO_PERF_CYCLES] > 0);
+    print_value(out, counts[PHENO_PERF_CACHE_MISSES], valid & (1u << PHENO_PERF_CACHE_MISSES));
+    print_value(out, counts[PHENO_PERF_BRANCH_MISSES], valid & (1u << PHENO_PERF_BRANCH_MISSES));
+    print_value(out, counts[PHENO_PERF_CONTEXT_SWITCHES], valid & (1u << PHENO_PERF_CONTEXT_SWITCHES));
+}
+
+// ---- Runtime probes ----
+
+atomic_bool pheno_perf_probes_on = false;
+
+static _Atomic(PhenoPerfProbe*) g_probes;
+
+// Counters of each thread that entered a probe, closed when it exits
+static pthread_key_t g_thread_key;
+static pthread_once_t g_thread_once = PTHREAD_ONCE_INIT;
+static bool g_thread_key_ok;
+
+static void thread_perf_release(void* p) {
+    pheno_perf_close((PhenoPerf*)p);
+    free(p);
+}
+
+static void thread_perf_key(void) {
+    g_thread_key_ok = pthread_key_create(&g_thread_key, thread_perf_release) == 0;
+}
+
+static PhenoPerf* thread_perf(void) {
+    pthread_once(&g_thread_once, thread_perf_key);
+    if (!g_thread_key_ok) return NULL;
+    
+    PhenoPerf* perf = (PhenoPerf*)pthread_getspecific(g_thread_key);
+    if (!perf && (perf = (PhenoPerf*)malloc(sizeof(*perf)))) {
+        pheno_perf_open(perf);      // Probes still time passes without counters
+        if (pthread_setspecific(g_thread_key, perf) != 0) {
+            thread_perf_release(perf);
+            perf = NULL;
+        }
+    }
+    return perf;
+}
+
+static uint64_t now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000u + (uint64_t)ts.tv_nsec;
+}
+
+void pheno_perf_probes_enable(bool on) {
+    atomic_store(&pheno_perf_probes_on, on);
+}
+
+void pheno_perf_probe_start(PhenoPerfMark* mark) {
+    PhenoPerf* perf = thread_perf();
+    if (perf) pheno_perf_read(perf, &mark->start);
+    else memset(&mark->start, 0, sizeof(mark->start));
+    mark->time_ns = now_ns();
+}
+
+void pheno_perf_probe_stop(PhenoPerfProbe* probe, const PhenoPerfMark* mark) {
+    uint64_t elapsed = now_ns() - mark->time_ns;
+    PhenoPerfSample end, delta;
+    PhenoPerf* perf = thread_perf();
+    if (perf) pheno_perf_read(perf, &end);
+    else memset(&end, 0, sizeof(end));
+    pheno_perf_delta(&mark->start, &end, &delta);
+    
+    atomic_fetch_add_explicit(&probe->calls, 1, memory_order_relaxed);
+    atomic_fetch_add_explicit(&probe->time_ns, elapsed, memory_order_relaxed);
+    for (int c = 0; c < PHENO_PERF_COUNT; c++) {
+        if (delta.valid & (1u << c)) {
+            atomic_fetch_add_explicit(&probe->totals[c], delta.values[c], memory_order_relaxed);
+        }
+    }
+    atomic_fetch_or_explicit(&probe->valid, delta.valid, memory_order_relaxed);
+    
+    if (!atomic_exchange(&probe->registered, true)) {
+        PhenoPerfProbe* head = atomic_load(&g_probes);
+        do {
+            probe->next = head;
+        } while (!atomic_compare_exchange_weak(&g_probes, &head, probe));
+    }
+}
+
+void pheno_perf_probes_report(FILE* out) {
+    fprintf(out, "%-24s %10s %12s", "probe", "calls", "us/call");
+    pheno_perf_print_header(out);
+    fprintf(out, "\n");
+    for (PhenoPerfProbe* p = atomic_load(&g_probes); p; p = p->next) {
+        uint64_t calls = atomic_load(&p->calls);
+        if (!calls) continue;
+    
+        double per_call[PHENO_PERF_COUNT];
+        for (int c = 0; c < PHENO_PERF_COUNT; c++) {
+            per_call[c] = (double)atomic_load(&p->totals[c]) / (double)calls;
+        }
+        fprintf(out, "%-24s %10llu %12.2f", p->name, (unsigned long long)calls,
+                (double)atomic_load(&p->time_ns) / (double)calls / 1e3);
+        pheno_perf_print_counts(out, per_call, atomic_load(&p->valid));
+        fprintf(out, "\n");
+    }
+}
@@ -0,0 +1,317 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "pheno_reach.h"
+#include "pheno_id_map.h"
+
+// Out-edges of one node (destination node indices, duplicates allowed)
+typedef struct {
+    uint32_t* dst;
+    uint32_t count;
+    uint32_t capacity;
+} ReachAdjacency;
+
+// Work space of reach_recompute, sized with the node capacity so that
+// removing an edge never allocates
+typedef struct {
+    uint32_t* order;
+    uint32_t* stack;
+    uint32_t* cursor;
+    uint8_t* seen;
+    uint8_t* marked;
+} ReachScratch;
+
+struct PhenoReachIndex {
+    PhenoIdMap ids;             // token id -> node index
+    ReachAdjacency* out;
+    uint64_t* rows;             // Closure matrix, words_per_row per node
+    size_t words_per_row;
+    size_t node_count;
+    size_t node_capacity;
+    size_t node_limit;
+    bool limit_reported;
+    size_t edge_count;
+    ReachScratch scratch;
+};
+
+#define ROW(index, x) (&(index)->rows[(size_t)(x) * (index)->words_per_row])
+
+static inline bool row_test(const uint64_t* row, uint32_t bit) {
+    return (row[bit >> 6] >> (bit & 63)) & 1;
+}
+
+static inline void row_set(uint64_t* row, uint32_t bit) {
+    row[bit >> 6] |= 1ULL << (bit & 63);
+}
+
+// row |= other over the used words; returns true if row changed
+static inline bool row_or(uint64_t* row, const uint64_t* other, size_t words) {
+    uint64_t changed = 0;
+    for (size_t w = 0; w < words; w++) {
+        uint64_t merged = row[w] | other[w];
+        changed |= merged ^ row[w];
+        row[w] = merged;
+    }
+    return changed != 0;
+}
+
+PhenoReachIndex* reach_index_create(void) {
+    PhenoReachIndex* index = (PhenoReachIndex*)calloc(1, sizeof(PhenoReachIndex));
+    if (!index) return NULL;
+    
+    if (!pheno_id_map_init(&index->ids, 64)) {
+        free(index);
+        return NULL;
+    }
+    index->node_limit = PHENO_REACH_MAX_NODES;
+    return index;
+}
+
+size_t reach_index_set_node_limit(PhenoReachIndex* index, size_t max_nodes) {
+    index->node_limit = max_nodes < PHENO_REACH_MAX_NODES ? max_nodes : PHENO_REACH_MAX_NODES;
+    index->limit_reported = false;
+    return index->node_limit;
+}
+
+void reach_index_destroy(PhenoReachIndex* index) {
+    if (!index) return;
+    
+    for (size_t i = 0; i < index->node_count; i++) {
+        free(index->out[i].dst);
+    }
+    free(index->out);
+    free(index->rows);
+    free(index->scratch.order);
+    pheno_id_map_free(&index->ids);
+    free(index);
+}
+
+// Double node capacity (up to the limit), widening every closure row
+static bool reach_grow(PhenoReachIndex* index) {
+    size_t capacity = index->node_capacity ? index->node_capacity * 2 : 64;
+    size_t limit = (index->node_limit + 63) & ~(size_t)63;
+    if (capacity > limit && limit > index->node_capacity) capacity = limit;
+    size_t words = capacity / 64;
+    
+    // One block for the scratch arrays: three of uint32_t, two of bytes
+    uint64_t* rows = (uint64_t*)calloc(capacity * words, sizeof(uint64_t));
+    uint32_t* scratch = (uint32_t*)malloc(capacity * (3 * sizeof(uint32_t) + 2));
+    ReachAdjacency* out = (ReachAdjacency*)realloc(index->out, capacity * sizeof(ReachAdjacency));
+    if (!rows || !scratch || !out) {
+        free(rows);
+        free(scratch);
+        if (out) index->out = out;
+        return false;
+    }
+    free(index->scratch.order);
+    index->scratch.order = scratch;
+    index->scratch.stack = scratch + capacity;
+    index->scratch.cursor = scratch + 2 * capacity;
+    index->scratch.seen = (uint8_t*)(scratch + 3 * capacity);
+    index->scratch.marked = index->scratch.seen + capacity;
+    
+    for (size_t x = 0; x < index->node_count; x++) {
+        memcpy(&rows[x * words], ROW(index, x), index->words_per_row * sizeof(uint64_t));
+    }
+    free(index->rows);
+    index->rows = rows;
+    index->out = out;
+    index->words_per_row = words;
+    index->node_capacity = capacity;
+    return true;
+}
+
+// Node index for a token id, creating the node on first use. Known ids
+// are looked up first, so they never touch the allocator.
+static int64_t reach_node(PhenoReachIndex* index, uint32_t id) {
+    uint32_t node;
+    if (pheno_id_map_get(&index->ids, id, &node)) return node;
+    if (index->node_count >= index->node_limit) {
+        if (!index->limit_reported) {
+            fprintf(stderr, "[REACH] More than %zu related tokens; the closure needs n^2/8 bytes, "
+                            "so relations to further tokens are refused\n", index->node_limit);
+            index->limit_reported = true;
+        }
+        return -1;
+    }
+    int rc = pheno_id_map_insert(&index->ids, id, (uint32_t)index->node_count, &node);
+    if (rc <= 0) return rc < 0 ? -1 : (int64_t)node;
+    
+    if (index->node_count == index->node_capacity && !reach_grow(index)) {
+        pheno_id_map_remove(&index->ids, id);
+        return -1;
+    }
+    memset(&index->out[node], 0, sizeof(ReachAdjacency));
+    row_set(ROW(index, node), node);
+    index->node_count++;
+    return node;
+}
+
+static bool adjacency_push(ReachAdjacency* adj, uint32_t dst) {
+    if (adj->count == adj->capacity) {
+        uint32_t capacity = adj->capacity ? adj->capacity * 2 : 4;
+        uint32_t* grown = (uint32_t*)realloc(adj->dst, capacity * sizeof(uint32_t));
+        if (!grown) return false;
+        adj->dst = grown;
+        adj->capacity = capacity;
+    }
+    adj->dst[adj->count++] = dst;
+    return true;
+}
+
+// Remove one instance of dst; returns whether another instance remains
+static bool adjacency_pop(ReachAdjacency* adj, uint32_t dst, bool* found) {
+    bool remaining = false;
+    *found = false;
+    for (uint32_t i = 0; i < adj->count; i++) {
+        if (adj->dst[i] != dst) continue;
+        if (*found) {
+            remaining = true;
+            break;
+        }
+        adj->dst[i] = adj->dst[--adj->count];
+        *found = true;
+        i--;
+    }
+    return remaining;
+}
+
+// Recompute the closure rows of the nodes marked in the scratch space,
+// whose reach sets may have shrunk. Unmarked rows are already exact.
+// Nodes are relaxed in DFS post-order, so acyclic regions settle in a
+// single pass.
+static void reach_recompute(PhenoReachIndex* index) {
+    size_t n = index->node_count;
+    uint32_t* order = index->scratch.order;
+    uint32_t* stack = index->scratch.stack;
+    uint32_t* cursor = index->scratch.cursor;
+    uint8_t* seen = index->scratch.seen;
+    const uint8_t* marked = index->scratch.marked;
+    memset(cursor, 0, n * sizeof(uint32_t));
+    memset(seen, 0, n);
+    
+    size_t ordered = 0;
+    for (uint32_t root = 0; root < n; root++) {
+        if (!marked[root] || seen[root]) continue;
+        
+        size_t depth = 0;
+        stack[depth++] = root;
+        seen[root] = 1;
+        while (depth) {
+            uint32_t x = stack[depth - 1];
+            ReachAdjacency* adj = &index->out[x];
+            if (cursor[x] < adj->count) {
+                uint32_t y = adj->dst[cursor[x]++];
+                if (marked[y] && !seen[y]) {
+                    seen[y] = 1;
+                    stack[depth++] = y;
+                }
+                continue;
+            }
+            order[ordered++] = x;
+            depth--;
+        }
+    }
+    
+    for (size_t i = 0; i < ordered; i++) {
+        uint64_t* row = ROW(index, order[i]);
+        memset(row, 0, index->words_per_row * sizeof(uint64_t));
+        row_set(row, order[i]);
+    }
+    
+    size_t words = (n + 63) / 64;
+    bool changed = true;
+    while (changed) {
+        changed = false;
+        for (size_t i = 0; i < ordered; i++) {
+            uint32_t x = order[i];
+            ReachAdjacency* adj = &index->out[x];
+            for (uint32_t e = 0; e < adj->count; e++) {
+                if (adj->dst[e] == x) continue;
+                changed |= row_or(ROW(index, x), ROW(index, adj->dst[e]), words);
+            }
+        }
+    }
+}
+
+bool reach_add_edge(PhenoReachIndex* index, uint32_t src_id, uint32_t dst_id) {
+    if (!index) return false;
+    
+    int64_t u = reach_node(index, src_id);
+    int64_t v = reach_node(index, dst_id);
+    if (u < 0 || v < 0) return false;
+    if (!adjacency_push(&index->out[u], (uint32_t)v)) return false;
+    index->edge_count++;
+    
+    if (row_test(ROW(index, u), (uint32_t)v)) return true;
+    
+    // Every node that reaches u now also reaches everything v reaches
+    size_t words = (index->node_count + 63) / 64;
+    const uint64_t* reach_v = ROW(index, v);
+    for (size_t x = 0; x < index->node_count; x++) {
+        uint64_t* row = ROW(index, x);
+        if (row_test(row, (uint32_t)u)) row_or(row, reach_v, words);
+    }
+    return true;
+}
+
+bool reach_remove_edge(PhenoReachIndex* index, uint32_t src_id, uint32_t dst_id) {
+    if (!index) return false;
+    
+    uint32_t u, v;
+    if (!pheno_id_map_get(&index->ids, src_id, &u) ||
+        !pheno_id_map_get(&index->ids, dst_id, &v)) {
+        return false;
+    }
+    
+    bool found;
+    bool parallel = adjacency_pop(&index->out[u], v, &found);
+    if (!found) return false;
+    index->edge_count--;
+    if (parallel || u == v) return true;
+    
+    // Only rows that reached u can lose members
+    for (size_t x = 0; x < index->node_count; x++) {
+        index->scratch.marked[x] = row_test(ROW(index, x), u);
+    }
+    reach_recompute(index);
+    return true;
+}
+
+bool reach_add_edges(PhenoReachIndex* index, const PhenoEdge* edges, size_t count) {
+    if (!index || (!edges && count)) return false;
+    
+    bool ok = true;
+    for (size_t i = 0; ok && i < count; i++) {
+        int64_t u = reach_node(index, edges[i].src_id);
+        int64_t v = reach_node(index, edges[i].dst_id);
+        ok = u >= 0 && v >= 0 && adjacency_push(&index->out[u], (uint32_t)v);
+        if (ok) index->edge_count++;
+    }
+    
+    // Also after a failure, so the closure covers the edges that were added
+    if (index->node_count) {
+        memset(index->scratch.marked, 1, index->node_count);
+        reach_recompute(index);
+    }
+    return ok;
+}
+
+bool reach_query(const PhenoReachIndex* index, uint32_t from_id, uint32_t to_id) {
+    if (!index) return false;
+    
+    uint32_t from, to;
+    if (!pheno_id_map_get(&index->ids, from_id, &from) ||
+        !pheno_id_map_get(&index->ids, to_id, &to)) {
+        return false;
+    }
+    return row_test(ROW(index, from), to);
+}
+
+size_t reach_node_count(const PhenoReachIndex* index) {
+    return index ? index->node_count : 0;
+}
+
+size_t reach_edge_count(const PhenoReachIndex* index) {
+    return index ? index->edge_count : 0;
+}
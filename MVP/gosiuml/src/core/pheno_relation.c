@@ -1,5 +1,15 @@
+#include <string.h>
 #include "phenomemory_platform.h"
 
+// The default flags target baseline x86-64, which has neither SSSE3 nor
+// popcnt: the vector kernels are compiled for them explicitly and
+// chosen at run time
+#if defined(__x86_64__) || defined(__i386__)
+#include <tmmintrin.h>
+#define PERSON_MODEL_SIMD 1
+#define PERSON_MODEL_TARGET __attribute__((target("ssse3,popcnt")))
+#endif
+
 // Object-to-Object mapping function
 void map_obj_to_obj(PhenoRelation* src, PhenoRelation* dst) {
     // XOR for differential mapping
@@ -11,6 +21,13 @@ void map_obj_to_obj(PhenoRelation* src, PhenoRelation* dst) {
     dst->person_state = ROTATE_LEFT(src->person_state, 2);
 }
 
+// Person state flags: bit0 Active (a&0x01), bit1 Connected (b&0x02),
+// bit2 Differential ((a^b)&0x04) - all three keep their bit position
+static inline uint8_t person_state_bits(uint8_t person_a, uint8_t person_b) {
+    return (uint8_t)((person_a & 0x01) | (person_b & 0x02) |
+                     ((person_a ^ person_b) & 0x04));
+}
+
 // Person-to-Person model implementation
 void apply_person_model(PhenoRelation* rel, uint8_t person_a, uint8_t person_b) {
     // Set person IDs using bit operations
@@ -18,16 +35,109 @@ void apply_person_model(PhenoRelation* rel, uint8_t person_a, uint8_t person_b)
     rel->person_role = person_b;
     
     // Calculate authority level using bit counting
-    uint8_t xor_val = person_a ^ person_b;
-    rel->person_auth = 0;
-    while (xor_val) {
-        rel->person_auth += xor_val & 1;
-        xor_val >>= 1;
-    }
+    rel->person_auth = (uint8_t)__builtin_popcount(person_a ^ person_b);
     
     // Set state flags
-    rel->person_state = 0;
-    if (person_a & 0x01) BIT_SET(rel->person_state, 0); // Active
-    if (person_b & 0x02) BIT_SET(rel->person_state, 1); // Connected
-    if ((person_a ^ person_b) & 0x04) BIT_SET(rel->person_state, 2); // Differential
+    rel->person_state = person_state_bits(person_a, person_b);
+}
+
+#ifdef PERSON_MODEL_SIMD
+static bool person_model_simd(void) {
+    return __builtin_cpu_supports("ssse3") && __builtin_cpu_supports("popcnt");
+}
+
+// Score 16 person pairs at once and write the person quad of 16
+// consecutive relations. Popcount uses the nibble lookup table.
+static inline PERSON_MODEL_TARGET void person_model_kernel16(PhenoRelation* out, __m128i a, __m128i b) {
+    const __m128i nibble_lut = _mm_setr_epi8(0, 1, 1, 2, 1, 2, 2, 3,
+                                             1, 2, 2, 3, 2, 3, 3, 4);
+    const __m128i low_mask = _mm_set1_epi8(0x0F);
+    
+    __m128i x = _mm_xor_si128(a, b);
+    __m128i lo = _mm_and_si128(x, low_mask);
+    __m128i hi = _mm_and_si128(_mm_srli_epi16(x, 4), low_mask);
+    __m128i auth = _mm_add_epi8(_mm_shuffle_epi8(nibble_lut, lo),
+                                _mm_shuffle_epi8(nibble_lut, hi));
+    
+    __m128i state = _mm_or_si128(
+        _mm_or_si128(_mm_and_si128(a, _mm_set1_epi8(0x01)),
+                     _mm_and_si128(b, _mm_set1_epi8(0x02))),
+        _mm_and_si128(x, _mm_set1_epi8(0x04)));
+    
+    // Interleave into {id, role, auth, state} quads matching the struct tail
+    __m128i ab_lo = _mm_unpacklo_epi8(a, b);
+    __m128i ab_hi = _mm_unpackhi_epi8(a, b);
+    __m128i as_lo = _mm_unpacklo_epi8(auth, state);
+    __m128i as_hi = _mm_unpackhi_epi8(auth, state);
+    
+    uint32_t quads[16];
+    _mm_storeu_si128((__m128i*)&quads[0],  _mm_unpacklo_epi16(ab_lo, as_lo));
+    _mm_storeu_si128((__m128i*)&quads[4],  _mm_unpackhi_epi16(ab_lo, as_lo));
+    _mm_storeu_si128((__m128i*)&quads[8],  _mm_unpacklo_epi16(ab_hi, as_hi));
+    _mm_storeu_si128((__m128i*)&quads[12], _mm_unpackhi_epi16(ab_hi, as_hi));
+    
+    for (int k = 0; k < 16; k++) {
+        memcpy(&out[k].person_id, &quads[k], sizeof(uint32_t));
+    }
+}
+
+// Whole blocks of 16 of a batch; returns how many relations were written
+static PERSON_MODEL_TARGET size_t person_model_batch16(PhenoRelation* rels, const uint8_t* person_a,
+                                                       const uint8_t* person_b, size_t count) {
+    size_t i = 0;
+    for (; i + 16 <= count; i += 16) {
+        person_model_kernel16(&rels[i],
+                              _mm_loadu_si128((const __m128i*)&person_a[i]),
+                              _mm_loadu_si128((const __m128i*)&person_b[i]));
+    }
+    return i;
+}
+
+// Whole blocks of 16 of one row of the pair matrix
+static PERSON_MODEL_TARGET size_t person_model_row16(PhenoRelation* row, uint8_t person_a,
+                                                     const uint8_t* persons_b, size_t count_b) {
+    __m128i a = _mm_set1_epi8((char)person_a);
+    size_t j = 0;
+    for (; j + 16 <= count_b; j += 16) {
+        person_model_kernel16(&row[j], a, _mm_loadu_si128((const __m128i*)&persons_b[j]));
+    }
+    return j;
+}
+#endif
+
+// Batch person model: rels[i] <- (person_a[i], person_b[i])
+void apply_person_model_batch(PhenoRelation* rels, const uint8_t* person_a,
+                              const uint8_t* person_b, size_t count) {
+    if (!rels || !person_a || !person_b) return;
+    
+    size_t i = 0;
+#ifdef PERSON_MODEL_SIMD
+    if (person_model_simd()) i = person_model_batch16(rels, person_a, person_b, count);
+#endif
+    for (; i < count; i++) {
+        apply_person_model(&rels[i], person_a[i], person_b[i]);
+    }
+}
+
+// All-pairs person model over a block of the interaction matrix:
+// rels[i * count_b + j] <- (persons_a[i], persons_b[j]). Large cohorts
+// are scored by tiling the matrix into blocks that fit the output buffer.
+void apply_person_model_pairs(PhenoRelation* rels,
+                              const uint8_t* persons_a, size_t count_a,
+                              const uint8_t* persons_b, size_t count_b) {
+    if (!rels || !persons_a || !persons_b) return;
+    
+#ifdef PERSON_MODEL_SIMD
+    bool simd = person_model_simd();
+#endif
+    for (size_t i = 0; i < count_a; i++) {
+        PhenoRelation* row = &rels[i * count_b];
+        size_t j = 0;
+#ifdef PERSON_MODEL_SIMD
+        if (simd) j = person_model_row16(row, persons_a[i], persons_b, count_b);
+#endif
+        for (; j < count_b; j++) {
+            apply_person_model(&row[j], persons_a[i], persons_b[j]);
+        }
+    }
 }
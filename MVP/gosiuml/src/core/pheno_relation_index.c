@@ -0,0 +1,236 @@
+#include <stdlib.h>
+#include "pheno_relation_index.h"
+
+static const PhenoRelationField default_fields[] = {
+    REL_FIELD_SUBJECT_ID,
+    REL_FIELD_CLASS_ID,
+    REL_FIELD_PERSON_ID
+};
+
+static void field_index_free(PhenoFieldIndex* fi) {
+    if (!fi) return;
+    
+    for (int v = 0; v < 256; v++) pheno_bitmap_free(&fi->values[v]);
+    for (int b = 0; b < 8; b++) pheno_bitmap_free(&fi->bits[b]);
+    free(fi);
+}
+
+// Add (or remove) a row under one field value and its set bits
+static bool field_index_add(PhenoFieldIndex* fi, uint32_t row, uint8_t value) {
+    if (!pheno_bitmap_add(&fi->values[value], row)) return false;
+    
+    for (int b = 0; b < 8; b++) {
+        if ((value >> b) & 1) {
+            if (!pheno_bitmap_add(&fi->bits[b], row)) return false;
+        }
+    }
+    return true;
+}
+
+static void field_index_remove(PhenoFieldIndex* fi, uint32_t row, uint8_t value) {
+    pheno_bitmap_remove(&fi->values[value], row);
+    
+    for (int b = 0; b < 8; b++) {
+        if ((value >> b) & 1) pheno_bitmap_remove(&fi->bits[b], row);
+    }
+}
+
+// Index one row of the table under every indexed field
+static bool index_row(PhenoRelationIndex* index, uint32_t row) {
+    for (int f = 0; f < REL_FIELD_COUNT; f++) {
+        if (index->fields[f] &&
+            !field_index_add(index->fields[f], row, index->table->columns[f][row])) {
+            return false;
+        }
+    }
+    return pheno_bitmap_add(&index->live, row);
+}
+
+static void unindex_row(PhenoRelationIndex* index, uint32_t row) {
+    for (int f = 0; f < REL_FIELD_COUNT; f++) {
+        if (index->fields[f]) {
+            field_index_remove(index->fields[f], row, index->table->columns[f][row]);
+        }
+    }
+    pheno_bitmap_remove(&index->live, row);
+}
+
+// Build indexes over the rows already present in the table
+PhenoRelationIndex* relation_index_create(PhenoRelationTable* table,
+                                          const PhenoRelationField* fields,
+                                          size_t field_count) {
+    if (!table) return NULL;
+    
+    if (!fields) {
+        fields = default_fields;
+        field_count = sizeof(default_fields) / sizeof(default_fields[0]);
+    }
+    
+    PhenoRelationIndex* index = (PhenoRelationIndex*)calloc(1, sizeof(PhenoRelationIndex));
+    if (!index) return NULL;
+    index->table = table;
+    pheno_bitmap_init(&index->live);
+    
+    for (size_t i = 0; i < field_count; i++) {
+        PhenoRelationField f = fields[i];
+        if (f >= REL_FIELD_COUNT || index->fields[f]) continue;
+        
+        // calloc leaves every bitmap in its initialized (empty) state
+        index->fields[f] = (PhenoFieldIndex*)calloc(1, sizeof(PhenoFieldIndex));
+        if (!index->fields[f]) {
+            relation_index_destroy(index);
+            return NULL;
+        }
+    }
+    
+    for (size_t row = 0; row < table->count; row++) {
+        if (!index_row(index, (uint32_t)row)) {
+            relation_index_destroy(index);
+            return NULL;
+        }
+    }
+    return index;
+}
+
+void relation_index_destroy(PhenoRelationIndex* index) {
+    if (!index) return;
+    
+    for (int f = 0; f < REL_FIELD_COUNT; f++) {
+        field_index_free(index->fields[f]);
+    }
+    pheno_bitmap_free(&index->live);
+    free(index);
+}
+
+// Append a relation to the table and index it
+int64_t relation_index_insert(PhenoRelationIndex* index, const PhenoRelation* rel) {
+    if (!index || !rel) return -1;
+    
+    uint32_t row = (uint32_t)index->table->count;
+    if (!relation_table_append(index->table, rel)) return -1;
+    if (!index_row(index, row)) {
+        // Take back the partial index entries and the appended row
+        unindex_row(index, row);
+        index->table->count = row;
+        return -1;
+    }
+    return row;
+}
+
+// Tombstone a row: it stays in the table but leaves every bitmap
+bool relation_index_delete(PhenoRelationIndex* index, uint32_t row) {
+    if (!index || !pheno_bitmap_contains(&index->live, row)) return false;
+    
+    unindex_row(index, row);
+    return true;
+}
+
+// Rewrite a live row in place; on failure the old values go back
+bool relation_index_update(PhenoRelationIndex* index, uint32_t row, const PhenoRelation* rel) {
+    if (!index || !rel || !pheno_bitmap_contains(&index->live, row)) return false;
+    
+    PhenoRelation old;
+    relation_table_get(index->table, row, &old);
+    unindex_row(index, row);
+    relation_table_set(index->table, row, rel);
+    if (index_row(index, row)) return true;
+    
+    unindex_row(index, row);
+    relation_table_set(index->table, row, &old);
+    if (!index_row(index, row)) unindex_row(index, row);    // Left deleted
+    return false;
+}
+
+const PhenoBitmap* relation_index_eq(const PhenoRelationIndex* index,
+                                     PhenoRelationField field, uint8_t value) {
+    if (!index || field >= REL_FIELD_COUNT || !index->fields[field]) return NULL;
+    return &index->fields[field]->values[value];
+}
+
+const PhenoBitmap* relation_index_bit(const PhenoRelationIndex* index,
+                                      PhenoRelationField field, int bit) {
+    if (!index || field >= REL_FIELD_COUNT || !index->fields[field]) return NULL;
+    if (bit < 0 || bit > 7) return NULL;
+    return &index->fields[field]->bits[bit];
+}
+
+const PhenoBitmap* relation_index_live(const PhenoRelationIndex* index) {
+    return index ? &index->live : NULL;
+}
+
+// Rows matching a predicate, ignoring negation (EQ/NE -> value bitmap,
+// ANY_BITS/NO_BITS -> union of bit bitmaps). May return a borrowed bitmap
+// or fill scratch.
+static const PhenoBitmap* predicate_bitmap(const PhenoRelationIndex* index,
+                                           const PhenoRelationPredicate* pred,
+                                           PhenoBitmap* scratch, PhenoBitmap* tmp) {
+    const PhenoFieldIndex* fi = index->fields[pred->field];
+    
+    if (pred->op == REL_PRED_EQ || pred->op == REL_PRED_NE) {
+        return &fi->values[pred->value];
+    }
+    
+    const PhenoBitmap* acc = NULL;
+    for (int b = 0; b < 8; b++) {
+        if (!((pred->value >> b) & 1)) continue;
+        if (!acc) {
+            acc = &fi->bits[b];
+            continue;
+        }
+        if (!pheno_bitmap_or(acc, &fi->bits[b], tmp)) return NULL;
+        PhenoBitmap swap = *scratch; *scratch = *tmp; *tmp = swap;
+        acc = scratch;
+    }
+    if (!acc) {
+        pheno_bitmap_clear(scratch);  // Empty mask matches nothing
+        acc = scratch;
+    }
+    return acc;
+}
+
+bool relation_index_query(const PhenoRelationIndex* index,
+                          const PhenoRelationPredicate* preds, size_t pred_count,
+                          PhenoBitmap* out) {
+    if (!index || !out) return false;
+    
+    size_t first = pred_count;
+    for (size_t p = 0; p < pred_count; p++) {
+        if (preds[p].field >= REL_FIELD_COUNT || !index->fields[preds[p].field]) return false;
+        bool negated = preds[p].op == REL_PRED_NE || preds[p].op == REL_PRED_NO_BITS;
+        if (!negated && first == pred_count) first = p;
+    }
+    
+    PhenoBitmap acc, scratch, tmp;
+    pheno_bitmap_init(&acc);
+    pheno_bitmap_init(&scratch);
+    pheno_bitmap_init(&tmp);
+    
+    // Seed from the first positive predicate; only all-negative queries
+    // start from the live set
+    const PhenoBitmap* seed = &index->live;
+    if (first < pred_count) seed = predicate_bitmap(index, &preds[first], &scratch, &tmp);
+    bool ok = seed && pheno_bitmap_copy(&acc, seed);
+    
+    // Remaining positive predicates, then negations on the smaller set
+    for (int pass = 0; pass < 2 && ok; pass++) {
+        for (size_t p = 0; p < pred_count && ok; p++) {
+            bool negated = preds[p].op == REL_PRED_NE || preds[p].op == REL_PRED_NO_BITS;
+            if (p == first || negated != (pass == 1)) continue;
+            
+            const PhenoBitmap* bm = predicate_bitmap(index, &preds[p], &scratch, &tmp);
+            if (!bm) { ok = false; break; }
+            
+            ok = negated ? pheno_bitmap_andnot(&acc, bm, out)
+                         : pheno_bitmap_and(&acc, bm, out);
+            PhenoBitmap swap = acc; acc = *out; *out = swap;
+        }
+    }
+    
+    if (ok) {
+        PhenoBitmap swap = acc; acc = *out; *out = swap;
+    }
+    pheno_bitmap_free(&acc);
+    pheno_bitmap_free(&scratch);
+    pheno_bitmap_free(&tmp);
+    return ok;
+}
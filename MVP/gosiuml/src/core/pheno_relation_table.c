@@ -0,0 +1,262 @@
+#include <stdlib.h>
+#include <string.h>
+#include "pheno_relation_table.h"
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+// Column buffers are cache-line aligned and sized in whole lines
+#define COLUMN_ALIGN 64
+#define TABLE_MIN_CAPACITY 1024
+
+_Static_assert(sizeof(PhenoRelation) == REL_FIELD_COUNT,
+               "PhenoRelation must be one byte per field");
+
+// Create an empty relation table
+PhenoRelationTable* relation_table_create(size_t initial_capacity) {
+    PhenoRelationTable* table = (PhenoRelationTable*)calloc(1, sizeof(PhenoRelationTable));
+    if (!table) return NULL;
+    
+    if (!relation_table_reserve(table, initial_capacity)) {
+        free(table);
+        return NULL;
+    }
+    return table;
+}
+
+// Destroy a relation table and its columns
+void relation_table_destroy(PhenoRelationTable* table) {
+    if (!table) return;
+    
+    for (int f = 0; f < REL_FIELD_COUNT; f++) {
+        free(table->columns[f]);
+    }
+    free(table);
+}
+
+// Grow every column to hold at least capacity rows
+bool relation_table_reserve(PhenoRelationTable* table, size_t capacity) {
+    if (!table) return false;
+    if (capacity <= table->capacity && table->columns[0]) return true;
+    if (capacity > UINT32_MAX) return false;
+    
+    if (capacity < TABLE_MIN_CAPACITY) capacity = TABLE_MIN_CAPACITY;
+    capacity = (capacity + COLUMN_ALIGN - 1) & ~(size_t)(COLUMN_ALIGN - 1);
+    
+    uint8_t* columns[REL_FIELD_COUNT];
+    for (int f = 0; f < REL_FIELD_COUNT; f++) {
+        columns[f] = (uint8_t*)aligned_alloc(COLUMN_ALIGN, capacity);
+        if (!columns[f]) {
+            while (--f >= 0) free(columns[f]);
+            return false;
+        }
+    }
+    
+    for (int f = 0; f < REL_FIELD_COUNT; f++) {
+        if (table->columns[f]) {
+            memcpy(columns[f], table->columns[f], table->count);
+            free(table->columns[f]);
+        }
+        table->columns[f] = columns[f];
+    }
+    table->capacity = capacity;
+    return true;
+}
+
+// Drop all rows, keeping the column buffers
+void relation_table_clear(PhenoRelationTable* table) {
+    if (table) table->count = 0;
+}
+
+#ifdef __SSE2__
+// In-place 16x16 byte transpose. One interleave round of rows i and
+// i+8 rotates the (row, col) index bits left by one; four rounds swap
+// the row and column nibbles.
+static inline void transpose16x16(__m128i m[16]) {
+    for (int round = 0; round < 4; round++) {
+        __m128i t[16];
+        for (int i = 0; i < 8; i++) {
+            t[2 * i]     = _mm_unpacklo_epi8(m[i], m[i + 8]);
+            t[2 * i + 1] = _mm_unpackhi_epi8(m[i], m[i + 8]);
+        }
+        memcpy(m, t, sizeof(t));
+    }
+}
+#endif
+
+// Append a single relation
+bool relation_table_append(PhenoRelationTable* table, const PhenoRelation* rel) {
+    if (!table || !rel) return false;
+    
+    if (table->count == table->capacity &&
+        !relation_table_reserve(table, table->capacity * 2)) {
+        return false;
+    }
+    relation_table_set(table, table->count++, rel);
+    return true;
+}
+
+// Append relations in bulk, transposing 16 rows at a time
+bool relation_table_append_batch(PhenoRelationTable* table,
+                                 const PhenoRelation* rels, size_t count) {
+    if (!table || (!rels && count)) return false;
+    
+    size_t needed = table->count + count;
+    if (needed > table->capacity) {
+        size_t capacity = table->capacity * 2;
+        if (capacity < needed) capacity = needed;
+        if (!relation_table_reserve(table, capacity)) return false;
+    }
+    
+    size_t base = table->count;
+    size_t i = 0;
+#ifdef __SSE2__
+    for (; i + 16 <= count; i += 16) {
+        __m128i m[16];
+        for (int r = 0; r < 16; r++) {
+            m[r] = _mm_loadu_si128((const __m128i*)&rels[i + r]);
+        }
+        transpose16x16(m);
+        for (int f = 0; f < REL_FIELD_COUNT; f++) {
+            _mm_storeu_si128((__m128i*)&table->columns[f][base + i], m[f]);
+        }
+    }
+#endif
+    for (; i < count; i++) {
+        relation_table_set(table, base + i, &rels[i]);
+    }
+    
+    table->count = needed;
+    return true;
+}
+
+// Gather one row back into a PhenoRelation
+void relation_table_get(const PhenoRelationTable* table, size_t row, PhenoRelation* out) {
+    uint8_t* bytes = (uint8_t*)out;
+    for (int f = 0; f < REL_FIELD_COUNT; f++) {
+        bytes[f] = table->columns[f][row];
+    }
+}
+
+// Scatter a PhenoRelation into an existing row
+void relation_table_set(PhenoRelationTable* table, size_t row, const PhenoRelation* rel) {
+    const uint8_t* bytes = (const uint8_t*)rel;
+    for (int f = 0; f < REL_FIELD_COUNT; f++) {
+        table->columns[f][row] = bytes[f];
+    }
+}
+
+// Convert a row range back to array-of-structs form
+void relation_table_export(const PhenoRelationTable* table, size_t start,
+                           size_t count, PhenoRelation* out) {
+    size_t i = 0;
+#ifdef __SSE2__
+    for (; i + 16 <= count; i += 16) {
+        __m128i m[16];
+        for (int f = 0; f < REL_FIELD_COUNT; f++) {
+            m[f] = _mm_loadu_si128((const __m128i*)&table->columns[f][start + i]);
+        }
+        transpose16x16(m);
+        for (int r = 0; r < 16; r++) {
+            _mm_storeu_si128((__m128i*)&out[i + r], m[r]);
+        }
+    }
+#endif
+    for (; i < count; i++) {
+        relation_table_get(table, start + i, &out[i]);
+    }
+}
+
+// Evaluate a predicate on a single byte
+static inline bool pred_match(const PhenoRelationPredicate* pred, uint8_t v) {
+    switch (pred->op) {
+        case REL_PRED_EQ:       return v == pred->value;
+        case REL_PRED_NE:       return v != pred->value;
+        case REL_PRED_ANY_BITS: return (v & pred->value) != 0;
+        case REL_PRED_NO_BITS:  return (v & pred->value) == 0;
+    }
+    return false;
+}
+
+#ifdef __SSE2__
+// Evaluate a predicate on 16 consecutive rows, one mask bit per row
+static inline uint32_t pred_mask16(const PhenoRelationPredicate* pred, const uint8_t* col) {
+    __m128i v = _mm_loadu_si128((const __m128i*)col);
+    __m128i k = _mm_set1_epi8((char)pred->value);
+    __m128i hit;
+    
+    switch (pred->op) {
+        case REL_PRED_EQ:
+        case REL_PRED_NE:
+            hit = _mm_cmpeq_epi8(v, k);
+            break;
+        default:
+            hit = _mm_cmpeq_epi8(_mm_and_si128(v, k), _mm_setzero_si128());
+            break;
+    }
+    
+    uint32_t mask = (uint32_t)_mm_movemask_epi8(hit);
+    // NE and ANY_BITS are the complements of the compares above
+    if (pred->op == REL_PRED_NE || pred->op == REL_PRED_ANY_BITS) {
+        mask ^= 0xFFFF;
+    }
+    return mask;
+}
+#endif
+
+// Conjunctive predicate scan over the whole table
+size_t relation_table_scan(const PhenoRelationTable* table,
+                           const PhenoRelationPredicate* preds, size_t pred_count,
+                           uint32_t* sel) {
+    if (!table || !sel) return 0;
+    
+    size_t n = 0;
+    size_t row = 0;
+#ifdef __SSE2__
+    for (; row + 16 <= table->count; row += 16) {
+        uint32_t mask = 0xFFFF;
+        for (size_t p = 0; p < pred_count && mask; p++) {
+            mask &= pred_mask16(&preds[p], &table->columns[preds[p].field][row]);
+        }
+        while (mask) {
+            sel[n++] = (uint32_t)(row + __builtin_ctz(mask));
+            mask &= mask - 1;
+        }
+    }
+#endif
+    for (; row < table->count; row++) {
+        bool match = true;
+        for (size_t p = 0; p < pred_count && match; p++) {
+            match = pred_match(&preds[p], table->columns[preds[p].field][row]);
+        }
+        if (match) sel[n++] = (uint32_t)row;
+    }
+    return n;
+}
+
+// Single-field equality scan
+size_t relation_table_scan_eq(const PhenoRelationTable* table,
+                              PhenoRelationField field, uint8_t value, uint32_t* sel) {
+    PhenoRelationPredicate pred = { field, REL_PRED_EQ, value };
+    return relation_table_scan(table, &pred, 1, sel);
+}
+
+// Refine a selection vector (sel_out may alias sel_in)
+size_t relation_table_filter(const PhenoRelationTable* table,
+                             const PhenoRelationPredicate* preds, size_t pred_count,
+                             const uint32_t* sel_in, size_t sel_count, uint32_t* sel_out) {
+    if (!table || !sel_in || !sel_out) return 0;
+    
+    size_t n = 0;
+    for (size_t i = 0; i < sel_count; i++) {
+        uint32_t row = sel_in[i];
+        bool match = true;
+        for (size_t p = 0; p < pred_count && match; p++) {
+            match = pred_match(&preds[p], table->columns[preds[p].field][row]);
+        }
+        sel_out[n] = row;
+        n += match;
+    }
+    return n;
+}
@@ -3,6 +3,7 @@
 #include <string.h>
 #include <stdbool.h>
 #include "phenomemory_platform.h"
+#include "pheno_trace.h"
 
 // State name lookup
 const char* get_state_name(PhenoState state) {
@@ -28,6 +29,20 @@ const char* get_event_name(PhenoEvent event) {
     return "UNKNOWN";
 }
 
+// Infer a token's state from its flag bits (the inverse of the flag
+// updates made by the transitions below)
+PhenoState pheno_token_state(const PhenoToken* token) {
+    uint32_t flags = atomic_load(&token->mem_flags.flags);
+    
+    if (!(flags & (1U << FLAG_ALLOCATED_BIT))) return STATE_NIL;
+    if (flags & (1U << FLAG_SHARED_BIT)) return STATE_SHARED;
+    if (flags & (1U << FLAG_PROCESSING_BIT)) {
+        return (flags & (1U << FLAG_COHERENT_BIT)) ? STATE_ACTIVE : STATE_DEGRADED;
+    }
+    if (flags & (1U << FLAG_LOCKED_BIT)) return STATE_LOCKED;
+    return STATE_ALLOCATED;
+}
+
 // Create state machine
 StateMachine* create_state_machine(void) {
     StateMachine* sm = (StateMachine*)calloc(1, sizeof(StateMachine));
@@ -89,8 +104,8 @@ static bool transition_nil_to_allocated(StateMachine* sm) {
 static bool transition_allocated_to_locked(StateMachine* sm) {
     if (!sm->token) return false;
     
-    // Atomically set the locked flag
-    if (test_and_set_flag(&sm->token->mem_flags, FLAG_LOCKED_BIT)) {
+    // Atomically set the locked flag (true if it was clear)
+    if (!test_and_set_flag(&sm->token->mem_flags, FLAG_LOCKED_BIT)) {
         return false;  // Already locked
     }
     
@@ -189,6 +204,7 @@ void step_state_machine(StateMachine* sm, PhenoEvent event) {
     
     bool transition_success = false;
     PhenoState old_state = sm->current_state;
+    uint32_t token_id = sm->token ? sm->token->token_id : 0;
     
     switch (sm->current_state) {
         case STATE_NIL:
@@ -250,6 +266,9 @@ void step_state_machine(StateMachine* sm, PhenoEvent event) {
     }
     
     if (transition_success) {
+        // The token may have been replaced (alloc) or released (free)
+        pheno_trace_record(sm->token ? sm->token->token_id : token_id,
+                           old_state, sm->current_state, event);
         printf("[STATE_MACHINE] %s + %s -> %s\n",
                get_state_name(old_state),
                get_event_name(event),
@@ -0,0 +1,416 @@
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <time.h>
+#include <unistd.h>
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include "pheno_stream.h"
+#include "pheno_trace.h"
+#include "pheno_writer.h"
+#include "token_parser.h"
+
+#define STREAM_MAX_CLIENTS 32
+#define STREAM_REQUEST_MAX 4096
+#define STREAM_BACKLOG_MAX (8u << 20)   // Queued bytes before a subscriber is dropped
+#define STREAM_BATCH 4096               // Events per ring read
+
+typedef enum {
+    CONN_REQUEST,       // Reading the request head
+    CONN_RESPONSE,      // Sending a one-shot response, then close
+    CONN_EVENTS         // Subscribed to /events
+} ConnMode;
+
+typedef struct {
+    int fd;
+    ConnMode mode;
+    size_t in_len;
+    char in[STREAM_REQUEST_MAX];
+    PhenoWriter out;    // Bytes not yet accepted by the socket
+    size_t sent;        // Prefix of out already written
+} StreamConn;
+
+struct PhenoStream {
+    PhenoStreamOptions options;
+    int listen_fd;
+    int wake[2];        // Self-pipe that stops the thread
+    uint16_t port;
+    pthread_t thread;
+    pthread_mutex_t diagram_lock;   // Held while the thread uses options.diagram
+    StreamConn* conns[STREAM_MAX_CLIENTS];
+    size_t conn_count;
+    PhenoTraceCursor cursor;
+    uint64_t frame;
+    _Atomic uint64_t events;
+    _Atomic uint64_t dropped;
+    PhenoWriter frame_out;  // Event-stream text of the current frame
+    PhenoWriter patch;
+};
+
+void pheno_stream_defaults(PhenoStreamOptions* options) {
+    memset(options, 0, sizeof(*options));
+    options->frame_ms = 16;
+}
+
+static uint64_t stream_now_ms(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000u + (uint64_t)ts.tv_nsec / 1000000u;
+}
+
+static void conn_close(PhenoStream* s, size_t index) {
+    StreamConn* c = s->conns[index];
+    close(c->fd);
+    pheno_writer_close(&c->out);
+    free(c);
+    s->conns[index] = s->conns[--s->conn_count];
+}
+
+// Push queued output; false once the connection should be closed
+static bool conn_flush(StreamConn* c) {
+    while (c->sent < c->out.used) {
+        ssize_t n = send(c->fd, c->out.buf + c->sent, c->out.used - c->sent, MSG_NOSIGNAL);
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            return errno == EAGAIN || errno == EWOULDBLOCK;
+        }
+        c->sent += (size_t)n;
+    }
+    c->out.used = 0;
+    c->sent = 0;
+    return c->mode != CONN_RESPONSE;
+}
+
+static void conn_respond(StreamConn* c, const char* status, const char* type,
+                         const char* body, size_t len) {
+    pheno_writer_lit(&c->out, "HTTP/1.1 ");
+    pheno_writer_str(&c->out, status);
+    pheno_writer_lit(&c->out, "\r\nContent-Type: ");
+    pheno_writer_str(&c->out, type);
+    pheno_writer_lit(&c->out, "\r\nContent-Length: ");
+    pheno_writer_u32(&c->out, (uint32_t)len);
+    pheno_writer_lit(&c->out, "\r\nCache-Control: no-store\r\nConnection: close\r\n\r\n");
+    pheno_writer_put(&c->out, body, len);
+    c->mode = CONN_RESPONSE;
+}
+
+// Only loopback host names, so pages from other origins cannot reach the
+// endpoint through DNS rebinding. The Host value must be one of them
+// exactly, optionally with a port; a request without Host is refused.
+static bool stream_host_allowed(const char* head) {
+    static const char* const allowed[] = { "127.0.0.1", "localhost", "[::1]" };
+    
+    for (const char* line = strstr(head, "\r\n"); line; line = strstr(line, "\r\n")) {
+        line += 2;
+        if (*line == '\r') break;      // End of the headers
+        if (strncasecmp(line, "Host:", 5) != 0) continue;
+        
+        const char* host = line + 5;
+        while (*host == ' ' || *host == '\t') host++;
+        for (size_t i = 0; i < sizeof(allowed) / sizeof(allowed[0]); i++) {
+            size_t len = strlen(allowed[i]);
+            if (strncasecmp(host, allowed[i], len) != 0) continue;
+            
+            const char* rest = host + len;
+            if (*rest == ':') {
+                const char* port = ++rest;
+                while (*rest >= '0' && *rest <= '9') rest++;
+                if (rest == port) return false;
+            }
+            while (*rest == ' ' || *rest == '\t') rest++;
+            return rest[0] == '\r' && rest[1] == '\n';
+        }
+        return false;
+    }
+    return false;
+}
+
+static void stream_route(PhenoStream* s, StreamConn* c) {
+    char* line_end = strstr(c->in, "\r\n");
+    char* path = c->in + 4;
+    char* path_end = line_end ? memchr(path, ' ', (size_t)(line_end - path)) : NULL;
+    if (strncmp(c->in, "GET ", 4) != 0 || !path_end) {
+        conn_respond(c, "400 Bad Request", "text/plain", "bad request\n", 12);
+        return;
+    }
+    *path_end = '\0';
+    char* query = strchr(path, '?');
+    if (query) *query = '\0';
+    if (!stream_host_allowed(path_end + 1)) {
+        conn_respond(c, "403 Forbidden", "text/plain", "forbidden\n", 10);
+        return;
+    }
+    
+    if (strcmp(path, "/events") == 0) {
+        pheno_writer_lit(&c->out, "HTTP/1.1 200 OK\r\nContent-Type: text/event-stream\r\n"
+                                  "Cache-Control: no-store\r\nConnection: keep-alive\r\n\r\n"
+                                  "retry: 1000\n\n");
+        c->mode = CONN_EVENTS;
+    } else if (strcmp(path, "/diagram.svg") == 0 && s->options.diagram) {
+        PhenoWriter svg;
+        if (!pheno_writer_memory(&svg, 1 << 16)) {
+            conn_respond(c, "500 Internal Server Error", "text/plain", "out of memory\n", 14);
+            return;
+        }
+        pthread_mutex_lock(&s->diagram_lock);
+        pheno_diagram_write_svg(s->options.diagram, &svg);
+        pthread_mutex_unlock(&s->diagram_lock);
+        conn_respond(c, "200 OK", "image/svg+xml", svg.buf, svg.used);
+        pheno_writer_close(&svg);
+    } else if (strcmp(path, "/") == 0 && s->options.page) {
+        // Mapped per request so edits to the page show on reload
+        TokenFileMap map;
+        if (!token_file_map(s->options.page, &map)) {
+            conn_respond(c, "404 Not Found", "text/plain", "not found\n", 10);
+            return;
+        }
+        conn_respond(c, "200 OK", "image/svg+xml", map.data ? map.data : "", map.size);
+        token_file_unmap(&map);
+    } else {
+        conn_respond(c, "404 Not Found", "text/plain", "not found\n", 10);
+    }
+}
+
+static bool conn_read(PhenoStream* s, StreamConn* c) {
+    if (c->mode != CONN_REQUEST) {
+        // Anything after the request is ignored; only watch for the close
+        char discard[512];
+        ssize_t n = recv(c->fd, discard, sizeof(discard), 0);
+        return n > 0 || (n < 0 && (errno == EAGAIN || errno == EINTR));
+    }
+    
+    ssize_t n = recv(c->fd, c->in + c->in_len, sizeof(c->in) - 1 - c->in_len, 0);
+    if (n <= 0) return n < 0 && (errno == EAGAIN || errno == EINTR);
+    c->in_len += (size_t)n;
+    c->in[c->in_len] = '\0';
+    if (strstr(c->in, "\r\n\r\n")) {
+        stream_route(s, c);
+    } else if (c->in_len == sizeof(c->in) - 1) {
+        conn_respond(c, "431 Request Header Fields Too Large", "text/plain", "too large\n", 10);
+    }
+    return true;
+}
+
+static void stream_accept(PhenoStream* s) {
+    int fd = accept4(s->listen_fd, NULL, NULL, SOCK_NONBLOCK | SOCK_CLOEXEC);
+    if (fd < 0) return;
+    StreamConn* c = s->conn_count < STREAM_MAX_CLIENTS ? (StreamConn*)malloc(sizeof(StreamConn)) : NULL;
+    if (!c || !pheno_writer_memory(&c->out, 4096)) {
+        free(c);
+        close(fd);
+        return;
+    }
+    c->fd = fd;
+    c->mode = CONN_REQUEST;
+    c->in_len = 0;
+    c->sent = 0;
+    s->conns[s->conn_count++] = c;
+}
+
+// Drain the ring into this frame's messages and queue them for every
+// subscriber. Called with diagram_lock held.
+static void stream_frame(PhenoStream* s) {
+    PhenoTraceEvent batch[STREAM_BATCH];
+    PhenoWriter* w = &s->frame_out;
+    PhenoDiagram* diagram = s->options.diagram;
+    uint64_t events = 0, dropped = 0;
+    w->used = 0;
+    
+    for (;;) {
+        uint64_t lost;
+        size_t n = pheno_trace_read(&s->cursor, batch, STREAM_BATCH, &lost);
+        dropped += lost;
+        for (size_t i = 0; i < n; i++) {
+            const PhenoTraceEvent* ev = &batch[i];
+            if (diagram) pheno_diagram_touch_id(diagram, ev->token_id);
+            if (events) pheno_writer_lit(w, ",");
+            pheno_writer_lit(w, "[");
+            pheno_writer_u32(w, ev->token_id);
+            pheno_writer_lit(w, ",");
+            pheno_writer_u32(w, ev->from);
+            pheno_writer_lit(w, ",");
+            pheno_writer_u32(w, ev->to);
+            pheno_writer_lit(w, ",");
+            pheno_writer_u32(w, ev->event);
+            pheno_writer_lit(w, ",");
+            // Microseconds modulo 2^32, enough to order and pace a frame
+            pheno_writer_u32(w, (uint32_t)(ev->time_ns / 1000u));
+            pheno_writer_lit(w, "]");
+            events++;
+        }
+        if (n < STREAM_BATCH) break;
+    }
+    atomic_fetch_add(&s->events, events);
+    atomic_fetch_add(&s->dropped, dropped);
+    bool transitions = events || dropped;
+    
+    // Nodes can also change without transitions (edited definitions)
+    PhenoWriter patch_line;
+    bool patched = false;
+    if (diagram && pheno_writer_memory(&patch_line, 4096)) {
+        patched = pheno_diagram_patch(diagram, &patch_line) > 0;
+        if (!patched) pheno_writer_close(&patch_line);
+    }
+    if (!transitions && !patched) return;
+    
+    // Wrap the event list now that the counts are known
+    PhenoWriter* p = &s->patch;
+    p->used = 0;
+    if (transitions) {
+        pheno_writer_lit(p, "event: transitions\ndata: {\"frame\":");
+        pheno_writer_u32(p, (uint32_t)++s->frame);
+        pheno_writer_lit(p, ",\"dropped\":");
+        pheno_writer_u32(p, (uint32_t)dropped);
+        pheno_writer_lit(p, ",\"events\":[");
+    }
+    size_t head = p->used;
+    
+    for (size_t i = 0; i < s->conn_count; i++) {
+        StreamConn* c = s->conns[i];
+        if (c->mode != CONN_EVENTS) continue;
+        if (transitions) {
+            pheno_writer_put(&c->out, p->buf, head);
+            pheno_writer_put(&c->out, w->buf, w->used);
+            pheno_writer_lit(&c->out, "]}\n\n");
+        }
+        if (patched) {
+            pheno_writer_lit(&c->out, "event: patch\ndata: ");
+            pheno_writer_put(&c->out, patch_line.buf, patch_line.used);
+            pheno_writer_lit(&c->out, "\n");
+        }
+    }
+    if (patched) pheno_writer_close(&patch_line);
+}
+
+static void* stream_thread(void* arg) {
+    PhenoStream* s = (PhenoStream*)arg;
+    struct pollfd fds[STREAM_MAX_CLIENTS + 2];
+    uint64_t next_frame = stream_now_ms() + s->options.frame_ms;
+    
+    for (;;) {
+        fds[0] = (struct pollfd){ s->wake[0], POLLIN, 0 };
+        fds[1] = (struct pollfd){ s->listen_fd, POLLIN, 0 };
+        for (size_t i = 0; i < s->conn_count; i++) {
+            StreamConn* c = s->conns[i];
+            fds[i + 2] = (struct pollfd){ c->fd, (short)(POLLIN | (c->out.used ? POLLOUT : 0)), 0 };
+        }
+        uint64_t now = stream_now_ms();
+        int timeout = next_frame > now ? (int)(next_frame - now) : 0;
+        size_t polled = s->conn_count;
+        if (poll(fds, polled + 2, timeout) < 0 && errno != EINTR) break;
+        if (fds[0].revents) break;
+    
+        // Walk backwards so closing (which moves the last entry) is safe
+        for (size_t i = polled; i-- > 0;) {
+            StreamConn* c = s->conns[i];
+            bool keep = true;
+            if (fds[i + 2].revents & (POLLERR | POLLHUP)) keep = false;
+            if (keep && (fds[i + 2].revents & POLLIN)) keep = conn_read(s, c);
+            if (keep && c->out.used) keep = conn_flush(c);
+            if (!keep) conn_close(s, i);
+        }
+        if (fds[1].revents & POLLIN) stream_accept(s);
+    
+        if (stream_now_ms() >= next_frame) {
+            pthread_mutex_lock(&s->diagram_lock);
+            stream_frame(s);
+            pthread_mutex_unlock(&s->diagram_lock);
+            for (size_t i = s->conn_count; i-- > 0;) {
+                StreamConn* c = s->conns[i];
+                bool keep = c->out.used ? conn_flush(c) : true;
+                if (keep && c->out.used - c->sent > STREAM_BACKLOG_MAX) keep = false;
+                if (!keep) conn_close(s, i);
+            }
+            next_frame += s->options.frame_ms;
+            now = stream_now_ms();
+            if (next_frame <= now) next_frame = now + s->options.frame_ms;
+        }
+    }
+    return NULL;
+}
+
+static void stream_free(PhenoStream* s) {
+    while (s->conn_count) conn_close(s, s->conn_count - 1);
+    if (s->listen_fd >= 0) close(s->listen_fd);
+    if (s->wake[0] >= 0) close(s->wake[0]);
+    if (s->wake[1] >= 0) close(s->wake[1]);
+    if (s->frame_out.buf) pheno_writer_close(&s->frame_out);
+    if (s->patch.buf) pheno_writer_close(&s->patch);
+    pthread_mutex_destroy(&s->diagram_lock);
+    free(s);
+}
+
+PhenoStream* pheno_stream_start(const PhenoStreamOptions* options) {
+    PhenoStream* s = (PhenoStream*)calloc(1, sizeof(PhenoStream));
+    if (!s) return NULL;
+    s->options = *options;
+    if (!s->options.frame_ms) s->options.frame_ms = 16;
+    s->listen_fd = -1;
+    s->wake[0] = s->wake[1] = -1;
+    pthread_mutex_init(&s->diagram_lock, NULL);
+    
+    struct sockaddr_in addr = { 0 };
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    addr.sin_port = htons(options->port);
+    socklen_t addr_len = sizeof(addr);
+    int one = 1;
+    
+    s->listen_fd = socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    if (s->listen_fd < 0 ||
+        setsockopt(s->listen_fd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one)) != 0 ||
+        bind(s->listen_fd, (struct sockaddr*)&addr, sizeof(addr)) != 0 ||
+        listen(s->listen_fd, 16) != 0 ||
+        getsockname(s->listen_fd, (struct sockaddr*)&addr, &addr_len) != 0 ||
+        pipe2(s->wake, O_CLOEXEC) != 0 ||
+        !pheno_writer_memory(&s->frame_out, 1 << 16) ||
+        !pheno_writer_memory(&s->patch, 256)) {
+        perror("pheno_stream_start");
+        stream_free(s);
+        return NULL;
+    }
+    s->port = ntohs(addr.sin_port);
+    
+    pheno_trace_cursor(&s->cursor);
+    pheno_trace_enable(true);
+    if (pthread_create(&s->thread, NULL, stream_thread, s) != 0) {
+        pheno_trace_enable(false);
+        stream_free(s);
+        return NULL;
+    }
+    return s;
+}
+
+uint16_t pheno_stream_port(const PhenoStream* stream) {
+    return stream->port;
+}
+
+void pheno_stream_lock(PhenoStream* stream) {
+    pthread_mutex_lock(&stream->diagram_lock);
+}
+
+void pheno_stream_unlock(PhenoStream* stream) {
+    pthread_mutex_unlock(&stream->diagram_lock);
+}
+
+void pheno_stream_stats(const PhenoStream* stream, uint64_t* events, uint64_t* dropped) {
+    if (events) *events = atomic_load(&stream->events);
+    if (dropped) *dropped = atomic_load(&stream->dropped);
+}
+
+void pheno_stream_stop(PhenoStream* stream) {
+    if (!stream) return;
+    pheno_trace_enable(false);
+    ssize_t n;
+    do {
+        n = write(stream->wake[1], "x", 1);
+    } while (n < 0 && errno == EINTR);
+    pthread_join(stream->thread, NULL);
+    stream_free(stream);
+}
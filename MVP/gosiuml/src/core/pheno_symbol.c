@@ -0,0 +1,181 @@
+#include <stdlib.h>
+#include <string.h>
+#include <stdbool.h>
+#include <stdatomic.h>
+#include "pheno_symbol.h"
+
+// The table is a chain of open-addressed levels, each twice the size of
+// the one before. Slots only ever go from empty to filled, so a thread
+// that passes a slot can rely on it staying taken: two threads interning
+// the same string follow the same probe sequence and meet at the same
+// slot, where one CAS wins and the other sees the winner's entry. When a
+// level has no free slot within SYMBOL_MAX_PROBES the insert moves on to
+// the next level, which is created on demand.
+#define SYMBOL_FIRST_LEVEL_BITS 10
+#define SYMBOL_MAX_LEVELS 20
+#define SYMBOL_MAX_PROBES 32
+
+// Id -> entry directory: lazily allocated chunks of entry pointers
+#define SYMBOL_CHUNK_BITS 12
+#define SYMBOL_CHUNK_SIZE (1u << SYMBOL_CHUNK_BITS)
+#define SYMBOL_MAX_CHUNKS 65536
+
+typedef struct {
+    uint64_t hash;
+    _Atomic uint32_t id;    // 0 until the inserting thread publishes it
+    uint32_t len;
+    char name[];
+} SymbolEntry;
+
+typedef _Atomic(SymbolEntry*) SymbolSlot;
+
+typedef struct {
+    size_t mask;
+    SymbolSlot slots[];
+} SymbolLevel;
+
+static _Atomic(SymbolLevel*) g_levels[SYMBOL_MAX_LEVELS];
+static _Atomic(SymbolSlot*) g_chunks[SYMBOL_MAX_CHUNKS];
+static _Atomic uint32_t g_next_id;
+
+static uint64_t symbol_hash(const char* str, size_t len) {
+    uint64_t hash = 0xcbf29ce484222325ULL;
+    for (size_t i = 0; i < len; i++) {
+        hash ^= (uint8_t)str[i];
+        hash *= 0x100000001b3ULL;
+    }
+    return hash;
+}
+
+// Level k, optionally created; concurrent creators race with a CAS and
+// the losers free their copy
+static SymbolLevel* symbol_level(int k, bool create) {
+    SymbolLevel* level = atomic_load_explicit(&g_levels[k], memory_order_acquire);
+    if (level || !create) return level;
+    
+    size_t capacity = (size_t)1 << (SYMBOL_FIRST_LEVEL_BITS + k);
+    SymbolLevel* fresh = (SymbolLevel*)malloc(sizeof(SymbolLevel) + capacity * sizeof(SymbolSlot));
+    if (!fresh) return NULL;
+    fresh->mask = capacity - 1;
+    for (size_t i = 0; i < capacity; i++) {
+        atomic_init(&fresh->slots[i], NULL);
+    }
+    
+    if (atomic_compare_exchange_strong_explicit(&g_levels[k], &level, fresh,
+                                                memory_order_acq_rel, memory_order_acquire)) {
+        return fresh;
+    }
+    free(fresh);
+    return level;
+}
+
+static SymbolSlot* symbol_chunk(uint32_t chunk, bool create) {
+    SymbolSlot* entries = atomic_load_explicit(&g_chunks[chunk], memory_order_acquire);
+    if (entries || !create) return entries;
+    
+    SymbolSlot* fresh = (SymbolSlot*)malloc(SYMBOL_CHUNK_SIZE * sizeof(SymbolSlot));
+    if (!fresh) return NULL;
+    for (uint32_t i = 0; i < SYMBOL_CHUNK_SIZE; i++) {
+        atomic_init(&fresh[i], NULL);
+    }
+    
+    if (atomic_compare_exchange_strong_explicit(&g_chunks[chunk], &entries, fresh,
+                                                memory_order_acq_rel, memory_order_acquire)) {
+        return fresh;
+    }
+    free(fresh);
+    return entries;
+}
+
+// Called by the thread whose CAS placed the entry: assign the next id and
+// make it reachable from pheno_symbol_name before publishing it
+static PhenoSymbol symbol_publish(SymbolEntry* entry) {
+    uint32_t id = atomic_fetch_add(&g_next_id, 1) + 1;
+    uint32_t index = id - 1;
+    
+    if ((index >> SYMBOL_CHUNK_BITS) < SYMBOL_MAX_CHUNKS) {
+        SymbolSlot* entries = symbol_chunk(index >> SYMBOL_CHUNK_BITS, true);
+        if (entries) {
+            atomic_store_explicit(&entries[index & (SYMBOL_CHUNK_SIZE - 1)], entry,
+                                  memory_order_release);
+        }
+    }
+    atomic_store_explicit(&entry->id, id, memory_order_release);
+    return id;
+}
+
+// Id of an entry found in the table. Its inserter publishes the id right
+// after winning the slot, so this waits a few instructions at most.
+static PhenoSymbol symbol_wait_id(SymbolEntry* entry) {
+    uint32_t id;
+    while ((id = atomic_load_explicit(&entry->id, memory_order_acquire)) == 0) {
+        // Spin
+    }
+    return id;
+}
+
+static PhenoSymbol symbol_lookup(const char* str, size_t len, bool insert) {
+    if (len > UINT32_MAX) return PHENO_SYMBOL_NONE;
+    
+    uint64_t hash = symbol_hash(str, len);
+    SymbolEntry* fresh = NULL;
+    
+    for (int k = 0; k < SYMBOL_MAX_LEVELS; k++) {
+        SymbolLevel* level = symbol_level(k, insert);
+        if (!level) break;
+        
+        size_t slot = (size_t)hash & level->mask;
+        for (int probe = 0; probe < SYMBOL_MAX_PROBES; probe++, slot = (slot + 1) & level->mask) {
+            SymbolEntry* entry = atomic_load_explicit(&level->slots[slot], memory_order_acquire);
+            if (!entry) {
+                if (!insert) return PHENO_SYMBOL_NONE;
+                if (!fresh) {
+                    fresh = (SymbolEntry*)malloc(sizeof(SymbolEntry) + len + 1);
+                    if (!fresh) return PHENO_SYMBOL_NONE;
+                    fresh->hash = hash;
+                    atomic_init(&fresh->id, 0);
+                    fresh->len = (uint32_t)len;
+                    memcpy(fresh->name, str, len);
+                    fresh->name[len] = '\0';
+                }
+                if (atomic_compare_exchange_strong_explicit(&level->slots[slot], &entry, fresh,
+                                                            memory_order_acq_rel,
+                                                            memory_order_acquire)) {
+                    return symbol_publish(fresh);
+                }
+                // Lost the slot; entry now holds the winner
+            }
+            if (entry->hash == hash && entry->len == len && memcmp(entry->name, str, len) == 0) {
+                free(fresh);
+                return symbol_wait_id(entry);
+            }
+        }
+    }
+    
+    free(fresh);
+    return PHENO_SYMBOL_NONE;
+}
+
+PhenoSymbol pheno_symbol_intern(const char* str, size_t len) {
+    return symbol_lookup(str, len, true);
+}
+
+PhenoSymbol pheno_symbol_find(const char* str, size_t len) {
+    return symbol_lookup(str, len, false);
+}
+
+const char* pheno_symbol_name(PhenoSymbol symbol) {
+    if (symbol == PHENO_SYMBOL_NONE) return NULL;
+    
+    uint32_t index = symbol - 1;
+    if ((index >> SYMBOL_CHUNK_BITS) >= SYMBOL_MAX_CHUNKS) return NULL;
+    SymbolSlot* entries = symbol_chunk(index >> SYMBOL_CHUNK_BITS, false);
+    if (!entries) return NULL;
+    SymbolEntry* entry = atomic_load_explicit(&entries[index & (SYMBOL_CHUNK_SIZE - 1)],
+                                              memory_order_acquire);
+    return entry ? entry->name : NULL;
+}
+
+size_t pheno_symbol_count(void) {
+    return atomic_load(&g_next_id);
+}
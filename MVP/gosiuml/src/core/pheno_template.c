@@ -0,0 +1,348 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include "pheno_template.h"
+#include "token_parser.h"
+
+typedef enum {
+    OP_LITERAL,
+    OP_U32,
+    OP_HEX,
+    OP_TEXT,
+    OP_XML,
+    OP_JSON
+} TemplateOpKind;
+
+typedef struct {
+    uint8_t kind;
+    uint16_t field;
+    int32_t add;            // Constant added to a number field
+    uint32_t offset;        // Literal span in the template text
+    uint32_t len;
+} TemplateOp;
+
+typedef struct {
+    uint32_t name;          // Offset and length of the name in the text
+    uint32_t name_len;
+    uint32_t first;         // First op
+    uint32_t count;
+} TemplateBlock;
+
+struct PhenoTemplate {
+    char* text;
+    size_t len;
+    TemplateOp* ops;
+    size_t op_count;
+    size_t op_capacity;
+    TemplateBlock* blocks;
+    size_t block_count;
+    size_t block_capacity;
+    const PhenoTemplateSchema* schema;
+    char* path;             // Source file of a loaded template
+    struct timespec mtime;
+    off_t size;
+};
+
+// Line number of text[pos], for error messages
+static unsigned template_line(const char* text, size_t pos) {
+    unsigned line = 1;
+    for (size_t i = 0; i < pos; i++) line += text[i] == '\n';
+    return line;
+}
+
+static bool template_push(PhenoTemplate* t, TemplateOp op) {
+    if (op.kind == OP_LITERAL && !op.len) return true;
+    
+    // Adjacent spans come from one piece of text, so just extend
+    TemplateBlock* block = &t->blocks[t->block_count - 1];
+    if (op.kind == OP_LITERAL && block->count) {
+        TemplateOp* last = &t->ops[t->op_count - 1];
+        if (last->kind == OP_LITERAL && last->offset + last->len == op.offset) {
+            last->len += op.len;
+            return true;
+        }
+    }
+    if (t->op_count == t->op_capacity) {
+        size_t capacity = t->op_capacity ? t->op_capacity * 2 : 32;
+        TemplateOp* ops = (TemplateOp*)realloc(t->ops, capacity * sizeof(TemplateOp));
+        if (!ops) return false;
+        t->ops = ops;
+        t->op_capacity = capacity;
+    }
+    t->ops[t->op_count++] = op;
+    block->count++;
+    return true;
+}
+
+static bool template_open_block(PhenoTemplate* t, size_t name, size_t name_len) {
+    if (t->block_count == t->block_capacity) {
+        size_t capacity = t->block_capacity ? t->block_capacity * 2 : 8;
+        TemplateBlock* blocks = (TemplateBlock*)realloc(t->blocks, capacity * sizeof(TemplateBlock));
+        if (!blocks) return false;
+        t->blocks = blocks;
+        t->block_capacity = capacity;
+    }
+    t->blocks[t->block_count++] = (TemplateBlock){
+        (uint32_t)name, (uint32_t)name_len, (uint32_t)t->op_count, 0
+    };
+    return true;
+}
+
+// Placeholder body "field[+-N][|filter]" into a field op
+static const char* template_field(PhenoTemplate* t, const char* tag, size_t len, TemplateOp* op) {
+    const char* bar = memchr(tag, '|', len);
+    size_t spec = bar ? (size_t)(bar - tag) : len;
+    size_t name_len = 0;
+    while (name_len < spec && tag[name_len] != '+' && tag[name_len] != '-') name_len++;
+    
+    size_t field = 0;
+    const PhenoTemplateSchema* schema = t->schema;
+    while (field < schema->count && (strlen(schema->fields[field].name) != name_len ||
+                                      memcmp(schema->fields[field].name, tag, name_len) != 0)) {
+        field++;
+    }
+    if (!name_len || field == schema->count) return "unknown field";
+    op->field = (uint16_t)field;
+    op->add = 0;
+    
+    bool number = schema->fields[field].type == TEMPLATE_FIELD_U32;
+    if (name_len < spec) {
+        if (!number) return "offset on a text field";
+        int32_t add = 0;
+        size_t i = name_len + 1;
+        if (i == spec) return "bad offset";
+        for (; i < spec; i++) {
+            if (tag[i] < '0' || tag[i] > '9' || add > 100000000) return "bad offset";
+            add = add * 10 + (tag[i] - '0');
+        }
+        op->add = tag[name_len] == '-' ? -add : add;
+    }
+    
+    const char* filter = bar ? bar + 1 : NULL;
+    size_t filter_len = bar ? len - spec - 1 : 0;
+    if (!filter) {
+        op->kind = number ? OP_U32 : OP_TEXT;
+    } else if (number && filter_len == 3 && memcmp(filter, "hex", 3) == 0) {
+        op->kind = OP_HEX;
+    } else if (!number && filter_len == 3 && memcmp(filter, "xml", 3) == 0) {
+        op->kind = OP_XML;
+    } else if (!number && filter_len == 4 && memcmp(filter, "json", 4) == 0) {
+        op->kind = OP_JSON;
+    } else {
+        return "unknown filter";
+    }
+    return NULL;
+}
+
+static bool template_parse(PhenoTemplate* t, const char* origin) {
+    const char* text = t->text;
+    size_t pos = 0;
+    bool in_block = false;
+    const char* error = NULL;
+    size_t error_pos = 0;
+    
+    while (!error) {
+        const char* open = pos < t->len ? strstr(text + pos, "{{") : NULL;
+        size_t end = open ? (size_t)(open - text) : t->len;
+        if (in_block && !template_push(t, (TemplateOp){ OP_LITERAL, 0, 0, (uint32_t)pos, (uint32_t)(end - pos) })) {
+            error = "out of memory";
+            break;
+        }
+        if (!open) {
+            if (in_block) {
+                error = "unterminated block";
+                error_pos = t->blocks[t->block_count - 1].name;
+            }
+            break;
+        }
+    
+        const char* close = strstr(open + 2, "}}");
+        error_pos = end;
+        if (!close) {
+            error = "unterminated placeholder";
+            break;
+        }
+        const char* tag = open + 2;
+        size_t tag_len = (size_t)(close - tag);
+        pos = (size_t)(close - text) + 2;
+        
+        // Outside blocks only an opening tag at the start of a line counts
+        bool line_start = end == 0 || text[end - 1] == '\n';
+        if (!in_block && (tag_len < 2 || tag[0] != '#' || !line_start)) {
+            pos = end + 2;
+            continue;
+        }
+        
+        if (tag_len && tag[0] == '#') {
+            if (in_block) error = "nested block";
+            else if (!template_open_block(t, (size_t)(tag + 1 - text), tag_len - 1)) error = "out of memory";
+            in_block = true;
+            if (pos < t->len && text[pos] == '\n') pos++;
+        } else if (tag_len && tag[0] == '/') {
+            const TemplateBlock* block = in_block ? &t->blocks[t->block_count - 1] : NULL;
+            if (!block || block->name_len != tag_len - 1 ||
+                memcmp(text + block->name, tag + 1, tag_len - 1) != 0) {
+                error = "mismatched block end";
+            }
+            in_block = false;
+        } else {
+            TemplateOp op = { 0 };
+            error = template_field(t, tag, tag_len, &op);
+            if (!error && !template_push(t, op)) error = "out of memory";
+        }
+    }
+    
+    if (error) {
+        fprintf(stderr, "[TEMPLATE] %s:%u: %s\n", origin, template_line(text, error_pos), error);
+        return false;
+    }
+    return true;
+}
+
+static void template_release(PhenoTemplate* t) {
+    free(t->text);
+    free(t->ops);
+    free(t->blocks);
+    t->text = NULL;
+    t->ops = NULL;
+    t->blocks = NULL;
+}
+
+PhenoTemplate* pheno_template_compile(const char* text, size_t len,
+                                      const PhenoTemplateSchema* schema, const char* origin) {
+    if (len > UINT32_MAX || schema->count > UINT16_MAX) return NULL;
+    PhenoTemplate* t = (PhenoTemplate*)calloc(1, sizeof(PhenoTemplate));
+    if (!t) return NULL;
+    t->schema = schema;
+    t->len = len;
+    
+    // Own a NUL-terminated copy so literal spans stay valid and strstr stops
+    t->text = (char*)malloc(len + 1);
+    if (!t->text) {
+        free(t);
+        return NULL;
+    }
+    memcpy(t->text, text, len);
+    t->text[len] = '\0';
+    
+    if (memchr(t->text, '\0', len) || !template_parse(t, origin ? origin : "template")) {
+        template_release(t);
+        free(t);
+        return NULL;
+    }
+    return t;
+}
+
+static PhenoTemplate* template_read(const char* path, const PhenoTemplateSchema* schema,
+                                    struct stat* st) {
+    TokenFileMap map;
+    if (stat(path, st) != 0 || !token_file_map(path, &map)) {
+        perror(path);
+        return NULL;
+    }
+    PhenoTemplate* t = pheno_template_compile(map.data ? map.data : "", map.size, schema, path);
+    token_file_unmap(&map);
+    return t;
+}
+
+PhenoTemplate* pheno_template_load(const char* path, const PhenoTemplateSchema* schema) {
+    struct stat st;
+    PhenoTemplate* t = template_read(path, schema, &st);
+    if (!t) return NULL;
+    
+    t->path = strdup(path);
+    if (!t->path) {
+        pheno_template_free(t);
+        return NULL;
+    }
+    t->mtime = st.st_mtim;
+    t->size = st.st_size;
+    return t;
+}
+
+int pheno_template_reload(PhenoTemplate* tpl, const char* const* required, size_t required_count) {
+    struct stat st;
+    if (!tpl->path || stat(tpl->path, &st) != 0) return -1;
+    if (st.st_mtim.tv_sec == tpl->mtime.tv_sec && st.st_mtim.tv_nsec == tpl->mtime.tv_nsec &&
+        st.st_size == tpl->size) {
+        return 0;
+    }
+    
+    struct stat read_st;
+    PhenoTemplate* fresh = template_read(tpl->path, tpl->schema, &read_st);
+    if (fresh) st = read_st;
+    const char* missing = NULL;
+    for (size_t r = 0; fresh && r < required_count && !missing; r++) {
+        if (pheno_template_block(fresh, required[r]) < 0) missing = required[r];
+    }
+    
+    // A rejected version is not retried until the file changes again
+    tpl->mtime = st.st_mtim;
+    tpl->size = st.st_size;
+    if (missing) {
+        fprintf(stderr, "[TEMPLATE] %s: missing block %s; keeping the previous version\n",
+                tpl->path, missing);
+        pheno_template_free(fresh);
+        return -1;
+    }
+    if (!fresh) return -1;
+    
+    template_release(tpl);
+    tpl->text = fresh->text;
+    tpl->len = fresh->len;
+    tpl->ops = fresh->ops;
+    tpl->op_count = fresh->op_count;
+    tpl->op_capacity = fresh->op_capacity;
+    tpl->blocks = fresh->blocks;
+    tpl->block_count = fresh->block_count;
+    tpl->block_capacity = fresh->block_capacity;
+    free(fresh);
+    return 1;
+}
+
+void pheno_template_free(PhenoTemplate* tpl) {
+    if (!tpl) return;
+    template_release(tpl);
+    free(tpl->path);
+    free(tpl);
+}
+
+int pheno_template_block(const PhenoTemplate* tpl, const char* name) {
+    size_t len = strlen(name);
+    for (size_t b = 0; b < tpl->block_count; b++) {
+        const TemplateBlock* block = &tpl->blocks[b];
+        if (block->name_len == len && memcmp(tpl->text + block->name, name, len) == 0) return (int)b;
+    }
+    return -1;
+}
+
+void pheno_template_render(const PhenoTemplate* tpl, int block, PhenoWriter* out,
+                           const PhenoTemplateValue* values) {
+    const TemplateBlock* b = &tpl->blocks[block];
+    const TemplateOp* op = tpl->ops + b->first;
+    const TemplateOp* end = op + b->count;
+    for (; op < end; op++) {
+        const PhenoTemplateValue* value = &values[op->field];
+        switch (op->kind) {
+            case OP_LITERAL:
+                pheno_writer_put(out, tpl->text + op->offset, op->len);
+                break;
+            case OP_U32:
+                pheno_writer_u32(out, value->u32 + (uint32_t)op->add);
+                break;
+            case OP_HEX:
+                pheno_writer_hex32(out, value->u32 + (uint32_t)op->add);
+                break;
+            case OP_TEXT:
+                pheno_writer_put(out, value->text.ptr, value->text.len);
+                break;
+            case OP_XML:
+                pheno_writer_xml_text(out, value->text.ptr, value->text.len);
+                break;
+            case OP_JSON:
+                pheno_writer_json_string(out, value->text.ptr, value->text.len);
+                break;
+        }
+    }
+}
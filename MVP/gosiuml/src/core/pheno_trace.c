@@ -0,0 +1,79 @@
+#include <time.h>
+#include "pheno_trace.h"
+
+#define TRACE_MASK (PHENO_TRACE_CAPACITY - 1)
+
+// Per-slot sequence lock: 2n+1 while event n is written, 2n+2 once it is
+// complete. The payload is two atomic words so a racing overwrite is
+// detected by the reader instead of being a data race.
+typedef struct {
+    _Atomic uint64_t seq;
+    _Atomic uint64_t time_ns;
+    _Atomic uint64_t packed;    // token_id | from << 32 | to << 40 | event << 48
+} TraceSlot;
+
+atomic_bool pheno_trace_on = false;
+
+static TraceSlot g_ring[PHENO_TRACE_CAPACITY];
+static _Atomic uint64_t g_head;
+
+void pheno_trace_enable(bool on) {
+    atomic_store(&pheno_trace_on, on);
+}
+
+void pheno_trace_push(uint32_t token_id, PhenoState from, PhenoState to, PhenoEvent event) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    
+    uint64_t n = atomic_fetch_add_explicit(&g_head, 1, memory_order_relaxed);
+    TraceSlot* slot = &g_ring[n & TRACE_MASK];
+    atomic_store_explicit(&slot->seq, 2 * n + 1, memory_order_relaxed);
+    atomic_thread_fence(memory_order_release);
+    atomic_store_explicit(&slot->time_ns, (uint64_t)ts.tv_sec * 1000000000u + (uint64_t)ts.tv_nsec,
+                          memory_order_relaxed);
+    atomic_store_explicit(&slot->packed, (uint64_t)token_id | (uint64_t)(uint8_t)from << 32 |
+                          (uint64_t)(uint8_t)to << 40 | (uint64_t)(uint8_t)event << 48,
+                          memory_order_relaxed);
+    atomic_store_explicit(&slot->seq, 2 * n + 2, memory_order_release);
+}
+
+void pheno_trace_cursor(PhenoTraceCursor* cursor) {
+    cursor->next = atomic_load_explicit(&g_head, memory_order_acquire);
+}
+
+size_t pheno_trace_read(PhenoTraceCursor* cursor, PhenoTraceEvent* out, size_t max,
+                        uint64_t* dropped) {
+    uint64_t head = atomic_load_explicit(&g_head, memory_order_acquire);
+    uint64_t lost = 0;
+    if (head - cursor->next > PHENO_TRACE_CAPACITY) {
+        lost = head - PHENO_TRACE_CAPACITY - cursor->next;
+        cursor->next = head - PHENO_TRACE_CAPACITY;
+    }
+    
+    size_t count = 0;
+    while (cursor->next < head && count < max) {
+        uint64_t n = cursor->next;
+        TraceSlot* slot = &g_ring[n & TRACE_MASK];
+        uint64_t seq = atomic_load_explicit(&slot->seq, memory_order_acquire);
+        if (seq < 2 * n + 2) break;         // Claimed but not yet published
+    
+        uint64_t time_ns = atomic_load_explicit(&slot->time_ns, memory_order_relaxed);
+        uint64_t packed = atomic_load_explicit(&slot->packed, memory_order_relaxed);
+        atomic_thread_fence(memory_order_acquire);
+        cursor->next++;
+        if (seq != 2 * n + 2 || atomic_load_explicit(&slot->seq, memory_order_relaxed) != seq) {
+            lost++;                         // Overwritten by a later lap
+            continue;
+        }
+    
+        PhenoTraceEvent* ev = &out[count++];
+        ev->time_ns = time_ns;
+        ev->token_id = (uint32_t)packed;
+        ev->from = (uint8_t)(packed >> 32);
+        ev->to = (uint8_t)(packed >> 40);
+        ev->event = (uint8_t)(packed >> 48);
+        ev->reserved = 0;
+    }
+    if (dropped) *dropped = lost;
+    return count;
+}
@@ -0,0 +1,490 @@
+#include <stdlib.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <unistd.h>
+#include <sys/uio.h>
+#include "pheno_writer.h"
+#include "pheno_parallel.h"
+#include "pheno_deflate.h"
+#include "pheno_crc32.h"
+
+#define WRITER_CHUNK_ITEMS 4096     // Items per parallel chunk
+#define WRITER_CHUNKS_PER_THREAD 4  // Chunks per thread in one wave
+#define WRITER_SERIAL_ITEMS (2 * WRITER_CHUNK_ITEMS)
+
+#ifndef IOV_MAX
+#define IOV_MAX 1024
+#endif
+
+#define GZIP_MIN_CHUNKS (PHENO_WRITER_BUFFER / PHENO_DEFLATE_CHUNK)
+
+// gzip mode. The buffer is preceded by the last PHENO_DEFLATE_WINDOW
+// input bytes already compressed, so every chunk of a flush can match
+// against the input before it.
+struct PhenoWriterGzip {
+    int level;
+    int threads;
+    uint32_t crc;
+    uint32_t size;              // Input length mod 2^32
+    size_t history;             // Bytes of history in front of buf
+    char* base;                 // Allocation: history window, then buf
+    PhenoDeflate** states;      // Per thread, created on first use
+    PhenoWriter* chunks;        // Compressed output of each chunk
+    size_t chunk_count;
+};
+
+static int g_gzip_level = PHENO_DEFLATE_LEVEL_DEFAULT;
+
+bool pheno_writer_attach(PhenoWriter* w, int fd) {
+    w->fd = fd;
+    w->owns_fd = false;
+    w->failed = false;
+    w->used = 0;
+    w->capacity = PHENO_WRITER_BUFFER;
+    w->buf = (char*)malloc(PHENO_WRITER_BUFFER);
+    w->gzip = NULL;
+    return w->buf != NULL;
+}
+
+bool pheno_writer_memory(PhenoWriter* w, size_t capacity) {
+    w->fd = -1;
+    w->owns_fd = false;
+    w->failed = false;
+    w->used = 0;
+    w->capacity = capacity ? capacity : 1;
+    w->buf = (char*)malloc(w->capacity);
+    w->gzip = NULL;
+    return w->buf != NULL;
+}
+
+bool pheno_writer_open(PhenoWriter* w, const char* path) {
+    int fd = open(path, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+    if (fd < 0) return false;
+    
+    if (!pheno_writer_attach(w, fd)) {
+        close(fd);
+        return false;
+    }
+    w->owns_fd = true;
+    if (pheno_writer_gzip_path(path) && !pheno_writer_gzip(w, g_gzip_level, 0)) {
+        pheno_writer_close(w);
+        return false;
+    }
+    return true;
+}
+
+static void write_all(PhenoWriter* w, const char* data, size_t len) {
+    while (len && !w->failed) {
+        ssize_t n = write(w->fd, data, len);
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            w->failed = true;
+            break;
+        }
+        data += n;
+        len -= (size_t)n;
+    }
+}
+
+static void gzip_flush(PhenoWriter* w);
+static void gzip_put(PhenoWriter* w, const char* data, size_t len);
+static void gzip_finish(PhenoWriter* w);
+
+bool pheno_writer_flush(PhenoWriter* w) {
+    if (w->gzip) {
+        gzip_flush(w);
+        return !w->failed;
+    }
+    if (w->fd < 0) return !w->failed;
+    
+    write_all(w, w->buf, w->used);
+    w->used = 0;
+    return !w->failed;
+}
+
+// Memory writers double their buffer until data fits
+static void memory_put(PhenoWriter* w, const void* data, size_t len) {
+    if (w->failed) return;
+    
+    size_t capacity = w->capacity;
+    while (capacity - w->used < len) {
+        if (capacity > SIZE_MAX / 2) {
+            w->failed = true;
+            return;
+        }
+        capacity *= 2;
+    }
+    char* buf = (char*)realloc(w->buf, capacity);
+    if (!buf) {
+        w->failed = true;
+        return;
+    }
+    w->buf = buf;
+    w->capacity = capacity;
+    memcpy(w->buf + w->used, data, len);
+    w->used += len;
+}
+
+void pheno_writer_put_slow(PhenoWriter* w, const void* data, size_t len) {
+    if (w->gzip) {
+        gzip_put(w, (const char*)data, len);
+        return;
+    }
+    if (w->fd < 0) {
+        memory_put(w, data, len);
+        return;
+    }
+    
+    pheno_writer_flush(w);
+    if (len < w->capacity) {
+        memcpy(w->buf, data, len);
+        w->used = len;
+    } else {
+        write_all(w, (const char*)data, len);
+    }
+}
+
+bool pheno_writer_close(PhenoWriter* w) {
+    bool ok = pheno_writer_flush(w);
+    if (w->gzip) {
+        gzip_finish(w);
+        ok = !w->failed;
+    }
+    if (w->owns_fd && close(w->fd) != 0) ok = false;
+    free(w->buf);
+    w->buf = NULL;
+    w->fd = -1;
+    return ok;
+}
+
+// ---- Parallel formatting ----
+
+typedef struct {
+    PhenoWriter* buffers;   // One per chunk of the current wave
+    size_t first_chunk;
+    size_t chunks;          // Chunks in the current wave
+    size_t count;
+    PhenoFormatFunc fn;
+    void* user;
+} ParallelFormat;
+
+static void format_worker(void* arg, int tid, int nthreads) {
+    ParallelFormat* job = (ParallelFormat*)arg;
+    for (size_t c = (size_t)tid; c < job->chunks; c += (size_t)nthreads) {
+        size_t begin = (job->first_chunk + c) * WRITER_CHUNK_ITEMS;
+        size_t end = begin + WRITER_CHUNK_ITEMS < job->count ? begin + WRITER_CHUNK_ITEMS : job->count;
+        job->buffers[c].used = 0;
+        job->fn(&job->buffers[c], begin, end, job->user);
+    }
+}
+
+// Write buffers to the descriptor in order: one writev per IOV_MAX
+// buffers, resuming after short writes
+static void write_buffers(PhenoWriter* w, PhenoWriter* buffers, size_t chunks) {
+    struct iovec iov[IOV_MAX];
+    size_t c = 0;
+    while (c < chunks && !w->failed) {
+        int n = 0;
+        for (; c < chunks && n < IOV_MAX; c++) {
+            if (!buffers[c].used) continue;
+            iov[n].iov_base = buffers[c].buf;
+            iov[n].iov_len = buffers[c].used;
+            n++;
+        }
+    
+        struct iovec* next = iov;
+        while (n > 0 && !w->failed) {
+            ssize_t written = writev(w->fd, next, n);
+            if (written < 0) {
+                if (errno == EINTR) continue;
+                w->failed = true;
+                break;
+            }
+            while (n > 0 && (size_t)written >= next->iov_len) {
+                written -= (ssize_t)next->iov_len;
+                next++;
+                n--;
+            }
+            if (n > 0) {
+                next->iov_base = (char*)next->iov_base + written;
+                next->iov_len -= (size_t)written;
+            }
+        }
+    }
+}
+
+// Append the wave's buffers in order, through the buffer unless they can
+// go straight to the descriptor
+static void write_wave(PhenoWriter* w, PhenoWriter* buffers, size_t chunks) {
+    if (w->fd < 0 || w->gzip) {
+        for (size_t c = 0; c < chunks; c++) {
+            pheno_writer_put(w, buffers[c].buf, buffers[c].used);
+        }
+        return;
+    }
+    write_buffers(w, buffers, chunks);
+}
+
+bool pheno_writer_parallel(PhenoWriter* w, size_t count, PhenoFormatFunc fn,
+                           void* user, int threads) {
+    threads = pheno_parallel_threads(threads);
+    if (threads == 1 || count <= WRITER_SERIAL_ITEMS) {
+        fn(w, 0, count, user);
+        return !w->failed;
+    }
+    
+    size_t total_chunks = (count + WRITER_CHUNK_ITEMS - 1) / WRITER_CHUNK_ITEMS;
+    size_t wave = (size_t)threads * WRITER_CHUNKS_PER_THREAD;
+    if (wave > total_chunks) wave = total_chunks;
+    
+    PhenoWriter* buffers = (PhenoWriter*)calloc(wave, sizeof(PhenoWriter));
+    bool ok = buffers != NULL;
+    for (size_t c = 0; ok && c < wave; c++) {
+        ok = pheno_writer_memory(&buffers[c], 64 * 1024);
+    }
+    if (!ok) {
+        // Not enough memory for per-thread buffers: format serially
+        for (size_t c = 0; buffers && c < wave; c++) {
+            free(buffers[c].buf);
+        }
+        free(buffers);
+        fn(w, 0, count, user);
+        return !w->failed;
+    }
+    
+    // Everything already buffered goes first
+    if (!w->gzip) pheno_writer_flush(w);
+    
+    ParallelFormat job = { buffers, 0, 0, count, fn, user };
+    for (size_t first = 0; first < total_chunks && !w->failed; first += wave) {
+        job.first_chunk = first;
+        job.chunks = total_chunks - first < wave ? total_chunks - first : wave;
+        pheno_parallel_run(threads < (int)job.chunks ? threads : (int)job.chunks, format_worker, &job);
+        for (size_t c = 0; c < job.chunks; c++) {
+            if (buffers[c].failed) w->failed = true;
+        }
+        if (!w->failed) write_wave(w, buffers, job.chunks);
+    }
+    
+    for (size_t c = 0; c < wave; c++) {
+        free(buffers[c].buf);
+    }
+    free(buffers);
+    return !w->failed;
+}
+
+// ---- gzip mode ----
+
+typedef struct {
+    PhenoWriter* w;
+    size_t chunks;
+} GzipJob;
+
+static void gzip_worker(void* arg, int tid, int nthreads) {
+    GzipJob* job = (GzipJob*)arg;
+    PhenoWriterGzip* gz = job->w->gzip;
+    for (size_t c = (size_t)tid; c < job->chunks; c += (size_t)nthreads) {
+        size_t offset = c * PHENO_DEFLATE_CHUNK;
+        size_t len = job->w->used - offset < PHENO_DEFLATE_CHUNK ? job->w->used - offset : PHENO_DEFLATE_CHUNK;
+        gz->chunks[c].used = 0;
+        pheno_deflate_chunk(gz->states[tid], (const uint8_t*)job->w->buf + offset,
+                            gz->history + offset, len, &gz->chunks[c]);
+    }
+}
+
+// Compress the buffer chunk by chunk, write the chunks in order and keep
+// the tail of the input as history for the next flush
+static void gzip_flush(PhenoWriter* w) {
+    PhenoWriterGzip* gz = w->gzip;
+    if (!w->used) return;
+    if (w->failed) {
+        w->used = 0;
+        return;
+    }
+    
+    gz->crc = pheno_crc32(gz->crc, w->buf, w->used);
+    gz->size += (uint32_t)w->used;
+    
+    GzipJob job = { w, (w->used + PHENO_DEFLATE_CHUNK - 1) / PHENO_DEFLATE_CHUNK };
+    int threads = gz->threads < (int)job.chunks ? gz->threads : (int)job.chunks;
+    int ready = 0;
+    while (ready < threads) {
+        if (!gz->states[ready]) gz->states[ready] = pheno_deflate_create(gz->level);
+        if (!gz->states[ready]) break;
+        ready++;
+    }
+    if (!ready) {
+        w->failed = true;
+        return;
+    }
+    
+    pheno_parallel_run(ready, gzip_worker, &job);
+    for (size_t c = 0; c < job.chunks; c++) {
+        if (gz->chunks[c].failed) w->failed = true;
+    }
+    write_buffers(w, gz->chunks, job.chunks);
+    
+    size_t keep = gz->history + w->used < PHENO_DEFLATE_WINDOW ? gz->history + w->used
+                                                               : PHENO_DEFLATE_WINDOW;
+    memmove(w->buf - keep, w->buf + w->used - keep, keep);
+    gz->history = keep;
+    w->used = 0;
+}
+
+static void gzip_put(PhenoWriter* w, const char* data, size_t len) {
+    while (len && !w->failed) {
+        size_t n = w->capacity - w->used < len ? w->capacity - w->used : len;
+        memcpy(w->buf + w->used, data, n);
+        w->used += n;
+        data += n;
+        len -= n;
+        if (w->used == w->capacity) gzip_flush(w);
+    }
+}
+
+static void gzip_free(PhenoWriterGzip* gz) {
+    for (int t = 0; gz->states && t < gz->threads; t++) {
+        pheno_deflate_free(gz->states[t]);
+    }
+    for (size_t c = 0; gz->chunks && c < gz->chunk_count; c++) {
+        free(gz->chunks[c].buf);
+    }
+    free(gz->states);
+    free(gz->chunks);
+    free(gz->base);
+    free(gz);
+}
+
+// Final block and trailer (CRC-32 and length of the input, little-endian),
+// then back to a plain buffer so pheno_writer_close can free it
+static void gzip_finish(PhenoWriter* w) {
+    PhenoWriterGzip* gz = w->gzip;
+    PhenoWriter* tail = &gz->chunks[0];
+    tail->used = 0;
+    pheno_deflate_finish(tail);
+    uint8_t trailer[8] = {
+        (uint8_t)gz->crc, (uint8_t)(gz->crc >> 8), (uint8_t)(gz->crc >> 16), (uint8_t)(gz->crc >> 24),
+        (uint8_t)gz->size, (uint8_t)(gz->size >> 8), (uint8_t)(gz->size >> 16), (uint8_t)(gz->size >> 24)
+    };
+    pheno_writer_put(tail, trailer, sizeof(trailer));
+    if (tail->failed) w->failed = true;
+    write_all(w, tail->buf, tail->used);
+    
+    w->gzip = NULL;
+    w->buf = NULL;
+    w->used = 0;
+    gzip_free(gz);
+}
+
+bool pheno_writer_gzip(PhenoWriter* w, int level, int threads) {
+    if (w->fd < 0 || w->gzip || !pheno_writer_flush(w)) return false;
+    
+    PhenoWriterGzip* gz = (PhenoWriterGzip*)calloc(1, sizeof(PhenoWriterGzip));
+    if (!gz) return false;
+    gz->level = level < 0 ? 0 : level > 9 ? 9 : level;
+    gz->threads = pheno_parallel_threads(threads);
+    gz->chunk_count = (size_t)gz->threads * 2 > GZIP_MIN_CHUNKS ? (size_t)gz->threads * 2 : GZIP_MIN_CHUNKS;
+    
+    size_t capacity = gz->chunk_count * PHENO_DEFLATE_CHUNK;
+    gz->base = (char*)malloc(PHENO_DEFLATE_WINDOW + capacity);
+    gz->states = (PhenoDeflate**)calloc((size_t)gz->threads, sizeof(PhenoDeflate*));
+    gz->chunks = (PhenoWriter*)calloc(gz->chunk_count, sizeof(PhenoWriter));
+    bool ok = gz->base && gz->states && gz->chunks;
+    for (size_t c = 0; ok && c < gz->chunk_count; c++) {
+        ok = pheno_writer_memory(&gz->chunks[c], PHENO_DEFLATE_CHUNK / 4);
+    }
+    if (!ok) {
+        gzip_free(gz);
+        return false;
+    }
+    
+    // Header: deflate, no name, no timestamp, Unix
+    static const uint8_t header[10] = { 0x1F, 0x8B, 8, 0, 0, 0, 0, 0, 0, 3 };
+    write_all(w, (const char*)header, sizeof(header));
+    
+    free(w->buf);
+    w->buf = gz->base + PHENO_DEFLATE_WINDOW;
+    w->capacity = capacity;
+    w->used = 0;
+    w->gzip = gz;
+    return !w->failed;
+}
+
+void pheno_writer_set_gzip_level(int level) {
+    g_gzip_level = level < 0 ? 0 : level > 9 ? 9 : level;
+}
+
+bool pheno_writer_gzip_path(const char* path) {
+    size_t len = strlen(path);
+    return (len > 3 && strcmp(path + len - 3, ".gz") == 0) ||
+           (len > 5 && strcmp(path + len - 5, ".svgz") == 0);
+}
+
+// Bytes that cannot be copied verbatim: WRITER_ESC_XML in XML text and
+// attribute values, WRITER_ESC_JSON inside JSON strings. Everything else,
+// including UTF-8 sequences, passes through unchanged.
+#define WRITER_ESC_XML 1
+#define WRITER_ESC_JSON 2
+#define WRITER_ESC_BOTH (WRITER_ESC_XML | WRITER_ESC_JSON)
+
+static const uint8_t g_escape_class[256] = {
+    3, 3, 3, 3, 3, 3, 3, 3, 3, 2, 2, 3, 3, 2, 3, 3,
+    3, 3, 3, 3, 3, 3, 3, 3, 3, 3, 3, 3, 3, 3, 3, 3,
+    ['"'] = WRITER_ESC_BOTH,
+    ['&'] = WRITER_ESC_XML,
+    ['\''] = WRITER_ESC_XML,
+    ['<'] = WRITER_ESC_XML,
+    ['>'] = WRITER_ESC_XML,
+    ['\\'] = WRITER_ESC_JSON,
+};
+
+// Copy s[0..len), handing each byte that needs escaping to escape()
+static void writer_escaped(PhenoWriter* w, const char* s, size_t len, uint8_t mode,
+                           void (*escape)(PhenoWriter*, uint8_t)) {
+    size_t start = 0;
+    for (size_t i = 0; i < len; i++) {
+        if (!(g_escape_class[(uint8_t)s[i]] & mode)) continue;
+        pheno_writer_put(w, s + start, i - start);
+        escape(w, (uint8_t)s[i]);
+        start = i + 1;
+    }
+    pheno_writer_put(w, s + start, len - start);
+}
+
+static void xml_escape(PhenoWriter* w, uint8_t c) {
+    switch (c) {
+        case '<': pheno_writer_lit(w, "&lt;"); break;
+        case '>': pheno_writer_lit(w, "&gt;"); break;
+        case '&': pheno_writer_lit(w, "&amp;"); break;
+        case '"': pheno_writer_lit(w, "&quot;"); break;
+        case '\'': pheno_writer_lit(w, "&apos;"); break;
+        default: pheno_writer_lit(w, "\xEF\xBF\xBD"); break;   // Control byte: U+FFFD
+    }
+}
+
+static void json_escape(PhenoWriter* w, uint8_t c) {
+    static const char hex[16] = "0123456789abcdef";
+    switch (c) {
+        case '"': pheno_writer_lit(w, "\\\""); break;
+        case '\\': pheno_writer_lit(w, "\\\\"); break;
+        case '\n': pheno_writer_lit(w, "\\n"); break;
+        case '\r': pheno_writer_lit(w, "\\r"); break;
+        case '\t': pheno_writer_lit(w, "\\t"); break;
+        default: {
+            char seq[6] = { '\\', 'u', '0', '0', hex[c >> 4], hex[c & 0xF] };
+            pheno_writer_put(w, seq, sizeof(seq));
+            break;
+        }
+    }
+}
+
+void pheno_writer_xml_text(PhenoWriter* w, const char* s, size_t len) {
+    writer_escaped(w, s, len, WRITER_ESC_XML, xml_escape);
+}
+
+void pheno_writer_json_string(PhenoWriter* w, const char* s, size_t len) {
+    pheno_writer_lit(w, "\"");
+    writer_escaped(w, s, len, WRITER_ESC_JSON, json_escape);
+    pheno_writer_lit(w, "\"");
+}
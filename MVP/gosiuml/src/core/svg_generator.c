@@ -1,58 +1,328 @@
-#include "phenomemory_platform.h"
 #include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "gosiuml.h"
+#include "svg_generator.h"
+#include "pheno_writer.h"
+#include "pheno_join.h"
+#include "pheno_perf.h"
 
-void generate_svg_from_tokens(PhenoToken* tokens, int count, const char* output_file) {
-    FILE* svg = fopen(output_file, "w");
-    if (!svg) {
+// Grid geometry
+#define SVG_X_OFFSET 100
+#define SVG_Y_OFFSET 100
+#define SVG_H_SPACING 220
+#define SVG_V_SPACING (SVG_NODE_HEIGHT + 60)
+#define SVG_MIN_COLS 4
+#define SVG_MIN_WIDTH 1200
+#define SVG_MIN_HEIGHT 800
+#define SVG_LAYOUT_UNIT 300.0f     // Pixels per ideal edge length
+
+// Built-in diagram template; templates/svg_diagram.tpl is the same text
+// as a starting point for custom templates
+static const char SVG_DEFAULT_TEMPLATE[] =
+    "{{#header}}\n"
+    "<?xml version=\"1.0\" encoding=\"UTF-8\"?>\n"
+    "<svg xmlns=\"http://www.w3.org/2000/svg\" width=\"{{width}}\" height=\"{{height}}\" "
+    "viewBox=\"0 0 {{width}} {{height}}\">\n"
+    "  <title>PhenoMemory State Machine Visualization</title>\n"
+    "  <rect width=\"{{width}}\" height=\"{{height}}\" fill=\"#f5f5f5\"/>\n"
+    "  <text x=\"{{cx}}\" y=\"30\" text-anchor=\"middle\" "
+    "font-family=\"monospace\" font-size=\"18\" font-weight=\"bold\">"
+    "PhenoMemory Token State Visualization</text>\n"
+    "{{/header}}\n"
+    "{{#edges_open}}\n"
+    "  <g class=\"edges\">\n"
+    "{{/edges_open}}\n"
+    "{{#edge}}\n"
+    "    <line x1=\"{{x1}}\" y1=\"{{y1}}\" x2=\"{{x2}}\" y2=\"{{y2}}\" "
+    "stroke=\"#90A4AE\" stroke-width=\"1.5\"/>\n"
+    "{{/edge}}\n"
+    "{{#edges_close}}\n"
+    "  </g>\n"
+    "{{/edges_close}}\n"
+    "{{#node}}\n"
+    "  <rect x=\"{{x}}\" y=\"{{y}}\" width=\"180\" height=\"120\" "
+    "fill=\"#e8f4f8\" stroke=\"#2196F3\" stroke-width=\"2\" rx=\"5\"/>\n"
+    "  <text x=\"{{cx}}\" y=\"{{y+25}}\" text-anchor=\"middle\" font-family=\"monospace\" "
+    "font-size=\"14\" font-weight=\"bold\">{{type|xml}}</text>\n"
+    "  <text x=\"{{cx}}\" y=\"{{y+45}}\" text-anchor=\"middle\" font-family=\"monospace\" "
+    "font-size=\"12\">ID: 0x{{id|hex}}</text>\n"
+    "{{/node}}\n"
+    "{{#footer}}\n"
+    "</svg>\n"
+    "{{/footer}}\n";
+
+static const PhenoTemplateField g_svg_fields[SVG_FIELD_COUNT] = {
+    [SVG_FIELD_WIDTH] = { "width", TEMPLATE_FIELD_U32 },
+    [SVG_FIELD_HEIGHT] = { "height", TEMPLATE_FIELD_U32 },
+    [SVG_FIELD_X] = { "x", TEMPLATE_FIELD_U32 },
+    [SVG_FIELD_Y] = { "y", TEMPLATE_FIELD_U32 },
+    [SVG_FIELD_CX] = { "cx", TEMPLATE_FIELD_U32 },
+    [SVG_FIELD_CY] = { "cy", TEMPLATE_FIELD_U32 },
+    [SVG_FIELD_X1] = { "x1", TEMPLATE_FIELD_U32 },
+    [SVG_FIELD_Y1] = { "y1", TEMPLATE_FIELD_U32 },
+    [SVG_FIELD_X2] = { "x2", TEMPLATE_FIELD_U32 },
+    [SVG_FIELD_Y2] = { "y2", TEMPLATE_FIELD_U32 },
+    [SVG_FIELD_ID] = { "id", TEMPLATE_FIELD_U32 },
+    [SVG_FIELD_TYPE] = { "type", TEMPLATE_FIELD_TEXT },
+};
+
+const PhenoTemplateSchema svg_template_schema = { g_svg_fields, SVG_FIELD_COUNT };
+
+static const char* const g_svg_blocks[SVG_BLOCK_COUNT] = {
+    "header", "edges_open", "edge", "edges_close", "node", "footer"
+};
+
+static SvgTemplate g_svg_default;
+static pthread_once_t g_svg_default_once = PTHREAD_ONCE_INIT;
+
+bool svg_template_bind(SvgTemplate* st, const PhenoTemplate* tpl) {
+    for (int b = 0; b < SVG_BLOCK_COUNT; b++) {
+        st->blocks[b] = pheno_template_block(tpl, g_svg_blocks[b]);
+        if (st->blocks[b] < 0) {
+            fprintf(stderr, "[TEMPLATE] missing block: %s\n", g_svg_blocks[b]);
+            return false;
+        }
+    }
+    st->tpl = tpl;
+    return true;
+}
+
+int svg_template_reload(SvgTemplate* st, PhenoTemplate* tpl) {
+    int status = pheno_template_reload(tpl, g_svg_blocks, SVG_BLOCK_COUNT);
+    if (status == 1 && !svg_template_bind(st, tpl)) status = -1;
+    return status;
+}
+
+static void svg_default_compile(void) {
+    PhenoTemplate* tpl = pheno_template_compile(SVG_DEFAULT_TEMPLATE, sizeof(SVG_DEFAULT_TEMPLATE) - 1,
+                                                &svg_template_schema, "built-in svg template");
+    if (tpl && !svg_template_bind(&g_svg_default, tpl)) pheno_template_free(tpl);
+}
+
+const SvgTemplate* svg_template_default(void) {
+    pthread_once(&g_svg_default_once, svg_default_compile);
+    return g_svg_default.tpl ? &g_svg_default : NULL;
+}
+
+static uint32_t svg_columns(int count) {
+    uint32_t cols = SVG_MIN_COLS;
+    while ((uint64_t)cols * cols < (uint64_t)count) cols++;
+    return cols;
+}
+
+// Fields a block does not set render as 0 or empty text
+static void svg_values_clear(PhenoTemplateValue v[SVG_FIELD_COUNT]) {
+    memset(v, 0, SVG_FIELD_COUNT * sizeof(PhenoTemplateValue));
+    v[SVG_FIELD_TYPE].text.ptr = "";
+}
+
+// Canvas values, shared by header, edges_open, edges_close and footer
+static void svg_document_values(PhenoTemplateValue v[SVG_FIELD_COUNT], uint32_t width, uint32_t height) {
+    svg_values_clear(v);
+    v[SVG_FIELD_WIDTH].u32 = width;
+    v[SVG_FIELD_HEIGHT].u32 = height;
+    v[SVG_FIELD_CX].u32 = width / 2;
+}
+
+static void svg_render_header(const SvgTemplate* st, PhenoWriter* w, uint32_t width, uint32_t height) {
+    PhenoTemplateValue v[SVG_FIELD_COUNT];
+    svg_document_values(v, width, height);
+    pheno_template_render(st->tpl, st->blocks[SVG_BLOCK_HEADER], w, v);
+}
+
+void svg_header(PhenoWriter* w, uint32_t width, uint32_t height) {
+    const SvgTemplate* st = svg_template_default();
+    if (st) svg_render_header(st, w, width, height);
+}
+
+static void svg_render_node(const SvgTemplate* st, PhenoWriter* w, const PhenoToken* token,
+                            uint32_t x, uint32_t y) {
+    PhenoTemplateValue v[SVG_FIELD_COUNT];
+    svg_values_clear(v);
+    v[SVG_FIELD_X].u32 = x;
+    v[SVG_FIELD_Y].u32 = y;
+    v[SVG_FIELD_CX].u32 = x + SVG_NODE_WIDTH / 2;
+    v[SVG_FIELD_CY].u32 = y + SVG_NODE_HEIGHT / 2;
+    v[SVG_FIELD_ID].u32 = token->token_id;
+    v[SVG_FIELD_TYPE].text.ptr = pheno_token_type(token, &v[SVG_FIELD_TYPE].text.len);
+    pheno_template_render(st->tpl, st->blocks[SVG_BLOCK_NODE], w, v);
+}
+
+void svg_node(PhenoWriter* w, const PhenoToken* token, uint32_t x, uint32_t y) {
+    const SvgTemplate* st = svg_template_default();
+    if (st) svg_render_node(st, w, token, x, y);
+}
+
+static void svg_grid(SvgSlot* slots, int count, uint64_t* width, uint64_t* height) {
+    uint32_t cols = svg_columns(count);
+    uint32_t rows = ((uint32_t)count + cols - 1) / cols;
+    *width = SVG_X_OFFSET * 2 + (uint64_t)(cols - 1) * SVG_H_SPACING + SVG_NODE_WIDTH;
+    *height = SVG_Y_OFFSET * 2 + (uint64_t)(rows ? rows - 1 : 0) * SVG_V_SPACING + SVG_NODE_HEIGHT;
+    
+    // Walk the grid incrementally rather than dividing per node
+    uint32_t col = 0, x = SVG_X_OFFSET, y = SVG_Y_OFFSET;
+    for (int i = 0; i < count; i++) {
+        slots[i] = (SvgSlot){ x, y };
+        if (++col == cols) {
+            col = 0;
+            x = SVG_X_OFFSET;
+            y += SVG_V_SPACING;
+        } else {
+            x += SVG_H_SPACING;
+        }
+    }
+}
+
+// Scale layout coordinates so one ideal edge length is SVG_LAYOUT_UNIT
+static bool svg_force_layout(int count, const PhenoEdgeTable* edges, const PhenoLayoutOptions* options,
+                             SvgSlot* slots, uint64_t* width, uint64_t* height) {
+    PhenoPoint* points = (PhenoPoint*)malloc((size_t)count * sizeof(PhenoPoint));
+    if (!points || !pheno_layout_graph((size_t)count, edges, options, points)) {
+        free(points);
+        return false;
+    }
+    
+    float min_x = points[0].x, min_y = points[0].y, max_x = min_x, max_y = min_y;
+    for (int i = 1; i < count; i++) {
+        if (points[i].x < min_x) min_x = points[i].x;
+        if (points[i].x > max_x) max_x = points[i].x;
+        if (points[i].y < min_y) min_y = points[i].y;
+        if (points[i].y > max_y) max_y = points[i].y;
+    }
+    for (int i = 0; i < count; i++) {
+        slots[i].x = SVG_X_OFFSET + (uint32_t)((points[i].x - min_x) * SVG_LAYOUT_UNIT);
+        slots[i].y = SVG_Y_OFFSET + (uint32_t)((points[i].y - min_y) * SVG_LAYOUT_UNIT);
+    }
+    *width = SVG_X_OFFSET * 2 + (uint64_t)((max_x - min_x) * SVG_LAYOUT_UNIT) + SVG_NODE_WIDTH;
+    *height = SVG_Y_OFFSET * 2 + (uint64_t)((max_y - min_y) * SVG_LAYOUT_UNIT) + SVG_NODE_HEIGHT;
+    free(points);
+    return true;
+}
+
+void svg_place_tokens(int count, const PhenoEdgeTable* edges, const PhenoLayoutOptions* options,
+                      SvgSlot* slots, uint32_t* width, uint32_t* height) {
+    uint64_t w, h;
+    if (!edges || !edges->count || !svg_force_layout(count, edges, options, slots, &w, &h)) {
+        svg_grid(slots, count, &w, &h);
+    }
+    *width = w < SVG_MIN_WIDTH ? SVG_MIN_WIDTH : (uint32_t)w;
+    *height = h < SVG_MIN_HEIGHT ? SVG_MIN_HEIGHT : (uint32_t)h;
+}
+
+static void svg_render_edge(const SvgTemplate* st, PhenoWriter* w, SvgSlot from, SvgSlot to) {
+    PhenoTemplateValue v[SVG_FIELD_COUNT];
+    svg_values_clear(v);
+    v[SVG_FIELD_X1].u32 = from.x + SVG_NODE_WIDTH / 2;
+    v[SVG_FIELD_Y1].u32 = from.y + SVG_NODE_HEIGHT / 2;
+    v[SVG_FIELD_X2].u32 = to.x + SVG_NODE_WIDTH / 2;
+    v[SVG_FIELD_Y2].u32 = to.y + SVG_NODE_HEIGHT / 2;
+    pheno_template_render(st->tpl, st->blocks[SVG_BLOCK_EDGE], w, v);
+}
+
+void svg_edge(PhenoWriter* w, SvgSlot from, SvgSlot to) {
+    const SvgTemplate* st = svg_template_default();
+    if (st) svg_render_edge(st, w, from, to);
+}
+
+// Element ranges for pheno_writer_parallel
+typedef struct {
+    const SvgTemplate* st;
+    const PhenoToken* tokens;
+    const SvgSlot* slots;
+    const PhenoEdgeTable* edges;
+} SvgRender;
+
+static void svg_format_edges(PhenoWriter* w, size_t begin, size_t end, void* user) {
+    const SvgRender* render = (const SvgRender*)user;
+    for (size_t e = begin; e < end; e++) {
+        const PhenoAnnotatedEdge* edge = &render->edges->edges[e];
+        svg_render_edge(render->st, w, render->slots[edge->src_index], render->slots[edge->dst_index]);
+    }
+}
+
+static void svg_format_nodes(PhenoWriter* w, size_t begin, size_t end, void* user) {
+    const SvgRender* render = (const SvgRender*)user;
+    for (size_t i = begin; i < end; i++) {
+        svg_render_node(render->st, w, &render->tokens[i], render->slots[i].x, render->slots[i].y);
+    }
+}
+
+static int svg_generate(PhenoToken* tokens, int count, const char* output_file,
+                        const PhenoLayoutOptions* options, const SvgTemplate* st) {
+    if (!st) st = svg_template_default();
+    if (!st || count < 0 || (count > 0 && !tokens)) return -1;
+    
+    // Relations of a parsed set, joined to token indices
+    size_t relation_count = 0;
+    const PhenoEdge* relations = count ? gosiuml_token_relations(tokens, &relation_count) : NULL;
+    PhenoEdgeTable edges = {0};
+    if (relation_count && !pheno_join_edges(tokens, (size_t)count, relations, relation_count,
+                                            options ? options->threads : 0, &edges)) {
+        edges.count = 0;
+    }
+    
+    SvgSlot* slots = (SvgSlot*)malloc((count ? (size_t)count : 1) * sizeof(SvgSlot));
+    if (!slots) {
+        pheno_edge_table_free(&edges);
+        return -1;
+    }
+    
+    uint32_t width, height;
+    svg_place_tokens(count, &edges, options, slots, &width, &height);
+    
+    PhenoWriter w;
+    if (!pheno_writer_open(&w, output_file)) {
         perror("Failed to create SVG file");
-        return;
-    }
-    
-    // SVG header
-    fprintf(svg, "<?xml version=\"1.0\" encoding=\"UTF-8\"?>\n");
-    fprintf(svg, "<svg xmlns=\"http://www.w3.org/2000/svg\" width=\"1200\" height=\"800\" viewBox=\"0 0 1200 800\">\n");
-    fprintf(svg, "  <title>PhenoMemory State Machine Visualization</title>\n");
-    
-    // Background
-    fprintf(svg, "  <rect width=\"1200\" height=\"800\" fill=\"#f5f5f5\"/>\n");
-    
-    // Title
-    fprintf(svg, "  <text x=\"600\" y=\"30\" text-anchor=\"middle\" ");
-    fprintf(svg, "font-family=\"monospace\" font-size=\"18\" font-weight=\"bold\">");
-    fprintf(svg, "PhenoMemory Token State Visualization</text>\n");
-    
-    // Generate nodes for each token
-    int x_offset = 100;
-    int y_offset = 100;
-    int node_width = 180;
-    int node_height = 120;
-    int h_spacing = 220;
-    int cols = 4;
-    
-    for (int i = 0; i < count && i < 12; i++) {
-        PhenoToken* token = &tokens[i];
-        int col = i % cols;
-        int row = i / cols;
-        int x = x_offset + col * h_spacing;
-        int y = y_offset + row * (node_height + 60);
-        
-        // Draw node rectangle
-        fprintf(svg, "  <rect x=\"%d\" y=\"%d\" width=\"%d\" height=\"%d\" ", 
-                x, y, node_width, node_height);
-        fprintf(svg, "fill=\"#e8f4f8\" stroke=\"#2196F3\" stroke-width=\"2\" rx=\"5\"/>\n");
-        
-        // Token info
-        fprintf(svg, "  <text x=\"%d\" y=\"%d\" text-anchor=\"middle\" ",
-                x + node_width/2, y + 25);
-        fprintf(svg, "font-family=\"monospace\" font-size=\"14\" font-weight=\"bold\">");
-        fprintf(svg, "%s</text>\n", token->sentinel);
-        
-        fprintf(svg, "  <text x=\"%d\" y=\"%d\" text-anchor=\"middle\" ",
-                x + node_width/2, y + 45);
-        fprintf(svg, "font-family=\"monospace\" font-size=\"12\">");
-        fprintf(svg, "ID: 0x%08X</text>\n", token->token_id);
-    }
-    
-    fprintf(svg, "</svg>\n");
-    fclose(svg);
+        free(slots);
+        pheno_edge_table_free(&edges);
+        return -1;
+    }
+    
+    svg_render_header(st, &w, width, height);
+    
+    // Edges first so the node boxes are drawn over them
+    int threads = options ? options->threads : 0;
+    SvgRender render = { st, tokens, slots, &edges };
+    PhenoTemplateValue document[SVG_FIELD_COUNT];
+    svg_document_values(document, width, height);
+    if (edges.count) {
+        pheno_template_render(st->tpl, st->blocks[SVG_BLOCK_EDGES_OPEN], &w, document);
+        pheno_writer_parallel(&w, edges.count, svg_format_edges, &render, threads);
+        pheno_template_render(st->tpl, st->blocks[SVG_BLOCK_EDGES_CLOSE], &w, document);
+    }
+    pheno_writer_parallel(&w, (size_t)count, svg_format_nodes, &render, threads);
+    
+    free(slots);
+    pheno_edge_table_free(&edges);
+    pheno_template_render(st->tpl, st->blocks[SVG_BLOCK_FOOTER], &w, document);
+    if (!pheno_writer_close(&w)) {
+        fprintf(stderr, "Failed to write SVG file: %s\n", output_file);
+        return -1;
+    }
+    return 0;
+}
+
+int generate_svg_with_template(PhenoToken* tokens, int count, const char* output_file,
+                               const PhenoLayoutOptions* options, const SvgTemplate* st) {
+    static PhenoPerfProbe probe = PHENO_PERF_PROBE_INIT("svg_render");
+    PhenoPerfMark mark;
+    pheno_perf_probe_begin(&mark);
+    int status = svg_generate(tokens, count, output_file, options, st);
+    pheno_perf_probe_end(&probe, &mark);
+    return status;
+}
+
+int generate_svg_with_layout(PhenoToken* tokens, int count, const char* output_file,
+                             const PhenoLayoutOptions* options) {
+    return generate_svg_with_template(tokens, count, output_file, options, NULL);
+}
+
+int generate_svg_from_tokens(PhenoToken* tokens, int count, const char* output_file) {
+    return generate_svg_with_layout(tokens, count, output_file, NULL);
+}
+
+int gosiuml_generate_svg(GosiUMLContext* ctx, PhenoToken* tokens, int count, const char* output_file) {
+    (void)ctx;
+    return generate_svg_from_tokens(tokens, count, output_file);
 }
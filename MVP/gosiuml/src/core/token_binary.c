@@ -0,0 +1,398 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "gosiuml.h"
+#include "token_binary.h"
+#include "token_set.h"
+#include "pheno_id_map.h"
+#include "pheno_crc32.h"
+#include "pheno_symbol.h"
+
+_Static_assert(sizeof(GtokHeader) == 72, "GtokHeader layout changed");
+_Static_assert(sizeof(GtokToken) == 12, "GtokToken layout changed");
+_Static_assert(sizeof(GtokEdge) == 12, "GtokEdge layout changed");
+
+// Interned string table for the compiler: NUL-terminated strings packed
+// in one buffer, deduplicated through an open-addressing hash of offsets
+typedef struct {
+    char* data;
+    size_t size;
+    size_t capacity;
+    uint32_t* slots;        // offset + 1, 0 = empty
+    size_t slot_mask;
+    size_t count;
+} StringTable;
+
+static uint32_t string_hash(const char* s, size_t len) {
+    uint32_t h = 2166136261u;
+    for (size_t i = 0; i < len; i++) {
+        h = (h ^ (uint8_t)s[i]) * 16777619u;
+    }
+    return h;
+}
+
+static bool string_table_init(StringTable* table) {
+    memset(table, 0, sizeof(*table));
+    table->slot_mask = 255;
+    table->slots = (uint32_t*)calloc(table->slot_mask + 1, sizeof(uint32_t));
+    return table->slots != NULL;
+}
+
+static void string_table_free(StringTable* table) {
+    free(table->data);
+    free(table->slots);
+}
+
+static bool string_table_rehash(StringTable* table) {
+    size_t mask = table->slot_mask * 2 + 1;
+    uint32_t* slots = (uint32_t*)calloc(mask + 1, sizeof(uint32_t));
+    if (!slots) return false;
+    
+    for (size_t i = 0; i <= table->slot_mask; i++) {
+        uint32_t entry = table->slots[i];
+        if (!entry) continue;
+        const char* s = table->data + entry - 1;
+        size_t slot = string_hash(s, strlen(s)) & mask;
+        while (slots[slot]) slot = (slot + 1) & mask;
+        slots[slot] = entry;
+    }
+    free(table->slots);
+    table->slots = slots;
+    table->slot_mask = mask;
+    return true;
+}
+
+// Offset of s (bounded by max_len) in the table; UINT32_MAX on failure
+static uint32_t string_table_intern(StringTable* table, const char* s, size_t max_len) {
+    size_t len = strnlen(s, max_len);
+    uint32_t h = string_hash(s, len);
+    size_t slot = h & table->slot_mask;
+    
+    while (table->slots[slot]) {
+        const char* candidate = table->data + table->slots[slot] - 1;
+        if (strncmp(candidate, s, len) == 0 && candidate[len] == '\0') {
+            return table->slots[slot] - 1;
+        }
+        slot = (slot + 1) & table->slot_mask;
+    }
+    
+    if (table->size + len + 1 >= UINT32_MAX) return UINT32_MAX;
+    if (table->size + len + 1 > table->capacity) {
+        size_t capacity = table->capacity ? table->capacity * 2 : 4096;
+        while (capacity < table->size + len + 1) capacity *= 2;
+        char* data = (char*)realloc(table->data, capacity);
+        if (!data) return UINT32_MAX;
+        table->data = data;
+        table->capacity = capacity;
+    }
+    
+    uint32_t offset = (uint32_t)table->size;
+    memcpy(table->data + offset, s, len);
+    table->data[offset + len] = '\0';
+    table->size += len + 1;
+    table->slots[slot] = offset + 1;
+    
+    if (++table->count * 2 > table->slot_mask && !string_table_rehash(table)) {
+        return UINT32_MAX;
+    }
+    return offset;
+}
+
+// Append a section padded to 8 bytes, folding it into the checksum
+static bool write_section(FILE* fp, const void* data, size_t size,
+                          uint64_t* offset, uint32_t* crc) {
+    static const uint8_t zeros[8] = {0};
+    size_t pad = (8 - (size & 7)) & 7;
+    
+    if (size && fwrite(data, 1, size, fp) != size) return false;
+    if (pad && fwrite(zeros, 1, pad, fp) != pad) return false;
+    *crc = pheno_crc32(*crc, data, size);
+    *crc = pheno_crc32(*crc, zeros, pad);
+    *offset += size + pad;
+    return true;
+}
+
+bool gtok_compile(const char* input, const char* output) {
+    int count = 0;
+    PhenoToken* set = token_set_load(input, 0, &count);
+    if (!set) return false;
+    
+    size_t token_count = (size_t)count;
+    size_t relation_count = 0;
+    const PhenoEdge* relations = gosiuml_token_relations(set, &relation_count);
+    
+    GtokToken* tokens = (GtokToken*)calloc(token_count ? token_count : 1, sizeof(GtokToken));
+    uint32_t* rows = (uint32_t*)calloc(token_count + 1, sizeof(uint32_t));
+    uint32_t* src_index = (uint32_t*)malloc((relation_count ? relation_count : 1) * sizeof(uint32_t));
+    GtokEdge* edges = NULL;
+    StringTable strings;
+    PhenoIdMap ids;
+    bool strings_ready = string_table_init(&strings);
+    bool ids_ready = pheno_id_map_init(&ids, token_count);
+    bool ok = tokens && rows && src_index && strings_ready && ids_ready;
+    
+    // Tokens: intern types, index ids (first definition wins)
+    uint32_t reserved_index = GTOK_NO_TOKEN;   // PHENO_ID_MAP_EMPTY cannot be a map key
+    for (size_t i = 0; ok && i < token_count; i++) {
+        tokens[i].token_id = set[i].token_id;
+        tokens[i].zone = set[i].memory_zone;
+        // Full type name: the sentinel keeps only 15 characters
+        const char* type = pheno_symbol_name(set[i].type_symbol);
+        tokens[i].type = type ? string_table_intern(&strings, type, strlen(type))
+                              : string_table_intern(&strings, set[i].sentinel, sizeof(set[i].sentinel));
+        ok = tokens[i].type != UINT32_MAX;
+        if (set[i].token_id == PHENO_ID_MAP_EMPTY) {
+            if (reserved_index == GTOK_NO_TOKEN) reserved_index = (uint32_t)i;
+        } else if (ok) {
+            uint32_t existing;
+            ok = pheno_id_map_insert(&ids, set[i].token_id, (uint32_t)i, &existing) >= 0;
+        }
+    }
+    
+    // Relations: resolve endpoints and count rows
+    size_t edge_count = 0, skipped = 0;
+    for (size_t r = 0; ok && r < relation_count; r++) {
+        uint32_t index = GTOK_NO_TOKEN;
+        if (relations[r].src_id == PHENO_ID_MAP_EMPTY) index = reserved_index;
+        else pheno_id_map_get(&ids, relations[r].src_id, &index);
+        src_index[r] = index;
+        if (index == GTOK_NO_TOKEN) {
+            skipped++;
+            continue;
+        }
+        rows[index + 1]++;
+        edge_count++;
+    }
+    if (ok && edge_count >= UINT32_MAX) ok = false;
+    for (size_t i = 0; ok && i < token_count; i++) {
+        rows[i + 1] += rows[i];
+    }
+    
+    if (ok) {
+        edges = (GtokEdge*)malloc((edge_count ? edge_count : 1) * sizeof(GtokEdge));
+        ok = edges != NULL;
+    }
+    if (ok) {
+        // Stable fill: relations keep file order within a row
+        uint32_t* cursor = (uint32_t*)malloc((token_count ? token_count : 1) * sizeof(uint32_t));
+        ok = cursor != NULL;
+        if (ok) memcpy(cursor, rows, token_count * sizeof(uint32_t));
+        for (size_t r = 0; ok && r < relation_count; r++) {
+            if (src_index[r] == GTOK_NO_TOKEN) continue;
+            GtokEdge* edge = &edges[cursor[src_index[r]]++];
+            edge->dst_id = relations[r].dst_id;
+            edge->dst_index = GTOK_NO_TOKEN;
+            if (relations[r].dst_id == PHENO_ID_MAP_EMPTY) edge->dst_index = reserved_index;
+            else pheno_id_map_get(&ids, relations[r].dst_id, &edge->dst_index);
+            edge->type = string_table_intern(&strings, relations[r].rel_type,
+                                             sizeof(relations[r].rel_type));
+            ok = edge->type != UINT32_MAX;
+        }
+        free(cursor);
+    }
+    
+    if (ok && skipped) {
+        fprintf(stderr, "[GTOK] %s: skipped %zu relations with unknown source tokens\n",
+                input, skipped);
+    }
+    
+    // Write to a temporary file, then rename over the output
+    char* temp_path = NULL;
+    FILE* fp = NULL;
+    if (ok) {
+        size_t len = strlen(output);
+        temp_path = (char*)malloc(len + 5);
+        ok = temp_path != NULL;
+        if (ok) {
+            memcpy(temp_path, output, len);
+            memcpy(temp_path + len, ".tmp", 5);
+            fp = fopen(temp_path, "wb");
+            ok = fp != NULL;
+        }
+    }
+    
+    if (ok) {
+        GtokHeader header;
+        memset(&header, 0, sizeof(header));
+        memcpy(header.magic, GTOK_MAGIC, 4);
+        header.version = GTOK_VERSION;
+        header.header_size = sizeof(GtokHeader);
+        header.byte_order = GTOK_BYTE_ORDER;
+        header.token_count = (uint32_t)token_count;
+        header.edge_count = (uint32_t)edge_count;
+        
+        uint64_t offset = sizeof(GtokHeader);
+        uint32_t crc = 0;
+        ok = fwrite(&header, sizeof(header), 1, fp) == 1;
+        header.tokens_offset = offset;
+        ok = ok && write_section(fp, tokens, token_count * sizeof(GtokToken), &offset, &crc);
+        header.strings_offset = offset;
+        header.strings_size = strings.size;
+        ok = ok && write_section(fp, strings.data, strings.size, &offset, &crc);
+        header.rows_offset = offset;
+        ok = ok && write_section(fp, rows, (token_count + 1) * sizeof(uint32_t), &offset, &crc);
+        header.edges_offset = offset;
+        ok = ok && write_section(fp, edges, edge_count * sizeof(GtokEdge), &offset, &crc);
+        header.file_size = offset;
+        header.checksum = crc;
+        
+        ok = ok && fseek(fp, 0, SEEK_SET) == 0 && fwrite(&header, sizeof(header), 1, fp) == 1;
+        ok = (fclose(fp) == 0) && ok;
+        ok = ok && rename(temp_path, output) == 0;
+        if (!ok) unlink(temp_path);
+        else printf("[GTOK] Compiled %zu tokens, %zu relations, %zu strings into %s (%llu bytes)\n",
+                    token_count, edge_count, strings.count, output, (unsigned long long)offset);
+    } else if (temp_path) {
+        fprintf(stderr, "[GTOK] Could not write %s\n", output);
+    }
+    
+    free(temp_path);
+    free(tokens);
+    free(rows);
+    free(src_index);
+    free(edges);
+    if (strings_ready) string_table_free(&strings);
+    if (ids_ready) pheno_id_map_free(&ids);
+    gosiuml_free_tokens(set, count);
+    return ok;
+}
+
+static bool gtok_range_ok(uint64_t offset, uint64_t size, uint64_t file_size) {
+    return (offset & 7) == 0 && offset <= file_size && size <= file_size - offset;
+}
+
+// Everything the accessors index: rows must not decrease, and every
+// string offset and destination index must stay inside its section
+static const char* gtok_check_sections(const GtokHeader* h, const GtokToken* tokens,
+                                       const uint32_t* rows, const GtokEdge* edges) {
+    if (rows[0] != 0 || rows[h->token_count] != h->edge_count) return "corrupt relation rows";
+    for (uint32_t i = 0; i < h->token_count; i++) {
+        if (rows[i] > rows[i + 1]) return "corrupt relation rows";
+        if (tokens[i].type >= h->strings_size) return "token type out of bounds";
+        if (tokens[i].zone >= MAX_MEMORY_ZONES) return "token zone out of range";
+    }
+    for (uint32_t e = 0; e < h->edge_count; e++) {
+        if (edges[e].dst_index >= h->token_count && edges[e].dst_index != GTOK_NO_TOKEN) {
+            return "relation target out of bounds";
+        }
+        if (edges[e].type >= h->strings_size) return "relation type out of bounds";
+    }
+    return NULL;
+}
+
+bool gtok_open(const char* path, bool verify_checksum, GtokFile* file) {
+    memset(file, 0, sizeof(*file));
+    
+    int fd = open(path, O_RDONLY);
+    if (fd < 0) return false;
+    
+    struct stat st;
+    if (fstat(fd, &st) != 0 || (size_t)st.st_size < sizeof(GtokHeader)) {
+        close(fd);
+        return false;
+    }
+    
+    void* data = mmap(NULL, (size_t)st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (data == MAP_FAILED) return false;
+    
+    const char* base = (const char*)data;
+    const GtokHeader* h = (const GtokHeader*)data;
+    uint64_t size = (uint64_t)st.st_size;
+    const char* error = NULL;
+    
+    if (memcmp(h->magic, GTOK_MAGIC, 4) != 0) error = "not a .gtok file";
+    else if (h->byte_order != GTOK_BYTE_ORDER) error = "written with a different byte order";
+    else if (h->version != GTOK_VERSION) error = "unsupported version";
+    else if (h->header_size != sizeof(GtokHeader) || h->file_size != size) error = "truncated or resized";
+    else if (!gtok_range_ok(h->tokens_offset, (uint64_t)h->token_count * sizeof(GtokToken), size) ||
+             !gtok_range_ok(h->strings_offset, h->strings_size, size) ||
+             !gtok_range_ok(h->rows_offset, ((uint64_t)h->token_count + 1) * sizeof(uint32_t), size) ||
+             !gtok_range_ok(h->edges_offset, (uint64_t)h->edge_count * sizeof(GtokEdge), size)) {
+        error = "section out of bounds";
+    }
+    
+    const GtokToken* tokens = (const GtokToken*)(base + h->tokens_offset);
+    const uint32_t* rows = (const uint32_t*)(base + h->rows_offset);
+    const GtokEdge* edges = (const GtokEdge*)(base + h->edges_offset);
+    const char* strings = base + h->strings_offset;
+    if (!error && h->strings_size && strings[h->strings_size - 1] != '\0') error = "corrupt string table";
+    if (!error) error = gtok_check_sections(h, tokens, rows, edges);
+    
+    if (!error && verify_checksum) {
+        if (pheno_crc32(0, base + sizeof(GtokHeader), size - sizeof(GtokHeader)) != h->checksum) {
+            error = "checksum mismatch";
+        }
+    }
+    
+    if (error) {
+        fprintf(stderr, "[GTOK] %s: %s\n", path, error);
+        munmap(data, (size_t)size);
+        return false;
+    }
+    
+    file->header = h;
+    file->tokens = tokens;
+    file->strings = strings;
+    file->rows = rows;
+    file->edges = edges;
+    file->size = (size_t)size;
+    return true;
+}
+
+void gtok_close(GtokFile* file) {
+    if (file->header) {
+        munmap((void*)file->header, file->size);
+    }
+    memset(file, 0, sizeof(*file));
+}
+
+bool gtok_probe(const char* path) {
+    char magic[4];
+    int fd = open(path, O_RDONLY);
+    if (fd < 0) return false;
+    bool match = read(fd, magic, sizeof(magic)) == (ssize_t)sizeof(magic) &&
+                 memcmp(magic, GTOK_MAGIC, 4) == 0;
+    close(fd);
+    return match;
+}
+
+PhenoToken* gtok_load_set(const char* path, int* count) {
+    GtokFile file;
+    *count = 0;
+    if (!gtok_open(path, false, &file)) return NULL;
+    
+    const GtokHeader* h = file.header;
+    PhenoToken* set = token_set_alloc(h->token_count, h->edge_count);
+    if (!set) {
+        fprintf(stderr, "[GTOK] %s: out of memory\n", path);
+        gtok_close(&file);
+        return NULL;
+    }
+    
+    for (uint32_t i = 0; i < h->token_count; i++) {
+        const char* type = gtok_string(&file, file.tokens[i].type);
+        TokenRecord rec = { file.tokens[i].token_id, { type, strlen(type) }, file.tokens[i].zone, 0 };
+        token_set_init_token(&set[i], &rec);
+    }
+    
+    // Relations come out grouped by source token
+    PhenoEdge* relations = token_set_header(set)->relations;
+    for (uint32_t i = 0; i < h->token_count; i++) {
+        size_t n;
+        const GtokEdge* edges = gtok_edges_of(&file, i, &n);
+        for (size_t e = 0; e < n; e++) {
+            const char* type = gtok_string(&file, edges[e].type);
+            RelationRecord rec = { file.tokens[i].token_id, edges[e].dst_id, { type, strlen(type) }, 0 };
+            token_set_init_relation(relations++, &rec);
+        }
+    }
+    
+    *count = (int)h->token_count;
+    gtok_close(&file);
+    return set;
+}
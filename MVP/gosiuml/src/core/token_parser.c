@@ -1,65 +1,314 @@
+#define _GNU_SOURCE
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
 #include "gosiuml.h"
-#include "phenomemory_platform.h"
+#include "token_parser.h"
 
-// Parse token file and allocate tokens
-int parse_token_file(const char* filename) {
-    printf("[PARSER] Parsing token file: %s\n", filename);
+static inline bool is_blank(char c) {
+    return c == ' ' || c == '\t';
+}
+
+static inline const char* skip_blanks(const char* p, const char* end) {
+    while (p < end && is_blank(*p)) p++;
+    return p;
+}
+
+// Hex digit value, or -1
+static inline int hex_digit(unsigned char c) {
+    unsigned digit = (unsigned)c - '0';
+    unsigned alpha = (unsigned)(c | 0x20) - 'a';
+    if (digit < 10) return (int)digit;
+    if (alpha < 6) return (int)alpha + 10;
+    return -1;
+}
+
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+// Parse exactly 8 hex digits with SWAR range checks; false if any byte
+// is not a hex digit
+static inline bool parse_hex8(const char* p, uint32_t* out) {
+    const uint64_t ones = 0x0101010101010101ULL;
+    const uint64_t high = 0x8080808080808080ULL;
+    uint64_t v;
+    memcpy(&v, p, 8);
+    if (v & high) return false;
     
-    FILE* fp = fopen(filename, "r");
-    if (!fp) {
-        printf("[PARSER] Could not open file: %s\n", filename);
-        return -1;
+    uint64_t lower = v | (ones * 0x20);    // 'A'-'F' -> 'a'-'f', digits unchanged
+    uint64_t ge_0 = v + ones * (0x80 - '0');
+    uint64_t gt_9 = v + ones * (0x7F - '9');
+    uint64_t ge_a = lower + ones * (0x80 - 'a');
+    uint64_t gt_f = lower + ones * (0x7F - 'f');
+    uint64_t digit = ge_0 & ~gt_9 & high;
+    uint64_t alpha = ge_a & ~gt_f & high;
+    if ((digit | alpha) != high) return false;
+    
+    // Nibble values, then fold pairs (first character is most significant)
+    uint64_t nib = (lower & (ones * 0x0F)) + (alpha >> 7) * 9;
+    nib = ((nib << 4) | (nib >> 8)) & 0x00FF00FF00FF00FFULL;
+    nib = ((nib << 8) | (nib >> 16)) & 0x0000FFFF0000FFFFULL;
+    *out = (uint32_t)((nib << 16) | (nib >> 32));
+    return true;
+}
+#endif
+
+// Parse an optionally 0x-prefixed hex id of up to 8 digits
+static const char* parse_hex_id(const char* p, const char* end, uint32_t* out) {
+    if (end - p >= 2 && p[0] == '0' && (p[1] | 0x20) == 'x') p += 2;
+    
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+    if (end - p >= 8 && parse_hex8(p, out)) {
+        p += 8;
+        return (p < end && hex_digit((unsigned char)*p) >= 0) ? NULL : p;
     }
+#endif
     
-    char line[256];
-    int token_count = 0;
+    uint32_t value = 0;
+    const char* start = p;
+    int d;
+    while (p < end && (d = hex_digit((unsigned char)*p)) >= 0) {
+        if (p - start == 8) return NULL;   // More than 32 bits
+        value = (value << 4) | (uint32_t)d;
+        p++;
+    }
+    if (p == start) return NULL;
+    *out = value;
+    return p;
+}
+
+static const char* parse_zone(const char* p, const char* end, uint8_t* out) {
+    uint32_t value = 0;
+    const char* start = p;
+    while (p < end && (unsigned)(*p - '0') < 10) {
+        value = value * 10 + (uint32_t)(*p - '0');
+        if (value >= MAX_MEMORY_ZONES) return NULL;
+        p++;
+    }
+    if (p == start) return NULL;
+    *out = (uint8_t)value;
+    return p;
+}
+
+static const char* parse_word(const char* p, const char* end, TokenView* out) {
+    const char* start = p;
+    while (p < end && !is_blank(*p)) p++;
+    out->ptr = start;
+    out->len = (size_t)(p - start);
+    return p == start ? NULL : p;
+}
+
+static void report_error(const TokenScanHandler* handler, size_t line,
+                         const char* message, TokenScanStats* stats) {
+    stats->errors++;
+    if (handler->on_error) {
+        handler->on_error(handler->source, line, message, handler->user);
+    } else {
+        fprintf(stderr, "[PARSER] %s:%zu: %s\n",
+                handler->source ? handler->source : "<buffer>", line, message);
+    }
+}
+
+// "TOKEN:" <hex id> <type> <zone>
+static const char* scan_token(const char* p, const char* end, TokenRecord* rec) {
+    if (!(p = parse_hex_id(skip_blanks(p, end), end, &rec->id))) return "invalid token id";
+    if (p == end || !is_blank(*p)) return "expected token type";
+    if (!(p = parse_word(skip_blanks(p, end), end, &rec->type))) return "expected token type";
+    if (!(p = parse_zone(skip_blanks(p, end), end, &rec->zone))) return "invalid memory zone";
+    if (skip_blanks(p, end) != end) return "unexpected trailing characters";
+    return NULL;
+}
+
+// "RELATION:" <hex src> "->" <hex dst> ":" <type>
+static const char* scan_relation(const char* p, const char* end, RelationRecord* rec) {
+    if (!(p = parse_hex_id(skip_blanks(p, end), end, &rec->src_id))) return "invalid source id";
+    p = skip_blanks(p, end);
+    if (end - p < 2 || p[0] != '-' || p[1] != '>') return "expected '->'";
+    if (!(p = parse_hex_id(skip_blanks(p + 2, end), end, &rec->dst_id))) return "invalid destination id";
+    p = skip_blanks(p, end);
+    if (p == end || *p != ':') return "expected ':'";
+    if (!(p = parse_word(skip_blanks(p + 1, end), end, &rec->rel_type))) return "expected relation type";
+    if (skip_blanks(p, end) != end) return "unexpected trailing characters";
+    return NULL;
+}
+
+void token_scan_buffer(const char* data, size_t size, size_t first_line,
+                       const TokenScanHandler* handler, TokenScanStats* stats) {
+    const char* p = data;
+    const char* limit = data + size;
+    size_t line = first_line;
     
-    while (fgets(line, sizeof(line), fp)) {
-        // Skip comments and empty lines
-        if (line[0] == '#' || line[0] == '\n') continue;
+    while (p < limit) {
+        const char* newline = memchr(p, '\n', (size_t)(limit - p));
+        const char* end = newline ? newline : limit;
+        const char* next = newline ? newline + 1 : limit;
+        if (end > p && end[-1] == '\r') end--;
         
-        // Parse token definitions
-        if (strstr(line, "TOKEN:")) {
-            uint32_t id;
-            char type[32], zone[16];
+        p = skip_blanks(p, end);
+        if (p < end && *p != '#') {
+            size_t len = (size_t)(end - p);
+            const char* error = NULL;
             
-            if (sscanf(line, "TOKEN: 0x%x %s %s", &id, type, zone) == 3) {
-                token_count++;
-                printf("[PARSER] Found token: ID=0x%08X TYPE=%s ZONE=%s\n", 
-                       id, type, zone);
-                
-                // Create actual token using pheno_token_alloc
-                PhenoToken* token = pheno_token_alloc(1024);
-                if (token) {
-                    token->token_id = id;
-                    strncpy(token->sentinel, type, 15);
-                    token->sentinel[15] = '\0';  // Ensure null termination
-                    token->memory_zone = atoi(zone);
-                    
-                    // Process the token
-                    printf("[PARSER] Allocated token 0x%08X in zone %u\n",
-                           token->token_id, token->memory_zone);
+            if (len >= 6 && memcmp(p, "TOKEN:", 6) == 0) {
+                TokenRecord rec;
+                rec.line = line;
+                error = scan_token(p + 6, end, &rec);
+                if (!error) {
+                    stats->tokens++;
+                    if (handler->on_token) handler->on_token(&rec, handler->user);
+                }
+            } else if (len >= 9 && memcmp(p, "RELATION:", 9) == 0) {
+                RelationRecord rec;
+                rec.line = line;
+                error = scan_relation(p + 9, end, &rec);
+                if (!error) {
+                    stats->relations++;
+                    if (handler->on_relation) handler->on_relation(&rec, handler->user);
                 }
             }
+            
+            if (error) report_error(handler, line, error, stats);
         }
         
-        // Parse relation definitions
-        if (strstr(line, "RELATION:")) {
-            uint32_t src_id, dst_id;
-            char rel_type[32];
-            
-            if (sscanf(line, "RELATION: 0x%x -> 0x%x : %s", 
-                      &src_id, &dst_id, rel_type) == 3) {
-                printf("[PARSER] Found relation: 0x%08X -> 0x%08X (%s)\n",
-                       src_id, dst_id, rel_type);
+        stats->lines++;
+        line++;
+        p = next;
+    }
+}
+
+bool token_file_map(const char* filename, TokenFileMap* map) {
+    map->data = NULL;
+    map->size = 0;
+    
+    int fd = open(filename, O_RDONLY);
+    if (fd < 0) return false;
+    
+    struct stat st;
+    if (fstat(fd, &st) != 0 || !S_ISREG(st.st_mode)) {
+        close(fd);
+        return false;
+    }
+    
+    if (st.st_size > 0) {
+        void* data = mmap(NULL, (size_t)st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (data == MAP_FAILED) {
+            close(fd);
+            return false;
+        }
+        madvise(data, (size_t)st.st_size, MADV_SEQUENTIAL);
+        map->data = (const char*)data;
+        map->size = (size_t)st.st_size;
+    }
+    
+    close(fd);
+    return true;
+}
+
+void token_file_unmap(TokenFileMap* map) {
+    if (map->data) {
+        munmap((void*)map->data, map->size);
+    }
+    map->data = NULL;
+    map->size = 0;
+}
+
+int token_scan_stream(int fd, const TokenScanHandler* handler, TokenScanStats* stats) {
+    char* buffer = (char*)malloc(TOKEN_STREAM_BUFFER);
+    if (!buffer) return -1;
+    
+    size_t pending = 0;         // Bytes of an incomplete line kept at the front
+    bool discarding = false;    // Inside a line longer than the buffer
+    size_t line = 1 + stats->lines;
+    int status = 0;
+    
+    for (;;) {
+        ssize_t n = read(fd, buffer + pending, TOKEN_STREAM_BUFFER - pending);
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            status = -1;
+            break;
+        }
+        if (n == 0) break;
+        
+        char* data = buffer;
+        size_t size = pending + (size_t)n;
+        
+        if (discarding) {
+            char* newline = memchr(data, '\n', size);
+            if (!newline) {
+                pending = 0;
+                continue;
             }
+            discarding = false;
+            stats->lines++;
+            line++;
+            size -= (size_t)(newline + 1 - data);
+            data = newline + 1;
+        }
+        
+        // Scan complete lines; the tail waits for the next read
+        char* last = size ? memrchr(data, '\n', size) : NULL;
+        size_t complete = last ? (size_t)(last + 1 - data) : 0;
+        if (complete) {
+            size_t before = stats->lines;
+            token_scan_buffer(data, complete, line, handler, stats);
+            line += stats->lines - before;
+        }
+        
+        pending = size - complete;
+        if (pending == TOKEN_STREAM_BUFFER) {
+            report_error(handler, line, "line too long", stats);
+            discarding = true;
+            pending = 0;
+        } else if (pending) {
+            memmove(buffer, data + complete, pending);
         }
     }
     
-    fclose(fp);
-    printf("[PARSER] Parsed %d tokens\n", token_count);
-    return token_count;
+    // Final line without a newline
+    if (status == 0 && pending && !discarding) {
+        token_scan_buffer(buffer, pending, line, handler, stats);
+    } else if (discarding) {
+        stats->lines++;
+    }
+    
+    free(buffer);
+    return status;
+}
+
+int gosiuml_parse_stream(int fd, TokenCallback on_token, RelationCallback on_relation, void* user) {
+    char source[32];
+    snprintf(source, sizeof(source), "<fd %d>", fd);
+    
+    TokenScanHandler handler = {
+        .on_token = on_token,
+        .on_relation = on_relation,
+        .user = user,
+        .source = source
+    };
+    TokenScanStats stats = {0};
+    return token_scan_stream(fd, &handler, &stats);
+}
+
+// Parse token file and report what it contains
+int parse_token_file(const char* filename) {
+    printf("[PARSER] Parsing token file: %s\n", filename);
+    
+    TokenFileMap map;
+    if (!token_file_map(filename, &map)) {
+        printf("[PARSER] Could not open file: %s\n", filename);
+        return -1;
+    }
+    
+    TokenScanHandler handler = { .source = filename };
+    TokenScanStats stats = {0};
+    token_scan_buffer(map.data, map.size, 1, &handler, &stats);
+    token_file_unmap(&map);
+    
+    printf("[PARSER] Parsed %zu tokens, %zu relations (%zu lines, %zu errors)\n",
+           stats.tokens, stats.relations, stats.lines, stats.errors);
+    return (int)stats.tokens;
 }
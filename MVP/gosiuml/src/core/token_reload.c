@@ -0,0 +1,683 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <poll.h>
+#include <unistd.h>
+#include <sys/inotify.h>
+#include "token_reload.h"
+#include "token_parser.h"
+#include "pheno_id_map.h"
+#include "pheno_symbol.h"
+
+#define RELOAD_SLAB_BLOCK 4096      // Tokens per slab block (addresses never move)
+#define RELOAD_NO_SLOT 0xFFFFFFFFu
+
+enum {
+    LINE_INVALID,
+    LINE_TOKEN,
+    LINE_RELATION
+};
+
+// One distinct record line: its hash, multiplicity and parsed record
+typedef struct {
+    uint64_t hash;          // 0 marks an empty slot
+    uint32_t count;
+    uint8_t kind;
+    uint8_t zone;
+    char type[16];
+    uint32_t symbol;        // Interned token type
+    uint32_t id;            // Token id, or relation source
+    uint32_t dst_id;
+} LineEntry;
+
+typedef struct {
+    LineEntry* entries;
+    size_t mask;
+    size_t count;
+} LineMap;
+
+typedef struct {
+    LineEntry* items;
+    size_t count;
+    size_t capacity;
+} LineList;
+
+typedef struct {
+    uint64_t* items;
+    size_t count;
+    size_t capacity;
+} HashList;
+
+struct TokenReloader {
+    char* path;
+    LineMap lines;
+    
+    // Token slab
+    PhenoToken** blocks;
+    uint32_t* defs;             // Definition lines per slot (duplicate ids share a slot)
+    size_t block_count;
+    size_t slot_count;          // Slots handed out so far
+    uint32_t* free_slots;
+    size_t free_count;
+    size_t free_capacity;
+    PhenoIdMap ids;             // token id -> slot
+    uint32_t reserved_slot;     // Slot of PHENO_ID_MAP_EMPTY, which the map cannot hold
+    size_t live;
+    
+    PhenoReachIndex* graph;
+    TokenReloadHandler handler;
+    int watch_fd;
+    int watch_wd;
+};
+
+// 64-bit line hash, 8 bytes per step; never returns 0
+static uint64_t line_hash(const char* p, size_t len) {
+    const uint64_t k = 0x9E3779B97F4A7C15ULL;
+    uint64_t h = len * k;
+    while (len >= 8) {
+        uint64_t w;
+        memcpy(&w, p, 8);
+        h = (h ^ w) * k;
+        h ^= h >> 29;
+        p += 8;
+        len -= 8;
+    }
+    if (len) {
+        uint64_t w = 0;
+        memcpy(&w, p, len);
+        h = (h ^ w) * k;
+    }
+    h ^= h >> 32;
+    h *= 0xD6E8FEB86659FD93ULL;
+    h ^= h >> 32;
+    return h ? h : 1;
+}
+
+static bool line_map_init(LineMap* map, size_t expected) {
+    size_t capacity = 1024;
+    while (capacity < expected * 2) capacity <<= 1;
+    map->entries = (LineEntry*)calloc(capacity, sizeof(LineEntry));
+    map->mask = capacity - 1;
+    map->count = 0;
+    return map->entries != NULL;
+}
+
+static void line_map_free(LineMap* map) {
+    free(map->entries);
+    map->entries = NULL;
+    map->mask = 0;
+    map->count = 0;
+}
+
+static LineEntry* line_map_find(const LineMap* map, uint64_t hash) {
+    if (!map->entries) return NULL;
+    
+    size_t slot = (size_t)hash & map->mask;
+    while (map->entries[slot].hash) {
+        if (map->entries[slot].hash == hash) return &map->entries[slot];
+        slot = (slot + 1) & map->mask;
+    }
+    return NULL;
+}
+
+static bool line_map_grow(LineMap* map) {
+    LineMap grown;
+    if (!line_map_init(&grown, (map->mask + 1))) return false;
+    
+    for (size_t i = 0; i <= map->mask; i++) {
+        if (!map->entries[i].hash) continue;
+        size_t slot = (size_t)map->entries[i].hash & grown.mask;
+        while (grown.entries[slot].hash) slot = (slot + 1) & grown.mask;
+        grown.entries[slot] = map->entries[i];
+    }
+    grown.count = map->count;
+    free(map->entries);
+    *map = grown;
+    return true;
+}
+
+// Find or insert (count 0); *inserted tells which. NULL on allocation failure.
+static LineEntry* line_map_upsert(LineMap* map, uint64_t hash, bool* inserted) {
+    if ((map->count + 1) * 2 > map->mask + 1 && !line_map_grow(map)) return NULL;
+    
+    size_t slot = (size_t)hash & map->mask;
+    while (map->entries[slot].hash) {
+        if (map->entries[slot].hash == hash) {
+            *inserted = false;
+            return &map->entries[slot];
+        }
+        slot = (slot + 1) & map->mask;
+    }
+    LineEntry* entry = &map->entries[slot];
+    memset(entry, 0, sizeof(*entry));
+    entry->hash = hash;
+    map->count++;
+    *inserted = true;
+    return entry;
+}
+
+static bool line_list_push(LineList* list, const LineEntry* entry) {
+    if (list->count == list->capacity) {
+        size_t capacity = list->capacity ? list->capacity * 2 : 64;
+        LineEntry* items = (LineEntry*)realloc(list->items, capacity * sizeof(LineEntry));
+        if (!items) return false;
+        list->items = items;
+        list->capacity = capacity;
+    }
+    list->items[list->count++] = *entry;
+    return true;
+}
+
+static void copy_type(char* dst, const TokenView* view) {
+    size_t len = view->len < 15 ? view->len : 15;
+    memcpy(dst, view->ptr, len);
+    memset(dst + len, 0, 16 - len);
+}
+
+static void parse_token_line(const TokenRecord* rec, void* user) {
+    LineEntry* entry = (LineEntry*)user;
+    entry->kind = LINE_TOKEN;
+    entry->id = rec->id;
+    entry->zone = rec->zone;
+    copy_type(entry->type, &rec->type);
+    entry->symbol = pheno_symbol_intern(rec->type.ptr, rec->type.len);
+}
+
+static void parse_relation_line(const RelationRecord* rec, void* user) {
+    LineEntry* entry = (LineEntry*)user;
+    // The graph cannot hold the reserved id; such relations are skipped
+    if (rec->src_id == PHENO_ID_MAP_EMPTY || rec->dst_id == PHENO_ID_MAP_EMPTY) return;
+    entry->kind = LINE_RELATION;
+    entry->id = rec->src_id;
+    entry->dst_id = rec->dst_id;
+    copy_type(entry->type, &rec->rel_type);
+}
+
+// ---- Token slab ----
+
+static PhenoToken* slab_token(const TokenReloader* r, uint32_t slot) {
+    return &r->blocks[slot / RELOAD_SLAB_BLOCK][slot % RELOAD_SLAB_BLOCK];
+}
+
+static uint32_t slab_find(const TokenReloader* r, uint32_t id) {
+    uint32_t slot = RELOAD_NO_SLOT;
+    if (id == PHENO_ID_MAP_EMPTY) return r->reserved_slot;
+    pheno_id_map_get(&r->ids, id, &slot);
+    return slot;
+}
+
+static uint32_t slab_alloc(TokenReloader* r, uint32_t id) {
+    uint32_t slot;
+    bool reused = r->free_count > 0;
+    if (reused) {
+        slot = r->free_slots[--r->free_count];
+    } else {
+        if (r->slot_count >= RELOAD_NO_SLOT) return RELOAD_NO_SLOT;
+        if (r->slot_count == r->block_count * RELOAD_SLAB_BLOCK) {
+            size_t count = r->block_count + 1;
+            PhenoToken** blocks = (PhenoToken**)realloc(r->blocks, count * sizeof(PhenoToken*));
+            if (!blocks) return RELOAD_NO_SLOT;
+            r->blocks = blocks;
+            uint32_t* defs = (uint32_t*)realloc(r->defs, count * RELOAD_SLAB_BLOCK * sizeof(uint32_t));
+            if (!defs) return RELOAD_NO_SLOT;
+            r->defs = defs;
+            r->blocks[r->block_count] = (PhenoToken*)calloc(RELOAD_SLAB_BLOCK, sizeof(PhenoToken));
+            if (!r->blocks[r->block_count]) return RELOAD_NO_SLOT;
+            r->block_count = count;
+        }
+        slot = (uint32_t)r->slot_count++;
+    }
+    
+    if (id == PHENO_ID_MAP_EMPTY) {
+        r->reserved_slot = slot;
+    } else if (!pheno_id_map_put(&r->ids, id, slot)) {
+        if (reused) r->free_count++;
+        else r->slot_count--;
+        return RELOAD_NO_SLOT;
+    }
+    r->defs[slot] = 0;
+    r->live++;
+    return slot;
+}
+
+// Room for `extra` more free slots, so that many releases cannot fail
+static bool slab_reserve_free(TokenReloader* r, size_t extra) {
+    if (r->free_count + extra <= r->free_capacity) return true;
+    
+    size_t capacity = r->free_capacity ? r->free_capacity : 1024;
+    while (capacity < r->free_count + extra) capacity *= 2;
+    uint32_t* slots = (uint32_t*)realloc(r->free_slots, capacity * sizeof(uint32_t));
+    if (!slots) return false;
+    r->free_slots = slots;
+    r->free_capacity = capacity;
+    return true;
+}
+
+static bool slab_release(TokenReloader* r, uint32_t slot, uint32_t id) {
+    if (!slab_reserve_free(r, 1)) return false;
+    
+    PhenoToken* token = slab_token(r, slot);
+    memset(token->sentinel, 0, sizeof(token->sentinel));
+    token->type_symbol = PHENO_SYMBOL_NONE;
+    atomic_store(&token->mem_flags.flags, 0);
+    atomic_store(&token->mem_flags.ref_count, 0);
+    
+    if (id == PHENO_ID_MAP_EMPTY) r->reserved_slot = RELOAD_NO_SLOT;
+    else pheno_id_map_remove(&r->ids, id);
+    r->free_slots[r->free_count++] = slot;
+    r->live--;
+    return true;
+}
+
+static void slab_define(PhenoToken* token, const LineEntry* entry) {
+    memcpy(token->sentinel, entry->type, sizeof(token->sentinel));
+    token->memory_zone = entry->zone;
+    token->type_symbol = entry->symbol;
+}
+
+// ---- Reload ----
+
+TokenReloader* token_reloader_create(const char* path) {
+    TokenReloader* r = (TokenReloader*)calloc(1, sizeof(TokenReloader));
+    if (!r) return NULL;
+    
+    r->path = strdup(path);
+    r->graph = reach_index_create();
+    r->reserved_slot = RELOAD_NO_SLOT;
+    r->watch_fd = -1;
+    r->watch_wd = -1;
+    if (!r->path || !r->graph || !pheno_id_map_init(&r->ids, 1024) ||
+        !line_map_init(&r->lines, 0)) {
+        token_reloader_destroy(r);
+        return NULL;
+    }
+    return r;
+}
+
+void token_reloader_destroy(TokenReloader* r) {
+    if (!r) return;
+    
+    for (size_t b = 0; b < r->block_count; b++) {
+        free(r->blocks[b]);
+    }
+    free(r->blocks);
+    free(r->defs);
+    free(r->free_slots);
+    pheno_id_map_free(&r->ids);
+    line_map_free(&r->lines);
+    if (r->graph) reach_index_destroy(r->graph);
+    if (r->watch_fd >= 0) close(r->watch_fd);
+    free(r->path);
+    free(r);
+}
+
+// What an applied token line did, so a failed diff can be undone
+typedef struct {
+    uint32_t slot;
+    bool allocated;         // Slot was handed out for this line
+} ReloadUndo;
+
+// Token ids whose lines a diff adds or removes, mapped to 1 if the diff
+// created the token. Sized up front, so adding an id cannot fail.
+typedef struct {
+    PhenoIdMap ids;
+    int reserved;           // Same for PHENO_ID_MAP_EMPTY; -1 if untouched
+} TouchedIds;
+
+static void touched_add(TouchedIds* t, uint32_t id, uint32_t created) {
+    uint32_t existing;
+    if (id != PHENO_ID_MAP_EMPTY) pheno_id_map_insert(&t->ids, id, created, &existing);
+    else if (t->reserved < 0) t->reserved = (int)created;
+}
+
+static bool touched_take(TouchedIds* t, uint32_t id, uint32_t* created) {
+    if (id == PHENO_ID_MAP_EMPTY) {
+        if (t->reserved < 0) return false;
+        *created = (uint32_t)t->reserved;
+        t->reserved = -1;
+        return true;
+    }
+    if (!pheno_id_map_get(&t->ids, id, created)) return false;
+    pheno_id_map_remove(&t->ids, id);
+    return true;
+}
+
+static size_t touched_count(const TouchedIds* t) {
+    return t->ids.count + (t->reserved >= 0);
+}
+
+static void report_token(const TokenReloader* r, uint32_t id, TokenReloadChange change) {
+    if (r->handler.on_token) r->handler.on_token(id, change, r->handler.user);
+}
+
+// Undo the first `applied` additions, newest first. Removing an edge
+// that was just added cannot fail.
+static void undo_additions(TokenReloader* r, const LineList* added, const ReloadUndo* undo,
+                           size_t applied) {
+    for (size_t i = applied; i-- > 0; ) {
+        const LineEntry* e = &added->items[i];
+        if (e->kind == LINE_RELATION) {
+            reach_remove_edge(r->graph, e->id, e->dst_id);
+            continue;
+        }
+        if (e->kind != LINE_TOKEN) continue;
+        
+        r->defs[undo[i].slot]--;
+        if (undo[i].allocated) slab_release(r, undo[i].slot, e->id);
+    }
+}
+
+// Put back the edges of the first `applied` removals; adding back an
+// edge that was just removed cannot fail
+static void undo_unlinks(TokenReloader* r, const LineList* removed, size_t applied) {
+    for (size_t i = applied; i-- > 0; ) {
+        const LineEntry* e = &removed->items[i];
+        if (e->kind == LINE_RELATION) reach_add_edge(r->graph, e->id, e->dst_id);
+    }
+}
+
+// Each token whose lines changed takes its definition from its first line
+// in the file, as a fresh load would. order lists the token lines of the
+// file by hash.
+static void define_touched(TokenReloader* r, TouchedIds* touched, const LineMap* lines,
+                           const HashList* order, TokenReloadStats* stats) {
+    for (size_t i = 0; touched_count(touched) && i < order->count; i++) {
+        const LineEntry* e = line_map_find(lines, order->items[i]);
+        uint32_t created;
+        if (!e || !touched_take(touched, e->id, &created)) continue;
+        
+        PhenoToken* token = slab_token(r, slab_find(r, e->id));
+        if (created) {
+            slab_define(token, e);
+            report_token(r, e->id, TOKEN_RELOAD_ADDED);
+        } else if (token->type_symbol != e->symbol || token->memory_zone != e->zone ||
+                   memcmp(token->sentinel, e->type, sizeof(token->sentinel)) != 0) {
+            slab_define(token, e);
+            stats->tokens_changed++;
+            report_token(r, e->id, TOKEN_RELOAD_CHANGED);
+        }
+    }
+}
+
+// Apply a diff in three steps. Additions first: new ids get a slot and
+// every token line counts as a definition of its slot, so an edited token
+// (same id removed and added) keeps its slot and flags. Then removals:
+// edges leave the graph and slots left without definitions are released.
+// Adding a slot or an edge can run out of memory and removing an edge
+// fails if the graph does not hold it; everything applied up to then is
+// undone, leaving the live state as it was. Releasing slots (reserved up
+// front) and the final definitions cannot fail.
+static bool apply_diff(TokenReloader* r, const LineList* added, const LineList* removed,
+                       const LineMap* lines, const HashList* order, TokenReloadStats* stats) {
+    TouchedIds touched = { .reserved = -1 };
+    if (!pheno_id_map_init(&touched.ids, added->count + removed->count)) return false;
+    
+    ReloadUndo* undo = (ReloadUndo*)malloc((added->count ? added->count : 1) * sizeof(ReloadUndo));
+    if (!undo || !slab_reserve_free(r, added->count + removed->count)) {
+        free(undo);
+        pheno_id_map_free(&touched.ids);
+        return false;
+    }
+    
+    bool ok = true;
+    size_t applied = 0;
+    for (; ok && applied < added->count; applied++) {
+        const LineEntry* e = &added->items[applied];
+        if (e->kind == LINE_RELATION) {
+            ok = reach_add_edge(r->graph, e->id, e->dst_id);
+            if (!ok) break;
+            stats->relations_added++;
+            continue;
+        }
+        if (e->kind != LINE_TOKEN) continue;
+        
+        ReloadUndo* u = &undo[applied];
+        uint32_t slot = slab_find(r, e->id);
+        u->allocated = slot == RELOAD_NO_SLOT;
+        if (slot == RELOAD_NO_SLOT) {
+            slot = slab_alloc(r, e->id);
+            if (slot == RELOAD_NO_SLOT) {
+                ok = false;
+                break;
+            }
+            PhenoToken* token = slab_token(r, slot);
+            token->token_id = e->id;
+            atomic_store(&token->mem_flags.flags, 1U << FLAG_ALLOCATED_BIT);
+            atomic_store(&token->mem_flags.ref_count, 1);
+            atomic_store(&token->mem_flags.degradation_metrics, 0);
+            token->thread_owner = 0;
+            token->data_ptr = NULL;
+            token->data_size = 0;
+            stats->tokens_added++;
+        }
+        touched_add(&touched, e->id, u->allocated);
+        u->slot = slot;
+        r->defs[slot]++;
+    }
+    
+    size_t unlinked = 0;
+    for (; ok && unlinked < removed->count; unlinked++) {
+        const LineEntry* e = &removed->items[unlinked];
+        if (e->kind != LINE_RELATION) continue;
+        ok = reach_remove_edge(r->graph, e->id, e->dst_id);
+        if (!ok) break;
+        stats->relations_removed++;
+    }
+    
+    if (!ok) {
+        undo_unlinks(r, removed, unlinked);
+        undo_additions(r, added, undo, applied);
+        stats->tokens_added = stats->tokens_changed = 0;
+        stats->relations_added = stats->relations_removed = 0;
+        free(undo);
+        pheno_id_map_free(&touched.ids);
+        return false;
+    }
+    free(undo);
+    
+    for (size_t i = 0; i < removed->count; i++) {
+        const LineEntry* e = &removed->items[i];
+        if (e->kind != LINE_TOKEN) continue;
+        
+        uint32_t slot = slab_find(r, e->id);
+        if (slot == RELOAD_NO_SLOT) continue;
+        touched_add(&touched, e->id, 0);
+        if (--r->defs[slot] == 0) {
+            uint32_t created;
+            slab_release(r, slot, e->id);
+            touched_take(&touched, e->id, &created);
+            stats->tokens_removed++;
+            report_token(r, e->id, TOKEN_RELOAD_REMOVED);
+        }
+    }
+    define_touched(r, &touched, lines, order, stats);
+    
+    if (r->handler.on_relation) {
+        for (size_t i = 0; i < added->count; i++) {
+            const LineEntry* e = &added->items[i];
+            if (e->kind == LINE_RELATION) r->handler.on_relation(e->id, e->dst_id, true, r->handler.user);
+        }
+        for (size_t i = 0; i < removed->count; i++) {
+            const LineEntry* e = &removed->items[i];
+            if (e->kind == LINE_RELATION) r->handler.on_relation(e->id, e->dst_id, false, r->handler.user);
+        }
+    }
+    
+    pheno_id_map_free(&touched.ids);
+    return true;
+}
+
+static bool hash_list_push(HashList* list, uint64_t hash) {
+    if (list->count == list->capacity) {
+        size_t capacity = list->capacity ? list->capacity * 2 : 1024;
+        uint64_t* items = (uint64_t*)realloc(list->items, capacity * sizeof(uint64_t));
+        if (!items) return false;
+        list->items = items;
+        list->capacity = capacity;
+    }
+    list->items[list->count++] = hash;
+    return true;
+}
+
+bool token_reloader_reload(TokenReloader* r, TokenReloadStats* stats) {
+    TokenReloadStats local;
+    if (!stats) stats = &local;
+    memset(stats, 0, sizeof(*stats));
+    
+    TokenFileMap map;
+    if (!token_file_map(r->path, &map)) {
+        printf("[RELOAD] Could not open file: %s\n", r->path);
+        return false;
+    }
+    
+    LineMap lines;
+    LineList added = {0}, removed = {0};
+    HashList order = {0};
+    bool ok = line_map_init(&lines, r->lines.count);
+    
+    // Hash every record line; lines beyond the previous multiplicity are new
+    const char* p = map.data;
+    const char* limit = map.data + map.size;
+    size_t line_number = 0;
+    while (ok && p < limit) {
+        const char* newline = memchr(p, '\n', (size_t)(limit - p));
+        const char* end = newline ? newline : limit;
+        const char* start = p;
+        p = newline ? newline + 1 : limit;
+        line_number++;
+        
+        while (start < end && (*start == ' ' || *start == '\t')) start++;
+        if (start == end || (*start != 'T' && *start != 'R')) continue;
+        
+        uint64_t hash = line_hash(start, (size_t)(end - start));
+        const LineEntry* previous = line_map_find(&r->lines, hash);
+        bool inserted;
+        LineEntry* entry = line_map_upsert(&lines, hash, &inserted);
+        if (!entry) {
+            ok = false;
+            break;
+        }
+        
+        if (inserted) {
+            if (previous) {
+                *entry = *previous;
+                entry->count = 0;
+            } else {
+                TokenScanHandler handler = {
+                    .on_token = parse_token_line,
+                    .on_relation = parse_relation_line,
+                    .user = entry,
+                    .source = r->path
+                };
+                TokenScanStats scan = {0};
+                token_scan_buffer(start, (size_t)(end - start), line_number, &handler, &scan);
+            }
+        }
+        
+        entry->count++;
+        if (entry->kind == LINE_TOKEN && !hash_list_push(&order, hash)) {
+            ok = false;
+            break;
+        }
+        if (previous && entry->count <= previous->count) stats->lines_unchanged++;
+        else ok = line_list_push(&added, entry);
+    }
+    stats->lines = line_number;
+    token_file_unmap(&map);
+    
+    // Previous lines now seen fewer times were removed
+    for (size_t i = 0; ok && i <= r->lines.mask; i++) {
+        const LineEntry* previous = &r->lines.entries[i];
+        if (!previous->hash) continue;
+        const LineEntry* current = line_map_find(&lines, previous->hash);
+        for (uint32_t k = current ? current->count : 0; ok && k < previous->count; k++) {
+            ok = line_list_push(&removed, previous);
+        }
+    }
+    
+    // The new line map replaces the old one only once the diff is applied
+    if (ok) ok = apply_diff(r, &added, &removed, &lines, &order, stats);
+    if (ok) {
+        line_map_free(&r->lines);
+        r->lines = lines;
+    } else {
+        line_map_free(&lines);
+        fprintf(stderr, "[RELOAD] Could not apply the changes to %s; keeping the previous state\n", r->path);
+    }
+    
+    free(added.items);
+    free(removed.items);
+    free(order.items);
+    return ok;
+}
+
+PhenoToken* token_reloader_find(const TokenReloader* r, uint32_t token_id) {
+    uint32_t slot = slab_find(r, token_id);
+    return slot == RELOAD_NO_SLOT ? NULL : slab_token(r, slot);
+}
+
+size_t token_reloader_token_count(const TokenReloader* r) {
+    return r->live;
+}
+
+PhenoReachIndex* token_reloader_graph(const TokenReloader* r) {
+    return r->graph;
+}
+
+void token_reloader_set_handler(TokenReloader* r, const TokenReloadHandler* handler) {
+    if (handler) r->handler = *handler;
+    else memset(&r->handler, 0, sizeof(r->handler));
+}
+
+// ---- inotify ----
+
+int token_reloader_watch(TokenReloader* r) {
+    if (r->watch_fd >= 0) return r->watch_fd;
+    
+    char* dir = strdup(r->path);
+    if (!dir) return -1;
+    char* slash = strrchr(dir, '/');
+    if (slash == dir) slash[1] = '\0';
+    else if (slash) *slash = '\0';
+    else strcpy(dir, ".");
+    
+    int fd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+    if (fd >= 0) {
+        r->watch_wd = inotify_add_watch(fd, dir, IN_CLOSE_WRITE | IN_MOVED_TO);
+        if (r->watch_wd < 0) {
+            close(fd);
+            fd = -1;
+        }
+    }
+    free(dir);
+    r->watch_fd = fd;
+    return fd;
+}
+
+int token_reloader_poll(TokenReloader* r, int timeout_ms, TokenReloadStats* stats) {
+    if (token_reloader_watch(r) < 0) return -1;
+    
+    const char* base = strrchr(r->path, '/');
+    base = base ? base + 1 : r->path;
+    
+    struct pollfd pfd = { .fd = r->watch_fd, .events = POLLIN };
+    int ready = poll(&pfd, 1, timeout_ms);
+    if (ready < 0) return errno == EINTR ? 0 : -1;
+    if (ready == 0) return 0;
+    
+    // Drain all queued events; reload once if any names the file
+    char events[4096] __attribute__((aligned(__alignof__(struct inotify_event))));
+    bool changed = false;
+    ssize_t n;
+    while ((n = read(r->watch_fd, events, sizeof(events))) > 0) {
+        for (char* e = events; e < events + n; ) {
+            const struct inotify_event* event = (const struct inotify_event*)e;
+            if (event->len && strcmp(event->name, base) == 0) changed = true;
+            e += sizeof(struct inotify_event) + event->len;
+        }
+    }
+    
+    if (!changed) return 0;
+    return token_reloader_reload(r, stats) ? 1 : -1;
+}
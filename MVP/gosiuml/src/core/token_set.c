@@ -0,0 +1,375 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <limits.h>
+#include <pthread.h>
+#include "gosiuml.h"
+#include "token_set.h"
+#include "pheno_id_map.h"
+#include "pheno_parallel.h"
+#include "pheno_symbol.h"
+#include "pheno_perf.h"
+#include "token_binary.h"
+
+_Static_assert(sizeof(TokenSetHeader) <= TOKEN_SET_HEADER_SIZE, "token set header too large");
+
+#ifdef DEBUG
+// Live sets, so foreign pointers are refused before the header read
+// (AddressSanitizer flags reads in front of them)
+static TokenSetHeader* g_sets;
+static pthread_mutex_t g_sets_lock = PTHREAD_MUTEX_INITIALIZER;
+
+static bool token_set_listed(const TokenSetHeader* header) {
+    pthread_mutex_lock(&g_sets_lock);
+    const TokenSetHeader* h = g_sets;
+    while (h && h != header) h = h->next;
+    pthread_mutex_unlock(&g_sets_lock);
+    return h != NULL;
+}
+#endif
+
+PhenoToken* token_set_alloc(size_t token_count, size_t relation_count) {
+    size_t token_bytes = token_count * sizeof(PhenoToken);
+    size_t edge_bytes = relation_count * sizeof(PhenoEdge);
+    if (token_count && token_bytes / token_count != sizeof(PhenoToken)) return NULL;
+    if (relation_count && edge_bytes / relation_count != sizeof(PhenoEdge)) return NULL;
+    
+    size_t edge_offset = TOKEN_SET_HEADER_SIZE + token_bytes;
+    edge_offset = (edge_offset + 63) & ~(size_t)63;
+    size_t total = (edge_offset + edge_bytes + 63) & ~(size_t)63;
+    if (total < edge_offset) return NULL;
+    
+    char* base = (char*)aligned_alloc(64, total);
+    if (!base) return NULL;
+    
+    TokenSetHeader* header = (TokenSetHeader*)base;
+    header->magic = TOKEN_SET_MAGIC;
+    header->reserved = 0;
+    header->token_count = token_count;
+    header->relation_count = relation_count;
+    header->relations = (PhenoEdge*)(base + edge_offset);
+    header->self = header;
+    header->next = header->prev = NULL;
+#ifdef DEBUG
+    pthread_mutex_lock(&g_sets_lock);
+    header->next = g_sets;
+    if (g_sets) g_sets->prev = header;
+    g_sets = header;
+    pthread_mutex_unlock(&g_sets_lock);
+#endif
+    return (PhenoToken*)(base + TOKEN_SET_HEADER_SIZE);
+}
+
+TokenSetHeader* token_set_header(const PhenoToken* tokens) {
+    if (!tokens || ((uintptr_t)tokens & 63)) return NULL;
+    
+    TokenSetHeader* header = (TokenSetHeader*)((char*)tokens - TOKEN_SET_HEADER_SIZE);
+#ifdef DEBUG
+    if (!token_set_listed(header)) return NULL;
+#endif
+    return header->magic == TOKEN_SET_MAGIC && header->self == header ? header : NULL;
+}
+
+void token_set_free(PhenoToken* tokens) {
+    TokenSetHeader* header = token_set_header(tokens);
+    if (!header) return;
+    
+#ifdef DEBUG
+    pthread_mutex_lock(&g_sets_lock);
+    if (header->prev) header->prev->next = header->next;
+    else g_sets = header->next;
+    if (header->next) header->next->prev = header->prev;
+    pthread_mutex_unlock(&g_sets_lock);
+#endif
+    header->magic = 0;
+    header->self = NULL;
+    free(header);
+}
+
+void token_set_init_token(PhenoToken* token, const TokenRecord* rec) {
+    size_t len = rec->type.len < 15 ? rec->type.len : 15;
+    
+    token->token_id = rec->id;
+    memcpy(token->sentinel, rec->type.ptr, len);
+    memset(token->sentinel + len, 0, sizeof(token->sentinel) - len);
+    token->memory_zone = rec->zone;
+    token->type_symbol = pheno_symbol_intern(rec->type.ptr, rec->type.len);
+    atomic_init(&token->mem_flags.flags, 1U << FLAG_ALLOCATED_BIT);
+    atomic_init(&token->mem_flags.ref_count, 1);
+    atomic_init(&token->mem_flags.degradation_metrics, 0);
+    token->thread_owner = 0;
+    token->data_ptr = NULL;
+    token->data_size = 0;
+}
+
+void token_set_init_relation(PhenoEdge* edge, const RelationRecord* rec) {
+    size_t len = rec->rel_type.len < 15 ? rec->rel_type.len : 15;
+    
+    edge->src_id = rec->src_id;
+    edge->dst_id = rec->dst_id;
+    memcpy(edge->rel_type, rec->rel_type.ptr, len);
+    memset(edge->rel_type + len, 0, sizeof(edge->rel_type) - len);
+}
+
+#define LOAD_MIN_CHUNK (1 << 20)     // Files are split into chunks of at least 1 MB
+
+typedef struct {
+    size_t line;            // Line within the chunk (0-based)
+    const char* message;
+} ChunkError;
+
+// Per-thread parse output for one newline-aligned chunk of the file
+typedef struct {
+    const char* begin;
+    const char* end;
+    PhenoToken* tokens;
+    size_t* token_lines;
+    size_t token_count;
+    size_t token_cap;
+    PhenoEdge* relations;
+    size_t relation_count;
+    size_t relation_cap;
+    ChunkError* errors;
+    size_t error_count;
+    size_t error_cap;
+    TokenScanStats stats;
+    size_t first_line;      // Absolute line of begin, set during the merge
+    size_t token_offset;    // Position of the chunk's records in the set
+    size_t relation_offset;
+    bool failed;
+} LoadChunk;
+
+typedef struct {
+    LoadChunk* chunks;
+    PhenoToken* tokens;
+    PhenoEdge* relations;
+} LoadState;
+
+static bool grow(void** array, size_t* cap, size_t need, size_t elem) {
+    if (need <= *cap) return true;
+    
+    size_t cap_new = *cap ? *cap * 2 : 1024;
+    while (cap_new < need) cap_new *= 2;
+    void* array_new = realloc(*array, cap_new * elem);
+    if (!array_new) return false;
+    *array = array_new;
+    *cap = cap_new;
+    return true;
+}
+
+static void chunk_token(const TokenRecord* rec, void* user) {
+    LoadChunk* chunk = (LoadChunk*)user;
+    size_t cap = chunk->token_cap;
+    if (chunk->failed ||
+        !grow((void**)&chunk->tokens, &cap, chunk->token_count + 1, sizeof(PhenoToken)) ||
+        !grow((void**)&chunk->token_lines, &chunk->token_cap, chunk->token_count + 1, sizeof(size_t))) {
+        chunk->failed = true;
+        return;
+    }
+    token_set_init_token(&chunk->tokens[chunk->token_count], rec);
+    chunk->token_lines[chunk->token_count++] = rec->line;
+}
+
+static void chunk_relation(const RelationRecord* rec, void* user) {
+    LoadChunk* chunk = (LoadChunk*)user;
+    if (chunk->failed ||
+        !grow((void**)&chunk->relations, &chunk->relation_cap, chunk->relation_count + 1, sizeof(PhenoEdge))) {
+        chunk->failed = true;
+        return;
+    }
+    token_set_init_relation(&chunk->relations[chunk->relation_count++], rec);
+}
+
+// Held back until the merge knows the chunk's first line
+static void chunk_error(const char* source, size_t line, const char* message, void* user) {
+    LoadChunk* chunk = (LoadChunk*)user;
+    (void)source;
+    if (chunk->failed ||
+        !grow((void**)&chunk->errors, &chunk->error_cap, chunk->error_count + 1, sizeof(ChunkError))) {
+        chunk->failed = true;
+        return;
+    }
+    chunk->errors[chunk->error_count++] = (ChunkError){ line, message };
+}
+
+static void load_scan(void* arg, int tid, int nthreads) {
+    LoadState* state = (LoadState*)arg;
+    LoadChunk* chunk = &state->chunks[tid];
+    (void)nthreads;
+    
+    TokenScanHandler handler = {
+        .on_token = chunk_token,
+        .on_relation = chunk_relation,
+        .on_error = chunk_error,
+        .user = chunk
+    };
+    token_scan_buffer(chunk->begin, (size_t)(chunk->end - chunk->begin), 0, &handler, &chunk->stats);
+}
+
+static void load_copy(void* arg, int tid, int nthreads) {
+    LoadState* state = (LoadState*)arg;
+    LoadChunk* chunk = &state->chunks[tid];
+    (void)nthreads;
+    
+    if (chunk->token_count) {
+        memcpy(&state->tokens[chunk->token_offset], chunk->tokens,
+               chunk->token_count * sizeof(PhenoToken));
+    }
+    if (chunk->relation_count) {
+        memcpy(&state->relations[chunk->relation_offset], chunk->relations,
+               chunk->relation_count * sizeof(PhenoEdge));
+    }
+}
+
+// Absolute line of the token at a set position
+static size_t load_token_line(const LoadChunk* chunks, int nchunks, size_t index) {
+    int lo = 0, hi = nchunks - 1;
+    while (lo < hi) {
+        int mid = (lo + hi + 1) / 2;
+        if (chunks[mid].token_offset <= index) lo = mid;
+        else hi = mid - 1;
+    }
+    return chunks[lo].first_line + chunks[lo].token_lines[index - chunks[lo].token_offset];
+}
+
+// Warn about token ids defined more than once (all copies are kept)
+static void load_check_duplicates(const LoadChunk* chunks, int nchunks,
+                                  const PhenoToken* tokens, size_t count,
+                                  const char* filename) {
+    PhenoIdMap seen;
+    if (!pheno_id_map_init(&seen, count)) return;
+    
+    size_t reserved_first = SIZE_MAX;   // PHENO_ID_MAP_EMPTY cannot be a map key
+    for (size_t i = 0; i < count; i++) {
+        uint32_t first;
+        if (tokens[i].token_id == PHENO_ID_MAP_EMPTY) {
+            if (reserved_first == SIZE_MAX) {
+                reserved_first = i;
+                continue;
+            }
+            first = (uint32_t)reserved_first;
+        } else if (pheno_id_map_insert(&seen, tokens[i].token_id, (uint32_t)i, &first) != 0) {
+            continue;
+        }
+        fprintf(stderr, "[PARSER] %s:%zu: duplicate token id 0x%08X (first defined at line %zu)\n",
+                filename, load_token_line(chunks, nchunks, i), tokens[i].token_id,
+                load_token_line(chunks, nchunks, first));
+    }
+    pheno_id_map_free(&seen);
+}
+
+PhenoToken* token_set_load(const char* filename, int threads, int* count) {
+    if (count) *count = 0;
+    if (!filename) return NULL;
+    
+    TokenFileMap map;
+    if (!token_file_map(filename, &map)) {
+        printf("[PARSER] Could not open file: %s\n", filename);
+        return NULL;
+    }
+    
+    int nchunks = pheno_parallel_threads(threads);
+    if ((size_t)nchunks > map.size / LOAD_MIN_CHUNK) {
+        nchunks = (int)(map.size / LOAD_MIN_CHUNK);
+        if (nchunks < 1) nchunks = 1;
+    }
+    
+    LoadChunk* chunks = (LoadChunk*)calloc((size_t)nchunks, sizeof(LoadChunk));
+    if (!chunks) {
+        token_file_unmap(&map);
+        return NULL;
+    }
+    
+    // Newline-aligned split: each boundary moves past the next newline
+    const char* limit = map.data + map.size;
+    const char* cursor = map.data;
+    for (int c = 0; c < nchunks; c++) {
+        const char* end = map.data + map.size * (size_t)(c + 1) / (size_t)nchunks;
+        if (end < cursor) end = cursor;
+        if (end < limit && c + 1 < nchunks) {
+            const char* newline = end > map.data ? memchr(end - 1, '\n', (size_t)(limit - end + 1)) : NULL;
+            end = newline ? newline + 1 : limit;
+        } else {
+            end = limit;
+        }
+        chunks[c].begin = cursor;
+        chunks[c].end = end;
+        cursor = end;
+    }
+    
+    LoadState state = { chunks, NULL, NULL };
+    pheno_parallel_run(nchunks, load_scan, &state);
+    
+    // Merge: prefix sums give every chunk its lines and output offsets
+    size_t line = 1, token_total = 0, relation_total = 0;
+    bool failed = false;
+    for (int c = 0; c < nchunks; c++) {
+        chunks[c].first_line = line;
+        chunks[c].token_offset = token_total;
+        chunks[c].relation_offset = relation_total;
+        line += chunks[c].stats.lines;
+        token_total += chunks[c].token_count;
+        relation_total += chunks[c].relation_count;
+        failed |= chunks[c].failed;
+        
+        for (size_t e = 0; e < chunks[c].error_count; e++) {
+            fprintf(stderr, "[PARSER] %s:%zu: %s\n", filename,
+                    chunks[c].first_line + chunks[c].errors[e].line, chunks[c].errors[e].message);
+        }
+    }
+    
+    PhenoToken* tokens = NULL;
+    if (!failed && token_total <= INT_MAX) {
+        tokens = token_set_alloc(token_total, relation_total);
+    }
+    if (tokens) {
+        state.tokens = tokens;
+        state.relations = token_set_header(tokens)->relations;
+        pheno_parallel_run(nchunks, load_copy, &state);
+        load_check_duplicates(chunks, nchunks, tokens, token_total, filename);
+        if (count) *count = (int)token_total;
+    } else {
+        printf("[PARSER] Could not allocate %zu tokens from %s\n", token_total, filename);
+    }
+    
+    for (int c = 0; c < nchunks; c++) {
+        free(chunks[c].tokens);
+        free(chunks[c].token_lines);
+        free(chunks[c].relations);
+        free(chunks[c].errors);
+    }
+    free(chunks);
+    token_file_unmap(&map);
+    return tokens;
+}
+
+// Parse a token file into one arena, using all online CPUs for large files
+PhenoToken* gosiuml_parse_file(const char* filename, int* count) {
+    static PhenoPerfProbe probe = PHENO_PERF_PROBE_INIT("token_parse");
+    PhenoPerfMark mark;
+    pheno_perf_probe_begin(&mark);
+    // Precompiled .gtok files skip the text scan
+    PhenoToken* tokens = gtok_probe(filename) ? gtok_load_set(filename, count)
+                                              : token_set_load(filename, 0, count);
+    pheno_perf_probe_end(&probe, &mark);
+    return tokens;
+}
+
+// Release a set returned by gosiuml_parse_file (one free, any size)
+void gosiuml_free_tokens(PhenoToken* tokens, int count) {
+    (void)count;
+    if (!tokens) return;
+    
+    if (!token_set_header(tokens)) {
+        fprintf(stderr, "[PARSER] gosiuml_free_tokens: %p is not a parsed token set\n", (void*)tokens);
+        return;
+    }
+    token_set_free(tokens);
+}
+
+const PhenoEdge* gosiuml_token_relations(const PhenoToken* tokens, size_t* count) {
+    TokenSetHeader* header = token_set_header(tokens);
+    if (count) *count = header ? header->relation_count : 0;
+    return header ? header->relations : NULL;
+}
@@ -0,0 +1,42 @@
+GosiUML token diagram template (gosiuml-cli svg <input> <output.svg> <template>)
+
+Text outside {{#block}} ... {{/block}} pairs is ignored. Blocks:
+  header        width, height, cx (= width / 2)
+  edges_open    written before the edges when there are any; as header
+  edge          x1, y1, x2, y2: centres of the two node boxes
+  edges_close   as header
+  node          x, y (box corner), cx, cy (box centre), id, type
+  footer        as header
+Fields a block does not set render as 0 or empty text.
+Numbers take an offset ({{y+25}}) and |hex; text takes |xml or |json.
+Node boxes are laid out as 180 x 120.
+
+{{#header}}
+<?xml version="1.0" encoding="UTF-8"?>
+<svg xmlns="http://www.w3.org/2000/svg" width="{{width}}" height="{{height}}" viewBox="0 0 {{width}} {{height}}">
+  <title>PhenoMemory State Machine Visualization</title>
+  <rect width="{{width}}" height="{{height}}" fill="#f5f5f5"/>
+  <text x="{{cx}}" y="30" text-anchor="middle" font-family="monospace" font-size="18" font-weight="bold">PhenoMemory Token State Visualization</text>
+{{/header}}
+
+{{#edges_open}}
+  <g class="edges">
+{{/edges_open}}
+
+{{#edge}}
+    <line x1="{{x1}}" y1="{{y1}}" x2="{{x2}}" y2="{{y2}}" stroke="#90A4AE" stroke-width="1.5"/>
+{{/edge}}
+
+{{#edges_close}}
+  </g>
+{{/edges_close}}
+
+{{#node}}
+  <rect x="{{x}}" y="{{y}}" width="180" height="120" fill="#e8f4f8" stroke="#2196F3" stroke-width="2" rx="5"/>
+  <text x="{{cx}}" y="{{y+25}}" text-anchor="middle" font-family="monospace" font-size="14" font-weight="bold">{{type|xml}}</text>
+  <text x="{{cx}}" y="{{y+45}}" text-anchor="middle" font-family="monospace" font-size="12">ID: 0x{{id|hex}}</text>
+{{/node}}
+
+{{#footer}}
+</svg>
+{{/footer}}